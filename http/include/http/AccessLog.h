@@ -0,0 +1,75 @@
+#pragma once
+
+#include "http/HttpRequest.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/AsyncLogging.h>
+#include <mymuduo/Timestamp.h>
+
+#include <string>
+#include <string.h>
+#include <netinet/in.h>
+
+namespace http
+{
+    /**
+     * @brief 一条HTTP访问日志记录
+     * 记录随HttpContext按连接预先分配、请求之间复用，填充时只做memcpy和赋值，不构造std::string。
+     * 几个时间点都取自Timestamp::now()，格式化成文本时才换算成耗时(微秒)。
+     */
+    struct AccessLogRecord
+    {
+        static const int kMaxPathLength = 256;
+
+        AccessLogRecord()
+            : method(HttpRequest::kInvalid), pathLength(0), status(0), responseBytes(0), peerAddr()
+        {
+        }
+
+        // path超过kMaxPathLength的部分被截断
+        void setPath(const std::string &p)
+        {
+            pathLength = p.size() < kMaxPathLength ? static_cast<int>(p.size()) : kMaxPathLength;
+            ::memcpy(path, p.data(), pathLength);
+        }
+
+        HttpRequest::Method method;
+        char path[kMaxPathLength];
+        int pathLength;
+        int status;
+        size_t responseBytes;
+        sockaddr_in peerAddr;
+
+        mymuduo::Timestamp receiveTime;  // 请求首个字节随poll返回的时刻
+        mymuduo::Timestamp parsedTime;   // 请求行和请求头解析完成
+        mymuduo::Timestamp handledTime;  // httpCallback返回且响应已经序列化
+        mymuduo::Timestamp lastByteTime; // 响应最后一个字节写入内核，连接提前关闭时为invalid
+    };
+
+    /**
+     * @brief 访问日志，写入独立的AsyncLogging实例，和LOG_INFO等运行日志分开落盘
+     * 每行格式：
+     * 2023/02/19 12:00:00.123456 127.0.0.1:50000 GET /hello 200 154 parse_us=12 handler_us=3 ttlb_us=40
+     * ttlb_us(time to last byte)从请求首字节到达算到响应最后一个字节写入内核，未写完就断开的连接记为'-'
+     */
+    class AccessLog : mymuduo::noncopyable
+    {
+    public:
+        static const int kMaxLineLength = 512;
+
+        explicit AccessLog(const std::string &basename, int flushInterval = 2);
+        ~AccessLog();
+
+        void start() { output_.start(); }
+        void stop() { output_.stop(); }
+
+        // 线程安全，多个IO线程可以同时调用
+        void append(const AccessLogRecord &record);
+
+        // 把record格式化成一行文本写入buf(至少kMaxLineLength字节)，返回长度
+        static int format(const AccessLogRecord &record, char *buf);
+
+    private:
+        mymuduo::AsyncLogging output_;
+    };
+} // namespace http
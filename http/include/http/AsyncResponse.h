@@ -0,0 +1,122 @@
+#pragma once
+
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/AccessLog.h"
+#include "http/Compression.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/Callbacks.h>
+#include <mymuduo/Timestamp.h>
+#include <mymuduo/Buffer.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace mymuduo
+{
+    class EventLoop;
+} // namespace mymuduo
+
+namespace http
+{
+    class HttpServer;
+    class Http2Connection;
+    struct CachedResponse;
+
+    /**
+     * @brief 可以在其他线程里完成的HTTP响应
+     * HttpServer把解析好的请求交给AsyncResponse(swap，不拷贝)，异步回调可以把它转交给计算线程池，
+     * 填好response()后调用done()。序列化和发送总是回到连接所在的IO线程执行，
+     * 同一连接上流水线请求的响应按请求顺序发出，先完成的排在未完成的后面等待。
+     * done()之前只有持有者一个线程访问request()/response()，不需要加锁。
+     *
+     * 反向代理这类边收边发的场景不经过response()，而是在IO线程里用sendRaw()直接发送调用方
+     * 自己组装好的报文(状态行、头部、body)，最后用finishRaw()结束。排在前面的响应还没发完时，
+     * sendRaw()的数据先暂存起来，轮到它时再发。
+     *
+     * 很大或者边生成边发的响应用流式接口代替done()：beginStream()先发出response()的状态行和头部，
+     * 之后每次write()发一块body(HTTP/1.1用chunked编码)，end()结束。内存占用只和高水位有关，
+     * 生产者在writable()为false时暂停，等可写回调再继续。
+     *
+     * HTTP/2的请求(request().getVersion() == kHttp20)每个流一个AsyncResponse，流之间不排队；
+     * done()和流式接口照常使用，响应按HEADERS和DATA帧发出。sendRaw()发的是HTTP/1报文，不能用于HTTP/2。
+     */
+    class AsyncResponse : mymuduo::noncopyable, public std::enable_shared_from_this<AsyncResponse>
+    {
+    public:
+        AsyncResponse(HttpServer *server, const mymuduo::TcpConnectionPtr &conn, bool close);
+
+        const HttpRequest &request() const { return request_; }
+        HttpResponse *response() { return &response_; }
+
+        // 线程安全，只能调用一次，之后不能再访问request()/response()。连接已经断开或HttpServer已经析构时响应被丢弃
+        void done();
+
+        // 只能在IO线程调用，返回false表示连接已经断开(HTTP/2的请求总是返回false)
+        bool sendRaw(const char *data, size_t len);
+        // 线程安全，结束sendRaw发送的报文，代替done()。status只用于指标和访问日志，close为true时发完后关闭连接
+        void finishRaw(int status, bool close);
+
+        // 以下是流式响应，线程安全。同一个响应的调用要来自同一个线程，或者都在IO线程里，保证顺序
+        // 按response()的状态码和头部发出报文头，调用之后不能再修改response()。
+        // HTTP/1.0的请求不分块，body以关闭连接结束；HttpServer开启了压缩时按Accept-Encoding逐块压缩
+        void beginStream();
+        // 发送一块body，返回false表示连接已经断开。不在IO线程调用时会拷贝一份数据
+        bool write(const char *data, size_t len);
+        bool write(const std::string &data) { return write(data.data(), data.size()); }
+        // 发出结尾的空块，结束响应
+        void end();
+        // 输出缓冲区积压超过HttpServer::setHighWaterMark时变为false，缓冲区写空后恢复。sendRaw()也一样
+        bool writable() const { return writable_.load(std::memory_order_acquire); }
+        // 在beginStream()之前设置，在IO线程里调用：恢复可写时，或者连接断开时(之后write()返回false)。
+        // end()或连接断开后回调被清掉，所以回调里可以持有AsyncResponsePtr
+        void setWritableCallback(const std::function<void()> &cb) { writableCallback_ = cb; }
+
+        mymuduo::EventLoop *getLoop() const { return loop_; }
+        // 连接已经销毁时返回空
+        mymuduo::TcpConnectionPtr connection() const { return conn_.lock(); }
+
+    private:
+        friend class HttpServer;
+        friend class Http2Connection;
+
+        // HttpServer复用已经发出的响应对象，只在IO线程里、没有其他持有者时调用
+        void reset(bool close);
+        void doneInLoop();
+        void beginStreamInLoop();
+        void writeInLoop(const char *data, size_t len);
+        void endInLoop();
+        // 按chunked编码(或原样)发出一块，data为空时不发
+        void sendChunk(const char *data, size_t len);
+        // 以下由HttpServer在IO线程里调用
+        void onStreamWritable();
+        void onStreamClosed();
+
+        std::weak_ptr<HttpServer> server_; // HttpServer析构之后才完成的响应拿不到它，直接丢弃
+        std::weak_ptr<mymuduo::TcpConnection> conn_;
+        mymuduo::EventLoop *loop_;
+        HttpRequest request_;
+        HttpResponse response_;
+        uint32_t streamId_;      // HTTP/2的流ID，HTTP/1为0
+        mymuduo::Timestamp start_;
+        bool completed_;         // 只在IO线程读写
+        bool hasAccessLog_;
+        AccessLogRecord record_; // 开启访问日志时在收到请求时填好，发送时再补上状态码和字节数
+        bool raw_;               // 以下由sendRaw()/finishRaw()填写
+        int rawStatus_;
+        size_t rawBytes_;
+        mymuduo::Buffer rawBuffer_; // 轮到本响应之前sendRaw的数据
+        std::shared_ptr<const CachedResponse> cached_; // 命中响应缓存时不调用回调，轮到它时直接发送
+        bool streaming_;         // 以下由流式接口使用，除了两个atomic都只在IO线程读写
+        bool chunked_;
+        bool headOnly_;          // HEAD请求只发头部，忽略write()
+        std::atomic_bool writable_;
+        std::atomic_bool closed_;
+        std::function<void()> writableCallback_;
+        std::unique_ptr<StreamCompressor> compressor_;
+    };
+
+    using AsyncResponsePtr = std::shared_ptr<AsyncResponse>;
+} // namespace http
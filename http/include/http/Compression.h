@@ -0,0 +1,95 @@
+#pragma once
+
+#include <mymuduo/noncopyable.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http
+{
+    class HttpRequest;
+    class HttpResponse;
+
+    /**
+     * @brief 流式压缩器，一段一段地喂数据，压缩结果追加到调用方的string里
+     * gzip用zlib，br用libbrotlienc，编译时没有找到对应的库时available()返回false
+     */
+    class StreamCompressor : mymuduo::noncopyable
+    {
+    public:
+        enum Encoding
+        {
+            kIdentity,
+            kGzip,
+            kBrotli,
+        };
+
+        // level为-1时用各自的默认级别(gzip 6，br 5)
+        explicit StreamCompressor(Encoding encoding, int level = -1);
+        ~StreamCompressor();
+
+        Encoding encoding() const { return encoding_; }
+        bool ok() const { return ok_; }
+
+        // flush为true时把目前为止的输入全部输出，用于流式响应的每一块，压缩率会差一些
+        bool update(const char *data, size_t len, std::string *out, bool flush = false);
+        // 输出剩下的数据和结尾，之后不能再update
+        bool finish(std::string *out);
+
+        static bool available(Encoding encoding);
+        // Content-Encoding的取值
+        static const char *encodingName(Encoding encoding);
+
+    private:
+        struct Impl;
+
+        bool run(const char *data, size_t len, std::string *out, int mode);
+
+        Encoding encoding_;
+        bool ok_;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    /**
+     * @brief 按Accept-Encoding压缩响应body，见HttpServer::setCompressor
+     * 只压缩不小于minSize、Content-Type在白名单里、还没有Content-Encoding的响应；
+     * 白名单里的响应不管压没压缩都带Vary: Accept-Encoding，中间的缓存才不会把压缩版本发给不支持的客户端。
+     */
+    class ResponseCompressor : mymuduo::noncopyable
+    {
+    public:
+        ResponseCompressor();
+
+        // 以下设置要在HttpServer::start()之前调用
+        // 默认1024字节，太小的body压缩后省不了多少，还要多花CPU
+        void setMinSize(size_t bytes) { minSize_ = bytes; }
+        void setLevel(int level) { level_ = level; }
+        // 默认在库可用时开启
+        void setBrotli(bool on) { brotli_ = on && StreamCompressor::available(StreamCompressor::kBrotli); }
+        // Content-Type前缀，默认text/、application/json、application/javascript、application/xml、image/svg+xml
+        void addContentType(const std::string &prefix) { contentTypes_.push_back(prefix); }
+        void clearContentTypes() { contentTypes_.clear(); }
+
+        // 按客户端的偏好(q值)选一个可用的编码，都不接受时返回kIdentity
+        StreamCompressor::Encoding negotiate(const HttpRequest &req) const;
+        bool compressible(const std::string &contentType) const;
+
+        // 压缩body并设置Content-Encoding和Vary，返回是否压缩了
+        bool compress(const HttpRequest &req, HttpResponse *resp) const;
+        // 流式响应用：可以压缩时设置好头部并返回压缩器，之后每一块用update(..., flush=true)
+        std::unique_ptr<StreamCompressor> compressStream(const HttpRequest &req, HttpResponse *resp) const;
+
+        // 解析Accept-Encoding，返回各编码的q值(0表示不接受)
+        static void parseAcceptEncoding(const std::string &acceptEncoding, double *gzip, double *brotli);
+
+    private:
+        // Content-Type可以压缩并且还没有Content-Encoding时加上Vary: Accept-Encoding，返回true
+        bool addVary(HttpResponse *resp) const;
+
+        size_t minSize_;
+        int level_;
+        bool brotli_;
+        std::vector<std::string> contentTypes_;
+    };
+} // namespace http
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <mymuduo/noncopyable.h>
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace http
+{
+    using HpackHeader = std::pair<std::string, std::string>;
+
+    /**
+     * @brief HPACK(RFC 7541)的索引表：61项静态表加上按先进先出淘汰的动态表
+     * 编号1~61是静态表，62开始是动态表，最新加入的编号最小
+     */
+    class HpackTable
+    {
+    public:
+        static const size_t kStaticTableSize = 61;
+        // 每个条目除了名字和值还按32字节计算开销
+        static const size_t kEntryOverhead = 32;
+
+        explicit HpackTable(size_t maxSize = 4096);
+
+        // 缩小时立即淘汰超出的条目
+        void setMaxSize(size_t maxSize);
+        size_t maxSize() const { return maxSize_; }
+        size_t size() const { return size_; }
+
+        // 放不下的条目会清空整个动态表
+        void add(const std::string &name, const std::string &value);
+        // 编号非法时返回空
+        const HpackHeader *get(size_t index) const;
+        // 返回名字和值都相同的编号，没有时返回0，*nameIndex设为名字相同的编号(也可能为0)
+        size_t find(const std::string &name, const std::string &value, size_t *nameIndex) const;
+
+    private:
+        void evict(size_t maxSize);
+
+        std::deque<HpackHeader> entries_;
+        size_t size_;
+        size_t maxSize_;
+    };
+
+    class HpackDecoder : mymuduo::noncopyable
+    {
+    public:
+        HpackDecoder();
+
+        // 我方SETTINGS_HEADER_TABLE_SIZE，对方发来的表大小更新不能超过它
+        void setMaxTableSize(size_t maxSize) { maxTableSize_ = maxSize; }
+        // 头部列表(名字+值+32)的上限，超过时decode失败
+        void setMaxHeaderListSize(size_t maxSize) { maxHeaderListSize_ = maxSize; }
+
+        // 解码一个完整的头部块，追加到headers。返回false表示压缩错误，动态表已经不可用，连接必须关闭
+        bool decode(const char *data, size_t len, std::vector<HpackHeader> *headers);
+
+        // 解码Huffman编码的字符串，追加到out，编码非法时返回false
+        static bool huffmanDecode(const char *data, size_t len, std::string *out);
+
+    private:
+        bool decodeString(const unsigned char *&p, const unsigned char *end, std::string *out);
+
+        HpackTable table_;
+        size_t maxTableSize_;
+        size_t maxHeaderListSize_;
+    };
+
+    class HpackEncoder : mymuduo::noncopyable
+    {
+    public:
+        HpackEncoder();
+
+        // 对方的SETTINGS_HEADER_TABLE_SIZE，自己的动态表不超过4096，下一个头部块开头带上表大小更新
+        void setMaxTableSize(size_t maxSize);
+
+        // 开始一个新的头部块
+        void beginBlock(std::string *out);
+        // name必须是小写。index为false时不进动态表(每次都变的值，比如content-length)
+        void encode(const std::string &name, const std::string &value, std::string *out, bool index = true);
+
+        static size_t huffmanEncodedLength(const char *data, size_t len);
+        static void huffmanEncode(const char *data, size_t len, std::string *out);
+
+        // N位前缀的整数，first是第一个字节前缀以外的高位
+        static void encodeInteger(uint64_t value, int prefixBits, unsigned char first, std::string *out);
+
+    private:
+        void encodeString(const std::string &str, std::string *out);
+
+        HpackTable table_;
+        size_t pendingTableSize_;    // 待发送的表大小更新，-1表示没有
+        size_t pendingMinTableSize_; // 上次发送以来最小的表大小
+    };
+} // namespace http
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "http/HttpRequest.h"
+#include "http/Hpack.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/Buffer.h>
+#include <mymuduo/Callbacks.h>
+#include <mymuduo/Timestamp.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http
+{
+    class HttpServer;
+    class HttpResponse;
+    class AsyncResponse;
+
+    /**
+     * @brief 一个HTTP/2(h2c)连接，见HttpServer::enableHttp2
+     * 由HttpServer在收到连接前言(prior knowledge)或者Upgrade: h2c升级成功后创建，挂在HttpContext上，
+     * 之后连接上的数据都交给它。每个流收齐请求后转成HttpRequest，交给HttpServer按HTTP/1的同一套回调处理，
+     * 流之间互不等待；响应的DATA按双方的流量控制窗口在各个流之间轮流发送。
+     * 所有函数都在连接所在的IO线程里调用。
+     */
+    class Http2Connection : mymuduo::noncopyable
+    {
+    public:
+        enum FrameType
+        {
+            kData = 0x0,
+            kHeaders = 0x1,
+            kPriority = 0x2,
+            kRstStream = 0x3,
+            kSettings = 0x4,
+            kPushPromise = 0x5,
+            kPing = 0x6,
+            kGoAway = 0x7,
+            kWindowUpdate = 0x8,
+            kContinuation = 0x9,
+        };
+
+        enum ErrorCode
+        {
+            kNoError = 0x0,
+            kProtocolError = 0x1,
+            kInternalError = 0x2,
+            kFlowControlError = 0x3,
+            kStreamClosed = 0x5,
+            kFrameSizeError = 0x6,
+            kRefusedStream = 0x7,
+            kCancel = 0x8,
+            kCompressionError = 0x9,
+            kEnhanceYourCalm = 0xb,
+        };
+
+        static const size_t kFrameHeaderLength = 9;
+        // 客户端连接前言
+        static const char kPreface[];
+        static const size_t kPrefaceLength = 24;
+
+        Http2Connection(HttpServer *server, const mymuduo::TcpConnectionPtr &conn);
+        ~Http2Connection();
+
+        // 发送服务器的SETTINGS，之后等客户端的连接前言
+        void start();
+        // Upgrade: h2c：HTTP2-Settings(base64url编码的SETTINGS载荷)，格式不对时返回false
+        bool applyUpgradeSettings(const std::string &settings);
+        // Upgrade: h2c：升级的请求成为流1，start()之后调用
+        void startUpgradedStream(HttpRequest &request);
+
+        void onMessage(const mymuduo::TcpConnectionPtr &conn, mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime);
+        // 输出缓冲区写空，继续发送因为积压停下的DATA
+        void onWriteComplete();
+        // 连接已经断开
+        void onClosed();
+        // 优雅退出：发送GOAWAY，在途的流处理完后关闭连接
+        void goAway();
+
+        // 以下由HttpServer调用，流已经被重置或连接已经断开时返回false
+        // 一次发出完整的响应，headOnly时只发头部
+        bool sendResponse(uint32_t streamId, const HttpResponse &response, bool headOnly, size_t *bytes);
+        // 流式响应：先发头部，再逐块sendData，最后endStream为true
+        bool sendHeaders(uint32_t streamId, const HttpResponse &response, bool endStream, size_t *bytes);
+        bool sendData(uint32_t streamId, const char *data, size_t len, bool endStream);
+        // 流上还没发出去的字节(被流量控制挡住的)加上连接的输出缓冲区，超过高水位时流式响应暂停
+        size_t backlog(uint32_t streamId) const;
+        // 异步处理中的响应，流被重置或连接断开时通知它
+        void setResponse(uint32_t streamId, const std::shared_ptr<AsyncResponse> &response);
+
+    private:
+        struct Stream
+        {
+            Stream(uint32_t streamId, int64_t window, int64_t receiveWindow)
+                : id(streamId),
+                  sendWindow(window),
+                  recvWindow(receiveWindow),
+                  recvUnacked(0),
+                  buffered(0),
+                  remoteClosed(false),
+                  headersDone(false),
+                  endQueued(false),
+                  endSent(false)
+            {
+            }
+
+            uint32_t id;
+            HttpRequest request;
+            int64_t sendWindow;
+            int64_t recvWindow;
+            int64_t recvUnacked;     // 收到但还没有WINDOW_UPDATE的字节
+            int64_t buffered;        // 还没交给回调的请求体(含填充)，占着连接的缓存预算
+            bool remoteClosed;       // 请求已经收齐
+            bool headersDone;
+            bool endQueued;          // 响应的最后一块已经排队
+            bool endSent;
+            mymuduo::Buffer pending; // 被流量控制挡住的DATA
+            std::shared_ptr<AsyncResponse> response;
+        };
+
+        using StreamMap = std::map<uint32_t, std::unique_ptr<Stream>>;
+
+        // 处理一个完整的帧，返回false表示连接出错要关闭了
+        bool onFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char *payload, size_t len);
+        bool onData(uint8_t flags, uint32_t streamId, const char *payload, size_t len);
+        bool onHeaders(uint8_t flags, uint32_t streamId, const char *payload, size_t len);
+        bool onContinuation(uint8_t flags, uint32_t streamId, const char *payload, size_t len);
+        bool onHeaderBlock(uint32_t streamId, bool endStream);
+        // SETTINGS帧或HTTP2-Settings的载荷
+        bool applySettings(const char *payload, size_t len);
+        bool onWindowUpdate(uint32_t streamId, const char *payload, size_t len);
+        void onRstStream(uint32_t streamId);
+        // 把解码出的头部填进请求，头部不合法时返回false
+        bool fillRequest(Stream *stream, bool trailers);
+        void dispatch(Stream *stream);
+
+        void appendFrameHeader(size_t len, uint8_t type, uint8_t flags, uint32_t streamId);
+        // 头部块按对方的最大帧长度拆成HEADERS和CONTINUATION，contentLength小于0时不带content-length
+        size_t appendHeaderBlock(uint32_t streamId, const HttpResponse &response, int64_t contentLength, bool endStream);
+        void sendRstStream(uint32_t streamId, ErrorCode error);
+        void sendWindowUpdate(uint32_t streamId, uint32_t increment);
+        // 归还连接级的接收窗口，攒到一半再发WINDOW_UPDATE
+        void returnWindow(int64_t bytes);
+        // 请求体交给回调或者流关闭，腾出缓存预算
+        void releaseBody(Stream *stream);
+        // 连接错误：发GOAWAY后关闭
+        void connectionError(ErrorCode error);
+        // 按窗口在流之间轮流发送排队的DATA
+        void flushStreams();
+        // 积压降到高水位以下时恢复暂停的流式响应
+        void resumeStreams();
+        // 把攒下的帧交给TcpConnection
+        void flushOutput();
+        void closeStream(StreamMap::iterator it);
+        void closeIfDone();
+
+        HttpServer *server_;
+        std::weak_ptr<mymuduo::TcpConnection> conn_;
+        HpackDecoder decoder_;
+        HpackEncoder encoder_;
+        StreamMap streams_;
+        mymuduo::Buffer output_;   // 本轮要发出的帧
+        std::string headerBlock_;  // HEADERS + CONTINUATION拼起来的头部块
+        uint32_t headerStreamId_;  // 正在接收CONTINUATION的流，0表示没有
+        bool headerEndStream_;
+        std::vector<HpackHeader> decoded_;
+        bool prefaceReceived_;
+        bool goAwaySent_;
+        bool closed_;              // 连接出错或已经断开，不再处理数据
+        mymuduo::Timestamp receiveTime_;
+        uint32_t lastStreamId_;    // 收到的最大流ID
+        // 对方的设置
+        uint32_t peerMaxFrameSize_;
+        int64_t peerInitialWindow_;
+        int64_t sendWindow_;       // 连接级的发送窗口
+        int64_t recvWindow_;       // 连接级的接收窗口
+        int64_t recvUnacked_;
+        int64_t bufferedBody_;     // 所有流还没交给回调的请求体
+        int64_t recvOwed_;         // 超出预算时收下但还没归还的窗口，等腾出预算再还
+    };
+} // namespace http
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "http/AccessLog.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
 
 namespace mymuduo
 {
@@ -9,6 +15,10 @@ namespace mymuduo
 
 namespace http
 {
+    class AsyncResponse;
+    class WebSocketSession;
+    class Http2Connection;
+
     class HttpContext
     {
     public:
@@ -20,8 +30,13 @@ namespace http
             kGotAll,
         };
 
+        // 请求体上限，超过时按解析错误处理
+        static const size_t kMaxBodySize = 16 * 1024 * 1024;
+        // 头部个数上限，超过时按解析错误处理
+        static const size_t kMaxHeaders = 100;
+
         HttpContext()
-            : state_(kExpectRequestLine)
+            : state_(kExpectRequestLine), bodyRemaining_(0), statusCode_(0), response_(false)
         {
         }
 
@@ -29,17 +44,30 @@ namespace http
 
         // return false if any error
         bool parseRequest(mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime);
+        // 解析上游服务器响应的状态行和头部(反向代理用)，gotAll()之后buf里剩下的是body，由调用方按
+        // Content-Length/chunked处理。版本和头部同样存放在request()里
+        bool parseResponseHead(mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime);
+        int statusCode() const { return statusCode_; }
+        const std::string &statusMessage() const { return statusMessage_; }
 
         bool gotAll() const
         {
             return state_ == kGotAll;
         }
 
+        // 没有解析到一半的请求，也没有等待发送的响应
+        bool idle() const
+        {
+            return state_ == kExpectRequestLine && pendingResponses_.empty();
+        }
+
         void reset()
         {
             state_ = kExpectRequestLine;
-            HttpRequest dummy;
-            request_.swap(dummy);
+            request_.clear();
+            bodyRemaining_ = 0;
+            statusCode_ = 0;
+            statusMessage_.clear();
         }
 
         const HttpRequest &request() const
@@ -52,10 +80,72 @@ namespace http
             return request_;
         }
 
+        // 同步回调用的响应，每个请求清空后复用，body和头部的内存留给下一个请求
+        HttpResponse *response(bool close)
+        {
+            response_.clear(close);
+            return &response_;
+        }
+
+        // 上一个已经发出的AsyncResponse，留给下一个异步请求复用，见HttpServer::onRequest
+        std::shared_ptr<AsyncResponse> &spareResponse()
+        {
+            return spareResponse_;
+        }
+
+        // 响应已经交给TcpConnection，但最后一个字节还没写入内核的访问日志记录。
+        // 只在HttpServer开启访问日志时使用，clear()保留容量，稳态下不再分配内存
+        std::vector<AccessLogRecord> &pendingAccessLogs()
+        {
+            return pendingAccessLogs_;
+        }
+
+        // 已经收到请求、但响应还不能发送的AsyncResponse，按请求顺序排列。
+        // 队首完成后依次发送，直到遇到未完成的；没有异步请求在途时始终为空
+        std::deque<std::shared_ptr<AsyncResponse>> &pendingResponses()
+        {
+            return pendingResponses_;
+        }
+
+        // 升级成WebSocket之后连接上的数据都交给会话，不再按HTTP解析
+        void setWebSocket(const std::shared_ptr<WebSocketSession> &session)
+        {
+            webSocket_ = session;
+        }
+
+        const std::shared_ptr<WebSocketSession> &webSocket() const
+        {
+            return webSocket_;
+        }
+
+        // 切换到HTTP/2之后连接上的数据都交给Http2Connection
+        void setHttp2(const std::shared_ptr<Http2Connection> &http2)
+        {
+            http2_ = http2;
+        }
+
+        const std::shared_ptr<Http2Connection> &http2() const
+        {
+            return http2_;
+        }
+
     private:
         bool processRequestLine(const char *begin, const char *end);
+        bool processStatusLine(const char *begin, const char *end);
+        bool parse(mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime, bool isResponse);
+        // 头部结束后根据Content-Length决定是否还要读body
+        bool processHeadersEnd();
 
         HttpRequestParseState state_;
         HttpRequest request_;
+        size_t bodyRemaining_;
+        int statusCode_;
+        std::string statusMessage_;
+        HttpResponse response_;
+        std::shared_ptr<AsyncResponse> spareResponse_;
+        std::vector<AccessLogRecord> pendingAccessLogs_;
+        std::deque<std::shared_ptr<AsyncResponse>> pendingResponses_;
+        std::shared_ptr<WebSocketSession> webSocket_;
+        std::shared_ptr<Http2Connection> http2_;
     };
 } // namespace http
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <string.h>
+
+namespace http
+{
+    /**
+     * @brief 请求和响应头部的扁平容器，按设置的顺序存放，字段名大小写敏感
+     * 一个报文只有十来个头部，线性查找比map快，也没有树节点要分配。clear()只把size归零，
+     * 槽位里的string保留容量，连接上的下一个报文直接覆盖进去，稳态下解析头部不再分配内存
+     */
+    class HttpHeaders
+    {
+    public:
+        typedef std::pair<std::string, std::string> Header;
+        typedef std::vector<Header>::const_iterator const_iterator;
+
+        // clear()时容量超过这个值的槽位释放掉，偶尔一个很长的头部不会一直占着内存
+        static const size_t kMaxRetainedSize = 4096;
+
+        HttpHeaders()
+            : size_(0)
+        {
+        }
+
+        const_iterator begin() const { return entries_.begin(); }
+        const_iterator end() const { return entries_.begin() + size_; }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        const_iterator find(const char *field, size_t len) const
+        {
+            const_iterator it = begin();
+            for (; it != end(); ++it)
+            {
+                if (it->first.size() == len && ::memcmp(it->first.data(), field, len) == 0)
+                {
+                    break;
+                }
+            }
+            return it;
+        }
+
+        const_iterator find(const std::string &field) const
+        {
+            return find(field.data(), field.size());
+        }
+
+        const_iterator find(const char *field) const
+        {
+            return find(field, ::strlen(field));
+        }
+
+        size_t count(const std::string &field) const
+        {
+            return find(field) == end() ? 0 : 1;
+        }
+
+        size_t count(const char *field) const
+        {
+            return find(field) == end() ? 0 : 1;
+        }
+
+        // 没有这个头部时返回空串
+        const std::string &get(const char *field, size_t len) const
+        {
+            static const std::string kEmpty;
+            const_iterator it = find(field, len);
+            return it != end() ? it->second : kEmpty;
+        }
+
+        // 同名的字段覆盖原来的值
+        void set(const char *field, size_t fieldLen, const char *value, size_t valueLen)
+        {
+            const_iterator it = find(field, fieldLen);
+            if (it != end())
+            {
+                entries_[it - entries_.begin()].second.assign(value, valueLen);
+            }
+            else if (size_ < entries_.size())
+            {
+                Header &header = entries_[size_++];
+                header.first.assign(field, fieldLen);
+                header.second.assign(value, valueLen);
+            }
+            else
+            {
+                // 先拷贝再扩容，value可能就指向某个已有的头部
+                entries_.emplace_back(std::string(field, fieldLen), std::string(value, valueLen));
+                ++size_;
+            }
+        }
+
+        void set(const std::string &field, const std::string &value)
+        {
+            set(field.data(), field.size(), value.data(), value.size());
+        }
+
+        void clear()
+        {
+            for (size_t i = 0; i < size_; ++i)
+            {
+                shrink(&entries_[i].first);
+                shrink(&entries_[i].second);
+            }
+            size_ = 0;
+        }
+
+        void swap(HttpHeaders &that)
+        {
+            entries_.swap(that.entries_);
+            std::swap(size_, that.size_);
+        }
+
+    private:
+        static void shrink(std::string *s)
+        {
+            if (s->capacity() > kMaxRetainedSize)
+            {
+                std::string().swap(*s);
+            }
+        }
+
+        std::vector<Header> entries_; // 前size_个有效，后面是留着复用的空槽位
+        size_t size_;
+    };
+} // namespace http
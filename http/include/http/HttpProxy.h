@@ -0,0 +1,123 @@
+#pragma once
+
+#include "http/AsyncResponse.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/Callbacks.h>
+#include <mymuduo/InetAddress.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mymuduo
+{
+    class EventLoop;
+    class UpstreamPool;
+} // namespace mymuduo
+
+namespace http
+{
+    class HttpServer;
+
+    /**
+     * @brief 反向代理，把HttpServer收到的请求转发给一组上游服务器
+     *   HttpServer server(&loop, addr, "proxy");
+     *   HttpProxy proxy(&server, upstreams); // 在server.start()之前构造，在server之前析构
+     *   server.setAsyncHttpCallback(std::bind(&HttpProxy::handle, &proxy, _1));
+     *   server.start();
+     * 每个IO loop有自己的一组UpstreamPool，请求在收到它的loop上直接访问上游，不切换线程。
+     * 上游的响应边收边发给客户端(Content-Length、chunked或读到连接关闭)，不在内存里攒整个body；
+     * 请求体由HttpServer按Content-Length收齐后一次性转发。
+     * 被动健康检查：连续maxFails次连接失败/超时/响应非法后，该上游在failTimeout秒内不再被选中。
+     */
+    class HttpProxy : mymuduo::noncopyable
+    {
+    public:
+        enum Balance
+        {
+            kRoundRobin,
+            kLeastOutstanding, // 选在途请求最少的上游，所有loop共享计数
+        };
+
+        HttpProxy(HttpServer *server, const std::vector<mymuduo::InetAddress> &upstreams);
+        ~HttpProxy();
+
+        // 以下设置都要在server.start()之前调用
+        void setBalance(Balance balance) { balance_ = balance; }
+        // 默认连续失败3次后摘除10秒
+        void setHealthCheck(int maxFails, double failTimeout)
+        {
+            maxFails_ = maxFails;
+            failTimeout_ = failTimeout;
+        }
+        // 从选定上游到收完响应的总超时，默认30秒。还没有发出响应头时回复504，否则直接断开客户端
+        void setUpstreamTimeout(double seconds) { timeout_ = seconds; }
+        // 每个loop到每个上游最多保留的空闲keep-alive连接数，默认16
+        void setMaxIdlePerUpstream(size_t maxIdle) { maxIdle_ = maxIdle; }
+
+        // HttpServer的AsyncHttpCallback，在IO线程里调用
+        void handle(const AsyncResponsePtr &response);
+
+        size_t numUpstreams() const { return upstreams_.size(); }
+
+    private:
+        struct Upstream
+        {
+            explicit Upstream(const mymuduo::InetAddress &a)
+                : addr(a), fails(0), downUntil(0), outstanding(0)
+            {
+            }
+
+            const mymuduo::InetAddress addr;
+            std::atomic<int> fails;          // 连续失败次数
+            std::atomic<int64_t> downUntil;  // 摘除到这个时刻(微秒)，0表示可用
+            std::atomic<int> outstanding;    // 所有loop上在途的请求数
+        };
+        struct LoopState;
+        struct Exchange;
+        using ExchangePtr = std::shared_ptr<Exchange>;
+
+        void initLoop(mymuduo::EventLoop *loop);
+        void destroyLoopState(LoopState *state);
+
+        // 选一个可用的上游，exclude是刚失败、重试时要避开的那个；全部不可用时返回-1
+        int pickUpstream(int exclude);
+        void markFailure(int index);
+        void markSuccess(int index);
+
+        void startExchange(const ExchangePtr &ex, int exclude);
+        void onAcquired(const ExchangePtr &ex, int index, const mymuduo::TcpConnectionPtr &conn);
+        void onUpstreamConnection(const mymuduo::TcpConnectionPtr &conn);
+        void onUpstreamMessage(const mymuduo::TcpConnectionPtr &conn, mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime);
+        void onTimeout(const std::weak_ptr<Exchange> &weakEx);
+        // 解析响应头并转发，头部不完整时返回true等更多数据，出错返回false
+        bool forwardHead(const ExchangePtr &ex, mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime);
+        // 按分帧方式转发body，返回false表示上游数据非法或客户端已经断开
+        bool forwardBody(const ExchangePtr &ex, mymuduo::Buffer *buf);
+        // 上游出错：还能重试时换一个上游，否则回复status(响应头已经发出时直接断开客户端)
+        void fail(const ExchangePtr &ex, HttpResponse::HttpStatusCode status, const char *reason, bool upstreamFault);
+        // 结束一次转发。complete表示响应完整转发了，reusable表示上游连接可以放回池里
+        void finish(const ExchangePtr &ex, bool complete, bool reusable);
+        void replyError(const ExchangePtr &ex, HttpResponse::HttpStatusCode status, const char *message);
+        void detachUpstream(const ExchangePtr &ex, bool reusable);
+        // 在[data, data+len)中扫描chunked编码，返回可以原样转发的字节数
+        static size_t scanChunks(Exchange *ex, const char *data, size_t len, bool *done, bool *bad);
+
+        HttpServer *server_;
+        std::vector<std::unique_ptr<Upstream>> upstreams_;
+        Balance balance_;
+        int maxFails_;
+        double failTimeout_;
+        double timeout_;
+        size_t maxIdle_;
+        std::atomic<unsigned> next_; // 轮询的起点
+
+        // initLoop在各个loop线程里插入，server.start()返回后只读
+        std::mutex mutex_;
+        std::unordered_map<mymuduo::EventLoop *, LoopState *> loops_;
+    };
+} // namespace http
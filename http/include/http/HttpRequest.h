@@ -1,8 +1,10 @@
 #pragma once
 
+#include "http/HttpHeaders.h"
+
 #include <mymuduo/Timestamp.h>
 
-#include <map>
+#include <string>
 #include <assert.h>
 #include <stdio.h>
 
@@ -24,7 +26,8 @@ namespace http
         {
             kUnknown,
             kHttp10,
-            kHttp11
+            kHttp11,
+            kHttp20
         };
 
         HttpRequest()
@@ -80,9 +83,14 @@ namespace http
         }
 
         const char *methodString() const
+        {
+            return methodToString(method_);
+        }
+
+        static const char *methodToString(Method method)
         {
             const char *result = "UNKNOWN";
-            switch (method_)
+            switch (method)
             {
             case kGet:
                 result = "GET";
@@ -137,36 +145,70 @@ namespace http
 
         void addHeader(const char *start, const char *colon, const char *end)
         {
-            std::string field(start, colon);
-            ++colon;
-            while (colon < end && ::isspace(*colon))
+            const char *value = colon + 1;
+            while (value < end && ::isspace(*value))
             {
-                ++colon;
+                ++value;
             }
-            std::string value(colon, end);
-            while (!value.empty() && ::isspace(value[value.size() - 1]))
+            while (value < end && ::isspace(*(end - 1)))
             {
-                value.resize(value.size() - 1);
+                --end;
             }
-            headers_[field] = value;
+            headers_.set(start, colon - start, value, end - value);
         }
 
-        std::string getHeader(const std::string &field) const
+        // HTTP/2的头部由Http2Connection解码后逐个设置
+        void setHeader(const std::string &field, const std::string &value)
         {
-            std::string result;
-            std::map<std::string, std::string>::const_iterator it = headers_.find(field);
-            if (it != headers_.end())
-            {
-                result = it->second;
-            }
-            return result;
+            headers_.set(field, value);
         }
 
-        const std::map<std::string, std::string> &headers() const
+        // 没有这个头部时返回空串
+        const std::string &getHeader(const char *field) const
+        {
+            return headers_.get(field, ::strlen(field));
+        }
+
+        const std::string &getHeader(const std::string &field) const
+        {
+            return headers_.get(field.data(), field.size());
+        }
+
+        const HttpHeaders &headers() const
         {
             return headers_;
         }
 
+        void appendBody(const char *start, const char *end)
+        {
+            body_.append(start, end);
+        }
+
+        // 按Content-Length收齐的请求体
+        const std::string &body() const
+        {
+            return body_;
+        }
+
+        // 清空以便解析下一个请求，path、头部和body保留容量，很大的body释放掉
+        void clear()
+        {
+            method_ = kInvalid;
+            version_ = kUnknown;
+            path_.clear();
+            query_.clear();
+            receiveTime_ = mymuduo::Timestamp();
+            headers_.clear();
+            if (body_.capacity() > kMaxRetainedBodySize)
+            {
+                std::string().swap(body_);
+            }
+            else
+            {
+                body_.clear();
+            }
+        }
+
         void swap(HttpRequest &that)
         {
             std::swap(method_, that.method_);
@@ -175,15 +217,19 @@ namespace http
             query_.swap(that.query_);
             std::swap(receiveTime_, that.receiveTime_);
             headers_.swap(that.headers_);
+            body_.swap(that.body_);
         }
 
     private:
+        // clear()时保留的body容量上限，空闲的长连接不一直占着大块内存
+        static const size_t kMaxRetainedBodySize = 16 * 1024;
+
         Method method_;
         Version version_;
         std::string path_;
         std::string query_;
         mymuduo::Timestamp receiveTime_;
-        // headers: key_type -> field    value_type -> header
-        std::map<std::string, std::string> headers_;
+        HttpHeaders headers_;
+        std::string body_;
     };
 } // namespace http
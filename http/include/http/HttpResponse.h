@@ -1,6 +1,10 @@
 #pragma once
 
-#include <map>
+#include "http/HttpHeaders.h"
+
+#include <mymuduo/StringPiece.h>
+
+#include <string>
 
 namespace mymuduo
 {
@@ -15,15 +19,22 @@ namespace http
         enum HttpStatusCode
         {
             kUnknown,
+            k101SwitchingProtocols = 101,
             k200Ok = 200,
             k301MovedPermanently = 301,
+            k304NotModified = 304,
             k400BadRequest = 400,
             k404NotFound = 404,
+            k405MethodNotAllowed = 405,
+            k502BadGateway = 502,
+            k503ServiceUnavailable = 503,
+            k504GatewayTimeout = 504,
         };
 
         explicit HttpResponse(bool close)
             : statusCode_(kUnknown),
-              closeConnection_(close)
+              closeConnection_(close),
+              cacheTtl_(0)
         {
         }
 
@@ -32,9 +43,19 @@ namespace http
             statusCode_ = code;
         }
 
-        void setStatusMessage(const std::string &message)
+        HttpStatusCode statusCode() const
+        {
+            return statusCode_;
+        }
+
+        void setStatusMessage(mymuduo::StringPiece message)
+        {
+            statusMessage_.assign(message.data(), message.size());
+        }
+
+        const std::string &statusMessage() const
         {
-            statusMessage_ = message;
+            return statusMessage_;
         }
 
         void setCloseConnection(bool on)
@@ -47,15 +68,26 @@ namespace http
             return closeConnection_;
         }
 
-        void setContentType(const std::string &contentType)
+        void setContentType(mymuduo::StringPiece contentType)
         {
             addHeader("Content-Type", contentType);
         }
 
-        // FIXME: replace string with StringPiece
-        void addHeader(const std::string &key, const std::string &value)
+        // 同名的头部覆盖原来的值，按第一次设置的顺序发出
+        void addHeader(mymuduo::StringPiece key, mymuduo::StringPiece value)
         {
-            headers_[key] = value;
+            headers_.set(key.data(), key.size(), value.data(), value.size());
+        }
+
+        // 没有这个头部时返回空串
+        const std::string &getHeader(const char *key) const
+        {
+            return headers_.get(key, ::strlen(key));
+        }
+
+        const HttpHeaders &headers() const
+        {
+            return headers_;
         }
 
         void setBody(const std::string &body)
@@ -63,14 +95,64 @@ namespace http
             body_ = body;
         }
 
+        const std::string &body() const
+        {
+            return body_;
+        }
+
+        // 换入新的body，避免大body的复制
+        void swapBody(std::string &body)
+        {
+            body_.swap(body);
+        }
+
+        // HttpServer开启ResponseCache时，GET的200响应在seconds秒内直接从缓存回复，不再调用回调
+        void setCacheTtl(double seconds)
+        {
+            cacheTtl_ = seconds;
+        }
+
+        double cacheTtl() const
+        {
+            return cacheTtl_;
+        }
+
+        // 清空以便复用，状态消息和body保留容量，很大的body释放掉
+        void clear(bool close)
+        {
+            headers_.clear();
+            statusCode_ = kUnknown;
+            statusMessage_.clear();
+            closeConnection_ = close;
+            if (body_.capacity() > kMaxRetainedBodySize)
+            {
+                std::string().swap(body_);
+            }
+            else
+            {
+                body_.clear();
+            }
+            cacheTtl_ = 0;
+        }
+
         void appendToBuffer(mymuduo::Buffer *output) const;
+        // 流式响应的状态行和头部，不带Content-Length，chunked为false时body以关闭连接结束
+        void appendStreamHeadToBuffer(mymuduo::Buffer *output, bool chunked) const;
 
     private:
-        std::map<std::string, std::string> headers_;
+        // clear()时保留的body容量上限
+        static const size_t kMaxRetainedBodySize = 16 * 1024;
+
+        // 状态行、framing(Content-Length/Transfer-Encoding/Connection)和头部先算好总长度，一次写进output，
+        // extra是随后还要追加的body长度，一起预留
+        void appendHead(mymuduo::Buffer *output, const char *framing, size_t framingLen, size_t extra) const;
+
+        HttpHeaders headers_;
         HttpStatusCode statusCode_;
         // FIXME: add http version
         std::string statusMessage_;
         bool closeConnection_;
         std::string body_;
+        double cacheTtl_; // 0表示不缓存
     };
 } // namespace http
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/StringPiece.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http
+{
+    /**
+     * @brief 路由匹配时从路径里取出的参数，名字和值都指向路由表和请求路径，不拷贝
+     * 只在处理函数执行期间有效，需要保存时用as_string()
+     */
+    class RouteParams
+    {
+    public:
+        static const int kMaxParams = 8;
+
+        RouteParams() : size_(0) {}
+
+        int size() const { return size_; }
+        mymuduo::StringPiece name(int i) const { return names_[i]; }
+        mymuduo::StringPiece value(int i) const { return values_[i]; }
+        // 没有这个参数时返回空
+        mymuduo::StringPiece get(mymuduo::StringPiece name) const
+        {
+            for (int i = 0; i < size_; ++i)
+            {
+                if (names_[i] == name)
+                {
+                    return values_[i];
+                }
+            }
+            return mymuduo::StringPiece();
+        }
+
+        void clear() { size_ = 0; }
+
+    private:
+        friend class HttpRouter;
+
+        void push(mymuduo::StringPiece name, mymuduo::StringPiece value)
+        {
+            names_[size_] = name;
+            values_[size_] = value;
+            ++size_;
+        }
+        void pop() { --size_; }
+
+        mymuduo::StringPiece names_[kMaxParams];
+        mymuduo::StringPiece values_[kMaxParams];
+        int size_;
+    };
+
+    // 按方法和路径分发请求，路由编译成压缩前缀树(radix tree)
+    //   router.get("/users/:id", onUser);           // /users/42 -> id=42
+    //   router.get("/users/new", onNewUser);        // 静态段优先于参数
+    //   router.get("/static/*file", onStatic);      // /static/css/a.css -> file=css/a.css
+    //   server.setHttpCallback(std::bind(&HttpRouter::dispatch, &router, _1, _2));
+    // :name匹配一个非空的路径段，*name匹配剩下的全部(可以为空)，只能放在最后。
+    // 匹配时同一层按 静态 > 参数 > 通配 的顺序尝试，失败时回溯，不分配内存。
+    // 所有路由要在server.start()之前注册，之后只读，可以被多个IO线程同时使用。
+    class HttpRouter : mymuduo::noncopyable
+    {
+    public:
+        using Handler = std::function<void(const HttpRequest &, const RouteParams &, HttpResponse *)>;
+
+        HttpRouter();
+        ~HttpRouter();
+
+        // 同一方法同一路径重复注册、同一位置参数名不一致、参数太多时LOG_FATAL
+        void addRoute(HttpRequest::Method method, const std::string &pattern, const Handler &handler);
+        void get(const std::string &pattern, const Handler &handler) { addRoute(HttpRequest::kGet, pattern, handler); }
+        void post(const std::string &pattern, const Handler &handler) { addRoute(HttpRequest::kPost, pattern, handler); }
+        void put(const std::string &pattern, const Handler &handler) { addRoute(HttpRequest::kPut, pattern, handler); }
+        void del(const std::string &pattern, const Handler &handler) { addRoute(HttpRequest::kDelete, pattern, handler); }
+
+        // 没有匹配的路径时调用，默认回复404
+        void setNotFoundHandler(const Handler &handler) { notFound_ = handler; }
+
+        // 找到时返回处理函数并填好params；路径存在但方法不对时返回nullptr并置*methodNotAllowed
+        const Handler *find(HttpRequest::Method method, const std::string &path,
+                            RouteParams *params, bool *methodNotAllowed) const;
+
+        // 可以直接作为HttpServer::HttpCallback。方法不匹配时回复405，GET的路由也处理HEAD
+        void dispatch(const HttpRequest &req, HttpResponse *resp) const;
+
+    private:
+        struct Node;
+
+        static void insert(Node *node, const std::string &pattern, size_t pos, int numParams,
+                           HttpRequest::Method method, const Handler &handler);
+        // 找到有method处理函数的节点(HEAD也接受GET)。路径对上但方法不对的节点只记在*otherMethod里
+        // (按匹配顺序的第一个)，留作405，然后继续回溯其他分支
+        static const Node *match(const Node *node, const std::string &path, size_t pos, HttpRequest::Method method,
+                                 RouteParams *params, const Node **otherMethod);
+        static const Handler *handlerFor(const Node *node, HttpRequest::Method method);
+        static void allowedMethods(const Node *node, std::string *allow);
+
+        std::unique_ptr<Node> root_;
+        Handler notFound_;
+    };
+} // namespace http
@@ -2,21 +2,49 @@
 
 #include <mymuduo/TcpServer.h>
 
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace mymuduo
+{
+    class ThreadPool;
+    class TlsContext;
+} // namespace mymuduo
+
 namespace http
 {
     class HttpRequest;
     class HttpResponse;
+    class HttpContext;
+    class AccessLog;
+    struct AccessLogRecord;
+    class AsyncResponse;
+    class ResponseCache;
+    class ResponseCompressor;
+    class WebSocketServer;
+    class Http2Connection;
+    struct CachedResponse;
 
     class HttpServer : public mymuduo::noncopyable
     {
     public:
         using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+        using AsyncHttpCallback = std::function<void(const std::shared_ptr<AsyncResponse> &)>;
+
         HttpServer(mymuduo::EventLoop *loop,
                    const mymuduo::InetAddress &listenAddr,
                    const std::string &name,
                    mymuduo::TcpServer::Option option = mymuduo::TcpServer::kNoReusePort);
+        /// 使用已经在监听的socket，见mymuduo::ListenerHandoff
+        HttpServer(mymuduo::EventLoop *loop, int listenFd, const std::string &name);
+        // 先停掉计算线程池，再等每个subloop执行完手上的回调，之后迟到的AsyncResponse::done()被丢弃。
+        // 和TcpServer一样在baseloop线程里(或者baseloop退出之后)析构
+        ~HttpServer();
 
         mymuduo::EventLoop *getLoop() const { return server_.getLoop(); }
+        int listenFd() const { return server_.listenFd(); }
 
         /// Not thread safe, callback be registered before calling start().
         void setHttpCallback(const HttpCallback &cb)
@@ -24,22 +52,174 @@ namespace http
             httpCallback_ = cb;
         }
 
+        /// Not thread safe, callback be registered before calling start().
+        /// 设置后代替HttpCallback处理所有请求。回调在IO线程里被调用，可以当场填好响应并调用done()，
+        /// 也可以把AsyncResponse交给workerPool()，在计算线程里完成后再done()
+        void setAsyncHttpCallback(const AsyncHttpCallback &cb)
+        {
+            asyncHttpCallback_ = cb;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 计算线程池的线程数，默认0表示不创建线程，workerPool()->run()直接在调用线程执行
+        void setWorkerThreadNum(int numThreads)
+        {
+            numWorkerThreads_ = numThreads;
+        }
+
+        mymuduo::ThreadPool *workerPool() const { return workerPool_.get(); }
+
+        /// Not thread safe, must be called before start().
+        /// 开启访问日志，accessLog由调用方持有并start()，生命周期要长于HttpServer
+        void setAccessLog(AccessLog *accessLog)
+        {
+            accessLog_ = accessLog;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 开启响应缓存，见ResponseCache和HttpResponse::setCacheTtl。cache由调用方持有，生命周期要长于HttpServer
+        void setResponseCache(ResponseCache *cache)
+        {
+            cache_ = cache;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 按Accept-Encoding压缩响应，见ResponseCompressor。compressor由调用方持有，生命周期要长于HttpServer。
+        /// 同时开启缓存时压缩后的响应按Accept-Encoding分开缓存
+        void setCompressor(ResponseCompressor *compressor)
+        {
+            compressor_ = compressor;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 连接上还没写进内核的数据超过bytes时停止读新的请求，写空后恢复，默认64KB。
+        /// 同时也是流式响应和sendRaw的高水位，见AsyncResponse::writable
+        void setHighWaterMark(size_t bytes)
+        {
+            highWaterMark_ = bytes;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 对path的WebSocket升级请求完成握手后把连接交给ws，见WebSocketServer。
+        /// path上的普通请求回复400。ws由调用方持有，生命周期要长于HttpServer，可以挂在多个path上
+        void addWebSocket(const std::string &path, WebSocketServer *ws)
+        {
+            webSockets_[path] = ws;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 接受明文HTTP/2(h2c)：连接以HTTP/2连接前言开头(prior knowledge)，或者HTTP/1.1请求带Upgrade: h2c。
+        /// 请求照常交给HttpCallback/AsyncHttpCallback，同一连接上的流并发处理，响应不用按请求顺序等待。
+        /// HTTP/2的请求不经过响应缓存，AsyncResponse::sendRaw(反向代理)不可用
+        void enableHttp2()
+        {
+            http2_ = true;
+        }
+
+        /// Not thread safe, must be called before start().
+        /// HTTPS，见TcpServer::setTlsContext。开启了enableHttp2时ALPN可以带上"h2"，
+        /// 协商出h2的连接直接按HTTP/2处理(客户端先发连接前言)，否则只用"http/1.1"
+        void setTlsContext(mymuduo::TlsContext *context)
+        {
+            server_.setTlsContext(context);
+        }
+
+        /// Not thread safe, must be called before start().
+        /// 开启后对path的GET请求直接返回MetricsRegistry的Prometheus文本，不经过httpCallback
+        void enableMetrics(const std::string &path = "/metrics")
+        {
+            metricsPath_ = path;
+        }
+
         void setThreadNum(int numThreads)
         {
             server_.setThreadNum(numThreads);
         }
 
+        /// Not thread safe, must be called before start().
+        /// 每个IO loop启动时在loop线程里依次调用，用来建立每个loop私有的状态(如上游连接池)。
+        /// start()返回前所有回调都已经执行完
+        void addThreadInitCallback(const mymuduo::TcpServer::ThreadInitCallback &cb)
+        {
+            threadInitCallbacks_.push_back(cb);
+        }
+
         void start();
 
+        /// Thread safe. 优雅退出，见TcpServer::drain。之后的每个响应都带Connection: close并在发送后关闭连接，
+        /// 空闲的keep-alive连接直接关闭，有请求在处理中的连接等最后一个响应发出后关闭
+        void drain(double timeoutSeconds, const mymuduo::TcpServer::DrainCallback &cb);
+        /// Thread safe. 监听socket已经交给新进程，见TcpServer::detachListener
+        void detachListener() { server_.detachListener(); }
+
     private:
+        friend class AsyncResponse;
+        friend class Http2Connection;
+
+        void init();
+
         void onConnection(const mymuduo::TcpConnectionPtr &conn);
         void onMessage(const mymuduo::TcpConnectionPtr &conn,
                        mymuduo::Buffer *buf,
                        mymuduo::Timestamp receiveTime);
-        void onRequest(const mymuduo::TcpConnectionPtr &, const HttpRequest &);
+        void onRequest(const mymuduo::TcpConnectionPtr &conn, HttpContext *context);
+        void onBadRequest(const mymuduo::TcpConnectionPtr &conn, HttpContext *context, mymuduo::Timestamp receiveTime);
+        // 请求的路径上挂了WebSocketServer时处理升级并返回true，之后连接上的数据交给会话
+        bool upgradeWebSocket(const mymuduo::TcpConnectionPtr &conn, HttpContext *context, mymuduo::Timestamp start);
+        // 请求带Upgrade: h2c时切换到HTTP/2并返回true，请求本身成为流1
+        bool upgradeHttp2(const mymuduo::TcpConnectionPtr &conn, HttpContext *context);
+        // 以下是HTTP/2，在IO线程里调用
+        void onHttp2Request(const mymuduo::TcpConnectionPtr &conn, Http2Connection *http2, uint32_t streamId, HttpRequest &req);
+        void onHttp2ResponseDone(const mymuduo::TcpConnectionPtr &conn, const std::shared_ptr<AsyncResponse> &response);
+        // 流式响应的HEADERS
+        bool sendHttp2Head(const std::shared_ptr<AsyncResponse> &response);
+        void onWriteComplete(const mymuduo::TcpConnectionPtr &conn);
+        void onHighWaterMark(const mymuduo::TcpConnectionPtr &conn, size_t len);
+        // 停止读，等写完成回调里恢复
+        void pauseReading(const mymuduo::TcpConnectionPtr &conn);
+        void watchWriteComplete(const mymuduo::TcpConnectionPtr &conn);
+        void onDrain(const mymuduo::TcpConnectionPtr &conn);
+        // 在IO线程里执行：标记完成，按顺序发送连接上已经完成的响应
+        void onResponseDone(const std::shared_ptr<AsyncResponse> &response);
+        // 在IO线程里执行：轮到response时直接发送，否则暂存到response的rawBuffer_
+        bool onResponseData(const std::shared_ptr<AsyncResponse> &response, const char *data, size_t len);
+        // 原始报文已经发完，记录指标和访问日志，返回是否需要关闭连接
+        bool finishRawResponse(AsyncResponse *response, AccessLogRecord *record);
+        // 先按需压缩，回调填好的响应可以缓存时先放进缓存再从缓存发送，否则同sendResponse
+        bool finishResponse(const mymuduo::TcpConnectionPtr &conn, const HttpRequest &req, HttpResponse *response,
+                            mymuduo::Timestamp start, AccessLogRecord *record);
+        // 发送缓存的响应，条件请求命中时回复304，返回是否需要关闭连接
+        bool sendCachedResponse(const mymuduo::TcpConnectionPtr &conn, const HttpRequest &req, const CachedResponse &entry,
+                                bool close, mymuduo::Timestamp start, AccessLogRecord *record);
+        void onThreadInit(mymuduo::EventLoop *loop);
+        // 析构时在每个IO线程里调用，停掉各组件挂在该loop上的定时器
+        void stopLoop(mymuduo::EventLoop *loop);
+        // 响应发出后记录处理耗时、状态码计数和访问日志
+        static void recordResponse(int status, size_t bytes, mymuduo::Timestamp start, AccessLogRecord *record);
+        // 序列化并发送响应，返回是否需要关闭连接
+        bool sendResponse(const mymuduo::TcpConnectionPtr &conn, const HttpResponse &response,
+                          mymuduo::Timestamp start, AccessLogRecord *record);
+
+        // 在连接的HttpContext中追加一条访问日志记录，返回的指针在flushAccessLogs之前有效
+        AccessLogRecord *beginAccessLog(const mymuduo::TcpConnectionPtr &conn, const HttpRequest &req);
+        static void fillAccessLog(AccessLogRecord *record, const mymuduo::TcpConnectionPtr &conn, const HttpRequest &req);
+        void flushAccessLogs(HttpContext *context, mymuduo::Timestamp lastByteTime);
 
         mymuduo::TcpServer server_;
         HttpCallback httpCallback_;
+        AsyncHttpCallback asyncHttpCallback_;
+        int numWorkerThreads_;
+        std::unique_ptr<mymuduo::ThreadPool> workerPool_;
+        AccessLog *accessLog_;
+        ResponseCache *cache_;
+        ResponseCompressor *compressor_;
+        size_t highWaterMark_;
+        std::string metricsPath_; // 为空表示不开启指标接口
+        std::unordered_map<std::string, WebSocketServer *> webSockets_;
+        bool http2_;
+        std::atomic_bool draining_;
+        std::vector<mymuduo::TcpServer::ThreadInitCallback> threadInitCallbacks_;
+        std::shared_ptr<HttpServer> self_; // 不拥有，AsyncResponse只持有weak_ptr，析构时reset
     };
 
 } // namespace http
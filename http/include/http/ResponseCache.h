@@ -0,0 +1,108 @@
+#pragma once
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/TimerId.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <time.h>
+
+namespace mymuduo
+{
+    class EventLoop;
+} // namespace mymuduo
+
+namespace http
+{
+    class HttpRequest;
+    class HttpResponse;
+
+    // 一条缓存的响应，序列化好之后不再修改，多个连接、多个线程共享同一份字节
+    struct CachedResponse
+    {
+        std::string bytes;         // 完整的200响应，带Connection: Keep-Alive
+        size_t connectionOffset;   // Connection头部在bytes中的位置，短连接的请求在这里换成close
+        size_t headLength;         // 到空行为止的长度，HEAD只发这一段
+        std::string notModified;   // 304的状态行和头部，不含Connection和结尾空行
+        std::string etag;
+        time_t lastModified;
+        int64_t expires;           // 微秒
+    };
+    using CachedResponsePtr = std::shared_ptr<const CachedResponse>;
+
+    /**
+     * @brief HttpServer的响应缓存，见HttpServer::setResponseCache
+     * 回调用HttpResponse::setCacheTtl()声明可以缓存的GET 200响应，之后TTL内同一个键的GET/HEAD请求
+     * 直接用序列化好的字节回复，If-None-Match/If-Modified-Since命中时回复304。
+     * 键是path+query+addVaryHeader()指定的请求头，响应的Vary里有不在其中的请求头时不缓存。
+     * 回调没有设置ETag/Last-Modified/Cache-Control时自动生成。
+     *
+     * 每个IO loop一个分片，命中时不加锁；分片没有时再查所有loop共享的一层(读写锁，读多写少)，
+     * 查到后复制到本loop的分片。过期的条目由每个loop的定时器清理。
+     */
+    class ResponseCache : mymuduo::noncopyable
+    {
+    public:
+        explicit ResponseCache(size_t maxEntries = 10000);
+        ~ResponseCache();
+
+        // 以下设置都要在HttpServer::start()之前调用
+        // 请求头不同的响应分开缓存，比如Accept-Encoding
+        void addVaryHeader(const std::string &field) { varyHeaders_.push_back(field); }
+        // 每个分片和共享层各自最多保存的条目数，满了之后新的响应不再缓存
+        void setMaxEntries(size_t maxEntries) { maxEntries_ = maxEntries; }
+
+        // 以下在IO线程里调用
+        CachedResponsePtr lookup(mymuduo::EventLoop *loop, const HttpRequest &req);
+        // 序列化response并缓存，response不可缓存时返回空
+        CachedResponsePtr insert(mymuduo::EventLoop *loop, const HttpRequest &req, const HttpResponse &response);
+
+        // Thread safe. 清空所有缓存，各个分片在下一次lookup时清空
+        void clear();
+
+        // 由HttpServer在每个IO loop启动时调用
+        void initLoop(mymuduo::EventLoop *loop);
+        // 由HttpServer析构时在loop线程里(或者loop已经退出后)调用，取消该loop的清理定时器。
+        // cache比HttpServer活得长，之后loop可能已经销毁，析构时不再访问它
+        void stopLoop(mymuduo::EventLoop *loop);
+
+        // 请求带的If-None-Match/If-Modified-Since说明客户端的副本还是最新的
+        static bool notModified(const HttpRequest &req, const CachedResponse &entry);
+
+    private:
+        using EntryMap = std::unordered_map<std::string, CachedResponsePtr>;
+        struct Shard
+        {
+            mymuduo::EventLoop *loop; // stopLoop之后为空
+            EntryMap entries;
+            uint64_t generation;
+            std::string key; // 复用的键缓冲区，查找时不分配内存
+            mymuduo::TimerId sweepTimer;
+        };
+
+        Shard *findShard(mymuduo::EventLoop *loop);
+        bool varyCovered(const std::string &vary) const;
+        const std::string &makeKey(Shard *shard, const HttpRequest &req);
+        void sweep(Shard *shard);
+        static void sweepMap(EntryMap *entries, int64_t now);
+
+        size_t maxEntries_;
+        std::vector<std::string> varyHeaders_;
+        std::atomic<uint64_t> generation_;
+
+        // initLoop在各个loop线程里插入，HttpServer::start()返回后只读
+        std::mutex shardsMutex_;
+        std::unordered_map<mymuduo::EventLoop *, std::unique_ptr<Shard>> shards_;
+
+        std::shared_timed_mutex sharedMutex_;
+        EntryMap shared_;              // guarded by sharedMutex_
+        uint64_t sharedGeneration_;    // guarded by sharedMutex_
+        std::atomic<int64_t> lastSharedSweep_;
+    };
+} // namespace http
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <mymuduo/noncopyable.h>
+
+#include <string>
+
+namespace http
+{
+    class HttpRequest;
+    class HttpResponse;
+    class RouteParams;
+
+    // 把root目录下的文件作为静态资源返回，挂在HttpRouter的通配路由上
+    //   StaticFiles files("/var/www");
+    //   router.get("/static/*file", std::bind(&StaticFiles::handle, &files, _1, _2, _3));
+    // 客户端接受br/gzip并且旁边有预先压缩好的a.css.br/a.css.gz时直接返回压缩文件，运行时不再压缩
+    // (带Content-Encoding的响应ResponseCompressor会跳过)。
+    // 文件整个读进body，适合小文件；路径里有..或NUL时返回404。
+    class StaticFiles : mymuduo::noncopyable
+    {
+    public:
+        explicit StaticFiles(const std::string &root);
+
+        // 大于0时设置HttpResponse::setCacheTtl，开启ResponseCache时不再每次读文件
+        void setCacheTtl(double seconds) { cacheTtl_ = seconds; }
+        // 默认开启
+        void setPrecompressed(bool on) { precompressed_ = on; }
+
+        // 路由处理函数，文件路径取最后一个路由参数
+        void handle(const HttpRequest &req, const RouteParams &params, HttpResponse *resp) const;
+        // path是相对root的路径，为空或以/结尾时返回其中的index.html
+        void serve(const HttpRequest &req, const std::string &path, HttpResponse *resp) const;
+
+        // 按扩展名取Content-Type，不认识的返回application/octet-stream
+        static const char *mimeType(const std::string &path);
+
+    private:
+        std::string root_;
+        double cacheTtl_;
+        bool precompressed_;
+    };
+} // namespace http
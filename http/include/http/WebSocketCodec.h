@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace mymuduo
+{
+    class Buffer;
+} // namespace mymuduo
+
+namespace http
+{
+    /**
+     * @brief RFC 6455帧的编解码，不分配内存
+     * 解析时只读帧头，payload留在Buffer里原地解掩码，调用方直接使用，不拷贝。
+     * 服务器发出的帧不带掩码，同一帧的字节可以发给任意多个连接。
+     */
+    class WebSocketCodec
+    {
+    public:
+        enum Opcode
+        {
+            kContinuation = 0x0,
+            kText = 0x1,
+            kBinary = 0x2,
+            kClose = 0x8,
+            kPing = 0x9,
+            kPong = 0xA,
+        };
+
+        enum CloseCode
+        {
+            kNormalClosure = 1000,
+            kGoingAway = 1001,
+            kProtocolError = 1002,
+            kUnsupportedData = 1003,
+            kNoStatus = 1005,
+            kMessageTooBig = 1009,
+        };
+
+        struct FrameHeader
+        {
+            bool fin;
+            int opcode;
+            bool masked;
+            uint8_t mask[4];
+            uint64_t payloadLength;
+            size_t headerLength; // 帧头(含扩展长度和掩码)的字节数
+        };
+
+        // 控制帧的payload上限
+        static const size_t kMaxControlPayload = 125;
+        // 最长的帧头：2 + 8字节长度 + 4字节掩码
+        static const size_t kMaxHeaderLength = 14;
+
+        // 返回1表示帧头完整，0表示数据不够，-1表示帧头非法(RSV位不为0、控制帧分片或过长、未知opcode)
+        static int parseHeader(const char *data, size_t len, FrameHeader *header);
+
+        // 按key异或data，offset是data在整个payload里的偏移(掩码按4字节循环)
+        static void unmask(char *data, size_t len, const uint8_t mask[4], size_t offset = 0);
+
+        // 写入不带掩码的帧头，返回长度，out至少kMaxHeaderLength字节
+        static size_t encodeHeader(char *out, int opcode, uint64_t payloadLength, bool fin = true);
+        // 完整的不带掩码的帧
+        static void appendFrame(mymuduo::Buffer *out, int opcode, const char *data, size_t len, bool fin = true);
+        static void appendFrame(std::string *out, int opcode, const char *data, size_t len, bool fin = true);
+
+        // Sec-WebSocket-Accept: base64(SHA-1(key + GUID))
+        static std::string acceptKey(const std::string &key);
+
+        static bool isControl(int opcode) { return (opcode & 0x8) != 0; }
+    };
+} // namespace http
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "http/HttpRequest.h"
+#include "http/WebSocketCodec.h"
+
+#include <mymuduo/noncopyable.h>
+#include <mymuduo/Callbacks.h>
+#include <mymuduo/StringPiece.h>
+#include <mymuduo/TimerId.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace mymuduo
+{
+    class Buffer;
+    class EventLoop;
+} // namespace mymuduo
+
+namespace http
+{
+    class WebSocketServer;
+
+    // 序列化好的服务器帧(不带掩码)，广播时所有连接共享同一份字节
+    using WebSocketFramePtr = std::shared_ptr<const std::string>;
+
+    /**
+     * @brief 一个升级成WebSocket的连接，由HttpServer在握手成功后创建
+     * 收到的帧在连接的输入缓冲区里原地解掩码，没有分片的消息直接把缓冲区里的payload交给回调，不拷贝；
+     * 分片的消息拼到会话自己的缓冲区里。ping/pong和close由会话自己处理。
+     * 发送函数都是线程安全的。
+     */
+    class WebSocketSession : mymuduo::noncopyable, public std::enable_shared_from_this<WebSocketSession>
+    {
+    public:
+        WebSocketSession(WebSocketServer *server, const mymuduo::TcpConnectionPtr &conn, HttpRequest &request);
+
+        // 升级请求，可以取路径、查询参数和头部
+        const HttpRequest &request() const { return request_; }
+        mymuduo::EventLoop *getLoop() const { return loop_; }
+        // 连接已经销毁时返回空
+        mymuduo::TcpConnectionPtr connection() const { return conn_.lock(); }
+
+        void sendText(mymuduo::StringPiece message) { sendMessage(WebSocketCodec::kText, message); }
+        void sendBinary(mymuduo::StringPiece message) { sendMessage(WebSocketCodec::kBinary, message); }
+        // 发送WebSocketServer::makeFrame准备好的帧，不在IO线程时只增加引用计数，不拷贝
+        void send(const WebSocketFramePtr &frame);
+        void ping();
+        // 发出close帧，等对方回复close后关闭连接
+        void close(int code = WebSocketCodec::kNormalClosure, mymuduo::StringPiece reason = mymuduo::StringPiece());
+
+        // 用户数据
+        void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+        const std::shared_ptr<void> &getContext() const { return context_; }
+
+    private:
+        friend class WebSocketServer;
+        friend class HttpServer;
+
+        void sendMessage(int opcode, mymuduo::StringPiece message);
+        void sendControl(int opcode, const char *data, size_t len);
+        void closeInLoop(int code, const std::string &reason);
+        // 以下在IO线程里调用
+        void onMessage(const mymuduo::TcpConnectionPtr &conn, mymuduo::Buffer *buf);
+        // 处理一个完整的帧，返回false表示连接要关闭了
+        bool onFrame(const WebSocketCodec::FrameHeader &header, char *payload, size_t len);
+        void failConnection(int code);
+        void onClosed();
+
+        WebSocketServer *server_;
+        std::weak_ptr<mymuduo::TcpConnection> conn_;
+        mymuduo::EventLoop *loop_;
+        HttpRequest request_;
+        std::string fragments_; // 分片消息已经收到的部分
+        int fragmentOpcode_;    // 分片消息的类型，kContinuation表示没有分片消息在途
+        bool closeSent_;
+        bool closed_;
+        int64_t lastReceive_;   // 微秒，保活检查用
+        std::shared_ptr<void> context_;
+    };
+
+    using WebSocketSessionPtr = std::shared_ptr<WebSocketSession>;
+
+    /**
+     * @brief WebSocket服务，见HttpServer::addWebSocket
+     *   WebSocketServer ws;
+     *   ws.setMessageCallback([](const WebSocketSessionPtr &s, StringPiece msg, bool binary) { s->sendText(msg); });
+     *   server.addWebSocket("/ws", &ws);
+     * 会话按IO loop分组登记，每个loop一个保活定时器：每隔pingInterval向本loop里空闲的会话发ping，
+     * 超过两个周期没有收到任何数据的会话关闭。broadcast()只序列化一次，每个loop一个任务发给它的全部会话。
+     */
+    class WebSocketServer : mymuduo::noncopyable
+    {
+    public:
+        using OpenCallback = std::function<void(const WebSocketSessionPtr &)>;
+        // message只在回调期间有效，binary为false时是文本消息(不校验UTF-8)
+        using MessageCallback = std::function<void(const WebSocketSessionPtr &, mymuduo::StringPiece message, bool binary)>;
+        using CloseCallback = std::function<void(const WebSocketSessionPtr &)>;
+
+        WebSocketServer();
+        ~WebSocketServer();
+
+        // 以下设置都要在HttpServer::start()之前调用，回调在会话所在的IO线程里执行
+        void setOpenCallback(const OpenCallback &cb) { openCallback_ = cb; }
+        void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+        void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
+        // 默认30秒，0表示不发ping
+        void setPingInterval(double seconds) { pingInterval_ = seconds; }
+        // 单个消息(分片拼起来)的上限，超过时以1009关闭，默认1MB
+        void setMaxMessageSize(size_t bytes) { maxMessageSize_ = bytes; }
+
+        // Thread safe. 发给所有会话，帧只序列化一次
+        void broadcast(mymuduo::StringPiece message, bool binary = false);
+        void broadcast(const WebSocketFramePtr &frame);
+        size_t sessionCount() const { return sessionCount_.load(std::memory_order_relaxed); }
+
+        static WebSocketFramePtr makeFrame(int opcode, mymuduo::StringPiece payload);
+
+        // 由HttpServer在每个IO loop启动时调用
+        void initLoop(mymuduo::EventLoop *loop);
+        // 由HttpServer析构时在loop线程里(或者loop已经退出后)调用，取消该loop的保活定时器
+        void stopLoop(mymuduo::EventLoop *loop);
+        // 由HttpServer调用：校验升级请求，成功时把101响应写进out并返回true
+        static bool handshake(const HttpRequest &req, mymuduo::Buffer *out);
+
+    private:
+        friend class WebSocketSession;
+        friend class HttpServer;
+
+        struct LoopSessions
+        {
+            mymuduo::EventLoop *loop; // stopLoop之后为空，析构时不再访问
+            std::unordered_set<WebSocketSession *> sessions;
+            mymuduo::TimerId keepaliveTimer;
+        };
+
+        // 在会话所在的IO线程里调用
+        void addSession(const WebSocketSessionPtr &session);
+        void removeSession(WebSocketSession *session);
+        void keepalive(LoopSessions *loopSessions);
+
+        OpenCallback openCallback_;
+        MessageCallback messageCallback_;
+        CloseCallback closeCallback_;
+        double pingInterval_;
+        size_t maxMessageSize_;
+        std::atomic<size_t> sessionCount_;
+
+        // initLoop在各个loop线程里插入，HttpServer::start()返回后只读；每个LoopSessions只在自己的loop里访问
+        std::mutex mutex_;
+        std::unordered_map<mymuduo::EventLoop *, std::unique_ptr<LoopSessions>> loops_;
+    };
+} // namespace http
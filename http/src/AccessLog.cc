@@ -0,0 +1,132 @@
+#include <http/AccessLog.h>
+#include <mymuduo/LogStream.h>
+
+#include <arpa/inet.h>
+#include <time.h>
+
+using namespace mymuduo;
+
+namespace http
+{
+    namespace detail
+    {
+        // 和Logger一样按线程缓存日期部分，同一秒内的记录不再调用localtime_r/snprintf
+        // 年份最长11个字符("-2147481748")，加上"/MM/DD HH:MM:SS."共27个
+        __thread char t_accessTime[32];
+        __thread int t_accessTimeLength = 0;
+        __thread time_t t_accessLastSecond = -1;
+
+        inline char *appendRaw(char *p, const char *data, size_t len)
+        {
+            ::memcpy(p, data, len);
+            return p + len;
+        }
+
+        // 两位补零的日期字段后面跟一个分隔符
+        inline char *appendField(char *p, int value, char separator)
+        {
+            p += mymuduo::detail::formatZeroPadded(p, static_cast<uint32_t>(value), 2);
+            *p++ = separator;
+            return p;
+        }
+
+        // 形如" parse_us=123"，耗时为负(时间点缺失)时输出'-'
+        inline char *appendDuration(char *p, const char *key, size_t keyLen, Timestamp high, Timestamp low)
+        {
+            p = appendRaw(p, key, keyLen);
+            if (high.valid() && low.valid())
+            {
+                p += mymuduo::detail::formatSigned(p, high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch());
+            }
+            else
+            {
+                *p++ = '-';
+            }
+            return p;
+        }
+    } // namespace detail
+
+    AccessLog::AccessLog(const std::string &basename, int flushInterval)
+        : output_(basename, flushInterval)
+    {
+    }
+
+    AccessLog::~AccessLog() = default;
+
+    void AccessLog::append(const AccessLogRecord &record)
+    {
+        char line[kMaxLineLength];
+        int len = format(record, line);
+        output_.append(line, len);
+    }
+
+    int AccessLog::format(const AccessLogRecord &record, char *buf)
+    {
+        char *p = buf;
+
+        // 时间：请求到达的时刻
+        const int64_t micros = record.receiveTime.microSecondsSinceEpoch();
+        const time_t seconds = static_cast<time_t>(micros / Timestamp::kMicroSecondsPerSecond);
+        if (seconds != detail::t_accessLastSecond)
+        {
+            struct tm tm_time;
+            ::localtime_r(&seconds, &tm_time);
+            char *q = detail::t_accessTime;
+            q += mymuduo::detail::formatSigned(q, tm_time.tm_year + 1900);
+            *q++ = '/';
+            q = detail::appendField(q, tm_time.tm_mon + 1, '/');
+            q = detail::appendField(q, tm_time.tm_mday, ' ');
+            q = detail::appendField(q, tm_time.tm_hour, ':');
+            q = detail::appendField(q, tm_time.tm_min, ':');
+            q = detail::appendField(q, tm_time.tm_sec, '.');
+            detail::t_accessTimeLength = static_cast<int>(q - detail::t_accessTime);
+            detail::t_accessLastSecond = seconds;
+        }
+        p = detail::appendRaw(p, detail::t_accessTime, detail::t_accessTimeLength);
+        p += mymuduo::detail::formatZeroPadded(p, static_cast<uint32_t>(micros % Timestamp::kMicroSecondsPerSecond), 6);
+        *p++ = ' ';
+
+        // 客户端地址
+        if (::inet_ntop(AF_INET, &record.peerAddr.sin_addr, p, INET_ADDRSTRLEN))
+        {
+            p += ::strlen(p);
+        }
+        *p++ = ':';
+        p += mymuduo::detail::formatUnsigned(p, ntohs(record.peerAddr.sin_port));
+        *p++ = ' ';
+
+        // 请求行
+        if (record.method == HttpRequest::kInvalid)
+        {
+            *p++ = '-';
+        }
+        else
+        {
+            const char *method = HttpRequest::methodToString(record.method);
+            p = detail::appendRaw(p, method, ::strlen(method));
+        }
+        *p++ = ' ';
+        if (record.pathLength > 0)
+        {
+            p = detail::appendRaw(p, record.path, record.pathLength);
+        }
+        else
+        {
+            *p++ = '-';
+        }
+        *p++ = ' ';
+
+        // 状态码和响应字节数
+        p += mymuduo::detail::formatUnsigned(p, record.status);
+        *p++ = ' ';
+        p += mymuduo::detail::formatUnsigned(p, record.responseBytes);
+
+        // 各阶段耗时
+        p = detail::appendDuration(p, " parse_us=", 10, record.parsedTime, record.receiveTime);
+        p = detail::appendDuration(p, " handler_us=", 12, record.handledTime, record.parsedTime);
+        p = detail::appendDuration(p, " ttlb_us=", 9, record.lastByteTime, record.receiveTime);
+        *p++ = '\n';
+
+        return static_cast<int>(p - buf);
+    }
+} // namespace http
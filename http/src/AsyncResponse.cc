@@ -0,0 +1,258 @@
+#include <http/AsyncResponse.h>
+#include <http/HttpServer.h>
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Logger.h>
+
+#include <stdio.h>
+
+using namespace mymuduo;
+
+namespace http
+{
+    AsyncResponse::AsyncResponse(HttpServer *server, const TcpConnectionPtr &conn, bool close)
+        : server_(server->self_),
+          conn_(conn),
+          loop_(conn->getLoop()),
+          response_(close),
+          streamId_(0),
+          completed_(false),
+          hasAccessLog_(false),
+          raw_(false),
+          rawStatus_(0),
+          rawBytes_(0),
+          streaming_(false),
+          chunked_(false),
+          headOnly_(false),
+          writable_(true),
+          closed_(false)
+    {
+    }
+
+    void AsyncResponse::reset(bool close)
+    {
+        request_.clear();
+        response_.clear(close);
+        streamId_ = 0;
+        start_ = Timestamp();
+        completed_ = false;
+        hasAccessLog_ = false;
+        raw_ = false;
+        rawStatus_ = 0;
+        rawBytes_ = 0;
+        rawBuffer_.retrieveAll();
+        cached_.reset();
+        streaming_ = false;
+        chunked_ = false;
+        headOnly_ = false;
+        writable_.store(true, std::memory_order_relaxed);
+        closed_.store(false, std::memory_order_relaxed);
+        writableCallback_ = nullptr;
+        compressor_.reset();
+    }
+
+    void AsyncResponse::done()
+    {
+        // 在IO线程里调用时直接执行，同步回调的响应不会多一次queueInLoop
+        loop_->runInLoop(std::bind(&AsyncResponse::doneInLoop, shared_from_this()));
+    }
+
+    void AsyncResponse::doneInLoop()
+    {
+        std::shared_ptr<HttpServer> server(server_.lock());
+        if (server)
+        {
+            server->onResponseDone(shared_from_this());
+        }
+    }
+
+    bool AsyncResponse::sendRaw(const char *data, size_t len)
+    {
+        loop_->assertInLoopThread();
+        if (streamId_ != 0)
+        {
+            LOG_FMT_ERROR("AsyncResponse::sendRaw - not supported on HTTP/2 streams \n");
+            return false;
+        }
+        std::shared_ptr<HttpServer> server(server_.lock());
+        return server && server->onResponseData(shared_from_this(), data, len);
+    }
+
+    void AsyncResponse::finishRaw(int status, bool close)
+    {
+        raw_ = true;
+        rawStatus_ = status;
+        response_.setCloseConnection(close);
+        done();
+    }
+
+    void AsyncResponse::beginStream()
+    {
+        loop_->runInLoop(std::bind(&AsyncResponse::beginStreamInLoop, shared_from_this()));
+    }
+
+    bool AsyncResponse::write(const char *data, size_t len)
+    {
+        if (closed_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        if (loop_->isInLoopThread())
+        {
+            writeInLoop(data, len);
+        }
+        else
+        {
+            AsyncResponsePtr self(shared_from_this());
+            std::string chunk(data, len);
+            loop_->queueInLoop([self, chunk]() { self->writeInLoop(chunk.data(), chunk.size()); });
+        }
+        return true;
+    }
+
+    void AsyncResponse::end()
+    {
+        loop_->runInLoop(std::bind(&AsyncResponse::endInLoop, shared_from_this()));
+    }
+
+    void AsyncResponse::beginStreamInLoop()
+    {
+        TcpConnectionPtr conn(conn_.lock());
+        std::shared_ptr<HttpServer> server(server_.lock());
+        if (!conn || !conn->connected() || !server)
+        {
+            onStreamClosed();
+            return;
+        }
+        streaming_ = true;
+        headOnly_ = request_.method() == HttpRequest::kHead;
+        // HTTP/2的body本来就按DATA帧分块，不用chunked编码
+        chunked_ = request_.getVersion() == HttpRequest::kHttp11;
+        if (streamId_ == 0 && (!chunked_ || server->draining_.load(std::memory_order_relaxed)))
+        {
+            response_.setCloseConnection(true);
+        }
+        if (server->compressor_)
+        {
+            compressor_ = server->compressor_->compressStream(request_, &response_);
+        }
+        if (streamId_ != 0)
+        {
+            if (!server->sendHttp2Head(shared_from_this()))
+            {
+                onStreamClosed();
+            }
+            return;
+        }
+
+        mymuduo::Buffer head;
+        response_.appendStreamHeadToBuffer(&head, chunked_);
+        if (!server->onResponseData(shared_from_this(), head.peek(), head.readableBytes()))
+        {
+            onStreamClosed();
+        }
+    }
+
+    void AsyncResponse::writeInLoop(const char *data, size_t len)
+    {
+        if (!streaming_ || closed_ || headOnly_ || len == 0)
+        {
+            return;
+        }
+        if (compressor_)
+        {
+            // 每块都flush，客户端收到就能解出来，代价是压缩率低一些
+            std::string out;
+            if (!compressor_->update(data, len, &out, true))
+            {
+                LOG_FMT_ERROR("AsyncResponse::write - compression failed \n");
+                return;
+            }
+            sendChunk(out.data(), out.size());
+        }
+        else
+        {
+            sendChunk(data, len);
+        }
+    }
+
+    void AsyncResponse::endInLoop()
+    {
+        if (!streaming_ || closed_)
+        {
+            return; // 连接已经断开，pendingResponses已经清空
+        }
+        if (!headOnly_)
+        {
+            if (compressor_)
+            {
+                std::string tail;
+                compressor_->finish(&tail);
+                sendChunk(tail.data(), tail.size());
+            }
+            if (chunked_)
+            {
+                static const char kLastChunk[] = "0\r\n\r\n";
+                std::shared_ptr<HttpServer> server(server_.lock());
+                if (server)
+                {
+                    server->onResponseData(shared_from_this(), kLastChunk, sizeof kLastChunk - 1);
+                }
+            }
+        }
+        writableCallback_ = nullptr;
+        finishRaw(response_.statusCode(), response_.closeConnection());
+    }
+
+    void AsyncResponse::sendChunk(const char *data, size_t len)
+    {
+        if (len == 0)
+        {
+            return; // 空块在chunked编码里表示结束
+        }
+        mymuduo::Buffer chunk;
+        if (chunked_)
+        {
+            char size[32];
+            int n = snprintf(size, sizeof size, "%zx\r\n", len);
+            chunk.append(size, n);
+        }
+        chunk.append(data, len);
+        if (chunked_)
+        {
+            chunk.append("\r\n", 2);
+        }
+        std::shared_ptr<HttpServer> server(server_.lock());
+        if (!server || !server->onResponseData(shared_from_this(), chunk.peek(), chunk.readableBytes()))
+        {
+            onStreamClosed();
+        }
+    }
+
+    void AsyncResponse::onStreamWritable()
+    {
+        writable_.store(true, std::memory_order_release);
+        if (writableCallback_)
+        {
+            // 回调里可能调用end()清掉writableCallback_
+            std::function<void()> cb(writableCallback_);
+            cb();
+        }
+    }
+
+    void AsyncResponse::onStreamClosed()
+    {
+        if (closed_.exchange(true))
+        {
+            return;
+        }
+        writable_.store(false, std::memory_order_release);
+        std::function<void()> cb;
+        cb.swap(writableCallback_);
+        if (cb)
+        {
+            cb();
+        }
+    }
+} // namespace http
@@ -0,0 +1,380 @@
+#include <http/Compression.h>
+#include <http/HttpRequest.h>
+#include <http/HttpResponse.h>
+
+#include <mymuduo/Logger.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef HTTP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HTTP_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace http
+{
+    namespace
+    {
+        enum Mode
+        {
+            kProcess,
+            kFlush,
+            kFinish,
+        };
+
+        const size_t kChunkSize = 16 * 1024;
+    } // namespace
+
+    struct StreamCompressor::Impl
+    {
+#ifdef HTTP_HAVE_ZLIB
+        z_stream zs;
+#endif
+#ifdef HTTP_HAVE_BROTLI
+        BrotliEncoderState *br = nullptr;
+#endif
+    };
+
+    StreamCompressor::StreamCompressor(Encoding encoding, int level)
+        : encoding_(encoding),
+          ok_(false),
+          impl_(new Impl)
+    {
+        if (encoding_ == kGzip)
+        {
+#ifdef HTTP_HAVE_ZLIB
+            ::memset(&impl_->zs, 0, sizeof impl_->zs);
+            // windowBits 15+16：带gzip头和尾
+            ok_ = ::deflateInit2(&impl_->zs, level < 0 ? 6 : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#endif
+        }
+        else if (encoding_ == kBrotli)
+        {
+#ifdef HTTP_HAVE_BROTLI
+            impl_->br = ::BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+            if (impl_->br)
+            {
+                ::BrotliEncoderSetParameter(impl_->br, BROTLI_PARAM_QUALITY, level < 0 ? 5 : level);
+                ok_ = true;
+            }
+#endif
+        }
+        else
+        {
+            ok_ = true;
+        }
+        if (!ok_)
+        {
+            LOG_FMT_ERROR("StreamCompressor - %s is not available \n", encodingName(encoding_));
+        }
+    }
+
+    StreamCompressor::~StreamCompressor()
+    {
+#ifdef HTTP_HAVE_ZLIB
+        // finish()之后ok_已经是false，按zlib的内部状态判断是否初始化过
+        if (encoding_ == kGzip && impl_->zs.state)
+        {
+            ::deflateEnd(&impl_->zs);
+        }
+#endif
+#ifdef HTTP_HAVE_BROTLI
+        if (impl_->br)
+        {
+            ::BrotliEncoderDestroyInstance(impl_->br);
+        }
+#endif
+    }
+
+    bool StreamCompressor::available(Encoding encoding)
+    {
+        switch (encoding)
+        {
+        case kIdentity:
+            return true;
+        case kGzip:
+#ifdef HTTP_HAVE_ZLIB
+            return true;
+#else
+            return false;
+#endif
+        case kBrotli:
+#ifdef HTTP_HAVE_BROTLI
+            return true;
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    const char *StreamCompressor::encodingName(Encoding encoding)
+    {
+        switch (encoding)
+        {
+        case kGzip:
+            return "gzip";
+        case kBrotli:
+            return "br";
+        default:
+            return "identity";
+        }
+    }
+
+    bool StreamCompressor::update(const char *data, size_t len, std::string *out, bool flush)
+    {
+        return run(data, len, out, flush ? kFlush : kProcess);
+    }
+
+    bool StreamCompressor::finish(std::string *out)
+    {
+        bool succeed = run(nullptr, 0, out, kFinish);
+        ok_ = false; // 结尾已经写出，之后不能再用
+        return succeed;
+    }
+
+    bool StreamCompressor::run(const char *data, size_t len, std::string *out, int mode)
+    {
+        if (!ok_)
+        {
+            return false;
+        }
+        if (encoding_ == kIdentity)
+        {
+            out->append(data, len);
+            return true;
+        }
+#ifdef HTTP_HAVE_ZLIB
+        if (encoding_ == kGzip)
+        {
+            z_stream &zs = impl_->zs;
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+            zs.avail_in = static_cast<uInt>(len);
+            int flush = mode == kFinish ? Z_FINISH : (mode == kFlush ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+            char chunk[kChunkSize];
+            int err = Z_OK;
+            do
+            {
+                zs.next_out = reinterpret_cast<Bytef *>(chunk);
+                zs.avail_out = sizeof chunk;
+                err = ::deflate(&zs, flush);
+                if (err == Z_STREAM_ERROR)
+                {
+                    return false;
+                }
+                out->append(chunk, sizeof chunk - zs.avail_out);
+            } while (zs.avail_out == 0 || (mode == kFinish && err != Z_STREAM_END));
+            return true;
+        }
+#endif
+#ifdef HTTP_HAVE_BROTLI
+        if (encoding_ == kBrotli)
+        {
+            BrotliEncoderOperation op = mode == kFinish ? BROTLI_OPERATION_FINISH
+                                                        : (mode == kFlush ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS);
+            size_t availIn = len;
+            const uint8_t *nextIn = reinterpret_cast<const uint8_t *>(data);
+            while (true)
+            {
+                // 输出缓冲区给0，让编码器用自己的缓冲区，再用TakeOutput取出来
+                size_t availOut = 0;
+                if (!::BrotliEncoderCompressStream(impl_->br, op, &availIn, &nextIn, &availOut, nullptr, nullptr))
+                {
+                    return false;
+                }
+                size_t size = 0;
+                const uint8_t *output = ::BrotliEncoderTakeOutput(impl_->br, &size);
+                out->append(reinterpret_cast<const char *>(output), size);
+                if (availIn == 0 && !::BrotliEncoderHasMoreOutput(impl_->br) &&
+                    (op != BROTLI_OPERATION_FINISH || ::BrotliEncoderIsFinished(impl_->br)))
+                {
+                    return true;
+                }
+            }
+        }
+#endif
+        return false;
+    }
+
+    ResponseCompressor::ResponseCompressor()
+        : minSize_(1024),
+          level_(-1),
+          brotli_(StreamCompressor::available(StreamCompressor::kBrotli)),
+          contentTypes_({"text/", "application/json", "application/javascript", "application/xml", "image/svg+xml"})
+    {
+    }
+
+    void ResponseCompressor::parseAcceptEncoding(const std::string &acceptEncoding, double *gzip, double *brotli)
+    {
+        // Accept-Encoding: gzip, deflate, br;q=0.9, *;q=0
+        double star = -1;
+        *gzip = -1;
+        *brotli = -1;
+        const char *p = acceptEncoding.c_str();
+        while (*p)
+        {
+            while (*p == ' ' || *p == ',')
+            {
+                ++p;
+            }
+            const char *name = p;
+            while (*p && *p != ',' && *p != ';' && *p != ' ')
+            {
+                ++p;
+            }
+            size_t nameLen = p - name;
+            double q = 1.0;
+            while (*p && *p != ',')
+            {
+                if (*p == ';')
+                {
+                    ++p;
+                    while (*p == ' ')
+                    {
+                        ++p;
+                    }
+                    if ((*p == 'q' || *p == 'Q') && p[1] == '=')
+                    {
+                        q = ::strtod(p + 2, nullptr);
+                    }
+                }
+                else
+                {
+                    ++p;
+                }
+            }
+            if ((nameLen == 4 && ::strncasecmp(name, "gzip", 4) == 0) || (nameLen == 6 && ::strncasecmp(name, "x-gzip", 6) == 0))
+            {
+                *gzip = q;
+            }
+            else if (nameLen == 2 && ::strncasecmp(name, "br", 2) == 0)
+            {
+                *brotli = q;
+            }
+            else if (nameLen == 1 && *name == '*')
+            {
+                star = q;
+            }
+        }
+        // 没有单独列出的编码按*处理，连*也没有就是不接受
+        *gzip = *gzip >= 0 ? *gzip : (star >= 0 ? star : 0);
+        *brotli = *brotli >= 0 ? *brotli : (star >= 0 ? star : 0);
+    }
+
+    StreamCompressor::Encoding ResponseCompressor::negotiate(const HttpRequest &req) const
+    {
+        const std::string acceptEncoding = req.getHeader("Accept-Encoding");
+        if (acceptEncoding.empty())
+        {
+            return StreamCompressor::kIdentity;
+        }
+        double gzip = 0;
+        double brotli = 0;
+        parseAcceptEncoding(acceptEncoding, &gzip, &brotli);
+        if (!StreamCompressor::available(StreamCompressor::kGzip))
+        {
+            gzip = 0;
+        }
+        if (!brotli_)
+        {
+            brotli = 0;
+        }
+        // q值相同时br优先，同样的级别压得更小
+        if (brotli > 0 && brotli >= gzip)
+        {
+            return StreamCompressor::kBrotli;
+        }
+        return gzip > 0 ? StreamCompressor::kGzip : StreamCompressor::kIdentity;
+    }
+
+    bool ResponseCompressor::compressible(const std::string &contentType) const
+    {
+        for (const std::string &prefix : contentTypes_)
+        {
+            if (::strncasecmp(contentType.c_str(), prefix.c_str(), prefix.size()) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ResponseCompressor::addVary(HttpResponse *resp) const
+    {
+        const HttpHeaders &headers = resp->headers();
+        auto contentType = headers.find("Content-Type");
+        if (headers.count("Content-Encoding") || contentType == headers.end() || !compressible(contentType->second))
+        {
+            return false;
+        }
+        auto vary = headers.find("Vary");
+        if (vary == headers.end())
+        {
+            resp->addHeader("Vary", "Accept-Encoding");
+        }
+        else if (::strcasestr(vary->second.c_str(), "Accept-Encoding") == nullptr)
+        {
+            resp->addHeader("Vary", vary->second + ", Accept-Encoding");
+        }
+        return true;
+    }
+
+    bool ResponseCompressor::compress(const HttpRequest &req, HttpResponse *resp) const
+    {
+        if (!addVary(resp))
+        {
+            return false;
+        }
+        const HttpHeaders &headers = resp->headers();
+        const std::string &body = resp->body();
+        StreamCompressor::Encoding encoding = body.size() < minSize_ ? StreamCompressor::kIdentity : negotiate(req);
+        if (encoding == StreamCompressor::kIdentity)
+        {
+            return false;
+        }
+        StreamCompressor compressor(encoding, level_);
+        std::string compressed;
+        compressed.reserve(body.size() / 3);
+        if (!compressor.update(body.data(), body.size(), &compressed) || !compressor.finish(&compressed) ||
+            compressed.size() >= body.size())
+        {
+            return false;
+        }
+        resp->swapBody(compressed);
+        resp->addHeader("Content-Encoding", StreamCompressor::encodingName(encoding));
+
+        // 压缩后是另一份表示，回调自己设置的强ETag不能和原文共用
+        auto etag = headers.find("ETag");
+        if (etag != headers.end() && etag->second.size() >= 2 && etag->second.back() == '"')
+        {
+            std::string tagged(etag->second, 0, etag->second.size() - 1);
+            tagged.append("-").append(StreamCompressor::encodingName(encoding)).append("\"");
+            resp->addHeader("ETag", tagged);
+        }
+        return true;
+    }
+
+    std::unique_ptr<StreamCompressor> ResponseCompressor::compressStream(const HttpRequest &req, HttpResponse *resp) const
+    {
+        std::unique_ptr<StreamCompressor> compressor;
+        // 流式响应事先不知道长度，不看minSize
+        StreamCompressor::Encoding encoding = addVary(resp) ? negotiate(req) : StreamCompressor::kIdentity;
+        if (encoding != StreamCompressor::kIdentity)
+        {
+            compressor.reset(new StreamCompressor(encoding, level_));
+            if (compressor->ok())
+            {
+                resp->addHeader("Content-Encoding", StreamCompressor::encodingName(encoding));
+            }
+            else
+            {
+                compressor.reset();
+            }
+        }
+        return compressor;
+    }
+} // namespace http
@@ -0,0 +1,630 @@
+#include <http/Hpack.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace http
+{
+    namespace
+    {
+        // RFC 7541 附录A
+        const char *const kStaticTable[HpackTable::kStaticTableSize][2] = {
+            {":authority", ""},
+            {":method", "GET"},
+            {":method", "POST"},
+            {":path", "/"},
+            {":path", "/index.html"},
+            {":scheme", "http"},
+            {":scheme", "https"},
+            {":status", "200"},
+            {":status", "204"},
+            {":status", "206"},
+            {":status", "304"},
+            {":status", "400"},
+            {":status", "404"},
+            {":status", "500"},
+            {"accept-charset", ""},
+            {"accept-encoding", "gzip, deflate"},
+            {"accept-language", ""},
+            {"accept-ranges", ""},
+            {"accept", ""},
+            {"access-control-allow-origin", ""},
+            {"age", ""},
+            {"allow", ""},
+            {"authorization", ""},
+            {"cache-control", ""},
+            {"content-disposition", ""},
+            {"content-encoding", ""},
+            {"content-language", ""},
+            {"content-length", ""},
+            {"content-location", ""},
+            {"content-range", ""},
+            {"content-type", ""},
+            {"cookie", ""},
+            {"date", ""},
+            {"etag", ""},
+            {"expect", ""},
+            {"expires", ""},
+            {"from", ""},
+            {"host", ""},
+            {"if-match", ""},
+            {"if-modified-since", ""},
+            {"if-none-match", ""},
+            {"if-range", ""},
+            {"if-unmodified-since", ""},
+            {"last-modified", ""},
+            {"link", ""},
+            {"location", ""},
+            {"max-forwards", ""},
+            {"proxy-authenticate", ""},
+            {"proxy-authorization", ""},
+            {"range", ""},
+            {"referer", ""},
+            {"refresh", ""},
+            {"retry-after", ""},
+            {"server", ""},
+            {"set-cookie", ""},
+            {"strict-transport-security", ""},
+            {"transfer-encoding", ""},
+            {"user-agent", ""},
+            {"vary", ""},
+            {"via", ""},
+            {"www-authenticate", ""},
+        };
+
+        // RFC 7541 附录B，下标是符号，256是EOS
+        const uint32_t kHuffmanCodes[257] = {
+            0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+            0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+            0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+            0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+            0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+            0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+            0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+            0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+            0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+            0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+            0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+            0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+            0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+            0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+            0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+            0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+            0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+            0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+            0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+            0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+            0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+            0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+            0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+            0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+            0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+            0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+            0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+            0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+            0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+            0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+            0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+            0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+            0x3fffffff,
+        };
+        const uint8_t kHuffmanLengths[257] = {
+            13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+            28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+            6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+            5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+            13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+            7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+            15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+            6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+            20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+            24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+            22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+            21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+            26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+            19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+            20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+            26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+            30,
+        };
+
+        struct StaticTable
+        {
+            std::vector<HpackHeader> entries;
+            // 名字 -> 第一个同名条目的编号，同名的条目在表里是相邻的
+            std::unordered_map<std::string, size_t> names;
+
+            StaticTable()
+            {
+                for (size_t i = 0; i < HpackTable::kStaticTableSize; ++i)
+                {
+                    entries.emplace_back(kStaticTable[i][0], kStaticTable[i][1]);
+                    names.emplace(entries.back().first, i + 1);
+                }
+            }
+        };
+
+        const StaticTable &staticTable()
+        {
+            static const StaticTable table;
+            return table;
+        }
+
+        /**
+         * Huffman解码的状态机：每次吃4位，状态是Huffman树的内部节点。
+         * 最短的码是5位，所以4位里最多解出一个符号
+         */
+        enum
+        {
+            kEmit = 1,
+            kFail = 2,
+            kAccept = 4, // 到这里为止的位可以是合法的结尾(不超过7位的全1填充)
+        };
+
+        struct HuffmanTransition
+        {
+            uint16_t state;
+            uint8_t flags;
+            uint8_t symbol;
+        };
+
+        struct HuffmanDecodeTable
+        {
+            HuffmanTransition transitions[256][16];
+
+            HuffmanDecodeTable()
+            {
+                // children[node][bit]：正数是内部节点，负数是叶子-(符号+1)，0表示没有
+                std::vector<std::pair<int, int>> children(1, std::make_pair(0, 0));
+                for (int symbol = 0; symbol <= 256; ++symbol)
+                {
+                    uint32_t code = kHuffmanCodes[symbol];
+                    int node = 0;
+                    for (int bit = kHuffmanLengths[symbol] - 1; bit > 0; --bit)
+                    {
+                        int &child = (code >> bit) & 1 ? children[node].second : children[node].first;
+                        if (child == 0)
+                        {
+                            // emplace_back会让child失效，先记下新节点的编号
+                            child = static_cast<int>(children.size());
+                            node = child;
+                            children.emplace_back(0, 0);
+                        }
+                        else
+                        {
+                            node = child;
+                        }
+                    }
+                    (code & 1 ? children[node].second : children[node].first) = -(symbol + 1);
+                }
+
+                // 子节点总是在父节点之后创建，按顺序推一遍深度
+                std::vector<int> depth(children.size(), 0);
+                std::vector<bool> accept(children.size(), false);
+                accept[0] = true;
+                for (size_t node = 0; node < children.size(); ++node)
+                {
+                    if (children[node].first > 0)
+                    {
+                        depth[children[node].first] = depth[node] + 1;
+                    }
+                    if (children[node].second > 0)
+                    {
+                        int child = children[node].second;
+                        depth[child] = depth[node] + 1;
+                        accept[child] = accept[node] && depth[child] <= 7;
+                    }
+                }
+
+                for (size_t state = 0; state < children.size(); ++state)
+                {
+                    for (int nibble = 0; nibble < 16; ++nibble)
+                    {
+                        HuffmanTransition &t = transitions[state][nibble];
+                        t.flags = 0;
+                        t.symbol = 0;
+                        int node = static_cast<int>(state);
+                        for (int bit = 3; bit >= 0; --bit)
+                        {
+                            int next = (nibble >> bit) & 1 ? children[node].second : children[node].first;
+                            if (next < 0)
+                            {
+                                int symbol = -next - 1;
+                                if (symbol == 256)
+                                {
+                                    t.flags = kFail; // 头部里不能出现EOS
+                                    break;
+                                }
+                                t.flags |= kEmit;
+                                t.symbol = static_cast<uint8_t>(symbol);
+                                node = 0;
+                            }
+                            else
+                            {
+                                node = next;
+                            }
+                        }
+                        t.state = static_cast<uint16_t>(node);
+                        if (accept[node])
+                        {
+                            t.flags |= kAccept;
+                        }
+                    }
+                }
+            }
+        };
+
+        bool decodeInteger(const unsigned char *&p, const unsigned char *end, int prefixBits, uint64_t *value)
+        {
+            if (p == end)
+            {
+                return false;
+            }
+            const uint64_t max = (1u << prefixBits) - 1;
+            uint64_t v = *p++ & max;
+            if (v == max)
+            {
+                int shift = 0;
+                while (true)
+                {
+                    if (p == end || shift > 28)
+                    {
+                        return false; // 不完整，或者大得不合理
+                    }
+                    unsigned char b = *p++;
+                    v += static_cast<uint64_t>(b & 0x7f) << shift;
+                    shift += 7;
+                    if ((b & 0x80) == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+            *value = v;
+            return true;
+        }
+    } // namespace
+
+    HpackTable::HpackTable(size_t maxSize)
+        : size_(0),
+          maxSize_(maxSize)
+    {
+    }
+
+    void HpackTable::setMaxSize(size_t maxSize)
+    {
+        maxSize_ = maxSize;
+        evict(maxSize);
+    }
+
+    void HpackTable::evict(size_t maxSize)
+    {
+        while (size_ > maxSize)
+        {
+            const HpackHeader &oldest = entries_.back();
+            size_ -= oldest.first.size() + oldest.second.size() + kEntryOverhead;
+            entries_.pop_back();
+        }
+    }
+
+    void HpackTable::add(const std::string &name, const std::string &value)
+    {
+        size_t entrySize = name.size() + value.size() + kEntryOverhead;
+        if (entrySize > maxSize_)
+        {
+            entries_.clear();
+            size_ = 0;
+            return;
+        }
+        evict(maxSize_ - entrySize);
+        entries_.emplace_front(name, value);
+        size_ += entrySize;
+    }
+
+    const HpackHeader *HpackTable::get(size_t index) const
+    {
+        if (index == 0)
+        {
+            return nullptr;
+        }
+        if (index <= kStaticTableSize)
+        {
+            return &staticTable().entries[index - 1];
+        }
+        index -= kStaticTableSize + 1;
+        return index < entries_.size() ? &entries_[index] : nullptr;
+    }
+
+    size_t HpackTable::find(const std::string &name, const std::string &value, size_t *nameIndex) const
+    {
+        *nameIndex = 0;
+        const StaticTable &table = staticTable();
+        auto it = table.names.find(name);
+        if (it != table.names.end())
+        {
+            *nameIndex = it->second;
+            for (size_t i = it->second; i <= kStaticTableSize && table.entries[i - 1].first == name; ++i)
+            {
+                if (table.entries[i - 1].second == value)
+                {
+                    return i;
+                }
+            }
+        }
+        for (size_t i = 0; i < entries_.size(); ++i)
+        {
+            if (entries_[i].first == name)
+            {
+                if (entries_[i].second == value)
+                {
+                    return i + kStaticTableSize + 1;
+                }
+                if (*nameIndex == 0)
+                {
+                    *nameIndex = i + kStaticTableSize + 1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    HpackDecoder::HpackDecoder()
+        : maxTableSize_(4096),
+          maxHeaderListSize_(64 * 1024)
+    {
+    }
+
+    bool HpackDecoder::huffmanDecode(const char *data, size_t len, std::string *out)
+    {
+        static const HuffmanDecodeTable table;
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        const unsigned char *end = p + len;
+        unsigned state = 0;
+        bool accept = true;
+        for (; p != end; ++p)
+        {
+            const HuffmanTransition &high = table.transitions[state][*p >> 4];
+            if (high.flags & kFail)
+            {
+                return false;
+            }
+            if (high.flags & kEmit)
+            {
+                out->push_back(static_cast<char>(high.symbol));
+            }
+            const HuffmanTransition &low = table.transitions[high.state][*p & 0x0f];
+            if (low.flags & kFail)
+            {
+                return false;
+            }
+            if (low.flags & kEmit)
+            {
+                out->push_back(static_cast<char>(low.symbol));
+            }
+            state = low.state;
+            accept = (low.flags & kAccept) != 0;
+        }
+        return accept;
+    }
+
+    bool HpackDecoder::decodeString(const unsigned char *&p, const unsigned char *end, std::string *out)
+    {
+        if (p == end)
+        {
+            return false;
+        }
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t len = 0;
+        if (!decodeInteger(p, end, 7, &len) || len > static_cast<uint64_t>(end - p))
+        {
+            return false;
+        }
+        out->clear();
+        const char *data = reinterpret_cast<const char *>(p);
+        p += len;
+        if (huffman)
+        {
+            return huffmanDecode(data, len, out);
+        }
+        out->assign(data, len);
+        return true;
+    }
+
+    bool HpackDecoder::decode(const char *data, size_t len, std::vector<HpackHeader> *headers)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        const unsigned char *end = p + len;
+        size_t listSize = 0;
+        bool first = true;
+        while (p != end)
+        {
+            unsigned char b = *p;
+            uint64_t index = 0;
+            if (b & 0x80)
+            {
+                // 索引
+                if (!decodeInteger(p, end, 7, &index))
+                {
+                    return false;
+                }
+                const HpackHeader *entry = table_.get(index);
+                if (entry == nullptr)
+                {
+                    return false;
+                }
+                headers->push_back(*entry);
+            }
+            else if ((b & 0xe0) == 0x20)
+            {
+                // 动态表大小更新，只能出现在头部块开头
+                if (!first || !decodeInteger(p, end, 5, &index) || index > maxTableSize_)
+                {
+                    return false;
+                }
+                table_.setMaxSize(index);
+                continue;
+            }
+            else
+            {
+                // 字面值：01带索引，0000不索引，0001永不索引
+                bool indexing = (b & 0x40) != 0;
+                if (!decodeInteger(p, end, indexing ? 6 : 4, &index))
+                {
+                    return false;
+                }
+                headers->emplace_back();
+                HpackHeader &header = headers->back();
+                if (index != 0)
+                {
+                    const HpackHeader *entry = table_.get(index);
+                    if (entry == nullptr)
+                    {
+                        return false;
+                    }
+                    header.first = entry->first;
+                }
+                else if (!decodeString(p, end, &header.first))
+                {
+                    return false;
+                }
+                if (!decodeString(p, end, &header.second))
+                {
+                    return false;
+                }
+                if (indexing)
+                {
+                    table_.add(header.first, header.second);
+                }
+            }
+            first = false;
+            const HpackHeader &header = headers->back();
+            listSize += header.first.size() + header.second.size() + HpackTable::kEntryOverhead;
+            if (listSize > maxHeaderListSize_)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    HpackEncoder::HpackEncoder()
+        : pendingTableSize_(static_cast<size_t>(-1)),
+          pendingMinTableSize_(static_cast<size_t>(-1))
+    {
+    }
+
+    void HpackEncoder::setMaxTableSize(size_t maxSize)
+    {
+        maxSize = std::min<size_t>(maxSize, 4096);
+        if (maxSize == table_.maxSize())
+        {
+            return;
+        }
+        table_.setMaxSize(maxSize);
+        // 两个头部块之间先缩小再放大时，要先告诉对方最小的那次，对方才会淘汰同样的条目
+        pendingMinTableSize_ = std::min(pendingMinTableSize_, maxSize);
+        pendingTableSize_ = maxSize;
+    }
+
+    void HpackEncoder::beginBlock(std::string *out)
+    {
+        if (pendingTableSize_ != static_cast<size_t>(-1))
+        {
+            if (pendingMinTableSize_ < pendingTableSize_)
+            {
+                encodeInteger(pendingMinTableSize_, 5, 0x20, out);
+            }
+            encodeInteger(pendingTableSize_, 5, 0x20, out);
+            pendingTableSize_ = static_cast<size_t>(-1);
+            pendingMinTableSize_ = static_cast<size_t>(-1);
+        }
+    }
+
+    void HpackEncoder::encodeInteger(uint64_t value, int prefixBits, unsigned char first, std::string *out)
+    {
+        const uint64_t max = (1u << prefixBits) - 1;
+        if (value < max)
+        {
+            out->push_back(static_cast<char>(first | value));
+            return;
+        }
+        out->push_back(static_cast<char>(first | max));
+        value -= max;
+        while (value >= 0x80)
+        {
+            out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out->push_back(static_cast<char>(value));
+    }
+
+    size_t HpackEncoder::huffmanEncodedLength(const char *data, size_t len)
+    {
+        size_t bits = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            bits += kHuffmanLengths[static_cast<unsigned char>(data[i])];
+        }
+        return (bits + 7) / 8;
+    }
+
+    void HpackEncoder::huffmanEncode(const char *data, size_t len, std::string *out)
+    {
+        uint64_t bits = 0;
+        int count = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            bits = (bits << kHuffmanLengths[c]) | kHuffmanCodes[c];
+            count += kHuffmanLengths[c];
+            while (count >= 8)
+            {
+                count -= 8;
+                out->push_back(static_cast<char>(bits >> count));
+            }
+        }
+        if (count > 0)
+        {
+            // 用EOS的高位(全1)填充
+            out->push_back(static_cast<char>((bits << (8 - count)) | (0xff >> count)));
+        }
+    }
+
+    void HpackEncoder::encodeString(const std::string &str, std::string *out)
+    {
+        size_t huffmanLength = huffmanEncodedLength(str.data(), str.size());
+        if (huffmanLength < str.size())
+        {
+            encodeInteger(huffmanLength, 7, 0x80, out);
+            huffmanEncode(str.data(), str.size(), out);
+        }
+        else
+        {
+            encodeInteger(str.size(), 7, 0x00, out);
+            out->append(str);
+        }
+    }
+
+    void HpackEncoder::encode(const std::string &name, const std::string &value, std::string *out, bool index)
+    {
+        size_t nameIndex = 0;
+        size_t exact = table_.find(name, value, &nameIndex);
+        if (exact != 0)
+        {
+            encodeInteger(exact, 7, 0x80, out);
+            return;
+        }
+        encodeInteger(nameIndex, index ? 6 : 4, index ? 0x40 : 0x00, out);
+        if (nameIndex == 0)
+        {
+            encodeString(name, out);
+        }
+        encodeString(value, out);
+        if (index)
+        {
+            table_.add(name, value);
+        }
+    }
+} // namespace http
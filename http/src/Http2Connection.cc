@@ -0,0 +1,1092 @@
+#include <http/Http2Connection.h>
+#include <http/HttpServer.h>
+#include <http/HttpContext.h>
+#include <http/HttpResponse.h>
+#include <http/AsyncResponse.h>
+
+#include <mymuduo/Logger.h>
+#include <mymuduo/Metrics.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/LogStream.h>
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+
+using namespace mymuduo;
+
+namespace http
+{
+    namespace
+    {
+        Gauge *const g_connections = MetricsRegistry::instance().gauge(
+            "http2_connections", "Open HTTP/2 connections.");
+        Counter *const g_streams = MetricsRegistry::instance().counter(
+            "http2_streams_total", "HTTP/2 streams opened by clients.");
+        Counter *const g_streamResets = MetricsRegistry::instance().counter(
+            "http2_stream_resets_total", "HTTP/2 streams reset by either side before the response was sent.");
+        Counter *const g_connectionErrors = MetricsRegistry::instance().counter(
+            "http2_connection_errors_total", "HTTP/2 connections closed with GOAWAY for a protocol error.");
+
+        enum Flags
+        {
+            kEndStream = 0x1,
+            kAck = 0x1,
+            kEndHeaders = 0x4,
+            kPadded = 0x8,
+            kPriorityFlag = 0x20,
+        };
+
+        enum SettingsId
+        {
+            kHeaderTableSize = 0x1,
+            kEnablePush = 0x2,
+            kMaxConcurrentStreams = 0x3,
+            kInitialWindowSize = 0x4,
+            kMaxFrameSize = 0x5,
+            kMaxHeaderListSize = 0x6,
+        };
+
+        // 我方的设置
+        const uint32_t kOurMaxFrameSize = 16384;
+        const uint32_t kOurMaxConcurrentStreams = 128;
+        const int64_t kOurWindow = 1024 * 1024;
+        const size_t kMaxHeaderBlock = 64 * 1024;
+        const int64_t kDefaultWindow = 65535;
+        const int64_t kMaxWindow = 0x7fffffff;
+        // 一个连接上所有流缓存的请求体只按这么多归还窗口，不是并发流数乘以单个请求体的上限
+        const int64_t kMaxBufferedBody = HttpContext::kMaxBodySize;
+
+        uint32_t readUint32(const char *p)
+        {
+            const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+            return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+        }
+
+        void appendUint32(Buffer *buf, uint32_t value)
+        {
+            char bytes[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+                             static_cast<char>(value >> 8), static_cast<char>(value)};
+            buf->append(bytes, 4);
+        }
+
+        void appendSetting(Buffer *buf, uint16_t id, uint32_t value)
+        {
+            char bytes[2] = {static_cast<char>(id >> 8), static_cast<char>(id)};
+            buf->append(bytes, 2);
+            appendUint32(buf, value);
+        }
+
+        bool base64UrlDecode(const std::string &in, std::string *out)
+        {
+            uint32_t bits = 0;
+            int count = 0;
+            for (char c : in)
+            {
+                int v;
+                if (c >= 'A' && c <= 'Z')
+                {
+                    v = c - 'A';
+                }
+                else if (c >= 'a' && c <= 'z')
+                {
+                    v = c - 'a' + 26;
+                }
+                else if (c >= '0' && c <= '9')
+                {
+                    v = c - '0' + 52;
+                }
+                else if (c == '-' || c == '+')
+                {
+                    v = 62;
+                }
+                else if (c == '_' || c == '/')
+                {
+                    v = 63;
+                }
+                else if (c == '=')
+                {
+                    break;
+                }
+                else
+                {
+                    return false;
+                }
+                bits = (bits << 6) | v;
+                count += 6;
+                if (count >= 8)
+                {
+                    count -= 8;
+                    out->push_back(static_cast<char>(bits >> count));
+                }
+            }
+            return true;
+        }
+
+        // 连接专用的头部在HTTP/2里不允许出现
+        bool connectionSpecific(const std::string &name)
+        {
+            return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+                   name == "transfer-encoding" || name == "upgrade";
+        }
+
+        // accept-encoding -> Accept-Encoding，和HTTP/1客户端常用的写法一致，回调里按同样的名字取
+        std::string canonicalName(const std::string &name)
+        {
+            std::string result(name);
+            bool upper = true;
+            for (char &c : result)
+            {
+                if (upper && c >= 'a' && c <= 'z')
+                {
+                    c = static_cast<char>(c - 'a' + 'A');
+                }
+                upper = c == '-';
+            }
+            return result;
+        }
+    } // namespace
+
+    const char Http2Connection::kPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    const size_t Http2Connection::kPrefaceLength;
+    const size_t Http2Connection::kFrameHeaderLength;
+
+    Http2Connection::Http2Connection(HttpServer *server, const TcpConnectionPtr &conn)
+        : server_(server),
+          conn_(conn),
+          headerStreamId_(0),
+          headerEndStream_(false),
+          prefaceReceived_(false),
+          goAwaySent_(false),
+          closed_(false),
+          lastStreamId_(0),
+          peerMaxFrameSize_(16384),
+          peerInitialWindow_(kDefaultWindow),
+          sendWindow_(kDefaultWindow),
+          recvWindow_(kOurWindow),
+          recvUnacked_(0),
+          bufferedBody_(0),
+          recvOwed_(0)
+    {
+        decoder_.setMaxHeaderListSize(kMaxHeaderBlock);
+        g_connections->increment();
+    }
+
+    Http2Connection::~Http2Connection()
+    {
+        g_connections->decrement();
+    }
+
+    void Http2Connection::start()
+    {
+        appendFrameHeader(18, kSettings, 0, 0);
+        appendSetting(&output_, kMaxConcurrentStreams, kOurMaxConcurrentStreams);
+        appendSetting(&output_, kInitialWindowSize, static_cast<uint32_t>(kOurWindow));
+        appendSetting(&output_, kMaxHeaderListSize, static_cast<uint32_t>(kMaxHeaderBlock));
+        // 连接级窗口只能用WINDOW_UPDATE调大
+        sendWindowUpdate(0, static_cast<uint32_t>(kOurWindow - kDefaultWindow));
+        flushOutput();
+    }
+
+    bool Http2Connection::applyUpgradeSettings(const std::string &settings)
+    {
+        std::string payload;
+        return base64UrlDecode(settings, &payload) && payload.size() % 6 == 0 &&
+               applySettings(payload.data(), payload.size());
+    }
+
+    void Http2Connection::startUpgradedStream(HttpRequest &request)
+    {
+        // 升级的请求已经收齐，流1处于半关闭(远端)状态
+        std::unique_ptr<Stream> stream(new Stream(1, peerInitialWindow_, kOurWindow));
+        stream->request.swap(request);
+        stream->request.setVersion(HttpRequest::kHttp20);
+        stream->headersDone = true;
+        stream->remoteClosed = true;
+        Stream *raw = stream.get();
+        streams_[1] = std::move(stream);
+        lastStreamId_ = 1;
+        g_streams->increment();
+        dispatch(raw);
+    }
+
+    void Http2Connection::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+    {
+        receiveTime_ = receiveTime;
+        if (!prefaceReceived_)
+        {
+            size_t n = std::min(buf->readableBytes(), kPrefaceLength);
+            if (::memcmp(buf->peek(), kPreface, n) != 0)
+            {
+                LOG_FMT_ERROR("Http2Connection::onMessage - bad connection preface \n");
+                closed_ = true;
+                buf->retrieveAll();
+                conn->shutdown();
+                return;
+            }
+            if (n < kPrefaceLength)
+            {
+                return;
+            }
+            buf->retrieve(kPrefaceLength);
+            prefaceReceived_ = true;
+        }
+
+        while (!closed_ && buf->readableBytes() >= kFrameHeaderLength)
+        {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(buf->peek());
+            size_t len = (size_t(p[0]) << 16) | (size_t(p[1]) << 8) | p[2];
+            if (len > kOurMaxFrameSize)
+            {
+                connectionError(kFrameSizeError);
+                break;
+            }
+            if (buf->readableBytes() < kFrameHeaderLength + len)
+            {
+                break;
+            }
+            uint8_t type = p[3];
+            uint8_t flags = p[4];
+            uint32_t streamId = readUint32(buf->peek() + 5) & 0x7fffffff;
+            bool ok = onFrame(type, flags, streamId, buf->peek() + kFrameHeaderLength, len);
+            buf->retrieve(kFrameHeaderLength + len);
+            if (!ok)
+            {
+                break;
+            }
+            if (conn->outputBufferSize() + output_.readableBytes() >= server_->highWaterMark_)
+            {
+                // 客户端读得太慢，剩下的帧写空之后再处理
+                flushOutput();
+                server_->pauseReading(conn);
+                break;
+            }
+        }
+        if (closed_)
+        {
+            buf->retrieveAll();
+        }
+        flushOutput();
+    }
+
+    bool Http2Connection::onFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char *payload, size_t len)
+    {
+        if (headerStreamId_ != 0 && type != kContinuation)
+        {
+            // 头部块的CONTINUATION中间不能夹别的帧
+            connectionError(kProtocolError);
+            return false;
+        }
+        switch (type)
+        {
+        case kData:
+            return onData(flags, streamId, payload, len);
+        case kHeaders:
+            return onHeaders(flags, streamId, payload, len);
+        case kContinuation:
+            return onContinuation(flags, streamId, payload, len);
+        case kPriority:
+            if (streamId == 0)
+            {
+                connectionError(kProtocolError);
+                return false;
+            }
+            if (len != 5)
+            {
+                sendRstStream(streamId, kFrameSizeError);
+            }
+            return true; // 不按优先级调度
+        case kRstStream:
+            if (streamId == 0 || streamId > lastStreamId_ || len != 4)
+            {
+                connectionError(streamId == 0 || streamId > lastStreamId_ ? kProtocolError : kFrameSizeError);
+                return false;
+            }
+            onRstStream(streamId);
+            return true;
+        case kSettings:
+            if (streamId != 0)
+            {
+                connectionError(kProtocolError);
+                return false;
+            }
+            if (flags & kAck)
+            {
+                if (len != 0)
+                {
+                    connectionError(kFrameSizeError);
+                    return false;
+                }
+                return true;
+            }
+            if (len % 6 != 0)
+            {
+                connectionError(kFrameSizeError);
+                return false;
+            }
+            if (!applySettings(payload, len))
+            {
+                return false;
+            }
+            appendFrameHeader(0, kSettings, kAck, 0);
+            flushStreams();
+            return true;
+        case kPing:
+            if (streamId != 0 || len != 8)
+            {
+                connectionError(streamId != 0 ? kProtocolError : kFrameSizeError);
+                return false;
+            }
+            if ((flags & kAck) == 0)
+            {
+                appendFrameHeader(8, kPing, kAck, 0);
+                output_.append(payload, 8);
+            }
+            return true;
+        case kGoAway:
+            if (streamId != 0 || len < 8)
+            {
+                connectionError(streamId != 0 ? kProtocolError : kFrameSizeError);
+                return false;
+            }
+            // 对方不再发新请求，在途的流处理完后关闭
+            goAway();
+            return true;
+        case kWindowUpdate:
+            return onWindowUpdate(streamId, payload, len);
+        case kPushPromise:
+            // 客户端不能推送
+            connectionError(kProtocolError);
+            return false;
+        default:
+            return true; // 未知类型的帧忽略
+        }
+    }
+
+    bool Http2Connection::onData(uint8_t flags, uint32_t streamId, const char *payload, size_t len)
+    {
+        if (streamId == 0)
+        {
+            connectionError(kProtocolError);
+            return false;
+        }
+        const char *data = payload;
+        size_t dataLen = len;
+        if (flags & kPadded)
+        {
+            if (len < 1 || static_cast<unsigned char>(payload[0]) >= len)
+            {
+                connectionError(kProtocolError);
+                return false;
+            }
+            data = payload + 1;
+            dataLen = len - 1 - static_cast<unsigned char>(payload[0]);
+        }
+
+        // 填充也计入流量控制
+        recvWindow_ -= len;
+        if (recvWindow_ < 0)
+        {
+            connectionError(kFlowControlError);
+            return false;
+        }
+
+        auto it = streams_.find(streamId);
+        if (it == streams_.end() || it->second->remoteClosed)
+        {
+            if (streamId > lastStreamId_)
+            {
+                connectionError(kProtocolError); // 还没打开的流
+                return false;
+            }
+            returnWindow(len);
+            sendRstStream(streamId, kStreamClosed);
+            return true;
+        }
+        Stream *stream = it->second.get();
+        stream->recvWindow -= len;
+        if (stream->recvWindow < 0 || stream->request.body().size() + dataLen > HttpContext::kMaxBodySize)
+        {
+            returnWindow(len);
+            sendRstStream(streamId, stream->recvWindow < 0 ? kFlowControlError : kCancel);
+            closeStream(it);
+            return true;
+        }
+        stream->request.appendBody(data, data + dataLen);
+        // 请求体收齐才交给回调，之前一直占着缓存预算。预算以内的立即归还窗口，
+        // 超出的部分等dispatch或者流关闭腾出预算再还，整个连接缓存的请求体不超过预算加一个窗口
+        stream->buffered += len;
+        bufferedBody_ += len;
+        int64_t over = std::min<int64_t>(len, std::max<int64_t>(0, bufferedBody_ - kMaxBufferedBody));
+        recvOwed_ += over;
+        returnWindow(len - over);
+        if (flags & kEndStream)
+        {
+            stream->remoteClosed = true;
+            dispatch(stream);
+        }
+        else
+        {
+            stream->recvUnacked += len;
+            if (stream->recvUnacked >= kOurWindow / 2)
+            {
+                sendWindowUpdate(streamId, static_cast<uint32_t>(stream->recvUnacked));
+                stream->recvWindow += stream->recvUnacked;
+                stream->recvUnacked = 0;
+            }
+        }
+        return true;
+    }
+
+    bool Http2Connection::onHeaders(uint8_t flags, uint32_t streamId, const char *payload, size_t len)
+    {
+        if (streamId == 0 || (streamId & 1) == 0)
+        {
+            connectionError(kProtocolError);
+            return false;
+        }
+        const char *p = payload;
+        size_t n = len;
+        if (flags & kPadded)
+        {
+            if (n < 1 || static_cast<unsigned char>(p[0]) >= n)
+            {
+                connectionError(kProtocolError);
+                return false;
+            }
+            n -= 1 + static_cast<unsigned char>(p[0]);
+            ++p;
+        }
+        if (flags & kPriorityFlag)
+        {
+            if (n < 5)
+            {
+                connectionError(kFrameSizeError);
+                return false;
+            }
+            p += 5;
+            n -= 5;
+        }
+        headerBlock_.assign(p, n);
+        headerEndStream_ = (flags & kEndStream) != 0;
+        if (flags & kEndHeaders)
+        {
+            return onHeaderBlock(streamId, headerEndStream_);
+        }
+        headerStreamId_ = streamId;
+        return true;
+    }
+
+    bool Http2Connection::onContinuation(uint8_t flags, uint32_t streamId, const char *payload, size_t len)
+    {
+        if (headerStreamId_ == 0 || streamId != headerStreamId_)
+        {
+            connectionError(kProtocolError);
+            return false;
+        }
+        if (headerBlock_.size() + len > kMaxHeaderBlock)
+        {
+            connectionError(kEnhanceYourCalm);
+            return false;
+        }
+        headerBlock_.append(payload, len);
+        if (flags & kEndHeaders)
+        {
+            headerStreamId_ = 0;
+            return onHeaderBlock(streamId, headerEndStream_);
+        }
+        return true;
+    }
+
+    bool Http2Connection::onHeaderBlock(uint32_t streamId, bool endStream)
+    {
+        // 不管流会不会被处理都要解码，否则两边的动态表就不一致了
+        decoded_.clear();
+        bool decoded = decoder_.decode(headerBlock_.data(), headerBlock_.size(), &decoded_);
+        std::string().swap(headerBlock_);
+        if (!decoded)
+        {
+            connectionError(kCompressionError);
+            return false;
+        }
+
+        auto it = streams_.find(streamId);
+        if (it != streams_.end())
+        {
+            // 请求体之后的trailer，必须结束流
+            Stream *stream = it->second.get();
+            if (stream->remoteClosed || !endStream || !fillRequest(stream, true))
+            {
+                sendRstStream(streamId, stream->remoteClosed ? kStreamClosed : kProtocolError);
+                closeStream(it);
+                return true;
+            }
+            stream->remoteClosed = true;
+            dispatch(stream);
+            return true;
+        }
+        if (streamId <= lastStreamId_)
+        {
+            connectionError(kStreamClosed);
+            return false;
+        }
+        lastStreamId_ = streamId;
+        if (goAwaySent_)
+        {
+            return true; // GOAWAY之后的新流不处理，对方按GOAWAY里的流ID重试
+        }
+        if (streams_.size() >= kOurMaxConcurrentStreams)
+        {
+            sendRstStream(streamId, kRefusedStream);
+            return true;
+        }
+
+        g_streams->increment();
+        std::unique_ptr<Stream> stream(new Stream(streamId, peerInitialWindow_, kOurWindow));
+        Stream *raw = stream.get();
+        it = streams_.emplace(streamId, std::move(stream)).first;
+        raw->request.setReceiveTime(receiveTime_);
+        if (!fillRequest(raw, false))
+        {
+            sendRstStream(streamId, kProtocolError);
+            closeStream(it);
+            return true;
+        }
+        raw->headersDone = true;
+        if (endStream)
+        {
+            raw->remoteClosed = true;
+            dispatch(raw);
+        }
+        return true;
+    }
+
+    bool Http2Connection::fillRequest(Stream *stream, bool trailers)
+    {
+        HttpRequest &req = stream->request;
+        bool regular = false;
+        bool hasMethod = false;
+        bool hasPath = false;
+        const std::string *authority = nullptr;
+        for (const HpackHeader &header : decoded_)
+        {
+            const std::string &name = header.first;
+            const std::string &value = header.second;
+            if (!name.empty() && name[0] == ':')
+            {
+                // 伪头部只能出现在请求头部的最前面
+                if (trailers || regular)
+                {
+                    return false;
+                }
+                if (name == ":method" && !hasMethod)
+                {
+                    hasMethod = true;
+                    // 不支持的方法留给HttpServer回复400
+                    req.setMethod(value.data(), value.data() + value.size());
+                }
+                else if (name == ":path" && !hasPath && !value.empty())
+                {
+                    hasPath = true;
+                    const char *begin = value.data();
+                    const char *end = begin + value.size();
+                    const char *question = std::find(begin, end, '?');
+                    req.setPath(begin, question);
+                    if (question != end)
+                    {
+                        req.setQuery(question, end);
+                    }
+                }
+                else if (name == ":authority")
+                {
+                    authority = &value;
+                }
+                else if (name != ":scheme")
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            regular = true;
+            if (std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; }) ||
+                connectionSpecific(name) || (name == "te" && value != "trailers"))
+            {
+                return false;
+            }
+            if (trailers)
+            {
+                continue; // trailer里的字段不交给回调
+            }
+            std::string field(canonicalName(name));
+            auto exist = req.headers().find(field);
+            if (exist == req.headers().end())
+            {
+                if (req.headers().size() >= HttpContext::kMaxHeaders)
+                {
+                    return false;
+                }
+                req.setHeader(field, value);
+            }
+            else
+            {
+                // HTTP/2把cookie拆成多个字段，合并回一个
+                req.setHeader(field, exist->second + (name == "cookie" ? "; " : ", ") + value);
+            }
+        }
+        if (trailers)
+        {
+            return true;
+        }
+        if (!hasMethod || !hasPath)
+        {
+            return false;
+        }
+        if (authority && req.headers().count("Host") == 0)
+        {
+            req.setHeader("Host", *authority);
+        }
+        req.setVersion(HttpRequest::kHttp20);
+        return true;
+    }
+
+    void Http2Connection::dispatch(Stream *stream)
+    {
+        TcpConnectionPtr conn(conn_.lock());
+        if (conn)
+        {
+            // 同步回调会当场发出响应并关闭流，请求先换出来
+            HttpRequest request;
+            request.swap(stream->request);
+            releaseBody(stream);
+            server_->onHttp2Request(conn, this, stream->id, request);
+        }
+    }
+
+    bool Http2Connection::applySettings(const char *payload, size_t len)
+    {
+        for (size_t pos = 0; pos + 6 <= len; pos += 6)
+        {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(payload + pos);
+            uint16_t id = static_cast<uint16_t>((p[0] << 8) | p[1]);
+            uint32_t value = readUint32(payload + pos + 2);
+            switch (id)
+            {
+            case kHeaderTableSize:
+                encoder_.setMaxTableSize(value);
+                break;
+            case kEnablePush:
+                if (value > 1)
+                {
+                    connectionError(kProtocolError);
+                    return false;
+                }
+                break;
+            case kInitialWindowSize:
+            {
+                if (value > kMaxWindow)
+                {
+                    connectionError(kFlowControlError);
+                    return false;
+                }
+                // 已经打开的流按差值调整发送窗口，可能变成负数
+                int64_t delta = static_cast<int64_t>(value) - peerInitialWindow_;
+                for (auto &item : streams_)
+                {
+                    item.second->sendWindow += delta;
+                }
+                peerInitialWindow_ = value;
+                break;
+            }
+            case kMaxFrameSize:
+                if (value < 16384 || value > 16777215)
+                {
+                    connectionError(kProtocolError);
+                    return false;
+                }
+                peerMaxFrameSize_ = value;
+                break;
+            default:
+                break; // 服务器不推送，不限制对方的并发流；未知的设置忽略
+            }
+        }
+        return true;
+    }
+
+    bool Http2Connection::onWindowUpdate(uint32_t streamId, const char *payload, size_t len)
+    {
+        if (len != 4)
+        {
+            connectionError(kFrameSizeError);
+            return false;
+        }
+        int64_t increment = readUint32(payload) & 0x7fffffff;
+        if (streamId == 0)
+        {
+            if (increment == 0 || sendWindow_ + increment > kMaxWindow)
+            {
+                connectionError(increment == 0 ? kProtocolError : kFlowControlError);
+                return false;
+            }
+            sendWindow_ += increment;
+        }
+        else
+        {
+            auto it = streams_.find(streamId);
+            if (it == streams_.end())
+            {
+                return true; // 已经关闭的流
+            }
+            Stream *stream = it->second.get();
+            if (increment == 0 || stream->sendWindow + increment > kMaxWindow)
+            {
+                sendRstStream(streamId, increment == 0 ? kProtocolError : kFlowControlError);
+                closeStream(it);
+                return true;
+            }
+            stream->sendWindow += increment;
+        }
+        flushStreams();
+        return true;
+    }
+
+    void Http2Connection::onRstStream(uint32_t streamId)
+    {
+        auto it = streams_.find(streamId);
+        if (it != streams_.end())
+        {
+            closeStream(it);
+            closeIfDone();
+        }
+    }
+
+    void Http2Connection::onWriteComplete()
+    {
+        flushStreams();
+        flushOutput();
+    }
+
+    void Http2Connection::onClosed()
+    {
+        closed_ = true;
+        while (!streams_.empty())
+        {
+            closeStream(streams_.begin());
+        }
+    }
+
+    void Http2Connection::goAway()
+    {
+        if (goAwaySent_ || closed_)
+        {
+            return;
+        }
+        goAwaySent_ = true;
+        appendFrameHeader(8, kGoAway, 0, 0);
+        appendUint32(&output_, lastStreamId_);
+        appendUint32(&output_, kNoError);
+        flushOutput();
+        closeIfDone();
+    }
+
+    void Http2Connection::connectionError(ErrorCode error)
+    {
+        g_connectionErrors->increment();
+        LOG_FMT_ERROR("Http2Connection - connection error %d \n", static_cast<int>(error));
+        if (!goAwaySent_)
+        {
+            appendFrameHeader(8, kGoAway, 0, 0);
+            appendUint32(&output_, lastStreamId_);
+            appendUint32(&output_, error);
+        }
+        goAwaySent_ = true;
+        closed_ = true;
+        flushOutput();
+        TcpConnectionPtr conn(conn_.lock());
+        if (conn)
+        {
+            conn->shutdown();
+        }
+    }
+
+    void Http2Connection::appendFrameHeader(size_t len, uint8_t type, uint8_t flags, uint32_t streamId)
+    {
+        char header[kFrameHeaderLength] = {static_cast<char>(len >> 16), static_cast<char>(len >> 8), static_cast<char>(len),
+                                           static_cast<char>(type), static_cast<char>(flags)};
+        output_.append(header, 5);
+        appendUint32(&output_, streamId);
+    }
+
+    void Http2Connection::sendRstStream(uint32_t streamId, ErrorCode error)
+    {
+        appendFrameHeader(4, kRstStream, 0, streamId);
+        appendUint32(&output_, error);
+    }
+
+    void Http2Connection::sendWindowUpdate(uint32_t streamId, uint32_t increment)
+    {
+        appendFrameHeader(4, kWindowUpdate, 0, streamId);
+        appendUint32(&output_, increment);
+    }
+
+    void Http2Connection::returnWindow(int64_t bytes)
+    {
+        if (closed_)
+        {
+            return;
+        }
+        recvUnacked_ += bytes;
+        if (recvUnacked_ >= kOurWindow / 2)
+        {
+            sendWindowUpdate(0, static_cast<uint32_t>(recvUnacked_));
+            recvWindow_ += recvUnacked_;
+            recvUnacked_ = 0;
+        }
+    }
+
+    void Http2Connection::releaseBody(Stream *stream)
+    {
+        bufferedBody_ -= stream->buffered;
+        stream->buffered = 0;
+        // 腾出的预算先还之前欠下的窗口
+        int64_t paid = std::min(recvOwed_, std::max<int64_t>(0, kMaxBufferedBody - bufferedBody_));
+        recvOwed_ -= paid;
+        returnWindow(paid);
+    }
+
+    size_t Http2Connection::appendHeaderBlock(uint32_t streamId, const HttpResponse &response, int64_t contentLength, bool endStream)
+    {
+        std::string block;
+        encoder_.beginBlock(&block);
+        char buf[mymuduo::detail::kMaxNumericSize];
+        encoder_.encode(":status", std::string(buf, mymuduo::detail::formatUnsigned(buf, response.statusCode())), &block);
+        std::string name;
+        for (const auto &header : response.headers())
+        {
+            name.assign(header.first);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (connectionSpecific(name) || name == "content-length")
+            {
+                continue;
+            }
+            // 每个响应都不一样的值不进动态表，免得把常用的条目挤出去
+            bool index = name != "etag" && name != "last-modified" && name != "date" && name != "set-cookie";
+            encoder_.encode(name, header.second, &block, index);
+        }
+        if (contentLength >= 0)
+        {
+            encoder_.encode("content-length", std::string(buf, mymuduo::detail::formatUnsigned(buf, contentLength)), &block, false);
+        }
+
+        size_t before = output_.readableBytes();
+        size_t pos = 0;
+        uint8_t type = kHeaders;
+        do
+        {
+            size_t n = std::min<size_t>(block.size() - pos, peerMaxFrameSize_);
+            uint8_t flags = pos + n == block.size() ? kEndHeaders : 0;
+            if (type == kHeaders && endStream)
+            {
+                flags |= kEndStream;
+            }
+            appendFrameHeader(n, type, flags, streamId);
+            output_.append(block.data() + pos, n);
+            pos += n;
+            type = kContinuation;
+        } while (pos < block.size());
+        return output_.readableBytes() - before;
+    }
+
+    bool Http2Connection::sendResponse(uint32_t streamId, const HttpResponse &response, bool headOnly, size_t *bytes)
+    {
+        auto it = streams_.find(streamId);
+        if (closed_ || it == streams_.end())
+        {
+            return false;
+        }
+        Stream *stream = it->second.get();
+        const std::string &body = response.body();
+        bool hasBody = !headOnly && !body.empty();
+        *bytes = appendHeaderBlock(streamId, response, static_cast<int64_t>(body.size()), !hasBody);
+        stream->endQueued = true;
+        if (hasBody)
+        {
+            stream->pending.append(body);
+            *bytes += body.size();
+        }
+        else
+        {
+            stream->endSent = true;
+            closeStream(it);
+        }
+        flushStreams();
+        flushOutput();
+        closeIfDone();
+        return true;
+    }
+
+    bool Http2Connection::sendHeaders(uint32_t streamId, const HttpResponse &response, bool endStream, size_t *bytes)
+    {
+        auto it = streams_.find(streamId);
+        if (closed_ || it == streams_.end())
+        {
+            return false;
+        }
+        *bytes = appendHeaderBlock(streamId, response, -1, endStream);
+        if (endStream)
+        {
+            it->second->endQueued = true;
+            it->second->endSent = true;
+            closeStream(it);
+        }
+        flushOutput();
+        closeIfDone();
+        return true;
+    }
+
+    bool Http2Connection::sendData(uint32_t streamId, const char *data, size_t len, bool endStream)
+    {
+        auto it = streams_.find(streamId);
+        if (closed_ || it == streams_.end() || it->second->endQueued)
+        {
+            return false;
+        }
+        it->second->pending.append(data, len);
+        it->second->endQueued = endStream;
+        flushStreams();
+        flushOutput();
+        closeIfDone();
+        return true;
+    }
+
+    size_t Http2Connection::backlog(uint32_t streamId) const
+    {
+        TcpConnectionPtr conn(conn_.lock());
+        auto it = streams_.find(streamId);
+        return (it == streams_.end() ? 0 : it->second->pending.readableBytes()) +
+               output_.readableBytes() + (conn ? conn->outputBufferSize() : 0);
+    }
+
+    void Http2Connection::setResponse(uint32_t streamId, const std::shared_ptr<AsyncResponse> &response)
+    {
+        auto it = streams_.find(streamId);
+        if (it != streams_.end())
+        {
+            it->second->response = response;
+        }
+    }
+
+    void Http2Connection::flushStreams()
+    {
+        TcpConnectionPtr conn(conn_.lock());
+        if (!conn || closed_)
+        {
+            return;
+        }
+        bool progress = true;
+        while (progress)
+        {
+            if (conn->outputBufferSize() + output_.readableBytes() >= server_->highWaterMark_)
+            {
+                // 等输出缓冲区写空再继续
+                server_->watchWriteComplete(conn);
+                break;
+            }
+            progress = false;
+            // 每个流每轮最多一帧，大响应不会把别的流饿住
+            for (auto it = streams_.begin(); it != streams_.end();)
+            {
+                Stream *stream = it->second.get();
+                size_t pending = stream->pending.readableBytes();
+                int64_t window = std::min(stream->sendWindow, sendWindow_);
+                size_t n = window > 0 ? std::min<size_t>({pending, static_cast<size_t>(window), peerMaxFrameSize_}) : 0;
+                bool last = stream->endQueued && !stream->endSent && n == pending;
+                if (n > 0 || (last && pending == 0))
+                {
+                    appendFrameHeader(n, kData, last ? kEndStream : 0, stream->id);
+                    output_.append(stream->pending.peek(), n);
+                    stream->pending.retrieve(n);
+                    stream->sendWindow -= n;
+                    sendWindow_ -= n;
+                    stream->endSent = last;
+                    progress = true;
+                }
+                if (stream->endSent)
+                {
+                    closeStream(it++);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        resumeStreams();
+    }
+
+    void Http2Connection::resumeStreams()
+    {
+        std::vector<std::shared_ptr<AsyncResponse>> resumed;
+        for (const auto &item : streams_)
+        {
+            const std::shared_ptr<AsyncResponse> &response = item.second->response;
+            if (response && !response->writable() && !item.second->endQueued &&
+                backlog(item.first) < server_->highWaterMark_)
+            {
+                resumed.push_back(response);
+            }
+        }
+        // 可写回调里会接着sendData，遍历完再调用
+        for (const auto &response : resumed)
+        {
+            response->onStreamWritable();
+        }
+    }
+
+    void Http2Connection::flushOutput()
+    {
+        if (output_.readableBytes() == 0)
+        {
+            return;
+        }
+        TcpConnectionPtr conn(conn_.lock());
+        if (conn)
+        {
+            conn->send(&output_);
+        }
+        output_.retrieveAll();
+    }
+
+    void Http2Connection::closeStream(StreamMap::iterator it)
+    {
+        Stream *stream = it->second.get();
+        releaseBody(stream);
+        if (!stream->endSent)
+        {
+            if (!closed_)
+            {
+                g_streamResets->increment();
+            }
+            if (stream->response)
+            {
+                // 流被重置或连接断开，停止流式响应的生产者
+                stream->response->onStreamClosed();
+            }
+        }
+        streams_.erase(it);
+    }
+
+    void Http2Connection::closeIfDone()
+    {
+        if (goAwaySent_ && !closed_ && streams_.empty())
+        {
+            flushOutput();
+            TcpConnectionPtr conn(conn_.lock());
+            if (conn)
+            {
+                conn->shutdown();
+            }
+        }
+    }
+} // namespace http
@@ -1,6 +1,10 @@
 #include <http/HttpContext.h>
 #include <mymuduo/Buffer.h>
 
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+
 using namespace mymuduo;
 
 namespace http
@@ -48,7 +52,70 @@ namespace http
         return succeed;
     }
 
+    bool HttpContext::processStatusLine(const char *begin, const char *end)
+    {
+        // HTTP/1.1 200 OK
+        if (end - begin < 12 || !std::equal(begin, begin + 7, "HTTP/1.") || begin[8] != ' ')
+        {
+            return false;
+        }
+        if (begin[7] == '1')
+        {
+            request_.setVersion(HttpRequest::kHttp11);
+        }
+        else if (begin[7] == '0')
+        {
+            request_.setVersion(HttpRequest::kHttp10);
+        }
+        else
+        {
+            return false;
+        }
+        const char *code = begin + 9;
+        if (!::isdigit(code[0]) || !::isdigit(code[1]) || !::isdigit(code[2]) || (code + 3 != end && code[3] != ' '))
+        {
+            return false;
+        }
+        statusCode_ = (code[0] - '0') * 100 + (code[1] - '0') * 10 + (code[2] - '0');
+        statusMessage_.assign(code + 3 == end ? end : code + 4, end);
+        return true;
+    }
+
+    bool HttpContext::processHeadersEnd()
+    {
+        // 请求体只支持Content-Length，不支持chunked
+        if (!request_.getHeader("Transfer-Encoding").empty())
+        {
+            return false;
+        }
+        const std::string length = request_.getHeader("Content-Length");
+        if (length.empty())
+        {
+            state_ = kGotAll;
+            return true;
+        }
+        char *last = nullptr;
+        unsigned long long n = ::strtoull(length.c_str(), &last, 10);
+        if (last == length.c_str() || *last != '\0' || n > kMaxBodySize)
+        {
+            return false;
+        }
+        bodyRemaining_ = static_cast<size_t>(n);
+        state_ = bodyRemaining_ > 0 ? kExpectBody : kGotAll;
+        return true;
+    }
+
     bool HttpContext::parseRequest(mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime)
+    {
+        return parse(buf, receiveTime, false);
+    }
+
+    bool HttpContext::parseResponseHead(mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime)
+    {
+        return parse(buf, receiveTime, true);
+    }
+
+    bool HttpContext::parse(mymuduo::Buffer *buf, mymuduo::Timestamp receiveTime, bool isResponse)
     {
         bool ok = true;
         bool hasMore = true;
@@ -59,7 +126,7 @@ namespace http
                 const char *crlf = buf->findCRLF();
                 if (crlf)
                 {
-                    ok = processRequestLine(buf->peek(), crlf);
+                    ok = isResponse ? processStatusLine(buf->peek(), crlf) : processRequestLine(buf->peek(), crlf);
                     if (ok)
                     {
                         request_.setReceiveTime(receiveTime);
@@ -84,16 +151,28 @@ namespace http
                     const char *colon = std::find(buf->peek(), crlf, ':');
                     if (colon != crlf)
                     {
+                        if (request_.headers().size() >= kMaxHeaders)
+                        {
+                            ok = false;
+                            break;
+                        }
                         request_.addHeader(buf->peek(), colon, crlf);
+                        buf->retrieveUntil(crlf + 2);
                     }
                     else
                     {
                         // empty line, end of header
-                        // FIXME:
-                        state_ = kGotAll;
-                        hasMore = false;
+                        buf->retrieveUntil(crlf + 2);
+                        if (isResponse)
+                        {
+                            state_ = kGotAll; // 响应body由调用方处理
+                        }
+                        else
+                        {
+                            ok = processHeadersEnd();
+                        }
+                        hasMore = ok && state_ == kExpectBody;
                     }
-                    buf->retrieveUntil(crlf + 2);
                 }
                 else
                 {
@@ -102,7 +181,19 @@ namespace http
             }
             else if (state_ == kExpectBody)
             {
-                // FIXME:
+                size_t n = std::min(bodyRemaining_, buf->readableBytes());
+                request_.appendBody(buf->peek(), buf->peek() + n);
+                buf->retrieve(n);
+                bodyRemaining_ -= n;
+                if (bodyRemaining_ == 0)
+                {
+                    state_ = kGotAll;
+                }
+                hasMore = false;
+            }
+            else
+            {
+                hasMore = false;
             }
         }
         return ok;
@@ -0,0 +1,781 @@
+#include <http/HttpProxy.h>
+#include <http/HttpServer.h>
+#include <http/HttpContext.h>
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Metrics.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/UpstreamPool.h>
+
+#include <algorithm>
+#include <future>
+#include <unordered_map>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace mymuduo;
+
+namespace http
+{
+    namespace detail
+    {
+        Counter *const g_proxyRetries = MetricsRegistry::instance().counter(
+            "http_proxy_retries_total", "Proxied requests sent again to another upstream.");
+        Counter *const g_proxyUpstreamErrors = MetricsRegistry::instance().counter(
+            "http_proxy_upstream_errors_total", "Upstream connect failures, timeouts and malformed responses.");
+    } // namespace detail
+
+    namespace
+    {
+        // 只对相邻两跳有意义、不能转发的头部，RFC 7230 6.1
+        const char *const kHopByHopHeaders[] = {
+            "Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer", "Transfer-Encoding", "Upgrade",
+        };
+
+        bool isHopByHop(const std::string &field, const std::string &connection)
+        {
+            for (const char *name : kHopByHopHeaders)
+            {
+                if (::strcasecmp(field.c_str(), name) == 0)
+                {
+                    return true;
+                }
+            }
+            // Connection里列出的头部也只属于这一跳
+            const char *p = connection.c_str();
+            while (*p)
+            {
+                while (*p == ' ' || *p == ',')
+                {
+                    ++p;
+                }
+                const char *token = p;
+                while (*p && *p != ' ' && *p != ',')
+                {
+                    ++p;
+                }
+                if (static_cast<size_t>(p - token) == field.size() && ::strncasecmp(token, field.c_str(), field.size()) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 大小写不敏感地查找头部，上游的写法不一定和我们一致
+        const std::string *findHeader(const HttpHeaders &headers, const char *field)
+        {
+            for (const auto &header : headers)
+            {
+                if (::strcasecmp(header.first.c_str(), field) == 0)
+                {
+                    return &header.second;
+                }
+            }
+            return nullptr;
+        }
+
+        bool hasToken(const std::string *value, const char *token)
+        {
+            return value && ::strcasestr(value->c_str(), token) != nullptr;
+        }
+    } // namespace
+
+    // 每个IO loop私有，只在该loop线程里访问
+    struct HttpProxy::LoopState
+    {
+        EventLoop *loop;
+        std::vector<std::unique_ptr<UpstreamPool>> pools; // 和upstreams_一一对应
+        std::unordered_map<Exchange *, ExchangePtr> active;
+    };
+
+    // 一次转发：客户端的一个请求和为它选定的上游连接，作为上游连接的context
+    struct HttpProxy::Exchange
+    {
+        enum BodyMode
+        {
+            kNoBody,
+            kLength,
+            kChunked,
+            kUntilClose,
+        };
+        enum ChunkState
+        {
+            kChunkSize,
+            kChunkData, // chunk数据和它后面的CRLF
+            kChunkTrailer,
+        };
+
+        Exchange(const AsyncResponsePtr &resp, LoopState *s)
+            : client(resp),
+              state(s),
+              needHost(false),
+              headRequest(false),
+              retryable(false),
+              upstream(-1),
+              attempts(0),
+              sent(false),
+              received(false),
+              headSent(false),
+              clientGone(false),
+              finished(false),
+              mode(kNoBody),
+              remaining(0),
+              chunkState(kChunkSize),
+              keepAlive(false),
+              status(0)
+        {
+        }
+
+        AsyncResponsePtr client;
+        LoopState *state;
+        std::string requestHead; // 不含结尾空行，重试时再发一次
+        bool needHost;           // 客户端没带Host，发送时补上游地址
+        bool headRequest;        // HEAD的响应没有body
+        bool retryable;          // 幂等方法，请求发出去之后也可以换上游重试
+        int upstream;            // upstreams_的下标，-1表示没有占用上游
+        int attempts;
+        TcpConnectionPtr conn;
+        TimerId timer;
+        HttpContext head; // 解析响应头
+        bool sent;
+        bool received;
+        bool headSent;
+        bool clientGone;
+        bool finished;
+        BodyMode mode;
+        size_t remaining;
+        ChunkState chunkState;
+        bool keepAlive; // 上游连接在响应结束后可以复用
+        int status;
+    };
+
+    HttpProxy::HttpProxy(HttpServer *server, const std::vector<InetAddress> &upstreams)
+        : server_(server),
+          balance_(kRoundRobin),
+          maxFails_(3),
+          failTimeout_(10.0),
+          timeout_(30.0),
+          maxIdle_(16),
+          next_(0)
+    {
+        for (const InetAddress &addr : upstreams)
+        {
+            upstreams_.emplace_back(new Upstream(addr));
+        }
+        server_->addThreadInitCallback(std::bind(&HttpProxy::initLoop, this, std::placeholders::_1));
+    }
+
+    HttpProxy::~HttpProxy()
+    {
+        for (auto &item : loops_)
+        {
+            EventLoop *loop = item.first;
+            LoopState *state = item.second;
+            if (loop->isInLoopThread())
+            {
+                destroyLoopState(state);
+            }
+            else
+            {
+                // UpstreamPool只能在自己的loop里析构，等它做完；loop线程此时必须还在运行
+                std::promise<void> destroyed;
+                loop->runInLoop([this, state, &destroyed]() {
+                    destroyLoopState(state);
+                    destroyed.set_value();
+                });
+                destroyed.get_future().wait();
+            }
+        }
+    }
+
+    void HttpProxy::initLoop(EventLoop *loop)
+    {
+        LoopState *state = new LoopState;
+        state->loop = loop;
+        for (const auto &upstream : upstreams_)
+        {
+            std::unique_ptr<UpstreamPool> pool(new UpstreamPool(loop, upstream->addr, "HttpProxy"));
+            pool->setMaxIdle(maxIdle_);
+            pool->setConnectionCallback(std::bind(&HttpProxy::onUpstreamConnection, this, std::placeholders::_1));
+            pool->setMessageCallback(std::bind(&HttpProxy::onUpstreamMessage, this, std::placeholders::_1,
+                                               std::placeholders::_2, std::placeholders::_3));
+            state->pools.push_back(std::move(pool));
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        loops_[loop] = state;
+    }
+
+    void HttpProxy::destroyLoopState(LoopState *state)
+    {
+        // 还在途的请求回复502，它们的上游连接随连接池一起关闭
+        std::unordered_map<Exchange *, ExchangePtr> active;
+        active.swap(state->active);
+        for (auto &item : active)
+        {
+            const ExchangePtr &ex = item.second;
+            ex->conn.reset();
+            if (!ex->finished)
+            {
+                replyError(ex, HttpResponse::k502BadGateway, "Bad Gateway");
+            }
+        }
+        delete state;
+    }
+
+    void HttpProxy::handle(const AsyncResponsePtr &response)
+    {
+        auto it = loops_.find(response->getLoop());
+        if (it == loops_.end() || upstreams_.empty())
+        {
+            LOG_ERROR << "HttpProxy::handle - no upstream on this loop, constructed after HttpServer::start()?";
+            response->response()->setStatusCode(HttpResponse::k502BadGateway);
+            response->response()->setStatusMessage("Bad Gateway");
+            response->done();
+            return;
+        }
+        LoopState *state = it->second;
+        ExchangePtr ex(std::make_shared<Exchange>(response, state));
+        // 客户端读得慢时停止读上游，客户端的输出缓冲区写空后恢复，内存占用不超过高水位
+        std::weak_ptr<Exchange> weakEx(ex);
+        response->setWritableCallback([weakEx]() {
+            ExchangePtr ex(weakEx.lock());
+            if (ex && ex->conn)
+            {
+                ex->conn->startRead();
+            }
+        });
+
+        const HttpRequest &req = response->request();
+        HttpRequest::Method method = req.method();
+        ex->retryable = method == HttpRequest::kGet || method == HttpRequest::kHead ||
+                        method == HttpRequest::kPut || method == HttpRequest::kDelete;
+        ex->headRequest = method == HttpRequest::kHead;
+
+        std::string &out = ex->requestHead;
+        out.reserve(256);
+        out += req.methodString();
+        out += ' ';
+        out += req.path();
+        out += req.query(); // 带着'?'
+        out += " HTTP/1.1\r\n";
+        const HttpHeaders &headers = req.headers();
+        const std::string *connection = findHeader(headers, "Connection");
+        const std::string noConnection;
+        std::string forwardedFor;
+        bool hasHost = false;
+        for (const auto &header : headers)
+        {
+            const std::string &field = header.first;
+            if (isHopByHop(field, connection ? *connection : noConnection) ||
+                ::strcasecmp(field.c_str(), "Content-Length") == 0 ||
+                ::strcasecmp(field.c_str(), "Expect") == 0) // 请求体已经收齐了，不需要100-continue
+            {
+                continue;
+            }
+            if (::strcasecmp(field.c_str(), "X-Forwarded-For") == 0)
+            {
+                forwardedFor = header.second;
+                continue;
+            }
+            hasHost = hasHost || ::strcasecmp(field.c_str(), "Host") == 0;
+            out += field;
+            out += ": ";
+            out += header.second;
+            out += "\r\n";
+        }
+        ex->needHost = !hasHost;
+        TcpConnectionPtr conn(response->connection());
+        if (conn)
+        {
+            out += "X-Forwarded-For: ";
+            if (!forwardedFor.empty())
+            {
+                out += forwardedFor;
+                out += ", ";
+            }
+            out += conn->peerAddress().toIP();
+            out += "\r\n";
+        }
+        if (!req.body().empty() || method == HttpRequest::kPost || method == HttpRequest::kPut)
+        {
+            out += "Content-Length: ";
+            out += std::to_string(req.body().size());
+            out += "\r\n";
+        }
+
+        state->active[ex.get()] = ex;
+        ex->timer = state->loop->runAfter(timeout_, std::bind(&HttpProxy::onTimeout, this, std::weak_ptr<Exchange>(ex)));
+        startExchange(ex, -1);
+    }
+
+    int HttpProxy::pickUpstream(int exclude)
+    {
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        size_t n = upstreams_.size();
+        unsigned start = next_.fetch_add(1, std::memory_order_relaxed);
+        int best = -1;
+        int fallback = -1; // 只剩exclude可用时还是用它
+        for (size_t i = 0; i < n; ++i)
+        {
+            int index = static_cast<int>((start + i) % n);
+            const Upstream *upstream = upstreams_[index].get();
+            if (upstream->downUntil.load(std::memory_order_relaxed) > now)
+            {
+                continue;
+            }
+            if (index == exclude)
+            {
+                fallback = index;
+                continue;
+            }
+            if (balance_ == kRoundRobin)
+            {
+                return index;
+            }
+            if (best < 0 || upstream->outstanding.load(std::memory_order_relaxed) <
+                                upstreams_[best]->outstanding.load(std::memory_order_relaxed))
+            {
+                best = index;
+            }
+        }
+        return best >= 0 ? best : fallback;
+    }
+
+    void HttpProxy::markFailure(int index)
+    {
+        detail::g_proxyUpstreamErrors->increment();
+        Upstream *upstream = upstreams_[index].get();
+        if (upstream->fails.fetch_add(1, std::memory_order_relaxed) + 1 >= maxFails_)
+        {
+            upstream->fails.store(0, std::memory_order_relaxed);
+            int64_t until = Timestamp::now().microSecondsSinceEpoch() + static_cast<int64_t>(failTimeout_ * Timestamp::kMicroSecondsPerSecond);
+            upstream->downUntil.store(until, std::memory_order_relaxed);
+            LOG_FMT_ERROR("HttpProxy - upstream %s failed %d times, marked down for %.1fs \n",
+                          upstream->addr.toIPport().c_str(), maxFails_, failTimeout_);
+        }
+    }
+
+    void HttpProxy::markSuccess(int index)
+    {
+        Upstream *upstream = upstreams_[index].get();
+        // 大多数时候已经是0，不去写共享的缓存行
+        if (upstream->fails.load(std::memory_order_relaxed) != 0)
+        {
+            upstream->fails.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void HttpProxy::startExchange(const ExchangePtr &ex, int exclude)
+    {
+        int index = pickUpstream(exclude);
+        if (index < 0)
+        {
+            replyError(ex, HttpResponse::k503ServiceUnavailable, "Service Unavailable");
+            return;
+        }
+        ex->upstream = index;
+        ++ex->attempts;
+        upstreams_[index]->outstanding.fetch_add(1, std::memory_order_relaxed);
+        ex->state->pools[index]->acquire(std::bind(&HttpProxy::onAcquired, this, ex, index, std::placeholders::_1));
+    }
+
+    void HttpProxy::onAcquired(const ExchangePtr &ex, int index, const TcpConnectionPtr &conn)
+    {
+        if (ex->finished || ex->upstream != index)
+        {
+            // 连接建立之前已经超时了，新连接还能给后面的请求用
+            if (conn)
+            {
+                ex->state->pools[index]->release(conn);
+            }
+            return;
+        }
+        if (!conn)
+        {
+            fail(ex, HttpResponse::k502BadGateway, "connect failed", true);
+            return;
+        }
+        ex->conn = conn;
+        conn->setContext(ex);
+
+        const HttpRequest &req = ex->client->request();
+        Buffer out;
+        out.append(ex->requestHead);
+        if (ex->needHost)
+        {
+            out.append("Host: ");
+            out.append(upstreams_[ex->upstream]->addr.toIPport());
+            out.append("\r\n", 2);
+        }
+        out.append("\r\n", 2);
+        out.append(req.body());
+        conn->send(&out);
+        ex->sent = true;
+    }
+
+    void HttpProxy::onUpstreamConnection(const TcpConnectionPtr &conn)
+    {
+        if (conn->connected() || !conn->getContext())
+        {
+            return;
+        }
+        ExchangePtr ex(std::static_pointer_cast<Exchange>(conn->getContext()));
+        ex->conn.reset();
+        if (ex->headSent && ex->mode == Exchange::kUntilClose)
+        {
+            finish(ex, true, false); // 没有长度的body以连接关闭结束
+        }
+        else
+        {
+            // 还没收到任何数据时多半是空闲连接刚好被上游关掉，不算上游的错
+            fail(ex, HttpResponse::k502BadGateway, "connection closed", ex->received);
+        }
+    }
+
+    void HttpProxy::onUpstreamMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+    {
+        ExchangePtr ex(std::static_pointer_cast<Exchange>(conn->getContext()));
+        if (!ex)
+        {
+            buf->retrieveAll();
+            return;
+        }
+        ex->received = true;
+        bool ok = true;
+        if (!ex->headSent)
+        {
+            ok = forwardHead(ex, buf, receiveTime);
+            if (ok && !ex->headSent)
+            {
+                return; // 响应头还不完整
+            }
+        }
+        if (ok)
+        {
+            ok = forwardBody(ex, buf);
+        }
+        if (!ok)
+        {
+            if (ex->clientGone)
+            {
+                // 客户端已经断开，剩下的响应没人要了，上游连接也不能复用
+                finish(ex, false, false);
+            }
+            else
+            {
+                fail(ex, HttpResponse::k502BadGateway, "invalid response", true);
+            }
+        }
+    }
+
+    bool HttpProxy::forwardHead(const ExchangePtr &ex, Buffer *buf, Timestamp receiveTime)
+    {
+        HttpContext &head = ex->head;
+        while (true)
+        {
+            if (!head.parseResponseHead(buf, receiveTime))
+            {
+                return false;
+            }
+            if (!head.gotAll())
+            {
+                return true;
+            }
+            int code = head.statusCode();
+            if (code >= 100 && code < 200)
+            {
+                if (code == 101)
+                {
+                    return false; // 没有转发Upgrade，不应该切换协议
+                }
+                head.reset(); // 100 Continue之类的中间响应不转发
+                continue;
+            }
+            break;
+        }
+
+        const HttpRequest &resp = head.request();
+        const HttpHeaders &headers = resp.headers();
+        const std::string *connection = findHeader(headers, "Connection");
+        const std::string *transferEncoding = findHeader(headers, "Transfer-Encoding");
+        const std::string *contentLength = findHeader(headers, "Content-Length");
+        int code = head.statusCode();
+        ex->status = code;
+
+        // 分帧方式，RFC 7230 3.3.3
+        if (ex->headRequest || code == 204 || code == 304)
+        {
+            ex->mode = Exchange::kNoBody;
+        }
+        else if (transferEncoding)
+        {
+            ex->mode = hasToken(transferEncoding, "chunked") ? Exchange::kChunked : Exchange::kUntilClose;
+        }
+        else if (contentLength)
+        {
+            char *last = nullptr;
+            unsigned long long length = ::strtoull(contentLength->c_str(), &last, 10);
+            if (last == contentLength->c_str() || *last != '\0')
+            {
+                return false;
+            }
+            ex->mode = Exchange::kLength;
+            ex->remaining = static_cast<size_t>(length);
+        }
+        else
+        {
+            ex->mode = Exchange::kUntilClose;
+        }
+        ex->keepAlive = ex->mode != Exchange::kUntilClose &&
+                        (resp.getVersion() == HttpRequest::kHttp11 ? !hasToken(connection, "close")
+                                                                    : hasToken(connection, "keep-alive"));
+
+        // 没有长度的body只能靠关闭连接告诉客户端结束了
+        bool closeClient = ex->client->response()->closeConnection() || ex->mode == Exchange::kUntilClose;
+        std::string out;
+        out.reserve(256);
+        out += "HTTP/1.1 ";
+        out += std::to_string(code);
+        out += ' ';
+        out += head.statusMessage();
+        out += "\r\n";
+        const std::string noConnection;
+        for (const auto &header : headers)
+        {
+            // chunked的body原样转发，Transfer-Encoding要留着
+            if (isHopByHop(header.first, connection ? *connection : noConnection) &&
+                !(ex->mode == Exchange::kChunked && &header.second == transferEncoding))
+            {
+                continue;
+            }
+            out += header.first;
+            out += ": ";
+            out += header.second;
+            out += "\r\n";
+        }
+        out += closeClient ? "Connection: close\r\n\r\n" : "Connection: Keep-Alive\r\n\r\n";
+        ex->headSent = true;
+        if (!ex->client->sendRaw(out.data(), out.size()))
+        {
+            ex->clientGone = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool HttpProxy::forwardBody(const ExchangePtr &ex, Buffer *buf)
+    {
+        size_t n = 0;
+        bool done = false;
+        switch (ex->mode)
+        {
+        case Exchange::kNoBody:
+            done = true;
+            break;
+        case Exchange::kLength:
+            n = std::min(ex->remaining, buf->readableBytes());
+            ex->remaining -= n;
+            done = ex->remaining == 0;
+            break;
+        case Exchange::kChunked:
+        {
+            bool bad = false;
+            n = scanChunks(ex.get(), buf->peek(), buf->readableBytes(), &done, &bad);
+            if (bad)
+            {
+                return false;
+            }
+            break;
+        }
+        case Exchange::kUntilClose:
+            n = buf->readableBytes();
+            break;
+        }
+        if (n > 0)
+        {
+            if (!ex->client->sendRaw(buf->peek(), n))
+            {
+                ex->clientGone = true;
+                return false;
+            }
+            buf->retrieve(n);
+            if (!ex->client->writable())
+            {
+                ex->conn->stopRead();
+            }
+        }
+        if (done)
+        {
+            // 响应后面还有数据说明上游不守规矩，连接不能复用
+            bool reusable = ex->keepAlive && buf->readableBytes() == 0;
+            buf->retrieveAll();
+            finish(ex, true, reusable);
+        }
+        return true;
+    }
+
+    void HttpProxy::fail(const ExchangePtr &ex, HttpResponse::HttpStatusCode status, const char *reason, bool upstreamFault)
+    {
+        if (ex->finished)
+        {
+            return;
+        }
+        int last = ex->upstream;
+        LOG_FMT_ERROR("HttpProxy - %s %s: %s \n", ex->client->request().methodString(),
+                      last >= 0 ? upstreams_[last]->addr.toIPport().c_str() : "-", reason);
+        if (upstreamFault && last >= 0)
+        {
+            markFailure(last);
+        }
+        detachUpstream(ex, false);
+        // 响应头还没发出，并且请求可以安全地再发一次(还没发出去或者是幂等方法)
+        if (status == HttpResponse::k502BadGateway && !ex->headSent && ex->attempts < 2 &&
+            (!ex->sent || ex->retryable))
+        {
+            detail::g_proxyRetries->increment();
+            ex->sent = false;
+            ex->received = false;
+            ex->head.reset();
+            startExchange(ex, last);
+            return;
+        }
+        if (ex->headSent)
+        {
+            // 只能断开客户端，让它从不完整的body知道出错了
+            finish(ex, false, false);
+            return;
+        }
+        replyError(ex, status, status == HttpResponse::k504GatewayTimeout ? "Gateway Timeout" : "Bad Gateway");
+    }
+
+    void HttpProxy::onTimeout(const std::weak_ptr<Exchange> &weakEx)
+    {
+        ExchangePtr ex(weakEx.lock());
+        if (ex && !ex->finished)
+        {
+            ex->timer = TimerId(); // 已经触发了，不用再cancel
+            fail(ex, HttpResponse::k504GatewayTimeout, "timeout", true);
+        }
+    }
+
+    void HttpProxy::finish(const ExchangePtr &ex, bool complete, bool reusable)
+    {
+        if (ex->finished)
+        {
+            return;
+        }
+        if (complete && ex->upstream >= 0)
+        {
+            markSuccess(ex->upstream);
+        }
+        detachUpstream(ex, reusable);
+        ex->finished = true;
+        ex->state->loop->cancel(ex->timer);
+        // body不完整或者没有长度时，只能用关闭连接告诉客户端响应结束了
+        bool close = ex->client->response()->closeConnection() || !complete || ex->mode == Exchange::kUntilClose;
+        ex->client->finishRaw(ex->status, close);
+        ex->state->active.erase(ex.get());
+    }
+
+    void HttpProxy::replyError(const ExchangePtr &ex, HttpResponse::HttpStatusCode status, const char *message)
+    {
+        ex->finished = true;
+        ex->state->loop->cancel(ex->timer);
+        HttpResponse *response = ex->client->response();
+        response->setStatusCode(status);
+        response->setStatusMessage(message);
+        response->setContentType("text/plain");
+        response->setBody(std::string(message) + "\n");
+        ex->client->done();
+        ex->state->active.erase(ex.get());
+    }
+
+    void HttpProxy::detachUpstream(const ExchangePtr &ex, bool reusable)
+    {
+        if (ex->upstream < 0)
+        {
+            return;
+        }
+        if (ex->conn)
+        {
+            TcpConnectionPtr conn(std::move(ex->conn));
+            conn->setContext(std::shared_ptr<void>());
+            if (reusable)
+            {
+                conn->startRead(); // 最后一段body可能让它暂停了，空闲连接要能发现上游关闭
+                ex->state->pools[ex->upstream]->release(conn);
+            }
+            else
+            {
+                conn->forceClose();
+            }
+        }
+        upstreams_[ex->upstream]->outstanding.fetch_sub(1, std::memory_order_relaxed);
+        ex->upstream = -1;
+    }
+
+    size_t HttpProxy::scanChunks(Exchange *ex, const char *data, size_t len, bool *done, bool *bad)
+    {
+        static const size_t kMaxChunkLine = 4096;
+        size_t pos = 0;
+        while (pos < len && !*done)
+        {
+            if (ex->chunkState == Exchange::kChunkData)
+            {
+                size_t n = std::min(ex->remaining, len - pos);
+                pos += n;
+                ex->remaining -= n;
+                if (ex->remaining == 0)
+                {
+                    ex->chunkState = Exchange::kChunkSize;
+                }
+                continue;
+            }
+            const char *line = data + pos;
+            const char *crlf = static_cast<const char *>(::memmem(line, len - pos, "\r\n", 2));
+            if (crlf == nullptr)
+            {
+                *bad = len - pos > kMaxChunkLine;
+                break;
+            }
+            pos = crlf + 2 - data;
+            if (ex->chunkState == Exchange::kChunkTrailer)
+            {
+                *done = crlf == line; // 空行结束trailer
+                continue;
+            }
+            // chunk-size [; chunk-ext] CRLF
+            size_t size = 0;
+            const char *p = line;
+            for (; p < crlf && ::isxdigit(*p); ++p)
+            {
+                size = size * 16 + (::isdigit(*p) ? *p - '0' : (*p | 0x20) - 'a' + 10);
+                if (size > (static_cast<size_t>(1) << 40))
+                {
+                    *bad = true;
+                    return 0;
+                }
+            }
+            if (p == line)
+            {
+                *bad = true;
+                return 0;
+            }
+            if (size == 0)
+            {
+                ex->chunkState = Exchange::kChunkTrailer;
+            }
+            else
+            {
+                ex->chunkState = Exchange::kChunkData;
+                ex->remaining = size + 2;
+            }
+        }
+        return pos;
+    }
+} // namespace http
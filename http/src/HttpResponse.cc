@@ -1,5 +1,6 @@
 #include <http/HttpResponse.h>
 #include <mymuduo/Buffer.h>
+#include <mymuduo/LogStream.h>
 
 #include <assert.h>
 #include <string.h>
@@ -8,35 +9,143 @@ using namespace mymuduo;
 
 namespace http
 {
-    void HttpResponse::appendToBuffer(Buffer *output) const
+    namespace
     {
-        char buf[32];
-        ::memset(buf, '\0', sizeof(buf));
-        ::snprintf(buf, sizeof(buf), "HTTP/1.1 %d ", statusCode_);
-        output->append(buf);
-        output->append(statusMessage_);
-        output->append("\r\n");
+        struct StatusLine
+        {
+            int code;
+            const char *reason;
+            size_t reasonLength;
+            const char *line;
+            size_t lineLength;
+        };
 
-        if (closeConnection_)
+#define HTTP_STATUS_LINE(code, reason) \
+    {code, reason, sizeof(reason) - 1, "HTTP/1.1 " #code " " reason "\r\n", sizeof("HTTP/1.1 " #code " " reason "\r\n") - 1}
+
+        // 常见状态码配标准短语的整行预先编好，按出现的频率排列
+        const StatusLine kStatusLines[] = {
+            HTTP_STATUS_LINE(200, "OK"),
+            HTTP_STATUS_LINE(304, "Not Modified"),
+            HTTP_STATUS_LINE(404, "Not Found"),
+            HTTP_STATUS_LINE(301, "Moved Permanently"),
+            HTTP_STATUS_LINE(400, "Bad Request"),
+            HTTP_STATUS_LINE(405, "Method Not Allowed"),
+            HTTP_STATUS_LINE(502, "Bad Gateway"),
+            HTTP_STATUS_LINE(503, "Service Unavailable"),
+            HTTP_STATUS_LINE(504, "Gateway Timeout"),
+        };
+
+#undef HTTP_STATUS_LINE
+
+        const StatusLine *findStatusLine(int code, const std::string &message)
         {
-            output->append("Connection: close\r\n");
+            for (const StatusLine &status : kStatusLines)
+            {
+                if (status.code == code)
+                {
+                    bool same = message.size() == status.reasonLength &&
+                                ::memcmp(message.data(), status.reason, status.reasonLength) == 0;
+                    return same ? &status : nullptr;
+                }
+            }
+            return nullptr;
         }
-        else
+
+        char *copy(char *dest, const char *src, size_t len)
+        {
+            ::memcpy(dest, src, len);
+            return dest + len;
+        }
+
+        char *copy(char *dest, const std::string &src)
         {
-            ::snprintf(buf, sizeof buf, "Content-Length: %zd\r\n", body_.size());
-            output->append(buf);
-            output->append("Connection: Keep-Alive\r\n");
+            return copy(dest, src.data(), src.size());
         }
 
+        const char kKeepAlive[] = "Connection: Keep-Alive\r\n";
+        const char kClose[] = "Connection: close\r\n";
+        const char kChunked[] = "Transfer-Encoding: chunked\r\n";
+    } // namespace
+
+    void HttpResponse::appendHead(Buffer *output, const char *framing, size_t framingLen, size_t extra) const
+    {
+        // 状态码用LogStream的整数格式化函数，避免snprintf解析格式串
+        const StatusLine *status = findStatusLine(statusCode_, statusMessage_);
+        char code[mymuduo::detail::kMaxNumericSize];
+        size_t codeLength = status ? 0 : mymuduo::detail::formatUnsigned(code, statusCode_);
+        size_t total = status ? status->lineLength : 9 + codeLength + 1 + statusMessage_.size() + 2;
+        total += framingLen;
+        for (const auto &header : headers_)
+        {
+            total += header.first.size() + 2 + header.second.size() + 2;
+        }
+        total += 2;
+        output->ensureWritableBytes(total + extra);
+
+        char *begin = output->beginWrite();
+        char *p = begin;
+        if (status)
+        {
+            p = copy(p, status->line, status->lineLength);
+        }
+        else
+        {
+            p = copy(p, "HTTP/1.1 ", 9);
+            p = copy(p, code, codeLength);
+            *p++ = ' ';
+            p = copy(p, statusMessage_);
+            p = copy(p, "\r\n", 2);
+        }
+        p = copy(p, framing, framingLen);
         for (const auto &header : headers_)
         {
-            output->append(header.first);
-            output->append(": ");
-            output->append(header.second);
-            output->append("\r\n");
+            p = copy(p, header.first);
+            p = copy(p, ": ", 2);
+            p = copy(p, header.second);
+            p = copy(p, "\r\n", 2);
         }
+        p = copy(p, "\r\n", 2);
+        assert(static_cast<size_t>(p - begin) == total);
+        output->hasWritten(p - begin);
+    }
 
-        output->append("\r\n");
+    void HttpResponse::appendToBuffer(Buffer *output) const
+    {
+        if (closeConnection_)
+        {
+            appendHead(output, kClose, sizeof kClose - 1, body_.size());
+        }
+        else
+        {
+            char framing[96];
+            char *p = copy(framing, "Content-Length: ", 16);
+            p += mymuduo::detail::formatUnsigned(p, body_.size());
+            p = copy(p, "\r\n", 2);
+            p = copy(p, kKeepAlive, sizeof kKeepAlive - 1);
+            appendHead(output, framing, p - framing, body_.size());
+        }
         output->append(body_);
     }
+
+    void HttpResponse::appendStreamHeadToBuffer(Buffer *output, bool chunked) const
+    {
+        if (!chunked)
+        {
+            // 不分块时body以关闭连接结束
+            appendHead(output, kClose, sizeof kClose - 1, 0);
+            return;
+        }
+        char framing[64];
+        char *p = copy(framing, kChunked, sizeof kChunked - 1);
+        if (closeConnection_)
+        {
+            p = copy(p, kClose, sizeof kClose - 1);
+        }
+        else
+        {
+            p = copy(p, kKeepAlive, sizeof kKeepAlive - 1);
+        }
+        appendHead(output, framing, p - framing, 0);
+    }
 } // namespace http
@@ -0,0 +1,273 @@
+#include <http/HttpRouter.h>
+
+#include <mymuduo/Logger.h>
+
+using namespace mymuduo;
+
+namespace http
+{
+    namespace
+    {
+        const int kNumMethods = HttpRequest::kDelete + 1;
+
+        void defaultNotFound(const HttpRequest &, const RouteParams &, HttpResponse *resp)
+        {
+            resp->setStatusCode(HttpResponse::k404NotFound);
+            resp->setStatusMessage("Not Found");
+            resp->setCloseConnection(true);
+        }
+    } // namespace
+
+    /**
+     * 静态节点保存一段压缩后的路径前缀，子节点按首字符索引(indices[i]是children[i]前缀的首字符)。
+     * 参数节点和通配节点没有前缀，参数节点后面的静态部分是它的静态子节点，通配节点总是叶子。
+     */
+    struct HttpRouter::Node
+    {
+        std::string prefix;
+        std::string indices;
+        std::vector<std::unique_ptr<Node>> children;
+        std::unique_ptr<Node> paramChild;
+        std::unique_ptr<Node> wildChild;
+        std::string paramName; // 参数节点和通配节点的参数名
+        Handler handlers[kNumMethods];
+        bool hasHandler = false;
+    };
+
+    HttpRouter::HttpRouter()
+        : root_(new Node),
+          notFound_(defaultNotFound)
+    {
+    }
+
+    HttpRouter::~HttpRouter() = default;
+
+    void HttpRouter::addRoute(HttpRequest::Method method, const std::string &pattern, const Handler &handler)
+    {
+        if (pattern.empty() || pattern[0] != '/' || method == HttpRequest::kInvalid)
+        {
+            LOG_FMT_FATAL("HttpRouter::addRoute - invalid route %s %s \n", HttpRequest::methodToString(method), pattern.c_str());
+        }
+        insert(root_.get(), pattern, 0, 0, method, handler);
+    }
+
+    // node之前的部分已经和pattern[0, pos)对上了
+    void HttpRouter::insert(Node *node, const std::string &pattern, size_t pos, int numParams,
+                            HttpRequest::Method method, const Handler &handler)
+    {
+        while (true)
+        {
+            if (pos == pattern.size())
+            {
+                if (node->handlers[method])
+                {
+                    LOG_FMT_FATAL("HttpRouter::addRoute - duplicate route %s %s \n", HttpRequest::methodToString(method), pattern.c_str());
+                }
+                node->handlers[method] = handler;
+                node->hasHandler = true;
+                return;
+            }
+
+            char c = pattern[pos];
+            if (c == ':' || c == '*')
+            {
+                size_t end = c == ':' ? pattern.find('/', pos) : pattern.size();
+                if (end == std::string::npos)
+                {
+                    end = pattern.size();
+                }
+                std::string name(pattern, pos + 1, end - pos - 1);
+                if (name.empty() || ++numParams > RouteParams::kMaxParams ||
+                    name.find_first_of(":*/") != std::string::npos || (pos > 0 && pattern[pos - 1] != '/'))
+                {
+                    LOG_FMT_FATAL("HttpRouter::addRoute - invalid parameter in %s \n", pattern.c_str());
+                }
+                std::unique_ptr<Node> &child = c == ':' ? node->paramChild : node->wildChild;
+                if (!child)
+                {
+                    child.reset(new Node);
+                    child->paramName = name;
+                }
+                else if (child->paramName != name)
+                {
+                    LOG_FMT_FATAL("HttpRouter::addRoute - %s conflicts with parameter %s \n", pattern.c_str(), child->paramName.c_str());
+                }
+                node = child.get();
+                pos = end;
+                continue;
+            }
+
+            // 一段静态文本，到下一个参数为止
+            size_t end = pattern.find_first_of(":*", pos);
+            if (end == std::string::npos)
+            {
+                end = pattern.size();
+            }
+            size_t i = node->indices.find(c);
+            if (i == std::string::npos)
+            {
+                std::unique_ptr<Node> child(new Node);
+                child->prefix.assign(pattern, pos, end - pos);
+                node->indices.push_back(c);
+                node->children.push_back(std::move(child));
+                node = node->children.back().get();
+                pos = end;
+                continue;
+            }
+
+            Node *child = node->children[i].get();
+            size_t common = 0;
+            while (common < child->prefix.size() && pos + common < end && child->prefix[common] == pattern[pos + common])
+            {
+                ++common;
+            }
+            if (common < child->prefix.size())
+            {
+                // 拆开已有节点：公共前缀成为新的父节点
+                std::unique_ptr<Node> split(new Node);
+                split->prefix.assign(child->prefix, 0, common);
+                child->prefix.erase(0, common);
+                split->indices.push_back(child->prefix[0]);
+                split->children.push_back(std::move(node->children[i]));
+                node->children[i] = std::move(split);
+                child = node->children[i].get();
+            }
+            node = child;
+            pos += common;
+        }
+    }
+
+    // node之前的部分已经和path[0, pos)对上了
+    const HttpRouter::Node *HttpRouter::match(const Node *node, const std::string &path, size_t pos, HttpRequest::Method method,
+                                              RouteParams *params, const Node **otherMethod)
+    {
+        if (pos == path.size())
+        {
+            if (handlerFor(node, method))
+            {
+                return node;
+            }
+            if (node->hasHandler && *otherMethod == nullptr)
+            {
+                *otherMethod = node;
+            }
+        }
+        else
+        {
+            size_t i = node->indices.find(path[pos]);
+            if (i != std::string::npos)
+            {
+                const Node *child = node->children[i].get();
+                if (path.compare(pos, child->prefix.size(), child->prefix) == 0)
+                {
+                    const Node *found = match(child, path, pos + child->prefix.size(), method, params, otherMethod);
+                    if (found)
+                    {
+                        return found;
+                    }
+                }
+            }
+            if (node->paramChild && path[pos] != '/')
+            {
+                size_t end = path.find('/', pos);
+                if (end == std::string::npos)
+                {
+                    end = path.size();
+                }
+                const Node *param = node->paramChild.get();
+                params->push(param->paramName, StringPiece(path.data() + pos, static_cast<int>(end - pos)));
+                const Node *found = match(param, path, end, method, params, otherMethod);
+                if (found)
+                {
+                    return found;
+                }
+                params->pop();
+            }
+        }
+        if (node->wildChild)
+        {
+            const Node *wild = node->wildChild.get();
+            if (handlerFor(wild, method))
+            {
+                params->push(wild->paramName, StringPiece(path.data() + pos, static_cast<int>(path.size() - pos)));
+                return wild;
+            }
+            if (*otherMethod == nullptr)
+            {
+                *otherMethod = wild;
+            }
+        }
+        return nullptr;
+    }
+
+    const HttpRouter::Handler *HttpRouter::handlerFor(const Node *node, HttpRequest::Method method)
+    {
+        if (node->handlers[method])
+        {
+            return &node->handlers[method];
+        }
+        if (method == HttpRequest::kHead && node->handlers[HttpRequest::kGet])
+        {
+            return &node->handlers[HttpRequest::kGet];
+        }
+        return nullptr;
+    }
+
+    const HttpRouter::Handler *HttpRouter::find(HttpRequest::Method method, const std::string &path,
+                                                RouteParams *params, bool *methodNotAllowed) const
+    {
+        params->clear();
+        *methodNotAllowed = false;
+        const Node *otherMethod = nullptr;
+        const Node *node = match(root_.get(), path, 0, method, params, &otherMethod);
+        if (node)
+        {
+            return handlerFor(node, method);
+        }
+        *methodNotAllowed = otherMethod != nullptr;
+        return nullptr;
+    }
+
+    void HttpRouter::allowedMethods(const Node *node, std::string *allow)
+    {
+        for (int m = HttpRequest::kGet; m < kNumMethods; ++m)
+        {
+            if (node->handlers[m])
+            {
+                if (!allow->empty())
+                {
+                    allow->append(", ");
+                }
+                allow->append(HttpRequest::methodToString(static_cast<HttpRequest::Method>(m)));
+            }
+        }
+    }
+
+    void HttpRouter::dispatch(const HttpRequest &req, HttpResponse *resp) const
+    {
+        RouteParams params;
+        bool methodNotAllowed = false;
+        const Handler *handler = find(req.method(), req.path(), &params, &methodNotAllowed);
+        if (handler)
+        {
+            (*handler)(req, params, resp);
+        }
+        else if (methodNotAllowed)
+        {
+            // 再匹配一次取Allow，只在出错时走这条路
+            params.clear();
+            const Node *otherMethod = nullptr;
+            match(root_.get(), req.path(), 0, req.method(), &params, &otherMethod);
+            std::string allow;
+            allowedMethods(otherMethod, &allow);
+            resp->setStatusCode(HttpResponse::k405MethodNotAllowed);
+            resp->setStatusMessage("Method Not Allowed");
+            resp->addHeader("Allow", allow);
+        }
+        else
+        {
+            params.clear();
+            notFound_(req, params, resp);
+        }
+    }
+} // namespace http
@@ -2,9 +2,23 @@
 #include <http/HttpServer.h>
 #include <http/HttpResponse.h>
 #include <http/HttpRequest.h>
+#include <http/AccessLog.h>
+#include <http/AsyncResponse.h>
+#include <http/ResponseCache.h>
+#include <http/Compression.h>
+#include <http/WebSocketServer.h>
+#include <http/Http2Connection.h>
 
 #include <mymuduo/Logger.h>
 #include <mymuduo/TcpConnection.h>
+#include <mymuduo/Metrics.h>
+#include <mymuduo/ThreadPool.h>
+
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <future>
 
 using namespace mymuduo;
 
@@ -22,6 +36,41 @@ namespace http
             resp->setStatusMessage("Not Found");
             resp->setCloseConnection(true);
         }
+
+        Counter *const g_requests = MetricsRegistry::instance().counter(
+            "http_requests_total", "Number of HTTP requests parsed.");
+        Counter *const g_badRequests = MetricsRegistry::instance().counter(
+            "http_bad_requests_total", "Number of malformed HTTP requests answered with 400.");
+        Counter *const g_notModified = MetricsRegistry::instance().counter(
+            "http_cache_not_modified_total", "Conditional requests answered with 304 from the response cache.");
+        Counter *const g_readPauses = MetricsRegistry::instance().counter(
+            "http_read_pauses_total", "Times a connection stopped reading because its unsent output exceeded the high water mark.");
+        Histogram *const g_handlerSeconds = MetricsRegistry::instance().histogram(
+            "http_handler_duration_seconds", "Time spent in the HTTP callback including response serialization.");
+
+        // 按状态码类别(1xx~5xx)计数，下标为状态码/100，状态码非法时计入0号
+        Counter *const g_responses[] = {
+            MetricsRegistry::instance().counter("http_responses_total", "Number of HTTP responses by status class.", "code=\"other\""),
+            MetricsRegistry::instance().counter("http_responses_total", "Number of HTTP responses by status class.", "code=\"1xx\""),
+            MetricsRegistry::instance().counter("http_responses_total", "Number of HTTP responses by status class.", "code=\"2xx\""),
+            MetricsRegistry::instance().counter("http_responses_total", "Number of HTTP responses by status class.", "code=\"3xx\""),
+            MetricsRegistry::instance().counter("http_responses_total", "Number of HTTP responses by status class.", "code=\"4xx\""),
+            MetricsRegistry::instance().counter("http_responses_total", "Number of HTTP responses by status class.", "code=\"5xx\""),
+        };
+
+        void countResponse(int statusCode)
+        {
+            int index = statusCode / 100;
+            g_responses[index >= 1 && index <= 5 ? index : 0]->increment();
+        }
+
+        void metricsHttpCallback(const HttpRequest &, HttpResponse *resp)
+        {
+            resp->setStatusCode(HttpResponse::k200Ok);
+            resp->setStatusMessage("OK");
+            resp->setContentType("text/plain; version=0.0.4");
+            resp->setBody(MetricsRegistry::instance().scrape());
+        }
     } // namespace detail
 
     HttpServer::HttpServer(EventLoop *loop,
@@ -29,30 +78,196 @@ namespace http
                            const std::string &name,
                            TcpServer::Option option)
         : server_(loop, listenAddr, name, option),
-          httpCallback_(detail::defaultHttpCallback)
+          httpCallback_(detail::defaultHttpCallback),
+          numWorkerThreads_(0),
+          workerPool_(new ThreadPool(name + "Worker")),
+          accessLog_(nullptr),
+          cache_(nullptr),
+          compressor_(nullptr),
+          highWaterMark_(64 * 1024),
+          http2_(false),
+          draining_(false),
+          self_(this, [](HttpServer *) {})
+    {
+        init();
+    }
+
+    HttpServer::HttpServer(EventLoop *loop, int listenFd, const std::string &name)
+        : server_(loop, listenFd, name),
+          httpCallback_(detail::defaultHttpCallback),
+          numWorkerThreads_(0),
+          workerPool_(new ThreadPool(name + "Worker")),
+          accessLog_(nullptr),
+          cache_(nullptr),
+          compressor_(nullptr),
+          highWaterMark_(64 * 1024),
+          http2_(false),
+          draining_(false),
+          self_(this, [](HttpServer *) {})
+    {
+        init();
+    }
+
+    void HttpServer::init()
     {
         server_.setConnectionCallback(
             std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
         server_.setMessageCallback(
             std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        server_.setDrainConnectionCallback(
+            std::bind(&HttpServer::onDrain, this, std::placeholders::_1));
+    }
+
+    HttpServer::~HttpServer()
+    {
+        // 计算线程里不会再有新的done()
+        workerPool_->stop();
+        // 此后排队的onResponseDone拿不到self_，直接丢弃。subloop还在运行，
+        // 在每个subloop里跑一次stopLoop，保证已经拿到self_的回调都执行完了
+        self_.reset();
+        EventLoop *baseLoop = server_.getLoop();
+        for (EventLoop *loop : server_.getAllLoops())
+        {
+            if (loop == baseLoop || loop->isInLoopThread())
+            {
+                stopLoop(loop);
+                continue;
+            }
+            std::promise<void> done;
+            loop->runInLoop([this, loop, &done]() {
+                stopLoop(loop);
+                done.set_value();
+            });
+            done.get_future().wait();
+        }
+    }
+
+    void HttpServer::stopLoop(EventLoop *loop)
+    {
+        // 缓存和WebSocketServer比HttpServer活得长，它们在本loop上的定时器要趁loop还在时取消
+        if (cache_)
+        {
+            cache_->stopLoop(loop);
+        }
+        for (const auto &item : webSockets_)
+        {
+            item.second->stopLoop(loop); // 挂在多个path上的重复调用什么也不做
+        }
     }
 
     void HttpServer::start()
     {
         LOG_INFO << "HttpServer[" << server_.name()
                  << "] starts listening on " << server_.ipPort();
+        // 只有开启访问日志时才需要写完成回调来记录最后一个字节的时刻，
+        // 否则每次写完都会多一次queueInLoop
+        if (accessLog_)
+        {
+            server_.setWriteCompleteCallback(
+                std::bind(&HttpServer::onWriteComplete, this, std::placeholders::_1));
+        }
+        if (cache_)
+        {
+            if (compressor_)
+            {
+                cache_->addVaryHeader("Accept-Encoding");
+            }
+            threadInitCallbacks_.push_back(std::bind(&ResponseCache::initLoop, cache_, std::placeholders::_1));
+        }
+        std::vector<WebSocketServer *> webSockets;
+        for (const auto &item : webSockets_)
+        {
+            // 同一个WebSocketServer挂在多个path上时每个loop只初始化一次
+            if (std::find(webSockets.begin(), webSockets.end(), item.second) == webSockets.end())
+            {
+                webSockets.push_back(item.second);
+                threadInitCallbacks_.push_back(std::bind(&WebSocketServer::initLoop, item.second, std::placeholders::_1));
+            }
+        }
+        if (!threadInitCallbacks_.empty())
+        {
+            server_.setThreadInitCallback(std::bind(&HttpServer::onThreadInit, this, std::placeholders::_1));
+        }
+        workerPool_->start(numWorkerThreads_);
         server_.start();
     }
 
+    void HttpServer::onThreadInit(EventLoop *loop)
+    {
+        for (const auto &cb : threadInitCallbacks_)
+        {
+            cb(loop);
+        }
+    }
+
+    void HttpServer::drain(double timeoutSeconds, const TcpServer::DrainCallback &cb)
+    {
+        draining_ = true;
+        server_.drain(timeoutSeconds, cb);
+    }
+
+    // 在连接所在的IO线程里调用
+    void HttpServer::onDrain(const TcpConnectionPtr &conn)
+    {
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        if (context && context->webSocket())
+        {
+            // 等对方回复close后关闭，不回复的由drain超时强制关闭
+            context->webSocket()->close(WebSocketCodec::kGoingAway);
+            return;
+        }
+        if (context && context->http2())
+        {
+            // 在途的流处理完后关闭
+            context->http2()->goAway();
+            return;
+        }
+        if (context == nullptr || context->idle())
+        {
+            // 没有请求在处理，已经发出的响应写完后半关闭
+            conn->shutdown();
+        }
+        // 否则等onRequest/onResponseDone发出带Connection: close的最后一个响应后关闭
+    }
+
     void HttpServer::onConnection(const TcpConnectionPtr &conn)
     {
         if (conn->connected())
         {
             LOG_INFO << "new Connection arrived";
+            // 每个连接一个解析上下文，请求跨越多次read时保留解析状态
+            conn->setContext(std::make_shared<HttpContext>());
+            // 异步完成的响应发送后积压超过高水位时也要停止读
+            conn->setHighWaterMarkCallback(
+                std::bind(&HttpServer::onHighWaterMark, this, std::placeholders::_1, std::placeholders::_2), highWaterMark_);
         }
         else
         {
             LOG_INFO << "Connection closed";
+            HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+            if (context && context->webSocket())
+            {
+                context->webSocket()->onClosed();
+            }
+            if (context && context->http2())
+            {
+                context->http2()->onClosed();
+            }
+            if (conn->getContext())
+            {
+                std::deque<AsyncResponsePtr> pending;
+                pending.swap(static_cast<HttpContext *>(conn->getContext().get())->pendingResponses());
+                for (const AsyncResponsePtr &response : pending)
+                {
+                    // 让暂停中的流式响应的生产者知道连接已经断开
+                    response->onStreamClosed();
+                }
+            }
+            if (accessLog_ && conn->getContext())
+            {
+                // 响应没写完连接就断开了，ttlb记为缺失
+                flushAccessLogs(static_cast<HttpContext *>(conn->getContext().get()), Timestamp::invalid());
+            }
         }
     }
 
@@ -61,7 +276,28 @@ namespace http
                                Timestamp receiveTime)
     {
         LOG_INFO << "HttpServer::onMessage";
-        std::unique_ptr<HttpContext> context(new HttpContext);
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        if (context->webSocket())
+        {
+            context->webSocket()->onMessage(conn, buf);
+            return;
+        }
+        if (!context->http2() && http2_ && context->idle() && buf->readableBytes() > 0 &&
+            ::memcmp(buf->peek(), Http2Connection::kPreface, std::min<size_t>(buf->readableBytes(), 4)) == 0)
+        {
+            if (buf->readableBytes() < 4)
+            {
+                return; // 等够"PRI "再判断
+            }
+            // prior knowledge：HTTP/1里没有PRI方法，开头是它就一定是HTTP/2
+            context->setHttp2(std::make_shared<Http2Connection>(this, conn));
+            context->http2()->start();
+        }
+        if (context->http2())
+        {
+            context->http2()->onMessage(conn, buf, receiveTime);
+            return;
+        }
 
 #if 0
     // 打印请求报文
@@ -69,40 +305,630 @@ namespace http
     std::cout << request << std::endl;
 #endif
 
-        // 进行状态机解析
-        // 错误则发送 BAD REQUEST 半关闭
-        if (!context->parseRequest(buf, receiveTime))
+        // 一次read可能带来多个流水线请求，逐个解析处理，直到缓冲区里只剩不完整的请求
+        while (true)
+        {
+            // 进行状态机解析
+            // 错误则发送 BAD REQUEST 半关闭
+            if (!context->parseRequest(buf, receiveTime))
+            {
+                LOG_INFO << "parseRequest failed!";
+                onBadRequest(conn, context, receiveTime);
+                break;
+            }
+
+            // 如果成功解析
+            if (!context->gotAll())
+            {
+                break;
+            }
+            LOG_INFO << "parseRequest success!";
+            onRequest(conn, context);
+            context->reset();
+            if (context->webSocket())
+            {
+                // 跟在升级请求后面的数据已经是WebSocket帧
+                if (buf->readableBytes() > 0)
+                {
+                    context->webSocket()->onMessage(conn, buf);
+                }
+                break;
+            }
+            if (context->http2())
+            {
+                // 后面是客户端的连接前言和HTTP/2帧
+                if (buf->readableBytes() > 0)
+                {
+                    context->http2()->onMessage(conn, buf, receiveTime);
+                }
+                break;
+            }
+            if (conn->outputBufferSize() >= highWaterMark_)
+            {
+                // 客户端读得太慢：剩下的流水线请求留在输入缓冲区，写空之后再处理
+                pauseReading(conn);
+                break;
+            }
+            if (buf->readableBytes() == 0 || !conn->connected())
+            {
+                break;
+            }
+        }
+    }
+
+    void HttpServer::onBadRequest(const TcpConnectionPtr &conn, HttpContext *context, Timestamp receiveTime)
+    {
+        detail::g_badRequests->increment();
+        if (!context->pendingResponses().empty())
+        {
+            // 前面还有没完成的响应，400也要排在它们后面发
+            AsyncResponsePtr response(std::make_shared<AsyncResponse>(this, conn, true));
+            response->response()->setStatusCode(HttpResponse::k400BadRequest);
+            response->response()->setStatusMessage("Bad Request");
+            response->start_ = Timestamp::now();
+            if (accessLog_)
+            {
+                fillAccessLog(&response->record_, conn, context->request());
+                response->record_.receiveTime = receiveTime;
+                response->hasAccessLog_ = true;
+            }
+            context->pendingResponses().push_back(response);
+            onResponseDone(response);
+            return;
+        }
+
+        static const char kBadRequest[] = "HTTP/1.1 400 Bad Request\r\n\r\n";
+        detail::countResponse(HttpResponse::k400BadRequest);
+        if (accessLog_)
+        {
+            AccessLogRecord *record = beginAccessLog(conn, context->request());
+            record->receiveTime = receiveTime;
+            record->status = HttpResponse::k400BadRequest;
+            record->responseBytes = sizeof kBadRequest - 1;
+            record->handledTime = record->parsedTime;
+        }
+        conn->send(kBadRequest);
+        conn->shutdown();
+    }
+
+    bool HttpServer::upgradeWebSocket(const TcpConnectionPtr &conn, HttpContext *context, Timestamp start)
+    {
+        HttpRequest &req = context->request();
+        auto it = webSockets_.find(req.path());
+        if (it == webSockets_.end())
+        {
+            return false;
+        }
+        AccessLogRecord *record = accessLog_ ? beginAccessLog(conn, req) : nullptr;
+        Buffer buf;
+        // 前面还有没发出的响应时不能切换协议
+        bool upgraded = context->pendingResponses().empty() && !draining_.load(std::memory_order_relaxed) &&
+                        WebSocketServer::handshake(req, &buf);
+        if (!upgraded)
+        {
+            static const char kBadRequest[] = "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n";
+            buf.append(kBadRequest, sizeof kBadRequest - 1);
+        }
+        recordResponse(upgraded ? HttpResponse::k101SwitchingProtocols : HttpResponse::k400BadRequest,
+                       buf.readableBytes(), start, record);
+        conn->send(&buf);
+        if (!upgraded)
         {
-            LOG_INFO << "parseRequest failed!";
-            conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
             conn->shutdown();
+            return true;
         }
+        WebSocketSessionPtr session(std::make_shared<WebSocketSession>(it->second, conn, req));
+        context->setWebSocket(session);
+        it->second->addSession(session);
+        return true;
+    }
 
-        // 如果成功解析
-        if (context->gotAll())
+    bool HttpServer::upgradeHttp2(const TcpConnectionPtr &conn, HttpContext *context)
+    {
+        HttpRequest &req = context->request();
+        const std::string &upgrade = req.getHeader("Upgrade");
+        // 前面还有没发出的响应时不升级，按HTTP/1.1回复就行。TLS上的HTTP/2只能由ALPN协商
+        if (::strcasecmp(upgrade.c_str(), "h2c") != 0 || conn->isTls() || !context->pendingResponses().empty() ||
+            draining_.load(std::memory_order_relaxed))
         {
-            LOG_INFO << "parseRequest success!";
-            onRequest(conn, context->request());
-            context->reset();
+            return false;
         }
+        std::shared_ptr<Http2Connection> http2(std::make_shared<Http2Connection>(this, conn));
+        if (!http2->applyUpgradeSettings(req.getHeader("HTTP2-Settings")))
+        {
+            return false;
+        }
+        static const char kSwitching[] = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        conn->send(kSwitching, sizeof kSwitching - 1);
+        context->setHttp2(http2);
+        http2->start();
+        http2->startUpgradedStream(req);
+        return true;
+    }
+
+    void HttpServer::onHttp2Request(const TcpConnectionPtr &conn, Http2Connection *http2, uint32_t streamId, HttpRequest &req)
+    {
+        detail::g_requests->increment();
+        Timestamp start = Timestamp::now();
+        const bool isMetrics = !metricsPath_.empty() && req.method() == HttpRequest::kGet && req.path() == metricsPath_;
+        const bool head = req.method() == HttpRequest::kHead;
+        if (req.method() == HttpRequest::kInvalid || !asyncHttpCallback_ || isMetrics)
+        {
+            // 同步回调：当场填好响应发出去，流随之关闭
+            HttpResponse response(false);
+            AccessLogRecord *record = accessLog_ ? beginAccessLog(conn, req) : nullptr;
+            if (req.method() == HttpRequest::kInvalid)
+            {
+                detail::g_badRequests->increment();
+                response.setStatusCode(HttpResponse::k400BadRequest);
+                response.setStatusMessage("Bad Request");
+            }
+            else if (isMetrics)
+            {
+                detail::metricsHttpCallback(req, &response);
+            }
+            else
+            {
+                httpCallback_(req, &response);
+            }
+            if (compressor_)
+            {
+                compressor_->compress(req, &response);
+            }
+            size_t bytes = 0;
+            http2->sendResponse(streamId, response, head, &bytes);
+            recordResponse(response.statusCode(), bytes, start, record);
+            return;
+        }
+
+        AsyncResponsePtr response(std::make_shared<AsyncResponse>(this, conn, false));
+        response->request_.swap(req);
+        response->streamId_ = streamId;
+        response->start_ = start;
+        if (accessLog_)
+        {
+            fillAccessLog(&response->record_, conn, response->request_);
+            response->hasAccessLog_ = true;
+        }
+        http2->setResponse(streamId, response);
+        asyncHttpCallback_(response);
+    }
+
+    void HttpServer::onHttp2ResponseDone(const TcpConnectionPtr &conn, const AsyncResponsePtr &response)
+    {
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        Http2Connection *http2 = context->http2().get();
+        if (http2 == nullptr)
+        {
+            return;
+        }
+        AccessLogRecord *record = nullptr;
+        if (response->hasAccessLog_)
+        {
+            context->pendingAccessLogs().push_back(response->record_);
+            record = &context->pendingAccessLogs().back();
+        }
+        if (response->raw_)
+        {
+            // 流式响应：body已经发完，结束流
+            http2->sendData(response->streamId_, nullptr, 0, true);
+            finishRawResponse(response.get(), record);
+            return;
+        }
+        HttpResponse &resp = response->response_;
+        if (compressor_)
+        {
+            compressor_->compress(response->request_, &resp);
+        }
+        size_t bytes = 0;
+        http2->sendResponse(response->streamId_, resp, response->request_.method() == HttpRequest::kHead, &bytes);
+        recordResponse(resp.statusCode(), bytes, response->start_, record);
+    }
+
+    bool HttpServer::sendHttp2Head(const AsyncResponsePtr &response)
+    {
+        TcpConnectionPtr conn(response->conn_.lock());
+        if (!conn || !conn->getContext())
+        {
+            return false;
+        }
+        Http2Connection *http2 = static_cast<HttpContext *>(conn->getContext().get())->http2().get();
+        size_t bytes = 0;
+        if (!http2 || !http2->sendHeaders(response->streamId_, response->response_, false, &bytes))
+        {
+            return false;
+        }
+        response->raw_ = true;
+        response->rawBytes_ += bytes;
+        return true;
     }
 
-    void HttpServer::onRequest(const TcpConnectionPtr &conn, const HttpRequest &req)
+    void HttpServer::onRequest(const TcpConnectionPtr &conn, HttpContext *context)
     {
+        HttpRequest &req = context->request();
         const std::string &connection = req.getHeader("Connection");
         
         // 判断是长连接还是短连接
         bool close = connection == "close" ||
-                     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive");
-        HttpResponse response(close);
-        httpCallback_(req, &response);
+                     (req.getVersion() == HttpRequest::kHttp10 && connection != "Keep-Alive") ||
+                     draining_.load(std::memory_order_relaxed);
+        if (http2_ && upgradeHttp2(conn, context))
+        {
+            return; // 请求作为流1另外计数
+        }
+        detail::g_requests->increment();
+        Timestamp start = Timestamp::now();
+        if (!webSockets_.empty() && upgradeWebSocket(conn, context, start))
+        {
+            return;
+        }
+        const bool isMetrics = !metricsPath_.empty() && req.method() == HttpRequest::kGet && req.path() == metricsPath_;
+        std::shared_ptr<const CachedResponse> cached;
+        if (cache_ && !isMetrics && (req.method() == HttpRequest::kGet || req.method() == HttpRequest::kHead))
+        {
+            cached = cache_->lookup(conn->getLoop(), req);
+        }
+
+        if (cached && context->pendingResponses().empty())
+        {
+            AccessLogRecord *record = accessLog_ ? beginAccessLog(conn, req) : nullptr;
+            if (sendCachedResponse(conn, req, *cached, close, start, record))
+            {
+                conn->shutdown();
+            }
+            return;
+        }
+
+        // 同步回调并且前面没有在途的异步响应：当场序列化发送，不分配AsyncResponse
+        if (!cached && (!asyncHttpCallback_ || isMetrics) && context->pendingResponses().empty())
+        {
+            HttpResponse *response = context->response(close);
+            AccessLogRecord *record = accessLog_ ? beginAccessLog(conn, req) : nullptr;
+            if (isMetrics)
+            {
+                detail::metricsHttpCallback(req, response);
+            }
+            else
+            {
+                httpCallback_(req, response);
+            }
+            if (finishResponse(conn, req, response, start, record))
+            {
+                conn->shutdown();
+            }
+            return;
+        }
+
+        // 上一个响应已经发出，并且回调那边也不再持有它时，连同请求、响应的内存一起复用
+        AsyncResponsePtr response;
+        response.swap(context->spareResponse());
+        if (response && response.use_count() == 1)
+        {
+            response->reset(close);
+        }
+        else
+        {
+            response = std::make_shared<AsyncResponse>(this, conn, close);
+        }
+        // 请求交给AsyncResponse，换回来的是复用的空请求，两边的内存在连接上来回使用
+        response->request_.swap(req);
+        response->start_ = start;
+        if (accessLog_)
+        {
+            fillAccessLog(&response->record_, conn, response->request_);
+            response->hasAccessLog_ = true;
+        }
+        context->pendingResponses().push_back(response);
+        if (cached)
+        {
+            // 前面还有在途的响应，排队等轮到它
+            response->cached_ = std::move(cached);
+            response->done();
+        }
+        else if (asyncHttpCallback_ && !isMetrics)
+        {
+            asyncHttpCallback_(response);
+        }
+        else
+        {
+            (isMetrics ? HttpCallback(detail::metricsHttpCallback) : httpCallback_)(response->request_, &response->response_);
+            response->done();
+        }
+    }
+
+    void HttpServer::onResponseDone(const AsyncResponsePtr &response)
+    {
+        TcpConnectionPtr conn(response->conn_.lock());
+        if (!conn || !conn->getContext())
+        {
+            return; // 连接已经销毁，丢弃响应
+        }
+        if (response->streamId_ != 0)
+        {
+            onHttp2ResponseDone(conn, response);
+            return;
+        }
+        response->completed_ = true;
+
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        std::deque<AsyncResponsePtr> &pending = context->pendingResponses();
+        while (!pending.empty())
+        {
+            AsyncResponse *head = pending.front().get();
+            if (head->rawBuffer_.readableBytes() > 0)
+            {
+                // 轮到它之前sendRaw暂存的数据
+                conn->send(&head->rawBuffer_);
+            }
+            if (!head->completed_)
+            {
+                break;
+            }
+            AsyncResponsePtr front(std::move(pending.front()));
+            pending.pop_front();
+            if (pending.empty() && draining_.load(std::memory_order_relaxed))
+            {
+                // drain之前收到的请求的最后一个响应，发出后关闭连接
+                front->response_.setCloseConnection(true);
+            }
+            AccessLogRecord *record = nullptr;
+            if (front->hasAccessLog_)
+            {
+                context->pendingAccessLogs().push_back(front->record_);
+                record = &context->pendingAccessLogs().back();
+            }
+            bool close;
+            if (front->raw_)
+            {
+                close = finishRawResponse(front.get(), record);
+            }
+            else if (front->cached_)
+            {
+                close = sendCachedResponse(conn, front->request_, *front->cached_, front->response_.closeConnection(),
+                                           front->start_, record);
+            }
+            else
+            {
+                close = finishResponse(conn, front->request_, &front->response_, front->start_, record);
+            }
+            if (close)
+            {
+                // 关闭连接后后面的响应没有机会发出去了
+                pending.clear();
+                conn->shutdown();
+                break;
+            }
+            if (!front->raw_)
+            {
+                // 流式响应和sendRaw的生产者在结束之后也可能还拿着它，不复用
+                context->spareResponse() = std::move(front);
+            }
+        }
+    }
+
+    bool HttpServer::onResponseData(const AsyncResponsePtr &response, const char *data, size_t len)
+    {
+        TcpConnectionPtr conn(response->conn_.lock());
+        if (!conn || !conn->connected() || !conn->getContext())
+        {
+            return false;
+        }
+        response->raw_ = true;
+        response->rawBytes_ += len;
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        if (response->streamId_ != 0)
+        {
+            // 流式响应的一块body，按流量控制排队发送
+            Http2Connection *http2 = context->http2().get();
+            if (!http2 || !http2->sendData(response->streamId_, data, len, false))
+            {
+                return false;
+            }
+            if (response->writable() && http2->backlog(response->streamId_) >= highWaterMark_)
+            {
+                response->writable_.store(false, std::memory_order_release);
+                watchWriteComplete(conn);
+            }
+            return true;
+        }
+        std::deque<AsyncResponsePtr> &pending = context->pendingResponses();
+        if (!pending.empty() && pending.front() == response)
+        {
+            conn->send(data, len);
+        }
+        else
+        {
+            response->rawBuffer_.append(data, len);
+        }
+        // 高水位回调是queueInLoop执行的，生产者在同一轮里连续发送时来不及暂停，所以这里同步检查积压
+        if (response->writable() && conn->outputBufferSize() + response->rawBuffer_.readableBytes() >= highWaterMark_)
+        {
+            response->writable_.store(false, std::memory_order_release);
+            watchWriteComplete(conn);
+        }
+        return true;
+    }
+
+    bool HttpServer::finishRawResponse(AsyncResponse *response, AccessLogRecord *record)
+    {
+        recordResponse(response->rawStatus_, response->rawBytes_, response->start_, record);
+        // 报文头部已经发出，drain时没法再补Connection: close，发完后直接关闭
+        return response->response_.closeConnection();
+    }
+
+    bool HttpServer::finishResponse(const TcpConnectionPtr &conn, const HttpRequest &req, HttpResponse *response,
+                                    Timestamp start, AccessLogRecord *record)
+    {
+        if (compressor_)
+        {
+            compressor_->compress(req, response);
+        }
+        if (cache_ && response->cacheTtl() > 0)
+        {
+            std::shared_ptr<const CachedResponse> entry(cache_->insert(conn->getLoop(), req, *response));
+            if (entry)
+            {
+                return sendCachedResponse(conn, req, *entry, response->closeConnection(), start, record);
+            }
+        }
+        return sendResponse(conn, *response, start, record);
+    }
+
+    bool HttpServer::sendCachedResponse(const TcpConnectionPtr &conn, const HttpRequest &req, const CachedResponse &entry,
+                                        bool close, Timestamp start, AccessLogRecord *record)
+    {
+        static const char kKeepAlive[] = "Connection: Keep-Alive\r\n\r\n";
+        static const char kClose[] = "Connection: close\r\n\r\n";
+        const bool notModified = ResponseCache::notModified(req, entry);
+        const bool head = req.method() == HttpRequest::kHead;
+        size_t bytes = 0;
+        if (notModified)
+        {
+            Buffer buf;
+            buf.append(entry.notModified);
+            if (close)
+            {
+                buf.append(kClose, sizeof kClose - 1);
+            }
+            else
+            {
+                buf.append(kKeepAlive, sizeof kKeepAlive - 1);
+            }
+            bytes = buf.readableBytes();
+            conn->send(&buf);
+            detail::g_notModified->increment();
+        }
+        else if (!close)
+        {
+            // 长连接的响应就是缓存里的字节，直接从共享的缓存发送，不再序列化
+            bytes = head ? entry.headLength : entry.bytes.size();
+            conn->send(entry.bytes.data(), bytes);
+        }
+        else
+        {
+            Buffer buf;
+            buf.append(entry.bytes.data(), entry.connectionOffset);
+            buf.append(kClose, sizeof kClose - 1);
+            if (!head)
+            {
+                buf.append(entry.bytes.data() + entry.headLength, entry.bytes.size() - entry.headLength);
+            }
+            bytes = buf.readableBytes();
+            conn->send(&buf);
+        }
+
+        recordResponse(notModified ? HttpResponse::k304NotModified : HttpResponse::k200Ok, bytes, start, record);
+        return close;
+    }
+
+    bool HttpServer::sendResponse(const TcpConnectionPtr &conn, const HttpResponse &response,
+                                  Timestamp start, AccessLogRecord *record)
+    {
         Buffer buf;
         response.appendToBuffer(&buf);
+        recordResponse(response.statusCode(), buf.readableBytes(), start, record);
         conn->send(&buf);
-        if (response.closeConnection())
+        return response.closeConnection();
+    }
+
+    void HttpServer::recordResponse(int status, size_t bytes, Timestamp start, AccessLogRecord *record)
+    {
+        Timestamp end = Timestamp::now();
+        detail::g_handlerSeconds->record(end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+        detail::countResponse(status);
+        if (record)
         {
-            conn->shutdown();
+            record->status = status;
+            record->responseBytes = bytes;
+            record->handledTime = end;
+        }
+    }
+
+    void HttpServer::onWriteComplete(const TcpConnectionPtr &conn)
+    {
+        // 输出缓冲区已经清空，之前发出的响应都已写入内核
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        if (context == nullptr)
+        {
+            return;
+        }
+        if (accessLog_)
+        {
+            flushAccessLogs(context, Timestamp::now());
+        }
+        std::deque<AsyncResponsePtr> &pending = context->pendingResponses();
+        if (!pending.empty() && !pending.front()->writable())
+        {
+            pending.front()->onStreamWritable();
+        }
+        if (context->http2())
+        {
+            context->http2()->onWriteComplete();
+        }
+        if (!conn->isReading() && conn->connected())
+        {
+            conn->startRead();
+            if (conn->inputBuffer()->readableBytes() > 0)
+            {
+                onMessage(conn, conn->inputBuffer(), Timestamp::now());
+            }
+        }
+    }
+
+    void HttpServer::onHighWaterMark(const TcpConnectionPtr &conn, size_t)
+    {
+        // queueInLoop执行的，这之间缓冲区可能已经写出去了
+        if (conn->connected() && conn->outputBufferSize() >= highWaterMark_)
+        {
+            pauseReading(conn);
+        }
+    }
+
+    void HttpServer::pauseReading(const TcpConnectionPtr &conn)
+    {
+        if (conn->isReading())
+        {
+            detail::g_readPauses->increment();
+            conn->stopRead();
+        }
+        watchWriteComplete(conn);
+    }
+
+    void HttpServer::watchWriteComplete(const TcpConnectionPtr &conn)
+    {
+        // 没开访问日志时TcpServer没有设置写完成回调，只给积压的连接设置，避免每次写完都多一次queueInLoop
+        conn->setWriteCompleteCallback(std::bind(&HttpServer::onWriteComplete, this, std::placeholders::_1));
+    }
+
+    AccessLogRecord *HttpServer::beginAccessLog(const TcpConnectionPtr &conn, const HttpRequest &req)
+    {
+        HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+        std::vector<AccessLogRecord> &pending = context->pendingAccessLogs();
+        // 原地构造，避免拷贝整条记录
+        pending.resize(pending.size() + 1);
+        AccessLogRecord *record = &pending.back();
+        fillAccessLog(record, conn, req);
+        return record;
+    }
+
+    void HttpServer::fillAccessLog(AccessLogRecord *record, const TcpConnectionPtr &conn, const HttpRequest &req)
+    {
+        record->method = req.method();
+        record->setPath(req.path());
+        record->peerAddr = *conn->peerAddress().getSockAddr();
+        record->receiveTime = req.receiveTime();
+        record->parsedTime = Timestamp::now();
+    }
+
+    void HttpServer::flushAccessLogs(HttpContext *context, Timestamp lastByteTime)
+    {
+        std::vector<AccessLogRecord> &pending = context->pendingAccessLogs();
+        for (AccessLogRecord &record : pending)
+        {
+            record.lastByteTime = lastByteTime;
+            accessLog_->append(record);
         }
+        pending.clear();
     }
 
 } // namespace http
@@ -0,0 +1,442 @@
+#include <http/ResponseCache.h>
+#include <http/HttpRequest.h>
+#include <http/HttpResponse.h>
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Metrics.h>
+#include <mymuduo/Timestamp.h>
+#include <mymuduo/LogStream.h>
+
+#include <future>
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+using namespace mymuduo;
+
+namespace http
+{
+    namespace
+    {
+        Counter *const g_cacheHits = MetricsRegistry::instance().counter(
+            "http_cache_hits_total", "Requests answered from the response cache.");
+        Counter *const g_cacheMisses = MetricsRegistry::instance().counter(
+            "http_cache_misses_total", "Cacheable requests that had to run the handler.");
+
+        const double kSweepInterval = 1.0;
+
+        // FNV-1a，生成ETag用，跨进程稳定
+        uint64_t fnv1a(const std::string &data)
+        {
+            uint64_t hash = 14695981039346656037ULL;
+            for (unsigned char c : data)
+            {
+                hash ^= c;
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        // RFC 7231 IMF-fixdate: Sun, 06 Nov 1994 08:49:37 GMT
+        std::string formatHttpDate(time_t t)
+        {
+            struct tm tm;
+            ::gmtime_r(&t, &tm);
+            char date[64];
+            size_t n = ::strftime(date, sizeof date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+            return std::string(date, n);
+        }
+
+        bool parseHttpDate(const std::string &date, time_t *t)
+        {
+            struct tm tm;
+            ::memset(&tm, 0, sizeof tm);
+            const char *end = ::strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+            if (end == nullptr || *end != '\0')
+            {
+                return false;
+            }
+            *t = ::timegm(&tm);
+            return true;
+        }
+
+        const std::string *findHeader(const HttpHeaders &headers, const char *field)
+        {
+            for (const auto &header : headers)
+            {
+                if (::strcasecmp(header.first.c_str(), field) == 0)
+                {
+                    return &header.second;
+                }
+            }
+            return nullptr;
+        }
+
+        // If-None-Match: "a", W/"b"，弱比较
+        bool etagListMatches(const std::string &list, const std::string &etag)
+        {
+            if (list == "*")
+            {
+                return true;
+            }
+            size_t pos = 0;
+            while (pos < list.size())
+            {
+                while (pos < list.size() && (list[pos] == ' ' || list[pos] == ','))
+                {
+                    ++pos;
+                }
+                if (list.compare(pos, 2, "W/") == 0)
+                {
+                    pos += 2;
+                }
+                size_t end = list.find(',', pos);
+                if (end == std::string::npos)
+                {
+                    end = list.size();
+                }
+                size_t last = end;
+                while (last > pos && list[last - 1] == ' ')
+                {
+                    --last;
+                }
+                size_t offset = etag.compare(0, 2, "W/") == 0 ? 2 : 0;
+                if (last - pos == etag.size() - offset && list.compare(pos, last - pos, etag, offset, std::string::npos) == 0)
+                {
+                    return true;
+                }
+                pos = end;
+            }
+            return false;
+        }
+    } // namespace
+
+    // 响应的Vary里每个请求头都要在键里，否则不同的表示会混在同一个键下
+    bool ResponseCache::varyCovered(const std::string &vary) const
+    {
+        size_t pos = 0;
+        while (pos < vary.size())
+        {
+            while (pos < vary.size() && (vary[pos] == ' ' || vary[pos] == ','))
+            {
+                ++pos;
+            }
+            size_t end = vary.find(',', pos);
+            if (end == std::string::npos)
+            {
+                end = vary.size();
+            }
+            size_t last = end;
+            while (last > pos && vary[last - 1] == ' ')
+            {
+                --last;
+            }
+            if (last > pos)
+            {
+                bool covered = false;
+                for (const std::string &field : varyHeaders_)
+                {
+                    if (field.size() == last - pos && ::strncasecmp(field.c_str(), vary.c_str() + pos, field.size()) == 0)
+                    {
+                        covered = true;
+                        break;
+                    }
+                }
+                if (!covered)
+                {
+                    return false;
+                }
+            }
+            pos = end;
+        }
+        return true;
+    }
+
+    ResponseCache::ResponseCache(size_t maxEntries)
+        : maxEntries_(maxEntries),
+          generation_(0),
+          sharedGeneration_(0),
+          lastSharedSweep_(0)
+    {
+    }
+
+    ResponseCache::~ResponseCache()
+    {
+        // 清理定时器绑定了this，还没被HttpServer停掉的要在各自的loop里取消
+        for (auto &item : shards_)
+        {
+            EventLoop *loop = item.second->loop;
+            if (loop == nullptr)
+            {
+                continue;
+            }
+            if (loop->isInLoopThread())
+            {
+                stopLoop(loop);
+            }
+            else
+            {
+                // 等定时器取消完，正在执行的sweep也就结束了；loop线程此时必须还在运行
+                std::promise<void> stopped;
+                loop->runInLoop([this, loop, &stopped]() {
+                    stopLoop(loop);
+                    stopped.set_value();
+                });
+                stopped.get_future().wait();
+            }
+        }
+    }
+
+    void ResponseCache::initLoop(EventLoop *loop)
+    {
+        std::unique_ptr<Shard> shard(new Shard);
+        shard->loop = loop;
+        shard->generation = generation_.load(std::memory_order_acquire);
+        shard->sweepTimer = loop->runEvery(kSweepInterval, std::bind(&ResponseCache::sweep, this, shard.get()));
+        std::lock_guard<std::mutex> lock(shardsMutex_);
+        shards_[loop] = std::move(shard);
+    }
+
+    void ResponseCache::stopLoop(EventLoop *loop)
+    {
+        Shard *shard = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(shardsMutex_);
+            auto it = shards_.find(loop);
+            if (it != shards_.end())
+            {
+                shard = it->second.get();
+            }
+        }
+        // 分片本身留到析构，其他loop可能还在无锁地查shards_
+        if (shard && shard->loop)
+        {
+            loop->cancel(shard->sweepTimer);
+            shard->loop = nullptr;
+        }
+    }
+
+    ResponseCache::Shard *ResponseCache::findShard(EventLoop *loop)
+    {
+        auto it = shards_.find(loop);
+        if (it == shards_.end())
+        {
+            return nullptr;
+        }
+        Shard *shard = it->second.get();
+        uint64_t generation = generation_.load(std::memory_order_acquire);
+        if (shard->generation != generation)
+        {
+            shard->entries.clear();
+            shard->generation = generation;
+        }
+        return shard;
+    }
+
+    const std::string &ResponseCache::makeKey(Shard *shard, const HttpRequest &req)
+    {
+        std::string &key = shard->key;
+        key.assign(req.path());
+        key.append(req.query());
+        for (const std::string &field : varyHeaders_)
+        {
+            key.push_back('\0');
+            const std::string *value = findHeader(req.headers(), field.c_str());
+            if (value)
+            {
+                key.append(*value);
+            }
+        }
+        return key;
+    }
+
+    CachedResponsePtr ResponseCache::lookup(EventLoop *loop, const HttpRequest &req)
+    {
+        Shard *shard = findShard(loop);
+        if (shard == nullptr)
+        {
+            return CachedResponsePtr();
+        }
+        const std::string &key = makeKey(shard, req);
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        auto it = shard->entries.find(key);
+        if (it != shard->entries.end())
+        {
+            if (it->second->expires > now)
+            {
+                g_cacheHits->increment();
+                return it->second;
+            }
+            shard->entries.erase(it);
+        }
+
+        CachedResponsePtr entry;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(sharedMutex_);
+            auto shared = shared_.find(key);
+            if (shared != shared_.end() && shared->second->expires > now && sharedGeneration_ == shard->generation)
+            {
+                entry = shared->second;
+            }
+        }
+        if (entry)
+        {
+            g_cacheHits->increment();
+            if (shard->entries.size() < maxEntries_)
+            {
+                shard->entries[key] = entry;
+            }
+        }
+        else
+        {
+            g_cacheMisses->increment();
+        }
+        return entry;
+    }
+
+    CachedResponsePtr ResponseCache::insert(EventLoop *loop, const HttpRequest &req, const HttpResponse &response)
+    {
+        Shard *shard = findShard(loop);
+        if (shard == nullptr || req.method() != HttpRequest::kGet ||
+            response.statusCode() != HttpResponse::k200Ok || response.cacheTtl() <= 0)
+        {
+            return CachedResponsePtr();
+        }
+
+        const HttpHeaders &headers = response.headers();
+        const std::string *vary = findHeader(headers, "Vary");
+        if (vary && !varyCovered(*vary))
+        {
+            return CachedResponsePtr();
+        }
+
+        std::shared_ptr<CachedResponse> entry(std::make_shared<CachedResponse>());
+        Timestamp now(Timestamp::now());
+        entry->expires = now.microSecondsSinceEpoch() + static_cast<int64_t>(response.cacheTtl() * Timestamp::kMicroSecondsPerSecond);
+        entry->lastModified = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
+
+        const std::string *etag = findHeader(headers, "ETag");
+        const std::string *lastModified = findHeader(headers, "Last-Modified");
+        const std::string *cacheControl = findHeader(headers, "Cache-Control");
+        if (etag)
+        {
+            entry->etag = *etag;
+        }
+        else
+        {
+            char hash[24];
+            snprintf(hash, sizeof hash, "\"%016llx\"", static_cast<unsigned long long>(fnv1a(response.body())));
+            entry->etag = hash;
+        }
+        if (lastModified && !parseHttpDate(*lastModified, &entry->lastModified))
+        {
+            lastModified = nullptr; // 格式不对时用缓存的时刻
+        }
+        std::string validators;
+        validators.append("ETag: ").append(entry->etag).append("\r\n");
+        validators.append("Last-Modified: ").append(lastModified ? *lastModified : formatHttpDate(entry->lastModified)).append("\r\n");
+        if (!cacheControl)
+        {
+            char maxAge[48];
+            snprintf(maxAge, sizeof maxAge, "Cache-Control: max-age=%ld\r\n", static_cast<long>(response.cacheTtl()));
+            validators.append(maxAge);
+        }
+        else
+        {
+            validators.append("Cache-Control: ").append(*cacheControl).append("\r\n");
+        }
+
+        const std::string &body = response.body();
+        std::string &bytes = entry->bytes;
+        bytes.reserve(256 + body.size());
+        char buf[mymuduo::detail::kMaxNumericSize];
+        bytes.append("HTTP/1.1 200 ").append(response.statusMessage()).append("\r\n");
+        bytes.append("Content-Length: ");
+        bytes.append(buf, mymuduo::detail::formatUnsigned(buf, body.size()));
+        bytes.append("\r\n");
+        for (const auto &header : headers)
+        {
+            if (&header.second == etag || &header.second == lastModified || &header.second == cacheControl)
+            {
+                continue;
+            }
+            bytes.append(header.first).append(": ").append(header.second).append("\r\n");
+        }
+        bytes.append(validators);
+        entry->connectionOffset = bytes.size();
+        bytes.append("Connection: Keep-Alive\r\n\r\n");
+        entry->headLength = bytes.size();
+        bytes.append(body);
+        entry->notModified = "HTTP/1.1 304 Not Modified\r\n" + validators;
+
+        const std::string &key = makeKey(shard, req);
+        if (shard->entries.size() < maxEntries_ || shard->entries.count(key))
+        {
+            shard->entries[key] = entry;
+        }
+        {
+            std::unique_lock<std::shared_timed_mutex> lock(sharedMutex_);
+            if (sharedGeneration_ != shard->generation)
+            {
+                // clear()之后第一次写入，先清掉共享层的旧条目
+                shared_.clear();
+                sharedGeneration_ = shard->generation;
+            }
+            if (shared_.size() < maxEntries_ || shared_.count(key))
+            {
+                shared_[key] = entry;
+            }
+        }
+        return entry;
+    }
+
+    void ResponseCache::clear()
+    {
+        generation_.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    void ResponseCache::sweepMap(EntryMap *entries, int64_t now)
+    {
+        for (auto it = entries->begin(); it != entries->end();)
+        {
+            if (it->second->expires <= now)
+            {
+                it = entries->erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void ResponseCache::sweep(Shard *shard)
+    {
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        sweepMap(&shard->entries, now);
+
+        // 共享层每个周期只由一个loop清理
+        int64_t last = lastSharedSweep_.load(std::memory_order_relaxed);
+        int64_t interval = static_cast<int64_t>(kSweepInterval * Timestamp::kMicroSecondsPerSecond);
+        if (now - last >= interval && lastSharedSweep_.compare_exchange_strong(last, now, std::memory_order_relaxed))
+        {
+            std::unique_lock<std::shared_timed_mutex> lock(sharedMutex_);
+            sweepMap(&shared_, now);
+        }
+    }
+
+    bool ResponseCache::notModified(const HttpRequest &req, const CachedResponse &entry)
+    {
+        const HttpHeaders &headers = req.headers();
+        // 两个都有时以If-None-Match为准，RFC 7232 3.3
+        const std::string *ifNoneMatch = findHeader(headers, "If-None-Match");
+        if (ifNoneMatch)
+        {
+            return etagListMatches(*ifNoneMatch, entry.etag);
+        }
+        const std::string *ifModifiedSince = findHeader(headers, "If-Modified-Since");
+        time_t since = 0;
+        return ifModifiedSince && parseHttpDate(*ifModifiedSince, &since) && entry.lastModified <= since;
+    }
+} // namespace http
@@ -0,0 +1,223 @@
+#include <http/StaticFiles.h>
+#include <http/Compression.h>
+#include <http/HttpRequest.h>
+#include <http/HttpResponse.h>
+#include <http/HttpRouter.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace http
+{
+    namespace
+    {
+        struct MimeType
+        {
+            const char *extension;
+            const char *type;
+        };
+
+        const MimeType kMimeTypes[] = {
+            {"html", "text/html; charset=utf-8"},
+            {"htm", "text/html; charset=utf-8"},
+            {"css", "text/css; charset=utf-8"},
+            {"js", "application/javascript"},
+            {"mjs", "application/javascript"},
+            {"json", "application/json"},
+            {"txt", "text/plain; charset=utf-8"},
+            {"xml", "application/xml"},
+            {"svg", "image/svg+xml"},
+            {"png", "image/png"},
+            {"jpg", "image/jpeg"},
+            {"jpeg", "image/jpeg"},
+            {"gif", "image/gif"},
+            {"webp", "image/webp"},
+            {"ico", "image/x-icon"},
+            {"wasm", "application/wasm"},
+            {"woff", "font/woff"},
+            {"woff2", "font/woff2"},
+            {"pdf", "application/pdf"},
+        };
+
+        // 每一段都不能是..，也不能带NUL
+        bool safePath(const std::string &path)
+        {
+            if (path.find('\0') != std::string::npos)
+            {
+                return false;
+            }
+            size_t start = 0;
+            while (start <= path.size())
+            {
+                size_t end = path.find('/', start);
+                if (end == std::string::npos)
+                {
+                    end = path.size();
+                }
+                if (end - start == 2 && path.compare(start, 2, "..") == 0)
+                {
+                    return false;
+                }
+                start = end + 1;
+            }
+            return true;
+        }
+
+        // 读取普通文件，不存在或不是普通文件时返回false
+        bool readFile(const std::string &filename, std::string *content, time_t *mtime)
+        {
+            int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                return false;
+            }
+            struct stat st;
+            if (::fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+            {
+                ::close(fd);
+                return false;
+            }
+            content->resize(static_cast<size_t>(st.st_size));
+            size_t done = 0;
+            while (done < content->size())
+            {
+                ssize_t n = ::read(fd, &(*content)[done], content->size() - done);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    break;
+                }
+                done += static_cast<size_t>(n);
+            }
+            ::close(fd);
+            content->resize(done); // 读的过程中文件被截断
+            *mtime = st.st_mtime;
+            return true;
+        }
+
+        std::string formatHttpDate(time_t t)
+        {
+            struct tm tm;
+            ::gmtime_r(&t, &tm);
+            char date[64];
+            size_t n = ::strftime(date, sizeof date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+            return std::string(date, n);
+        }
+
+        void notFound(HttpResponse *resp)
+        {
+            resp->setStatusCode(HttpResponse::k404NotFound);
+            resp->setStatusMessage("Not Found");
+            resp->setCloseConnection(true);
+        }
+    } // namespace
+
+    StaticFiles::StaticFiles(const std::string &root)
+        : root_(root),
+          cacheTtl_(0),
+          precompressed_(true)
+    {
+        while (root_.size() > 1 && root_.back() == '/')
+        {
+            root_.pop_back();
+        }
+    }
+
+    const char *StaticFiles::mimeType(const std::string &path)
+    {
+        size_t dot = path.rfind('.');
+        if (dot != std::string::npos && path.find('/', dot) == std::string::npos)
+        {
+            const char *extension = path.c_str() + dot + 1;
+            for (const MimeType &mime : kMimeTypes)
+            {
+                if (::strcasecmp(extension, mime.extension) == 0)
+                {
+                    return mime.type;
+                }
+            }
+        }
+        return "application/octet-stream";
+    }
+
+    void StaticFiles::handle(const HttpRequest &req, const RouteParams &params, HttpResponse *resp) const
+    {
+        if (params.size() == 0)
+        {
+            notFound(resp);
+            return;
+        }
+        serve(req, params.value(params.size() - 1).as_string(), resp);
+    }
+
+    void StaticFiles::serve(const HttpRequest &req, const std::string &path, HttpResponse *resp) const
+    {
+        if (!safePath(path))
+        {
+            notFound(resp);
+            return;
+        }
+        std::string filename(root_);
+        filename.push_back('/');
+        filename.append(path);
+        if (path.empty() || path.back() == '/')
+        {
+            filename.append("index.html");
+        }
+
+        std::string content;
+        time_t mtime = 0;
+        const char *encoding = nullptr;
+        if (precompressed_)
+        {
+            double gzip = 0;
+            double brotli = 0;
+            const std::string acceptEncoding = req.getHeader("Accept-Encoding");
+            if (!acceptEncoding.empty())
+            {
+                ResponseCompressor::parseAcceptEncoding(acceptEncoding, &gzip, &brotli);
+            }
+            // 和ResponseCompressor一样，q值相同时br优先
+            if (brotli > 0 && brotli >= gzip && readFile(filename + ".br", &content, &mtime))
+            {
+                encoding = "br";
+            }
+            else if (gzip > 0 && readFile(filename + ".gz", &content, &mtime))
+            {
+                encoding = "gzip";
+            }
+        }
+        if (encoding == nullptr && !readFile(filename, &content, &mtime))
+        {
+            notFound(resp);
+            return;
+        }
+
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType(mimeType(filename));
+        resp->addHeader("Last-Modified", formatHttpDate(mtime));
+        if (encoding)
+        {
+            resp->addHeader("Content-Encoding", encoding);
+        }
+        if (precompressed_)
+        {
+            // 同一个URL按Accept-Encoding返回不同的内容
+            resp->addHeader("Vary", "Accept-Encoding");
+        }
+        resp->swapBody(content);
+        if (cacheTtl_ > 0)
+        {
+            resp->setCacheTtl(cacheTtl_);
+        }
+    }
+} // namespace http
@@ -0,0 +1,280 @@
+#include <http/WebSocketCodec.h>
+
+#include <mymuduo/Buffer.h>
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace http
+{
+    namespace
+    {
+        const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+        inline uint32_t rotl(uint32_t x, int n)
+        {
+            return (x << n) | (x >> (32 - n));
+        }
+
+        // SHA-1，只用于握手，不需要为它引入OpenSSL
+        void sha1(const std::string &input, unsigned char digest[20])
+        {
+            uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+            std::string msg(input);
+            uint64_t bits = static_cast<uint64_t>(input.size()) * 8;
+            msg.push_back(static_cast<char>(0x80));
+            while (msg.size() % 64 != 56)
+            {
+                msg.push_back('\0');
+            }
+            for (int i = 7; i >= 0; --i)
+            {
+                msg.push_back(static_cast<char>((bits >> (i * 8)) & 0xff));
+            }
+
+            for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+            {
+                uint32_t w[80];
+                const unsigned char *p = reinterpret_cast<const unsigned char *>(msg.data() + chunk);
+                for (int i = 0; i < 16; ++i)
+                {
+                    w[i] = (uint32_t(p[i * 4]) << 24) | (uint32_t(p[i * 4 + 1]) << 16) |
+                           (uint32_t(p[i * 4 + 2]) << 8) | uint32_t(p[i * 4 + 3]);
+                }
+                for (int i = 16; i < 80; ++i)
+                {
+                    w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+                }
+                uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+                for (int i = 0; i < 80; ++i)
+                {
+                    uint32_t f, k;
+                    if (i < 20)
+                    {
+                        f = (b & c) | (~b & d);
+                        k = 0x5A827999;
+                    }
+                    else if (i < 40)
+                    {
+                        f = b ^ c ^ d;
+                        k = 0x6ED9EBA1;
+                    }
+                    else if (i < 60)
+                    {
+                        f = (b & c) | (b & d) | (c & d);
+                        k = 0x8F1BBCDC;
+                    }
+                    else
+                    {
+                        f = b ^ c ^ d;
+                        k = 0xCA62C1D6;
+                    }
+                    uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotl(b, 30);
+                    b = a;
+                    a = temp;
+                }
+                h[0] += a;
+                h[1] += b;
+                h[2] += c;
+                h[3] += d;
+                h[4] += e;
+            }
+            for (int i = 0; i < 5; ++i)
+            {
+                digest[i * 4] = static_cast<unsigned char>(h[i] >> 24);
+                digest[i * 4 + 1] = static_cast<unsigned char>(h[i] >> 16);
+                digest[i * 4 + 2] = static_cast<unsigned char>(h[i] >> 8);
+                digest[i * 4 + 3] = static_cast<unsigned char>(h[i]);
+            }
+        }
+
+        std::string base64(const unsigned char *data, size_t len)
+        {
+            static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::string out;
+            out.reserve((len + 2) / 3 * 4);
+            size_t i = 0;
+            for (; i + 3 <= len; i += 3)
+            {
+                uint32_t v = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+                out.push_back(kTable[(v >> 18) & 63]);
+                out.push_back(kTable[(v >> 12) & 63]);
+                out.push_back(kTable[(v >> 6) & 63]);
+                out.push_back(kTable[v & 63]);
+            }
+            if (i < len)
+            {
+                uint32_t v = uint32_t(data[i]) << 16;
+                if (i + 1 < len)
+                {
+                    v |= uint32_t(data[i + 1]) << 8;
+                }
+                out.push_back(kTable[(v >> 18) & 63]);
+                out.push_back(kTable[(v >> 12) & 63]);
+                out.push_back(i + 1 < len ? kTable[(v >> 6) & 63] : '=');
+                out.push_back('=');
+            }
+            return out;
+        }
+    } // namespace
+
+    int WebSocketCodec::parseHeader(const char *data, size_t len, FrameHeader *header)
+    {
+        if (len < 2)
+        {
+            return 0;
+        }
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        if (p[0] & 0x70)
+        {
+            return -1; // 没有协商扩展，RSV必须为0
+        }
+        header->fin = (p[0] & 0x80) != 0;
+        header->opcode = p[0] & 0x0f;
+        switch (header->opcode)
+        {
+        case kContinuation:
+        case kText:
+        case kBinary:
+        case kClose:
+        case kPing:
+        case kPong:
+            break;
+        default:
+            return -1;
+        }
+        header->masked = (p[1] & 0x80) != 0;
+        uint64_t length = p[1] & 0x7f;
+        size_t pos = 2;
+        if (length == 126)
+        {
+            if (len < 4)
+            {
+                return 0;
+            }
+            length = (uint64_t(p[2]) << 8) | p[3];
+            pos = 4;
+        }
+        else if (length == 127)
+        {
+            if (len < 10)
+            {
+                return 0;
+            }
+            length = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                length = (length << 8) | p[2 + i];
+            }
+            if (length >> 63)
+            {
+                return -1;
+            }
+            pos = 10;
+        }
+        if (isControl(header->opcode) && (!header->fin || length > kMaxControlPayload))
+        {
+            return -1;
+        }
+        if (header->masked)
+        {
+            if (len < pos + 4)
+            {
+                return 0;
+            }
+            ::memcpy(header->mask, p + pos, 4);
+            pos += 4;
+        }
+        header->payloadLength = length;
+        header->headerLength = pos;
+        return 1;
+    }
+
+    void WebSocketCodec::unmask(char *data, size_t len, const uint8_t mask[4], size_t offset)
+    {
+        // 按偏移把掩码转好，之后从data开头按4字节循环
+        uint8_t key[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            key[i] = mask[(offset + i) & 3];
+        }
+        size_t i = 0;
+#if defined(__SSE2__)
+        // x86-64上SSE2总是可用，一次16字节
+        uint32_t key32;
+        ::memcpy(&key32, key, 4);
+        const __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+        for (; i + 16 <= len; i += 16)
+        {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_xor_si128(block, key128));
+        }
+#endif
+        uint64_t key64;
+        ::memcpy(&key64, key, 8);
+        for (; i + 8 <= len; i += 8)
+        {
+            uint64_t block;
+            ::memcpy(&block, data + i, 8);
+            block ^= key64;
+            ::memcpy(data + i, &block, 8);
+        }
+        for (; i < len; ++i)
+        {
+            data[i] ^= key[i & 3];
+        }
+    }
+
+    size_t WebSocketCodec::encodeHeader(char *out, int opcode, uint64_t payloadLength, bool fin)
+    {
+        unsigned char *p = reinterpret_cast<unsigned char *>(out);
+        p[0] = static_cast<unsigned char>((fin ? 0x80 : 0) | (opcode & 0x0f));
+        if (payloadLength < 126)
+        {
+            p[1] = static_cast<unsigned char>(payloadLength);
+            return 2;
+        }
+        if (payloadLength <= 0xffff)
+        {
+            p[1] = 126;
+            p[2] = static_cast<unsigned char>(payloadLength >> 8);
+            p[3] = static_cast<unsigned char>(payloadLength);
+            return 4;
+        }
+        p[1] = 127;
+        for (int i = 0; i < 8; ++i)
+        {
+            p[2 + i] = static_cast<unsigned char>(payloadLength >> ((7 - i) * 8));
+        }
+        return 10;
+    }
+
+    void WebSocketCodec::appendFrame(mymuduo::Buffer *out, int opcode, const char *data, size_t len, bool fin)
+    {
+        char header[kMaxHeaderLength];
+        out->ensureWritableBytes(kMaxHeaderLength + len);
+        out->append(header, encodeHeader(header, opcode, len, fin));
+        out->append(data, len);
+    }
+
+    void WebSocketCodec::appendFrame(std::string *out, int opcode, const char *data, size_t len, bool fin)
+    {
+        char header[kMaxHeaderLength];
+        out->reserve(out->size() + kMaxHeaderLength + len);
+        out->append(header, encodeHeader(header, opcode, len, fin));
+        out->append(data, len);
+    }
+
+    std::string WebSocketCodec::acceptKey(const std::string &key)
+    {
+        unsigned char digest[20];
+        sha1(key + kGuid, digest);
+        return base64(digest, sizeof digest);
+    }
+} // namespace http
@@ -0,0 +1,460 @@
+#include <http/WebSocketServer.h>
+#include <http/HttpRequest.h>
+
+#include <mymuduo/Buffer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Metrics.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Timestamp.h>
+
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+using namespace mymuduo;
+
+namespace http
+{
+    namespace
+    {
+        Gauge *const g_sessions = MetricsRegistry::instance().gauge(
+            "http_websocket_sessions", "Open WebSocket sessions.");
+        Counter *const g_framesReceived = MetricsRegistry::instance().counter(
+            "http_websocket_frames_received_total", "WebSocket frames received, including control frames.");
+        Counter *const g_protocolErrors = MetricsRegistry::instance().counter(
+            "http_websocket_protocol_errors_total", "WebSocket connections failed for protocol violations or oversized messages.");
+
+        const std::string *findHeader(const HttpHeaders &headers, const char *field)
+        {
+            for (const auto &header : headers)
+            {
+                if (::strcasecmp(header.first.c_str(), field) == 0)
+                {
+                    return &header.second;
+                }
+            }
+            return nullptr;
+        }
+
+        bool hasToken(const std::string *value, const char *token)
+        {
+            return value && ::strcasestr(value->c_str(), token) != nullptr;
+        }
+    } // namespace
+
+    WebSocketSession::WebSocketSession(WebSocketServer *server, const TcpConnectionPtr &conn, HttpRequest &request)
+        : server_(server),
+          conn_(conn),
+          loop_(conn->getLoop()),
+          fragmentOpcode_(WebSocketCodec::kContinuation),
+          closeSent_(false),
+          closed_(false),
+          lastReceive_(Timestamp::now().microSecondsSinceEpoch())
+    {
+        request_.swap(request);
+    }
+
+    void WebSocketSession::sendMessage(int opcode, StringPiece message)
+    {
+        if (loop_->isInLoopThread())
+        {
+            TcpConnectionPtr conn(conn_.lock());
+            if (conn && !closeSent_)
+            {
+                Buffer frame(WebSocketCodec::kMaxHeaderLength + message.size());
+                WebSocketCodec::appendFrame(&frame, opcode, message.data(), message.size());
+                conn->send(&frame);
+            }
+        }
+        else
+        {
+            send(WebSocketServer::makeFrame(opcode, message));
+        }
+    }
+
+    void WebSocketSession::send(const WebSocketFramePtr &frame)
+    {
+        if (loop_->isInLoopThread())
+        {
+            TcpConnectionPtr conn(conn_.lock());
+            if (conn && !closeSent_)
+            {
+                conn->send(frame->data(), frame->size());
+            }
+        }
+        else
+        {
+            WebSocketSessionPtr self(shared_from_this());
+            loop_->queueInLoop([self, frame]() { self->send(frame); });
+        }
+    }
+
+    void WebSocketSession::ping()
+    {
+        sendControl(WebSocketCodec::kPing, nullptr, 0);
+    }
+
+    void WebSocketSession::sendControl(int opcode, const char *data, size_t len)
+    {
+        send(WebSocketServer::makeFrame(opcode, StringPiece(data, static_cast<int>(len))));
+    }
+
+    void WebSocketSession::close(int code, StringPiece reason)
+    {
+        loop_->runInLoop(std::bind(&WebSocketSession::closeInLoop, shared_from_this(), code, reason.as_string()));
+    }
+
+    void WebSocketSession::closeInLoop(int code, const std::string &reason)
+    {
+        TcpConnectionPtr conn(conn_.lock());
+        if (!conn || closeSent_ || closed_)
+        {
+            return;
+        }
+        char payload[WebSocketCodec::kMaxControlPayload];
+        payload[0] = static_cast<char>((code >> 8) & 0xff);
+        payload[1] = static_cast<char>(code & 0xff);
+        size_t n = std::min(reason.size(), sizeof payload - 2);
+        ::memcpy(payload + 2, reason.data(), n);
+        Buffer frame(WebSocketCodec::kMaxHeaderLength + 2 + n);
+        WebSocketCodec::appendFrame(&frame, WebSocketCodec::kClose, payload, 2 + n);
+        conn->send(&frame);
+        closeSent_ = true;
+        // 对方回复close后关闭连接，不回复的由保活定时器关闭
+    }
+
+    void WebSocketSession::onMessage(const TcpConnectionPtr &, Buffer *buf)
+    {
+        lastReceive_ = Timestamp::now().microSecondsSinceEpoch();
+        while (!closed_)
+        {
+            WebSocketCodec::FrameHeader header;
+            int result = WebSocketCodec::parseHeader(buf->peek(), buf->readableBytes(), &header);
+            if (result == 0)
+            {
+                break;
+            }
+            if (result < 0 || !header.masked) // 客户端的帧必须带掩码
+            {
+                failConnection(WebSocketCodec::kProtocolError);
+                break;
+            }
+            if (header.payloadLength > server_->maxMessageSize_)
+            {
+                failConnection(WebSocketCodec::kMessageTooBig);
+                break;
+            }
+            size_t payloadLength = static_cast<size_t>(header.payloadLength);
+            if (buf->readableBytes() < header.headerLength + payloadLength)
+            {
+                break; // 帧还没收全，最多在输入缓冲区里攒maxMessageSize
+            }
+            g_framesReceived->increment();
+            char *payload = buf->beginRead() + header.headerLength;
+            WebSocketCodec::unmask(payload, payloadLength, header.mask);
+            bool ok = onFrame(header, payload, payloadLength);
+            buf->retrieve(header.headerLength + payloadLength);
+            if (!ok)
+            {
+                break;
+            }
+        }
+        if (closeSent_)
+        {
+            // 关闭握手开始后对方再发的数据都不处理
+            buf->retrieveAll();
+        }
+    }
+
+    bool WebSocketSession::onFrame(const WebSocketCodec::FrameHeader &header, char *payload, size_t len)
+    {
+        switch (header.opcode)
+        {
+        case WebSocketCodec::kText:
+        case WebSocketCodec::kBinary:
+            if (fragmentOpcode_ != WebSocketCodec::kContinuation)
+            {
+                failConnection(WebSocketCodec::kProtocolError); // 上一个分片消息还没结束
+                return false;
+            }
+            if (header.fin)
+            {
+                // 没有分片：直接用输入缓冲区里解好掩码的payload
+                if (!closeSent_ && server_->messageCallback_)
+                {
+                    server_->messageCallback_(shared_from_this(), StringPiece(payload, static_cast<int>(len)),
+                                              header.opcode == WebSocketCodec::kBinary);
+                }
+            }
+            else
+            {
+                fragmentOpcode_ = header.opcode;
+                fragments_.assign(payload, len);
+            }
+            return true;
+        case WebSocketCodec::kContinuation:
+            if (fragmentOpcode_ == WebSocketCodec::kContinuation)
+            {
+                failConnection(WebSocketCodec::kProtocolError);
+                return false;
+            }
+            if (fragments_.size() + len > server_->maxMessageSize_)
+            {
+                failConnection(WebSocketCodec::kMessageTooBig);
+                return false;
+            }
+            fragments_.append(payload, len);
+            if (header.fin)
+            {
+                int opcode = fragmentOpcode_;
+                fragmentOpcode_ = WebSocketCodec::kContinuation;
+                if (!closeSent_ && server_->messageCallback_)
+                {
+                    server_->messageCallback_(shared_from_this(), StringPiece(fragments_.data(), static_cast<int>(fragments_.size())),
+                                              opcode == WebSocketCodec::kBinary);
+                }
+                // 连接数很多时不让每个会话都留着最大消息的容量
+                std::string().swap(fragments_);
+            }
+            return true;
+        case WebSocketCodec::kPing:
+            if (!closeSent_)
+            {
+                TcpConnectionPtr conn(conn_.lock());
+                if (conn)
+                {
+                    Buffer frame(WebSocketCodec::kMaxHeaderLength + len);
+                    WebSocketCodec::appendFrame(&frame, WebSocketCodec::kPong, payload, len);
+                    conn->send(&frame);
+                }
+            }
+            return true;
+        case WebSocketCodec::kPong:
+            return true; // lastReceive_已经更新
+        case WebSocketCodec::kClose:
+        {
+            if (len == 1)
+            {
+                failConnection(WebSocketCodec::kProtocolError);
+                return false;
+            }
+            // 回复同样的状态码，没有状态码时回复1000
+            int code = len >= 2 ? ((static_cast<unsigned char>(payload[0]) << 8) | static_cast<unsigned char>(payload[1]))
+                                : static_cast<int>(WebSocketCodec::kNormalClosure);
+            closeInLoop(code, std::string());
+            TcpConnectionPtr conn(conn_.lock());
+            if (conn)
+            {
+                conn->shutdown();
+            }
+            return false;
+        }
+        default:
+            failConnection(WebSocketCodec::kProtocolError);
+            return false;
+        }
+    }
+
+    void WebSocketSession::failConnection(int code)
+    {
+        g_protocolErrors->increment();
+        closeInLoop(code, std::string());
+        closeSent_ = true;
+        std::string().swap(fragments_);
+        TcpConnectionPtr conn(conn_.lock());
+        if (conn)
+        {
+            conn->shutdown();
+        }
+    }
+
+    void WebSocketSession::onClosed()
+    {
+        if (closed_)
+        {
+            return;
+        }
+        closed_ = true;
+        server_->removeSession(this);
+        if (server_->closeCallback_)
+        {
+            server_->closeCallback_(shared_from_this());
+        }
+    }
+
+    WebSocketServer::WebSocketServer()
+        : pingInterval_(30.0),
+          maxMessageSize_(1024 * 1024),
+          sessionCount_(0)
+    {
+    }
+
+    WebSocketServer::~WebSocketServer()
+    {
+        // 保活定时器绑定了this和LoopSessions，还没被HttpServer停掉的要在各自的loop里取消
+        for (auto &item : loops_)
+        {
+            EventLoop *loop = item.second->loop;
+            if (loop == nullptr)
+            {
+                continue;
+            }
+            if (loop->isInLoopThread())
+            {
+                stopLoop(loop);
+            }
+            else
+            {
+                // 等取消完，正在执行的keepalive也就结束了；loop线程此时必须还在运行
+                std::promise<void> stopped;
+                loop->runInLoop([this, loop, &stopped]() {
+                    stopLoop(loop);
+                    stopped.set_value();
+                });
+                stopped.get_future().wait();
+            }
+        }
+    }
+
+    WebSocketFramePtr WebSocketServer::makeFrame(int opcode, StringPiece payload)
+    {
+        std::shared_ptr<std::string> frame(std::make_shared<std::string>());
+        WebSocketCodec::appendFrame(frame.get(), opcode, payload.data(), payload.size());
+        return frame;
+    }
+
+    void WebSocketServer::initLoop(EventLoop *loop)
+    {
+        std::unique_ptr<LoopSessions> loopSessions(new LoopSessions);
+        loopSessions->loop = loop;
+        if (pingInterval_ > 0)
+        {
+            loopSessions->keepaliveTimer = loop->runEvery(pingInterval_, std::bind(&WebSocketServer::keepalive, this, loopSessions.get()));
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        loops_[loop] = std::move(loopSessions);
+    }
+
+    void WebSocketServer::stopLoop(EventLoop *loop)
+    {
+        LoopSessions *loopSessions = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = loops_.find(loop);
+            if (it != loops_.end())
+            {
+                loopSessions = it->second.get();
+            }
+        }
+        // LoopSessions留到析构，其他loop可能还在无锁地查loops_
+        if (loopSessions && loopSessions->loop)
+        {
+            if (pingInterval_ > 0)
+            {
+                loop->cancel(loopSessions->keepaliveTimer);
+            }
+            loopSessions->loop = nullptr;
+        }
+    }
+
+    bool WebSocketServer::handshake(const HttpRequest &req, Buffer *out)
+    {
+        const HttpHeaders &headers = req.headers();
+        const std::string *key = findHeader(headers, "Sec-WebSocket-Key");
+        const std::string *version = findHeader(headers, "Sec-WebSocket-Version");
+        if (req.method() != HttpRequest::kGet || req.getVersion() != HttpRequest::kHttp11 ||
+            !hasToken(findHeader(headers, "Upgrade"), "websocket") ||
+            !hasToken(findHeader(headers, "Connection"), "upgrade") ||
+            key == nullptr || key->size() != 24 || version == nullptr || *version != "13")
+        {
+            return false;
+        }
+        out->append("HTTP/1.1 101 Switching Protocols\r\n"
+                    "Upgrade: websocket\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: ");
+        out->append(WebSocketCodec::acceptKey(*key));
+        out->append("\r\n\r\n", 4);
+        return true;
+    }
+
+    void WebSocketServer::addSession(const WebSocketSessionPtr &session)
+    {
+        auto it = loops_.find(session->getLoop());
+        if (it == loops_.end())
+        {
+            LOG_FMT_ERROR("WebSocketServer::addSession - loop is not initialized \n");
+            return;
+        }
+        it->second->sessions.insert(session.get());
+        sessionCount_.fetch_add(1, std::memory_order_relaxed);
+        g_sessions->increment();
+        if (openCallback_)
+        {
+            openCallback_(session);
+        }
+    }
+
+    void WebSocketServer::removeSession(WebSocketSession *session)
+    {
+        auto it = loops_.find(session->getLoop());
+        if (it != loops_.end() && it->second->sessions.erase(session))
+        {
+            sessionCount_.fetch_sub(1, std::memory_order_relaxed);
+            g_sessions->decrement();
+        }
+    }
+
+    void WebSocketServer::broadcast(StringPiece message, bool binary)
+    {
+        broadcast(makeFrame(binary ? WebSocketCodec::kBinary : WebSocketCodec::kText, message));
+    }
+
+    void WebSocketServer::broadcast(const WebSocketFramePtr &frame)
+    {
+        for (const auto &item : loops_)
+        {
+            LoopSessions *loopSessions = item.second.get();
+            item.first->runInLoop([loopSessions, frame]() {
+                // 在loop里同步发送不会关闭连接(出错只做标记)，遍历期间集合不会变
+                for (WebSocketSession *session : loopSessions->sessions)
+                {
+                    session->send(frame);
+                }
+            });
+        }
+    }
+
+    void WebSocketServer::keepalive(LoopSessions *loopSessions)
+    {
+        static const WebSocketFramePtr kPingFrame(makeFrame(WebSocketCodec::kPing, StringPiece()));
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        int64_t interval = static_cast<int64_t>(pingInterval_ * Timestamp::kMicroSecondsPerSecond);
+        std::vector<TcpConnectionPtr> dead;
+        for (WebSocketSession *session : loopSessions->sessions)
+        {
+            int64_t idle = now - session->lastReceive_;
+            if (idle >= 2 * interval)
+            {
+                TcpConnectionPtr conn(session->connection());
+                if (conn)
+                {
+                    dead.push_back(conn);
+                }
+            }
+            else if (idle >= interval - interval / 10)
+            {
+                session->send(kPingFrame);
+            }
+        }
+        // 关闭会从集合里删除会话，遍历完再关
+        for (const TcpConnectionPtr &conn : dead)
+        {
+            conn->forceClose();
+        }
+    }
+} // namespace http
@@ -0,0 +1,147 @@
+// 响应压缩的自测：gzip往返、Accept-Encoding协商、ResponseCompressor的跳过条件
+#include "http/Compression.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+
+std::string gunzip(const std::string &data)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    inflateInit2(&zs, 15 + 16);
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    std::string out;
+    char chunk[4096];
+    int err = Z_OK;
+    while (err == Z_OK)
+    {
+        zs.next_out = reinterpret_cast<Bytef *>(chunk);
+        zs.avail_out = sizeof chunk;
+        err = inflate(&zs, Z_NO_FLUSH);
+        out.append(chunk, sizeof chunk - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return err == Z_STREAM_END ? out : std::string("<corrupt>");
+}
+
+HttpRequest makeRequest(const char *acceptEncoding)
+{
+    HttpRequest req;
+    std::string header("Accept-Encoding: ");
+    header.append(acceptEncoding);
+    req.addHeader(header.data(), header.data() + 15, header.data() + header.size());
+    return req;
+}
+
+std::string makeJson(int items)
+{
+    std::string json("[");
+    for (int i = 0; i < items; ++i)
+    {
+        char item[64];
+        snprintf(item, sizeof item, "%s{\"id\":%d,\"name\":\"user%d\"}", i ? "," : "", i, i);
+        json.append(item);
+    }
+    json.append("]");
+    return json;
+}
+
+int main()
+{
+    // 一次性压缩和分块flush压缩都能还原
+    std::string json = makeJson(1000);
+    {
+        StreamCompressor gzip(StreamCompressor::kGzip);
+        std::string out;
+        CHECK(gzip.update(json.data(), json.size(), &out));
+        CHECK(gzip.finish(&out));
+        CHECK(out.size() < json.size() / 4);
+        CHECK(gunzip(out) == json);
+    }
+    {
+        StreamCompressor gzip(StreamCompressor::kGzip, 1);
+        std::string out;
+        for (size_t i = 0; i < json.size(); i += 1000)
+        {
+            size_t before = out.size();
+            CHECK(gzip.update(json.data() + i, std::min<size_t>(1000, json.size() - i), &out, true));
+            CHECK(out.size() > before); // flush之后客户端已经能解出这一块
+        }
+        CHECK(gzip.finish(&out));
+        CHECK(!gzip.update("x", 1, &out));
+        CHECK(gunzip(out) == json);
+    }
+
+    double gzip = 0;
+    double brotli = 0;
+    ResponseCompressor::parseAcceptEncoding("gzip, deflate, br", &gzip, &brotli);
+    CHECK(gzip == 1 && brotli == 1);
+    ResponseCompressor::parseAcceptEncoding("gzip;q=0.5, br;q=0", &gzip, &brotli);
+    CHECK(gzip == 0.5 && brotli == 0);
+    ResponseCompressor::parseAcceptEncoding("identity, *;q=0.3", &gzip, &brotli);
+    CHECK(gzip == 0.3 && brotli == 0.3);
+    ResponseCompressor::parseAcceptEncoding("deflate", &gzip, &brotli);
+    CHECK(gzip == 0 && brotli == 0);
+
+    ResponseCompressor compressor;
+    compressor.setBrotli(false);
+    CHECK(compressor.negotiate(makeRequest("br, gzip")) == StreamCompressor::kGzip);
+    CHECK(compressor.negotiate(makeRequest("deflate")) == StreamCompressor::kIdentity);
+    CHECK(compressor.negotiate(HttpRequest()) == StreamCompressor::kIdentity);
+    if (StreamCompressor::available(StreamCompressor::kBrotli))
+    {
+        compressor.setBrotli(true);
+        CHECK(compressor.negotiate(makeRequest("gzip, br")) == StreamCompressor::kBrotli);
+        CHECK(compressor.negotiate(makeRequest("gzip, br;q=0.8")) == StreamCompressor::kGzip);
+        compressor.setBrotli(false);
+    }
+
+    {
+        HttpResponse resp(false);
+        resp.setContentType("application/json");
+        resp.addHeader("ETag", "\"v1\"");
+        resp.setBody(json);
+        CHECK(compressor.compress(makeRequest("gzip"), &resp));
+        CHECK(resp.getHeader("Content-Encoding") == "gzip");
+        CHECK(resp.getHeader("Vary") == "Accept-Encoding");
+        CHECK(resp.getHeader("ETag") == "\"v1-gzip\"");
+        CHECK(gunzip(resp.body()) == json);
+    }
+    {
+        // 太小：不压缩，但仍然带Vary
+        HttpResponse resp(false);
+        resp.setContentType("text/plain");
+        resp.addHeader("Vary", "Origin");
+        resp.setBody("hello");
+        CHECK(!compressor.compress(makeRequest("gzip"), &resp));
+        CHECK(resp.getHeader("Vary") == "Origin, Accept-Encoding");
+        CHECK(resp.body() == "hello");
+    }
+    {
+        // 不在白名单里
+        HttpResponse resp(false);
+        resp.setContentType("image/png");
+        resp.setBody(json);
+        CHECK(!compressor.compress(makeRequest("gzip"), &resp));
+        CHECK(resp.headers().count("Vary") == 0);
+    }
+    {
+        // 已经压缩过
+        HttpResponse resp(false);
+        resp.setContentType("text/css");
+        resp.addHeader("Content-Encoding", "br");
+        resp.setBody(json);
+        CHECK(!compressor.compress(makeRequest("gzip"), &resp));
+        CHECK(resp.body() == json);
+    }
+
+    return testResult();
+}
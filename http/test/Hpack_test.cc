@@ -0,0 +1,153 @@
+// HPACK的自测：RFC 7541附录C的例子、Huffman编解码、编码器和解码器互通
+#include "http/Hpack.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+
+std::string fromHex(const char *hex)
+{
+    std::string out;
+    unsigned int byte = 0;
+    int digits = 0;
+    for (const char *p = hex; *p; ++p)
+    {
+        if (*p == ' ')
+        {
+            continue;
+        }
+        byte = (byte << 4) | (*p <= '9' ? *p - '0' : *p - 'a' + 10);
+        if (++digits == 2)
+        {
+            out.push_back(static_cast<char>(byte));
+            byte = 0;
+            digits = 0;
+        }
+    }
+    return out;
+}
+
+bool decode(HpackDecoder *decoder, const std::string &block, std::vector<HpackHeader> *headers)
+{
+    headers->clear();
+    return decoder->decode(block.data(), block.size(), headers);
+}
+
+int main()
+{
+    // C.4：同一连接上的三个请求，Huffman编码，后面的请求引用动态表
+    {
+        HpackDecoder decoder;
+        std::vector<HpackHeader> headers;
+        CHECK(decode(&decoder, fromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"), &headers));
+        CHECK(headers.size() == 4);
+        CHECK(headers.size() == 4 && headers[0] == HpackHeader(":method", "GET"));
+        CHECK(headers.size() == 4 && headers[3] == HpackHeader(":authority", "www.example.com"));
+
+        CHECK(decode(&decoder, fromHex("8286 84be 5886 a8eb 1064 9cbf"), &headers));
+        CHECK(headers.size() == 5);
+        CHECK(headers.size() == 5 && headers[3] == HpackHeader(":authority", "www.example.com"));
+        CHECK(headers.size() == 5 && headers[4] == HpackHeader("cache-control", "no-cache"));
+
+        CHECK(decode(&decoder, fromHex("8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf"), &headers));
+        CHECK(headers.size() == 5);
+        CHECK(headers.size() == 5 && headers[1] == HpackHeader(":scheme", "https"));
+        CHECK(headers.size() == 5 && headers[2] == HpackHeader(":path", "/index.html"));
+        CHECK(headers.size() == 5 && headers[4] == HpackHeader("custom-key", "custom-value"));
+    }
+
+    // C.6.1：响应，动态表只有256字节，加入:status 307时淘汰最早的条目
+    {
+        HpackTable table(256);
+        table.add(":status", "302");
+        table.add("cache-control", "private");
+        table.add("date", "Mon, 21 Oct 2013 20:13:21 GMT");
+        table.add("location", "https://www.example.com");
+        CHECK(table.size() == 222);
+        table.add(":status", "307");
+        CHECK(table.size() == 222);
+        size_t nameIndex = 0;
+        CHECK(table.find(":status", "302", &nameIndex) == 0);
+        CHECK(table.find(":status", "307", &nameIndex) == 62);
+        CHECK(table.find("location", "https://www.example.com", &nameIndex) == 63);
+        CHECK(table.find(":status", "404", &nameIndex) == 13);
+        CHECK(table.find(":status", "418", &nameIndex) == 0 && nameIndex == 8);
+        CHECK(table.get(66) == nullptr);
+        table.setMaxSize(0);
+        CHECK(table.size() == 0 && table.get(62) == nullptr);
+    }
+
+    // Huffman：C.4.1的例子，以及所有字节值的往返
+    {
+        std::string encoded;
+        HpackEncoder::huffmanEncode("www.example.com", 15, &encoded);
+        CHECK(encoded == fromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+        CHECK(HpackEncoder::huffmanEncodedLength("www.example.com", 15) == encoded.size());
+
+        std::string all;
+        for (int i = 0; i < 256; ++i)
+        {
+            all.push_back(static_cast<char>(i));
+        }
+        all += all;
+        encoded.clear();
+        HpackEncoder::huffmanEncode(all.data(), all.size(), &encoded);
+        CHECK(HpackEncoder::huffmanEncodedLength(all.data(), all.size()) == encoded.size());
+        std::string decoded;
+        CHECK(HpackDecoder::huffmanDecode(encoded.data(), encoded.size(), &decoded));
+        CHECK(decoded == all);
+
+        // 超过7位的填充、填充不是全1都不合法
+        decoded.clear();
+        CHECK(!HpackDecoder::huffmanDecode("\xff\xff", 2, &decoded));
+        CHECK(!HpackDecoder::huffmanDecode("\xf0", 1, &decoded));
+    }
+
+    // 编码器和解码器互通，中途对方缩小动态表
+    {
+        HpackEncoder encoder;
+        HpackDecoder decoder;
+        std::vector<HpackHeader> expected;
+        expected.emplace_back(":status", "200");
+        expected.emplace_back("content-type", "text/html; charset=utf-8");
+        expected.emplace_back("x-request-id", "abc123");
+        expected.emplace_back("set-cookie", std::string(300, 'c'));
+        for (int round = 0; round < 4; ++round)
+        {
+            if (round == 2)
+            {
+                encoder.setMaxTableSize(64);
+            }
+            std::string block;
+            encoder.beginBlock(&block);
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                encoder.encode(expected[i].first, expected[i].second, &block, i != 2);
+            }
+            std::vector<HpackHeader> headers;
+            CHECK(decode(&decoder, block, &headers));
+            CHECK(headers == expected);
+            // 第二遍起大部分头部都来自动态表
+            if (round == 1)
+            {
+                CHECK(block.size() < 20);
+            }
+        }
+    }
+
+    // 非法输入：编号越界、字符串被截断、超过头部列表上限
+    {
+        HpackDecoder decoder;
+        std::vector<HpackHeader> headers;
+        CHECK(!decode(&decoder, fromHex("be"), &headers));
+        CHECK(!decode(&decoder, fromHex("4088 25a8 49e9"), &headers));
+        HpackDecoder small;
+        small.setMaxHeaderListSize(64);
+        CHECK(!decode(&small, fromHex("8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff"), &headers));
+    }
+
+    return testResult();
+}
@@ -0,0 +1,444 @@
+// Http2Connection的自测：本进程起一个开启HTTP/2的HttpServer，客户端线程用阻塞socket直接收发帧，
+// 检查连接前言和SETTINGS/ACK、CONTINUATION中间夹别的帧、发送窗口用完后WINDOW_UPDATE恢复DATA、
+// 响应中途RST_STREAM、GOAWAY后在途的流处理完再关闭，以及缓存的请求体超过预算后不再归还接收窗口
+#include "http/HttpServer.h"
+#include "http/Http2Connection.h"
+#include "http/AsyncResponse.h"
+#include "http/Hpack.h"
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+using namespace mymuduo;
+
+namespace
+{
+    const uint8_t kEndStream = 0x1;
+    const uint8_t kAck = 0x1;
+    const uint8_t kEndHeaders = 0x4;
+    const size_t kFrameSize = 16384;
+
+    struct Frame
+    {
+        uint8_t type;
+        uint8_t flags;
+        uint32_t streamId;
+        std::string payload;
+    };
+
+    uint32_t readUint32(const char *p)
+    {
+        const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+        return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+    }
+
+    std::string uint32Bytes(uint32_t value)
+    {
+        char bytes[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+                         static_cast<char>(value >> 8), static_cast<char>(value)};
+        return std::string(bytes, 4);
+    }
+
+    std::string setting(uint16_t id, uint32_t value)
+    {
+        std::string s;
+        s.push_back(static_cast<char>(id >> 8));
+        s.push_back(static_cast<char>(id));
+        return s + uint32Bytes(value);
+    }
+
+    // 阻塞socket上的HTTP/2客户端，每次读最多等timeoutMs
+    class Client
+    {
+    public:
+        explicit Client(uint16_t port) : fd_(::socket(AF_INET, SOCK_STREAM, 0)), eof_(false)
+        {
+            struct sockaddr_in addr;
+            ::memset(&addr, 0, sizeof addr);
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            connected_ = ::connect(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0;
+        }
+
+        ~Client() { ::close(fd_); }
+
+        bool connected() const { return connected_; }
+        bool eof() const { return eof_; }
+
+        void sendPreface(const std::string &settings)
+        {
+            writeAll(Http2Connection::kPreface, Http2Connection::kPrefaceLength);
+            sendFrame(Http2Connection::kSettings, 0, 0, settings);
+        }
+
+        void sendFrame(uint8_t type, uint8_t flags, uint32_t streamId, const std::string &payload)
+        {
+            size_t len = payload.size();
+            char header[5] = {static_cast<char>(len >> 16), static_cast<char>(len >> 8), static_cast<char>(len),
+                              static_cast<char>(type), static_cast<char>(flags)};
+            std::string frame(header, 5);
+            frame.append(uint32Bytes(streamId));
+            frame.append(payload);
+            writeAll(frame.data(), frame.size());
+        }
+
+        std::string headerBlock(const char *method, const char *path)
+        {
+            std::string block;
+            encoder_.beginBlock(&block);
+            encoder_.encode(":method", method, &block);
+            encoder_.encode(":scheme", "http", &block);
+            encoder_.encode(":path", path, &block);
+            encoder_.encode(":authority", "test", &block);
+            return block;
+        }
+
+        void sendRequest(uint32_t streamId, const char *method, const char *path, bool endStream)
+        {
+            sendFrame(Http2Connection::kHeaders, kEndHeaders | (endStream ? kEndStream : 0), streamId, headerBlock(method, path));
+        }
+
+        void sendWindowUpdate(uint32_t streamId, uint32_t increment)
+        {
+            sendFrame(Http2Connection::kWindowUpdate, 0, streamId, uint32Bytes(increment));
+        }
+
+        // 超时或者连接关闭时返回false
+        bool readFrame(Frame *frame, int timeoutMs)
+        {
+            char header[Http2Connection::kFrameHeaderLength];
+            if (!readAll(header, sizeof header, timeoutMs))
+            {
+                return false;
+            }
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(header);
+            size_t len = (size_t(p[0]) << 16) | (size_t(p[1]) << 8) | p[2];
+            frame->type = p[3];
+            frame->flags = p[4];
+            frame->streamId = readUint32(header + 5) & 0x7fffffff;
+            frame->payload.resize(len);
+            return len == 0 || readAll(&frame->payload[0], len, timeoutMs);
+        }
+
+        // 读到指定类型的帧为止，跳过的帧放进skipped
+        bool readUntil(uint8_t type, Frame *frame, std::vector<Frame> *skipped, int timeoutMs = 2000)
+        {
+            while (readFrame(frame, timeoutMs))
+            {
+                if (frame->type == type)
+                {
+                    return true;
+                }
+                if (skipped)
+                {
+                    skipped->push_back(*frame);
+                }
+            }
+            return false;
+        }
+
+        // 发一个PING等它的ACK，之前发的帧服务端都处理完了
+        bool roundTrip(std::vector<Frame> *skipped)
+        {
+            sendFrame(Http2Connection::kPing, 0, 0, std::string(8, 'p'));
+            Frame frame;
+            while (readUntil(Http2Connection::kPing, &frame, skipped))
+            {
+                if (frame.flags & kAck)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        void writeAll(const char *data, size_t len)
+        {
+            while (len > 0)
+            {
+                ssize_t n = ::write(fd_, data, len);
+                if (n <= 0)
+                {
+                    return;
+                }
+                data += n;
+                len -= n;
+            }
+        }
+
+        bool readAll(char *data, size_t len, int timeoutMs)
+        {
+            struct timeval timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+            ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+            while (len > 0)
+            {
+                ssize_t n = ::read(fd_, data, len);
+                if (n <= 0)
+                {
+                    eof_ = n == 0;
+                    return false;
+                }
+                data += n;
+                len -= n;
+            }
+            return true;
+        }
+
+        int fd_;
+        bool connected_;
+        bool eof_;
+        HpackEncoder encoder_;
+    };
+
+    bool hasFrame(const std::vector<Frame> &frames, uint8_t type, uint32_t streamId)
+    {
+        for (const Frame &frame : frames)
+        {
+            if (frame.type == type && frame.streamId == streamId)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 读到流上带END_STREAM的DATA为止，返回拼起来的body
+    std::string readBody(Client *client, uint32_t streamId, std::vector<Frame> *skipped = nullptr)
+    {
+        std::string body;
+        Frame frame;
+        while (client->readUntil(Http2Connection::kData, &frame, skipped))
+        {
+            if (frame.streamId == streamId)
+            {
+                body.append(frame.payload);
+                if (frame.flags & kEndStream)
+                {
+                    break;
+                }
+            }
+        }
+        return body;
+    }
+
+    // 握手：发前言和SETTINGS，读到服务器的SETTINGS和对我方SETTINGS的ACK，回ACK
+    bool handshake(Client *client, const std::string &settings, Frame *serverSettings, std::vector<Frame> *skipped)
+    {
+        client->sendPreface(settings);
+        if (!client->readFrame(serverSettings, 2000) || serverSettings->type != Http2Connection::kSettings)
+        {
+            return false;
+        }
+        Frame frame;
+        while (client->readUntil(Http2Connection::kSettings, &frame, skipped))
+        {
+            if (frame.flags & kAck)
+            {
+                client->sendFrame(Http2Connection::kSettings, kAck, 0, std::string());
+                return frame.payload.empty();
+            }
+        }
+        return false;
+    }
+
+    // 把连接级的WINDOW_UPDATE加起来
+    int64_t connectionIncrements(const std::vector<Frame> &frames)
+    {
+        int64_t total = 0;
+        for (const Frame &frame : frames)
+        {
+            if (frame.type == Http2Connection::kWindowUpdate && frame.streamId == 0)
+            {
+                total += readUint32(frame.payload.data()) & 0x7fffffff;
+            }
+        }
+        return total;
+    }
+} // namespace
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+
+    // 回调都在IO线程里执行
+    AsyncResponsePtr streamResponse;
+    bool streamNotified = false;
+    AsyncResponsePtr held;
+    bool drained = false;
+    HttpServer server(&loop, InetAddress(0), "h2");
+    server.enableHttp2();
+    server.setAsyncHttpCallback([&](const AsyncResponsePtr &response) {
+        const std::string &path = response->request().path();
+        HttpResponse *resp = response->response();
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        if (path == "/stream")
+        {
+            streamResponse = response;
+            response->setWritableCallback([&streamNotified]() { streamNotified = true; });
+            response->beginStream();
+            response->write(std::string(64, 's'));
+            return;
+        }
+        if (path == "/hold")
+        {
+            held = response;
+            return;
+        }
+        resp->setBody(path == "/upload" ? std::to_string(response->request().body().size()) : std::string(100, 'x'));
+        response->done();
+    });
+    server.start();
+    uint16_t port = Socket::localAddress(server.listenFd()).toPort();
+
+    std::thread client([&]() {
+        // 1. 连接前言、双方的SETTINGS和ACK。流的初始发送窗口只给16字节
+        Client c1(port);
+        CHECK(c1.connected());
+        Frame serverSettings;
+        std::vector<Frame> skipped;
+        CHECK(handshake(&c1, setting(0x4, 16), &serverSettings, &skipped));
+        CHECK(serverSettings.flags == 0 && serverSettings.streamId == 0);
+        CHECK(serverSettings.payload.find(setting(0x3, 128)) != std::string::npos);
+        CHECK(serverSettings.payload.find(setting(0x4, 1024 * 1024)) != std::string::npos);
+        CHECK(connectionIncrements(skipped) == 1024 * 1024 - 65535);
+
+        // 2. 发送窗口用完后停下，WINDOW_UPDATE之后发完剩下的DATA
+        c1.sendRequest(1, "GET", "/hello", true);
+        Frame frame;
+        skipped.clear();
+        CHECK(c1.readUntil(Http2Connection::kData, &frame, &skipped));
+        CHECK(hasFrame(skipped, Http2Connection::kHeaders, 1));
+        CHECK(frame.streamId == 1 && frame.payload == std::string(16, 'x') && (frame.flags & kEndStream) == 0);
+        skipped.clear();
+        CHECK(c1.roundTrip(&skipped));
+        CHECK(!hasFrame(skipped, Http2Connection::kData, 1));
+        c1.sendWindowUpdate(1, 84);
+        CHECK(readBody(&c1, 1) == std::string(84, 'x'));
+
+        // 3. 流式响应被窗口挡住时客户端RST_STREAM，生产者收到通知，之后不再发这个流
+        c1.sendRequest(3, "GET", "/stream", true);
+        CHECK(c1.readUntil(Http2Connection::kData, &frame, nullptr));
+        CHECK(frame.streamId == 3 && frame.payload == std::string(16, 's'));
+        c1.sendFrame(Http2Connection::kRstStream, 0, 3, uint32Bytes(Http2Connection::kCancel));
+        c1.sendWindowUpdate(3, 1000);
+        skipped.clear();
+        CHECK(c1.roundTrip(&skipped));
+        CHECK(!hasFrame(skipped, Http2Connection::kData, 3));
+        CHECK(!hasFrame(skipped, Http2Connection::kRstStream, 3));
+
+        // 4. HEADERS没有END_HEADERS，后面不是CONTINUATION：GOAWAY(PROTOCOL_ERROR)后关闭
+        {
+            Client c2(port);
+            CHECK(handshake(&c2, std::string(), &serverSettings, nullptr));
+            c2.sendFrame(Http2Connection::kHeaders, kEndStream, 1, c2.headerBlock("GET", "/hello"));
+            c2.sendFrame(Http2Connection::kPing, 0, 0, std::string(8, 'p'));
+            CHECK(c2.readUntil(Http2Connection::kGoAway, &frame, &skipped));
+            CHECK(frame.payload.size() == 8 && readUint32(frame.payload.data() + 4) == Http2Connection::kProtocolError);
+            CHECK(!c2.readFrame(&frame, 2000) && c2.eof());
+        }
+
+        // 5. 两个流的请求体都不结束：缓存超过预算后不再归还连接窗口，一个流交给回调后再还
+        {
+            Client c3(port);
+            skipped.clear();
+            CHECK(handshake(&c3, std::string(), &serverSettings, &skipped));
+            int64_t connWindow = 65535 + connectionIncrements(skipped);
+            int64_t streamWindow[2] = {1024 * 1024, 1024 * 1024};
+            const uint32_t ids[2] = {1, 3};
+            c3.sendRequest(1, "POST", "/upload", false);
+            c3.sendRequest(3, "POST", "/upload", false);
+            const std::string chunk(kFrameSize, 'u');
+            int64_t sent = 0;
+            int64_t sentOn1 = 0;
+            bool stalled = false;
+            for (int turn = 0; !stalled && sent < 20 * 1024 * 1024; turn ^= 1)
+            {
+                if (connWindow >= static_cast<int64_t>(kFrameSize) && streamWindow[turn] >= static_cast<int64_t>(kFrameSize))
+                {
+                    c3.sendFrame(Http2Connection::kData, 0, ids[turn], chunk);
+                    connWindow -= kFrameSize;
+                    streamWindow[turn] -= kFrameSize;
+                    sent += kFrameSize;
+                    sentOn1 += turn == 0 ? kFrameSize : 0;
+                    continue;
+                }
+                // 窗口不够时等WINDOW_UPDATE，等不到就是被挡住了
+                if (!c3.readFrame(&frame, 500))
+                {
+                    stalled = true;
+                }
+                else if (frame.type == Http2Connection::kWindowUpdate)
+                {
+                    int64_t increment = readUint32(frame.payload.data()) & 0x7fffffff;
+                    (frame.streamId == 0 ? connWindow : streamWindow[frame.streamId == 1 ? 0 : 1]) += increment;
+                }
+                turn ^= 1; // 重试同一个流
+            }
+            CHECK(stalled);
+            CHECK(sent >= 16 * 1024 * 1024 && sent <= 17 * 1024 * 1024 + static_cast<int64_t>(kFrameSize));
+            CHECK(!c3.eof());
+
+            // 结束流1，请求体交给回调，腾出的预算把欠下的窗口还回来
+            c3.sendFrame(Http2Connection::kData, kEndStream, 1, std::string());
+            skipped.clear();
+            CHECK(readBody(&c3, 1, &skipped) == std::to_string(sentOn1));
+            CHECK(c3.roundTrip(&skipped));
+            CHECK(connectionIncrements(skipped) > 0);
+        }
+
+        // 6. GOAWAY：带上最后处理的流ID，之后的新流不处理，在途的流发完响应后关闭连接
+        c1.sendRequest(5, "GET", "/hold", true);
+        CHECK(c1.roundTrip(nullptr));
+        // 所有连接都关闭后退出loop
+        server.drain(5.0, [&]() {
+            drained = true;
+            loop.quit();
+        });
+        CHECK(c1.readUntil(Http2Connection::kGoAway, &frame, nullptr));
+        CHECK(frame.payload.size() == 8 && readUint32(frame.payload.data()) == 5 &&
+              readUint32(frame.payload.data() + 4) == Http2Connection::kNoError);
+        c1.sendRequest(7, "GET", "/hello", true);
+        CHECK(c1.roundTrip(&skipped));
+        loop.runInLoop([&held]() {
+            if (held)
+            {
+                held->response()->setBody("held");
+                held->done();
+            }
+        });
+        skipped.clear();
+        CHECK(readBody(&c1, 5, &skipped) == "held");
+        while (c1.readFrame(&frame, 2000))
+        {
+            skipped.push_back(frame);
+        }
+        CHECK(c1.eof());
+        CHECK(!hasFrame(skipped, Http2Connection::kHeaders, 7));
+    });
+    loop.loop();
+    client.join();
+
+    CHECK(drained);
+    CHECK(streamNotified);
+    CHECK(streamResponse && !streamResponse->write("more"));
+    return testResult();
+}
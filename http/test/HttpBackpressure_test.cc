@@ -0,0 +1,160 @@
+// HttpServer背压的自测：客户端一次发出很多流水线请求，先不读响应，服务端积压超过高水位后要停止读
+// (连接不再关注EPOLLIN，http_read_pauses_total加一，剩下的请求留在输入缓冲区)；客户端再把响应读完，
+// 每个请求都按顺序得到回复
+#include "http/HttpServer.h"
+#include "http/AsyncResponse.h"
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Metrics.h>
+#include <mymuduo/Logger.h>
+
+#include <future>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+using namespace mymuduo;
+
+namespace
+{
+    const int kRequests = 200;
+    const size_t kBodySize = 64 * 1024;
+
+    std::string requestPath(int i)
+    {
+        return "/r/" + std::to_string(i);
+    }
+
+    // 依次取出一个响应的body，没有Content-Length的(Connection: close)读到结尾。格式不对时返回false
+    bool nextBody(const std::string &data, size_t *pos, std::string *body)
+    {
+        size_t end = data.find("\r\n\r\n", *pos);
+        if (end == std::string::npos)
+        {
+            return false;
+        }
+        size_t field = data.find("Content-Length: ", *pos);
+        if (field == std::string::npos || field > end)
+        {
+            body->assign(data, end + 4, std::string::npos);
+            *pos = data.size();
+            return true;
+        }
+        size_t length = static_cast<size_t>(::strtoul(data.c_str() + field + 16, nullptr, 10));
+        if (end + 4 + length > data.size())
+        {
+            return false;
+        }
+        body->assign(data, end + 4, length);
+        *pos = end + 4 + length;
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+    Counter *readPauses = MetricsRegistry::instance().counter("http_read_pauses_total", "");
+    const int64_t pausesBefore = readPauses->value();
+
+    // 回调在IO线程里执行，记下服务端的连接，之后在loop里检查它的读状态
+    TcpConnectionPtr serverConn;
+    HttpServer server(&loop, InetAddress(0), "backpressure");
+    server.setHighWaterMark(16 * 1024);
+    server.setAsyncHttpCallback([&serverConn](const AsyncResponsePtr &response) {
+        if (!serverConn)
+        {
+            serverConn = response->connection();
+        }
+        HttpResponse *resp = response->response();
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setBody(response->request().path() + std::string(kBodySize, '.'));
+        response->done();
+    });
+    server.start();
+    const uint16_t port = Socket::localAddress(server.listenFd()).toPort();
+
+    bool paused = false;
+    size_t unreadRequests = 0;
+    int64_t pausesDuring = 0;
+    std::string responses;
+    std::thread client([&]() {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        // 接收缓冲区设小，服务端很快就写不进内核
+        int rcvbuf = 16 * 1024;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+        struct timeval timeout = {5, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0)
+        {
+            std::string requests;
+            for (int i = 0; i < kRequests; ++i)
+            {
+                requests += "GET " + requestPath(i) + " HTTP/1.1\r\nHost: test\r\n";
+                requests += i + 1 == kRequests ? "Connection: close\r\n\r\n" : "\r\n";
+            }
+            ::write(fd, requests.data(), requests.size());
+
+            // 不读，等服务端把内核缓冲区写满
+            ::usleep(300 * 1000);
+            std::promise<void> checked;
+            loop.runInLoop([&]() {
+                if (serverConn)
+                {
+                    paused = !serverConn->isReading();
+                    unreadRequests = serverConn->inputBuffer()->readableBytes();
+                }
+                pausesDuring = readPauses->value();
+                checked.set_value();
+            });
+            checked.get_future().wait();
+
+            char buf[64 * 1024];
+            ssize_t n = 0;
+            while ((n = ::read(fd, buf, sizeof buf)) > 0)
+            {
+                responses.append(buf, n);
+            }
+        }
+        ::close(fd);
+        loop.runInLoop([&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+
+    CHECK(paused);
+    CHECK(unreadRequests > 0);
+    CHECK(pausesDuring > pausesBefore);
+
+    // 写空之后恢复读，剩下的流水线请求按顺序处理完
+    size_t pos = 0;
+    int answered = 0;
+    std::string body;
+    while (nextBody(responses, &pos, &body))
+    {
+        CHECK(body == requestPath(answered) + std::string(kBodySize, '.'));
+        ++answered;
+    }
+    CHECK(answered == kRequests);
+    CHECK(pos == responses.size());
+    return testResult();
+}
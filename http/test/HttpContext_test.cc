@@ -0,0 +1,159 @@
+// HttpContext的自测：头部解析、头部个数上限，以及同一个连接上反复解析请求时稳态下不再分配内存
+#include "http/HttpContext.h"
+#include "http/HttpResponse.h"
+
+#include <mymuduo/Buffer.h>
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "TestCheck.h"
+
+using namespace http;
+using namespace mymuduo;
+
+size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+const char kRequest[] =
+    "POST /api/items?id=42 HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent: test-client/1.0 with a fairly long product string\r\n"
+    "Accept: application/json, text/plain, */*\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 27\r\n"
+    "\r\n"
+    "{\"name\":\"widget\",\"qty\":100}";
+
+void testParse()
+{
+    HttpContext context;
+    Buffer buf;
+    const char request[] = "GET /index.html HTTP/1.1\r\n"
+                           "Host:  example.com  \r\n"
+                           "X-Dup: first\r\n"
+                           "Accept: */*\r\n"
+                           "X-Dup: second\r\n"
+                           "\r\n";
+    buf.append(request, sizeof request - 1);
+    CHECK(context.parseRequest(&buf, Timestamp::now()));
+    CHECK(context.gotAll());
+    const HttpRequest &req = context.request();
+    CHECK(req.method() == HttpRequest::kGet);
+    CHECK(req.path() == "/index.html");
+    CHECK(req.getHeader("Host") == "example.com");
+    // 同名字段以后一个为准，位置不变
+    CHECK(req.getHeader("X-Dup") == "second");
+    CHECK(req.headers().size() == 3);
+    CHECK(req.headers().begin()->first == "Host");
+    CHECK((req.headers().begin() + 1)->first == "X-Dup");
+    CHECK(req.getHeader("host").empty());
+    CHECK(req.getHeader(std::string("Accept")) == "*/*");
+    CHECK(req.headers().count("Missing") == 0);
+
+    context.reset();
+    CHECK(context.request().headers().empty());
+    CHECK(context.request().path().empty());
+    CHECK(context.request().method() == HttpRequest::kInvalid);
+    CHECK(context.request().getHeader("Host").empty());
+}
+
+void testTooManyHeaders()
+{
+    HttpContext context;
+    Buffer buf;
+    buf.append("GET / HTTP/1.1\r\n");
+    for (size_t i = 0; i <= HttpContext::kMaxHeaders; ++i)
+    {
+        buf.append("X-Header-" + std::to_string(i) + ": v\r\n");
+    }
+    buf.append("\r\n");
+    CHECK(!context.parseRequest(&buf, Timestamp::now()));
+}
+
+void testLargeBodyReleased()
+{
+    HttpContext context;
+    Buffer buf;
+    std::string body(100 * 1024, 'x');
+    buf.append("POST /upload HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n");
+    buf.append(body);
+    CHECK(context.parseRequest(&buf, Timestamp::now()));
+    CHECK(context.gotAll() && context.request().body() == body);
+    context.reset();
+    CHECK(context.request().body().capacity() < body.size());
+
+    HttpResponse *response = context.response(false);
+    response->setBody(body);
+    response = context.response(true);
+    CHECK(response->body().empty() && response->body().capacity() < body.size());
+    CHECK(response->closeConnection() && response->statusCode() == HttpResponse::kUnknown);
+}
+
+// HttpServer的异步路径把请求swap进AsyncResponse，复用的AsyncResponse再把它上一个请求换回来，
+// 两份请求的内存在连接上来回使用
+void testSteadyStateAllocations()
+{
+    HttpContext context;
+    HttpRequest spare;
+    Buffer buf;
+    size_t steady = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        if (i == 10)
+        {
+            steady = allocations;
+        }
+        buf.append(kRequest, sizeof kRequest - 1);
+        bool ok = context.parseRequest(&buf, Timestamp::now());
+        CHECK(ok && context.gotAll());
+        CHECK(context.request().getHeader("Content-Type") == "application/json");
+        CHECK(context.request().body().size() == 27);
+        CHECK(context.request().query() == "?id=42");
+
+        // 同步路径：复用连接上的响应
+        HttpResponse *response = context.response(false);
+        response->setStatusCode(HttpResponse::k200Ok);
+        response->setStatusMessage("OK");
+        response->setBody(context.request().body());
+
+        spare.swap(context.request());
+        spare.clear();
+        context.reset();
+    }
+    printf("allocations per request after warmup: %zu\n", (allocations - steady) / 90);
+    CHECK(allocations == steady);
+}
+
+int main()
+{
+    testParse();
+    testTooManyHeaders();
+    testLargeBodyReleased();
+    testSteadyStateAllocations();
+    return testResult();
+}
@@ -0,0 +1,225 @@
+// HttpProxy的自测：本进程起几个假的上游和几个代理，客户端线程用阻塞socket访问代理，
+// 检查三种body分帧的转发、连接失败换上游重试、被动健康检查摘除，以及502/503/504
+#include "http/HttpServer.h"
+#include "http/HttpProxy.h"
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Logger.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+using namespace mymuduo;
+
+namespace
+{
+    // 按请求路径给出不同分帧方式的响应，/slow不回复
+    void onFramingMessage(const TcpConnectionPtr &conn, Buffer *buf, std::string *lastRequest)
+    {
+        while (true)
+        {
+            const char *end = static_cast<const char *>(::memmem(buf->peek(), buf->readableBytes(), "\r\n\r\n", 4));
+            if (end == nullptr)
+            {
+                return;
+            }
+            std::string head(buf->peek(), end + 4);
+            buf->retrieveUntil(end + 4);
+            *lastRequest = head;
+            if (head.compare(0, 12, "GET /length ") == 0)
+            {
+                conn->send("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello");
+            }
+            else if (head.compare(0, 13, "GET /chunked ") == 0)
+            {
+                conn->send("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                           "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n");
+            }
+            else if (head.compare(0, 11, "GET /close ") == 0)
+            {
+                conn->send("HTTP/1.1 200 OK\r\n\r\nhello until close");
+                conn->shutdown();
+                return;
+            }
+        }
+    }
+
+    // 一个Connection: close的GET，读到代理关闭连接为止，返回整个响应
+    std::string fetch(uint16_t port, const char *path)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct timeval timeout = {5, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        std::string response;
+        if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0)
+        {
+            std::string request = std::string("GET ") + path + " HTTP/1.1\r\nHost: test\r\nConnection: close\r\n\r\n";
+            ::write(fd, request.data(), request.size());
+            char buf[4096];
+            ssize_t n = 0;
+            while ((n = ::read(fd, buf, sizeof buf)) > 0)
+            {
+                response.append(buf, n);
+            }
+        }
+        ::close(fd);
+        return response;
+    }
+
+    bool startsWith(const std::string &s, const char *prefix)
+    {
+        return s.compare(0, ::strlen(prefix), prefix) == 0;
+    }
+
+    bool endsWith(const std::string &s, const char *suffix)
+    {
+        size_t len = ::strlen(suffix);
+        return s.size() >= len && s.compare(s.size() - len, len, suffix) == 0;
+    }
+
+    uint16_t portOf(int listenFd)
+    {
+        return Socket::localAddress(listenFd).toPort();
+    }
+
+    struct Proxy
+    {
+        Proxy(EventLoop *loop, const std::vector<InetAddress> &upstreams, int maxFails, double timeout)
+            : server(loop, InetAddress(0), "proxy"),
+              proxy(&server, upstreams)
+        {
+            proxy.setHealthCheck(maxFails, 60.0);
+            proxy.setUpstreamTimeout(timeout);
+            server.setAsyncHttpCallback(std::bind(&HttpProxy::handle, &proxy, std::placeholders::_1));
+            server.start();
+        }
+
+        uint16_t port() const { return portOf(server.listenFd()); }
+
+        HttpServer server;
+        HttpProxy proxy; // 在server之后构造，先于server析构
+    };
+} // namespace
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+
+    std::string lastRequest;
+    TcpServer framing(&loop, InetAddress(0), "framing");
+    framing.setConnectionCallback([](const TcpConnectionPtr &) {});
+    framing.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        onFramingMessage(conn, buf, &lastRequest);
+    });
+    framing.start();
+
+    // 对什么请求都回复非法的响应头
+    int garbageRequests = 0;
+    TcpServer garbage(&loop, InetAddress(0), "garbage");
+    garbage.setConnectionCallback([](const TcpConnectionPtr &) {});
+    garbage.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        buf->retrieveAll();
+        ++garbageRequests;
+        conn->send("garbage\r\n\r\n");
+    });
+    garbage.start();
+
+    // 绑定一个端口再关掉，连过去会被拒绝
+    int refusedFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    InetAddress any(0);
+    ::bind(refusedFd, reinterpret_cast<const struct sockaddr *>(any.getSockAddr()), sizeof(struct sockaddr_in));
+    uint16_t refusedPort = portOf(refusedFd);
+    ::close(refusedFd);
+
+    InetAddress framingAddr(portOf(framing.listenFd()));
+    InetAddress garbageAddr(portOf(garbage.listenFd()));
+    InetAddress refusedAddr(refusedPort);
+
+    Proxy direct(&loop, {framingAddr}, 3, 1.0);
+    Proxy retry(&loop, {refusedAddr, framingAddr}, 1, 30.0);
+    Proxy markDown(&loop, {garbageAddr, framingAddr}, 1, 30.0);
+    Proxy badGateway(&loop, {garbageAddr}, 100, 30.0);
+    Proxy unavailable(&loop, {refusedAddr}, 1, 30.0);
+
+    std::vector<std::string> results;
+    int garbageAfterMarkDown = -1;
+    std::thread client([&]() {
+        results.push_back(fetch(direct.port(), "/length"));
+        results.push_back(fetch(direct.port(), "/chunked"));
+        results.push_back(fetch(direct.port(), "/close"));
+        results.push_back(fetch(direct.port(), "/slow"));
+        results.push_back(fetch(retry.port(), "/length"));
+        for (int i = 0; i < 3; ++i)
+        {
+            results.push_back(fetch(markDown.port(), "/length"));
+        }
+        loop.runInLoop([&]() { garbageAfterMarkDown = garbageRequests; });
+        results.push_back(fetch(badGateway.port(), "/length"));
+        results.push_back(fetch(unavailable.port(), "/length"));
+        loop.runInLoop([&]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+
+    CHECK(results.size() == 10);
+    if (results.size() == 10)
+    {
+        // 1. Content-Length、chunked和读到关闭为止的body都完整转发
+        CHECK(startsWith(results[0], "HTTP/1.1 200 OK\r\n"));
+        CHECK(endsWith(results[0], "\r\n\r\nhello"));
+        CHECK(results[0].find("Content-Length: 5\r\n") != std::string::npos);
+        CHECK(startsWith(results[1], "HTTP/1.1 200 OK\r\n"));
+        CHECK(results[1].find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+        CHECK(endsWith(results[1], "\r\n\r\n5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"));
+        CHECK(startsWith(results[2], "HTTP/1.1 200 OK\r\n"));
+        CHECK(results[2].find("Connection: close\r\n") != std::string::npos);
+        CHECK(endsWith(results[2], "\r\n\r\nhello until close"));
+
+        // 2. 上游不回复，超时后504
+        CHECK(startsWith(results[3], "HTTP/1.1 504 "));
+
+        // 3. 第一个上游连不上，换下一个
+        CHECK(startsWith(results[4], "HTTP/1.1 200 OK\r\n") && endsWith(results[4], "hello"));
+
+        // 4. 响应非法的上游失败一次就被摘除：三个请求都成功，它只收到第一个
+        for (int i = 5; i < 8; ++i)
+        {
+            CHECK(startsWith(results[i], "HTTP/1.1 200 OK\r\n") && endsWith(results[i], "hello"));
+        }
+        CHECK(garbageAfterMarkDown == 1);
+
+        // 5. 唯一的上游两次都回复非法响应头时502，唯一的上游连不上被摘除后503
+        CHECK(startsWith(results[8], "HTTP/1.1 502 "));
+        CHECK(garbageRequests == 3);
+        CHECK(startsWith(results[9], "HTTP/1.1 503 "));
+    }
+
+    // 转发给上游的请求去掉了逐跳头部，带上了X-Forwarded-For
+    CHECK(lastRequest.find("Host: test\r\n") != std::string::npos);
+    CHECK(lastRequest.find("X-Forwarded-For: 127.0.0.1\r\n") != std::string::npos);
+    CHECK(lastRequest.find("Connection") == std::string::npos);
+    return testResult();
+}
@@ -0,0 +1,43 @@
+#include "http/HttpServer.h"
+#include "http/HttpProxy.h"
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace mymuduo;
+using namespace http;
+
+// ./testproxy <port> <numThreads> <ip:port>... 反向代理到一组上游，例如testhttp
+int main(int argc, char* argv[])
+{
+  if (argc < 4)
+  {
+    fprintf(stderr, "usage: %s <port> <numThreads> <ip:port>...\n", argv[0]);
+    return 1;
+  }
+  Logger::setLogLevel(Logger::ERROR);
+  std::vector<InetAddress> upstreams;
+  for (int i = 3; i < argc; ++i)
+  {
+    const char* colon = strchr(argv[i], ':');
+    if (colon == nullptr)
+    {
+      fprintf(stderr, "bad upstream %s\n", argv[i]);
+      return 1;
+    }
+    upstreams.push_back(InetAddress(static_cast<uint16_t>(atoi(colon + 1)), std::string(argv[i], colon - argv[i])));
+  }
+
+  EventLoop loop;
+  HttpServer server(&loop, InetAddress(static_cast<uint16_t>(atoi(argv[1]))), "proxy");
+  // proxy在server之后构造，先于server析构
+  HttpProxy proxy(&server, upstreams);
+  proxy.setBalance(HttpProxy::kLeastOutstanding);
+  server.setAsyncHttpCallback(std::bind(&HttpProxy::handle, &proxy, std::placeholders::_1));
+  server.setThreadNum(atoi(argv[2]));
+  server.enableMetrics();
+  server.start();
+  loop.loop();
+}
@@ -0,0 +1,149 @@
+// HttpResponse的自测：序列化的报文逐字节核对，复用的响应在稳态下构造和序列化都不分配内存
+#include "http/HttpResponse.h"
+
+#include <mymuduo/Buffer.h>
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "TestCheck.h"
+
+using namespace http;
+using namespace mymuduo;
+
+size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = ::malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+std::string serialize(const HttpResponse &resp)
+{
+    Buffer buf;
+    resp.appendToBuffer(&buf);
+    return buf.retrieveAllAsString();
+}
+
+void fillHello(HttpResponse *resp)
+{
+    resp->setStatusCode(HttpResponse::k200Ok);
+    resp->setStatusMessage("OK");
+    resp->setContentType("text/plain");
+    resp->addHeader("Server", "Muduo");
+    resp->setBody("hello, world!\n");
+}
+
+void testSerialize()
+{
+    HttpResponse resp(false);
+    fillHello(&resp);
+    CHECK(serialize(resp) == "HTTP/1.1 200 OK\r\n"
+                             "Content-Length: 14\r\n"
+                             "Connection: Keep-Alive\r\n"
+                             "Content-Type: text/plain\r\n"
+                             "Server: Muduo\r\n"
+                             "\r\n"
+                             "hello, world!\n");
+
+    // 同名头部覆盖原来的值，位置不变；非标准的状态短语照原样发出
+    resp.setContentType("text/html");
+    resp.setStatusMessage("Fine");
+    resp.setCloseConnection(true);
+    CHECK(serialize(resp) == "HTTP/1.1 200 Fine\r\n"
+                             "Connection: close\r\n"
+                             "Content-Type: text/html\r\n"
+                             "Server: Muduo\r\n"
+                             "\r\n"
+                             "hello, world!\n");
+    CHECK(resp.getHeader("Content-Type") == "text/html");
+    CHECK(resp.getHeader("Missing").empty());
+    CHECK(resp.headers().size() == 2);
+
+    HttpResponse notFound(true);
+    notFound.setStatusCode(HttpResponse::k404NotFound);
+    notFound.setStatusMessage("Not Found");
+    CHECK(serialize(notFound) == "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n");
+
+    HttpResponse custom(false);
+    custom.setStatusCode(static_cast<HttpResponse::HttpStatusCode>(418));
+    custom.setStatusMessage("I'm a teapot");
+    custom.addHeader("Vary", "Accept-Encoding");
+    // value指向容器自己的头部，扩容时也不能失效
+    for (int i = 0; i < 20; ++i)
+    {
+        custom.addHeader("X-Copy-" + std::to_string(i), custom.getHeader("Vary"));
+    }
+    std::string out = serialize(custom);
+    CHECK(out.compare(0, 27, "HTTP/1.1 418 I'm a teapot\r\n") == 0);
+    CHECK(out.find("X-Copy-19: Accept-Encoding\r\n") != std::string::npos);
+    CHECK(out.size() > 4 && out.compare(out.size() - 4, 4, "\r\n\r\n") == 0);
+}
+
+void testStreamHead()
+{
+    HttpResponse resp(false);
+    resp.setStatusCode(HttpResponse::k200Ok);
+    resp.setStatusMessage("OK");
+    resp.setContentType("text/plain");
+    Buffer buf;
+    resp.appendStreamHeadToBuffer(&buf, true);
+    CHECK(buf.retrieveAllAsString() == "HTTP/1.1 200 OK\r\n"
+                                       "Transfer-Encoding: chunked\r\n"
+                                       "Connection: Keep-Alive\r\n"
+                                       "Content-Type: text/plain\r\n"
+                                       "\r\n");
+    resp.appendStreamHeadToBuffer(&buf, false);
+    CHECK(buf.retrieveAllAsString() == "HTTP/1.1 200 OK\r\n"
+                                       "Connection: close\r\n"
+                                       "Content-Type: text/plain\r\n"
+                                       "\r\n");
+}
+
+void testSteadyStateAllocations()
+{
+    HttpResponse resp(false);
+    fillHello(&resp);
+    const size_t length = serialize(resp).size();
+    Buffer buf;
+    size_t steady = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        if (i == 10)
+        {
+            steady = allocations;
+        }
+        resp.clear(false);
+        fillHello(&resp);
+        resp.appendToBuffer(&buf);
+        CHECK(buf.readableBytes() == length);
+        buf.retrieveAll();
+    }
+    CHECK(allocations == steady);
+}
+
+int main()
+{
+    testSerialize();
+    testStreamHead();
+    testSteadyStateAllocations();
+    return testResult();
+}
@@ -0,0 +1,108 @@
+// HttpRouter的自测：静态段、参数、通配、回溯、405和404
+#include "http/HttpRouter.h"
+
+#include <stdio.h>
+
+#include "TestCheck.h"
+
+using namespace mymuduo;
+using namespace http;
+
+std::string lastRoute;
+
+HttpRouter::Handler named(const std::string &name)
+{
+    return [name](const HttpRequest &, const RouteParams &, HttpResponse *) { lastRoute = name; };
+}
+
+// 返回匹配到的路由名，没有匹配时为空；405时为"405"
+// params指向路径，路径要存到下一次调用之前
+std::string currentPath;
+
+std::string route(const HttpRouter &router, HttpRequest::Method method, const char *path, RouteParams *params)
+{
+    currentPath = path;
+    bool methodNotAllowed = false;
+    const HttpRouter::Handler *handler = router.find(method, currentPath, params, &methodNotAllowed);
+    if (handler == nullptr)
+    {
+        return methodNotAllowed ? "405" : "";
+    }
+    lastRoute.clear();
+    (*handler)(HttpRequest(), *params, nullptr);
+    return lastRoute;
+}
+
+int main()
+{
+    HttpRouter router;
+    router.get("/", named("root"));
+    router.get("/hello", named("hello"));
+    router.get("/help", named("help"));
+    router.get("/users/new", named("newUser"));
+    router.get("/users/:id", named("user"));
+    router.post("/users/:id", named("updateUser"));
+    router.get("/users/:id/posts/:post", named("post"));
+    router.get("/static/*file", named("static"));
+    router.get("/search", named("search"));
+    router.get("/s/:a/x", named("sx"));
+    router.get("/s/:a/:b", named("sab"));
+
+    RouteParams params;
+    CHECK(route(router, HttpRequest::kGet, "/", &params) == "root");
+    CHECK(route(router, HttpRequest::kGet, "/hello", &params) == "hello");
+    CHECK(route(router, HttpRequest::kGet, "/help", &params) == "help");
+    CHECK(route(router, HttpRequest::kGet, "/hel", &params) == "");
+    CHECK(route(router, HttpRequest::kGet, "/hello/", &params) == "");
+
+    CHECK(route(router, HttpRequest::kGet, "/users/new", &params) == "newUser");
+    CHECK(params.size() == 0);
+    CHECK(route(router, HttpRequest::kGet, "/users/42", &params) == "user");
+    CHECK(params.get("id") == "42");
+    // 静态段只匹配了一部分，回溯到参数
+    CHECK(route(router, HttpRequest::kGet, "/users/newton", &params) == "user");
+    CHECK(params.get("id") == "newton");
+    CHECK(route(router, HttpRequest::kGet, "/users/", &params) == "");
+    CHECK(route(router, HttpRequest::kPost, "/users/7", &params) == "updateUser");
+    CHECK(route(router, HttpRequest::kDelete, "/users/7", &params) == "405");
+    CHECK(route(router, HttpRequest::kHead, "/users/7", &params) == "user");
+    // 静态段只有GET，POST要回溯到参数分支，不能当成405
+    CHECK(route(router, HttpRequest::kPost, "/users/new", &params) == "updateUser");
+    CHECK(params.size() == 1 && params.get("id") == "new");
+    CHECK(route(router, HttpRequest::kHead, "/users/new", &params) == "newUser");
+    CHECK(params.size() == 0);
+    // 哪个分支都没有这个方法时才是405
+    CHECK(route(router, HttpRequest::kPut, "/users/new", &params) == "405");
+
+    CHECK(route(router, HttpRequest::kGet, "/users/42/posts/abc", &params) == "post");
+    CHECK(params.size() == 2);
+    CHECK(params.name(0) == "id" && params.value(0) == "42");
+    CHECK(params.name(1) == "post" && params.value(1) == "abc");
+
+    CHECK(route(router, HttpRequest::kGet, "/static/css/site.css", &params) == "static");
+    CHECK(params.get("file") == "css/site.css");
+    CHECK(route(router, HttpRequest::kGet, "/static/", &params) == "static");
+    CHECK(params.get("file").empty());
+
+    // 第二段的静态路由走不通时，参数要弹出再试下一个分支
+    CHECK(route(router, HttpRequest::kGet, "/s/1/x", &params) == "sx");
+    CHECK(params.size() == 1 && params.get("a") == "1");
+    CHECK(route(router, HttpRequest::kGet, "/s/1/y", &params) == "sab");
+    CHECK(params.size() == 2 && params.get("b") == "y");
+
+    CHECK(route(router, HttpRequest::kGet, "/search", &params) == "search");
+    CHECK(route(router, HttpRequest::kGet, "/nothing", &params) == "");
+
+    // dispatch：405带Allow，404用默认处理
+    HttpRequest req;
+    const char post[] = "POST";
+    req.setMethod(post, post + 4);
+    const char path[] = "/hello";
+    req.setPath(path, path + 6);
+    HttpResponse resp(false);
+    router.dispatch(req, &resp);
+    CHECK(resp.statusCode() == HttpResponse::k405MethodNotAllowed);
+    CHECK(resp.getHeader("Allow") == "GET");
+
+    return testResult();
+}
@@ -1,61 +1,137 @@
 #include "http/HttpServer.h"
 #include "http/HttpRequest.h"
 #include "http/HttpResponse.h"
+#include "http/AccessLog.h"
+#include "http/AsyncResponse.h"
+#include "http/HttpRouter.h"
+#include "http/ResponseCache.h"
+#include "http/Compression.h"
+#include "http/StaticFiles.h"
+#include "http/WebSocketServer.h"
 #include <mymuduo/EventLoop.h>
 #include <mymuduo/Logger.h>
+#include <mymuduo/ThreadPool.h>
+#include <mymuduo/ListenerHandoff.h>
+#include <mymuduo/TlsContext.h>
 
 #include <iostream>
-#include <map>
+#include <signal.h>
+#include <unistd.h>
 
 using namespace mymuduo;
 using namespace http;
 
 extern char favicon[555];
 bool benchmark = false;
+volatile sig_atomic_t stopRequested = 0;
 
-void onRequest(const HttpRequest& req, HttpResponse* resp)
+void onSignal(int)
+{
+  stopRequested = 1;
+}
+
+void printHeaders(const HttpRequest& req)
 {
   std::cout << "Headers " << req.methodString() << " " << req.path() << std::endl;
   if (!benchmark)
   {
-    const std::map<std::string, std::string>& headers = req.headers();
+    const HttpHeaders& headers = req.headers();
     for (const auto& header : headers)
     {
       std::cout << header.first << ": " << header.second << std::endl;
     }
   }
+}
 
-  if (req.path() == "/")
+void onIndex(const HttpRequest& req, const RouteParams&, HttpResponse* resp)
+{
+  printHeaders(req);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("text/html");
+  resp->addHeader("Server", "Muduo");
+  std::string now = Timestamp::now().tostring();
+  resp->setBody("<html><head><title>This is title</title></head>"
+      "<body><h1>Hello</h1>Now is " + now +
+      "</body></html>");
+}
+
+void onFavicon(const HttpRequest& req, const RouteParams&, HttpResponse* resp)
+{
+  printHeaders(req);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("image/png");
+  resp->setBody(std::string(favicon, sizeof favicon));
+}
+
+void onHello(const HttpRequest& req, const RouteParams& params, HttpResponse* resp)
+{
+  printHeaders(req);
+  resp->setStatusCode(HttpResponse::k200Ok);
+  resp->setStatusMessage("OK");
+  resp->setContentType("text/plain");
+  resp->addHeader("Server", "Muduo");
+  // /hello 和 /hello/:name 共用
+  StringPiece name = params.get("name");
+  resp->setBody("hello, " + (name.empty() ? std::string("world") : name.as_string()) + "!\n");
+  resp->setCacheTtl(5);
+}
+
+HttpRouter router;
+
+// /stream 边生成边发送：积压超过高水位时停下，输出缓冲区写空后由可写回调接着生成
+void produceLines(const AsyncResponsePtr& resp, const std::shared_ptr<int>& next)
+{
+  const int kLines = 200000;
+  std::string lines;
+  while (*next < kLines && resp->writable())
   {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/html");
-    resp->addHeader("Server", "Muduo");
-    std::string now = Timestamp::now().tostring();
-    resp->setBody("<html><head><title>This is title</title></head>"
-        "<body><h1>Hello</h1>Now is " + now +
-        "</body></html>");
+    lines.clear();
+    for (int i = 0; i < 100 && *next < kLines; ++i, ++*next)
+    {
+      lines += "line " + std::to_string(*next) + "\n";
+    }
+    if (!resp->write(lines))
+    {
+      return; // 客户端已经断开
+    }
+  }
+  if (*next == kLines)
+  {
+    ++*next;
+    resp->end();
   }
-  else if (req.path() == "/favicon.ico")
+}
+
+// /slow 模拟阻塞的处理函数，交给计算线程池执行，其余请求仍在IO线程里同步处理
+void onAsyncRequest(HttpServer* server, const AsyncResponsePtr& resp)
+{
+  if (resp->request().path() == "/slow")
   {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("image/png");
-    resp->setBody(std::string(favicon, sizeof favicon));
+    server->workerPool()->run([resp]() {
+      ::usleep(100 * 1000);
+      resp->response()->setStatusCode(HttpResponse::k200Ok);
+      resp->response()->setStatusMessage("OK");
+      resp->response()->setContentType("text/plain");
+      resp->response()->setBody("slow, world!\n");
+      resp->done();
+    });
   }
-  else if (req.path() == "/hello")
+  else if (resp->request().path() == "/stream")
   {
-    resp->setStatusCode(HttpResponse::k200Ok);
-    resp->setStatusMessage("OK");
-    resp->setContentType("text/plain");
-    resp->addHeader("Server", "Muduo");
-    resp->setBody("hello, world!\n");
+    resp->response()->setStatusCode(HttpResponse::k200Ok);
+    resp->response()->setStatusMessage("OK");
+    resp->response()->setContentType("text/plain");
+    std::shared_ptr<int> next(std::make_shared<int>(0));
+    resp->setWritableCallback([resp, next]() { produceLines(resp, next); });
+    resp->beginStream();
+    produceLines(resp, next);
   }
   else
   {
-    resp->setStatusCode(HttpResponse::k404NotFound);
-    resp->setStatusMessage("Not Found");
-    resp->setCloseConnection(true);
+    router.dispatch(resp->request(), resp->response());
+    resp->done();
   }
 }
 
@@ -68,11 +144,78 @@ int main(int argc, char* argv[])
     Logger::setLogLevel(Logger::FATAL);
     numThreads = atoi(argv[1]);
   }
+  router.get("/", onIndex);
+  router.get("/favicon.ico", onFavicon);
+  router.get("/hello", onHello);
+  router.get("/hello/:name", onHello);
+  // ./static 下的文件，有a.js.gz/a.js.br时直接返回压缩好的版本
+  StaticFiles files("./static");
+  files.setCacheTtl(10);
+  router.get("/static/*file", std::bind(&StaticFiles::handle, &files,
+      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
   EventLoop loop;
-  HttpServer server(&loop, InetAddress(8000), "dummy");
-  server.setHttpCallback(onRequest);
-  server.setThreadNum(numThreads);
-  server.start();
+  // 要比server活得久
+  ResponseCache cache;
+  ResponseCompressor compressor;
+  // /ws 聊天室：收到的消息广播给所有会话
+  WebSocketServer chat;
+  chat.setPingInterval(10);
+  chat.setMessageCallback([&chat](const WebSocketSessionPtr &, StringPiece message, bool binary) {
+    chat.broadcast(message, binary);
+  });
+  // 热重启：同一路径上有旧进程在运行时接管它的监听socket，旧进程随后drain退出
+  const std::string handoffPath = "/tmp/testhttp.handoff";
+  std::vector<int> listenFds = ListenerHandoff::receive(handoffPath);
+  std::unique_ptr<HttpServer> server(listenFds.empty()
+      ? new HttpServer(&loop, InetAddress(8000), "dummy")
+      : new HttpServer(&loop, listenFds[0], "dummy"));
+  server->setAsyncHttpCallback(std::bind(onAsyncRequest, server.get(), std::placeholders::_1));
+  server->setWorkerThreadNum(2);
+  server->setThreadNum(numThreads);
+  server->enableMetrics();
+  server->setResponseCache(&cache);
+  server->setCompressor(&compressor);
+  server->addWebSocket("/ws", &chat);
+  server->enableHttp2();
+  // ./testhttp <numThreads> <accessLogFile> 开启访问日志
+  std::unique_ptr<AccessLog> accessLog;
+  if (argc > 2)
+  {
+    accessLog.reset(new AccessLog(argv[2]));
+    accessLog->start();
+    server->setAccessLog(accessLog.get());
+  }
+  // ./testhttp <numThreads> <accessLogFile> <cert.pem> <key.pem> 改为HTTPS，ALPN优先h2
+  TlsContext tls;
+  if (argc > 4)
+  {
+    if (!tls.loadCertificate(argv[3], argv[4]))
+    {
+      return 1;
+    }
+    tls.setAlpnProtocols({"h2", "http/1.1"});
+    server->setTlsContext(&tls);
+  }
+  server->start();
+  // 收到SIGTERM/SIGINT后优雅退出：最多等5秒让在途请求完成
+  ::signal(SIGTERM, onSignal);
+  ::signal(SIGINT, onSignal);
+  bool draining = false;
+  loop.runEvery(0.1, [&]() {
+    if (stopRequested && !draining)
+    {
+      draining = true;
+      server->drain(5.0, [&loop]() { loop.quit(); });
+    }
+  });
+  // 新进程连上来取走监听socket后，本进程不再accept，处理完已有连接后退出
+  ListenerHandoff handoff(&loop, handoffPath);
+  handoff.serve({server->listenFd()}, [&]() {
+    draining = true;
+    server->detachListener();
+    server->drain(5.0, [&loop]() { loop.quit(); });
+  });
   loop.loop();
 }
 
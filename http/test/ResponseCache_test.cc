@@ -0,0 +1,214 @@
+// ResponseCache的自测：If-None-Match的弱比较和列表、两个条件头的优先级、TTL过期、Vary不在键里时不缓存，
+// 以及HttpServer发出的缓存响应在HEAD和Connection: close时的字节布局
+#include "http/ResponseCache.h"
+#include "http/HttpServer.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+using namespace mymuduo;
+
+namespace
+{
+    const char kLastModified[] = "Sun, 06 Nov 1994 08:49:37 GMT";
+
+    HttpRequest makeRequest(const char *method, const char *path)
+    {
+        HttpRequest req;
+        req.setMethod(method, method + ::strlen(method));
+        req.setPath(path, path + ::strlen(path));
+        req.setVersion(HttpRequest::kHttp11);
+        return req;
+    }
+
+    void fillPage(HttpResponse *resp, const char *etag, double ttl)
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setStatusMessage("OK");
+        resp->setContentType("text/plain");
+        resp->addHeader("ETag", etag);
+        resp->addHeader("Last-Modified", kLastModified);
+        resp->setBody("hello");
+        resp->setCacheTtl(ttl);
+    }
+
+    bool notModified(const CachedResponse &entry, const char *ifNoneMatch, const char *ifModifiedSince)
+    {
+        HttpRequest req(makeRequest("GET", "/page"));
+        if (ifNoneMatch)
+        {
+            req.setHeader("If-None-Match", ifNoneMatch);
+        }
+        if (ifModifiedSince)
+        {
+            req.setHeader("If-Modified-Since", ifModifiedSince);
+        }
+        return ResponseCache::notModified(req, entry);
+    }
+
+    // 把request原样写过去，读到服务端关闭连接为止
+    std::string exchange(uint16_t port, const std::string &request)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct timeval timeout = {5, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        std::string response;
+        if (::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0)
+        {
+            ::write(fd, request.data(), request.size());
+            char buf[4096];
+            ssize_t n = 0;
+            while ((n = ::read(fd, buf, sizeof buf)) > 0)
+            {
+                response.append(buf, n);
+            }
+        }
+        ::close(fd);
+        return response;
+    }
+
+    bool startsWith(const std::string &s, const char *prefix)
+    {
+        return s.compare(0, ::strlen(prefix), prefix) == 0;
+    }
+
+    bool endsWith(const std::string &s, const std::string &suffix)
+    {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+} // namespace
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+
+    {
+        ResponseCache cache;
+        cache.addVaryHeader("Accept-Encoding");
+        cache.initLoop(&loop);
+
+        HttpRequest get(makeRequest("GET", "/page"));
+        HttpResponse page(false);
+        fillPage(&page, "\"v1\"", 60);
+        CachedResponsePtr entry(cache.insert(&loop, get, page));
+        CHECK(entry);
+        if (entry)
+        {
+            // 1. If-None-Match：弱比较忽略W/，逗号分隔的列表里有一个匹配即可
+            CHECK(notModified(*entry, "\"v1\"", nullptr));
+            CHECK(notModified(*entry, "W/\"v1\"", nullptr));
+            CHECK(notModified(*entry, "\"x\", W/\"v1\"", nullptr));
+            CHECK(notModified(*entry, "*", nullptr));
+            CHECK(!notModified(*entry, "\"x\" , \"y\"", nullptr));
+            CHECK(!notModified(*entry, "\"v\"", nullptr));
+
+            // 2. 两个都有时以If-None-Match为准
+            CHECK(notModified(*entry, nullptr, kLastModified));
+            CHECK(!notModified(*entry, nullptr, "Sat, 05 Nov 1994 08:49:37 GMT"));
+            CHECK(!notModified(*entry, "\"x\"", kLastModified));
+            CHECK(notModified(*entry, "\"v1\"", "Sat, 05 Nov 1994 08:49:37 GMT"));
+
+            // 缓存的字节：Connection头部在末尾，HEAD只发到空行
+            const std::string keepAlive("Connection: Keep-Alive\r\n\r\n");
+            CHECK(startsWith(entry->bytes, "HTTP/1.1 200 OK\r\n"));
+            CHECK(entry->bytes.compare(entry->connectionOffset, keepAlive.size(), keepAlive) == 0);
+            CHECK(entry->headLength == entry->connectionOffset + keepAlive.size());
+            CHECK(entry->bytes.substr(entry->headLength) == "hello");
+            CHECK(entry->bytes.find("Content-Length: 5\r\n") < entry->connectionOffset);
+            CHECK(startsWith(entry->notModified, "HTTP/1.1 304 Not Modified\r\n"));
+            CHECK(cache.lookup(&loop, get) == entry);
+        }
+
+        // 响应自己的弱ETag和请求里的强ETag也匹配
+        HttpRequest weakGet(makeRequest("GET", "/weak"));
+        HttpResponse weak(false);
+        fillPage(&weak, "W/\"w\"", 60);
+        CachedResponsePtr weakEntry(cache.insert(&loop, weakGet, weak));
+        CHECK(weakEntry && notModified(*weakEntry, "\"w\"", nullptr));
+
+        // 3. TTL到了之后查不到
+        HttpRequest shortGet(makeRequest("GET", "/short"));
+        HttpResponse shortLived(false);
+        fillPage(&shortLived, "\"s\"", 0.05);
+        CHECK(cache.insert(&loop, shortGet, shortLived));
+        CHECK(cache.lookup(&loop, shortGet));
+        ::usleep(100 * 1000);
+        CHECK(!cache.lookup(&loop, shortGet));
+
+        // 4. Vary里的请求头不在键里时不缓存，在键里时缓存
+        HttpRequest varyGet(makeRequest("GET", "/vary"));
+        HttpResponse varyCookie(false);
+        fillPage(&varyCookie, "\"c\"", 60);
+        varyCookie.addHeader("Vary", "Accept-Encoding, Cookie");
+        CHECK(!cache.insert(&loop, varyGet, varyCookie));
+        CHECK(!cache.lookup(&loop, varyGet));
+        HttpResponse varyEncoding(false);
+        fillPage(&varyEncoding, "\"e\"", 60);
+        varyEncoding.addHeader("Vary", "accept-encoding");
+        CHECK(cache.insert(&loop, varyGet, varyEncoding));
+    } // cache在loop线程里析构，取消清理定时器
+
+    // 5. 经过HttpServer发出的缓存响应：短连接把Connection换成close，HEAD不带body
+    ResponseCache cache;
+    HttpServer server(&loop, InetAddress(0), "cache");
+    server.setThreadNum(1);
+    server.setResponseCache(&cache);
+    int calls = 0;
+    server.setHttpCallback([&calls](const HttpRequest &, HttpResponse *resp) {
+        ++calls;
+        fillPage(resp, "\"v1\"", 60);
+    });
+    server.start();
+    uint16_t port = Socket::localAddress(server.listenFd()).toPort();
+
+    std::string getClose;
+    std::string pipelined;
+    std::string conditional;
+    std::thread client([&]() {
+        getClose = exchange(port, "GET /page HTTP/1.1\r\nHost: t\r\nConnection: close\r\n\r\n");
+        pipelined = exchange(port, "GET /page HTTP/1.1\r\nHost: t\r\n\r\n"
+                                   "HEAD /page HTTP/1.1\r\nHost: t\r\nConnection: close\r\n\r\n");
+        conditional = exchange(port, "GET /page HTTP/1.1\r\nHost: t\r\nIf-None-Match: W/\"v1\"\r\nConnection: close\r\n\r\n");
+        loop.runInLoop([&]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+
+    CHECK(calls == 1);
+    CHECK(startsWith(getClose, "HTTP/1.1 200 OK\r\n"));
+    CHECK(endsWith(getClose, "\r\nConnection: close\r\n\r\nhello"));
+    CHECK(getClose.find("Keep-Alive") == std::string::npos);
+
+    // 长连接的命中就是缓存里的字节，除了Connection头部和短连接的响应一样
+    const std::string head(getClose.substr(0, getClose.size() - ::strlen("Connection: close\r\n\r\nhello")));
+    const std::string keepAlive(head + "Connection: Keep-Alive\r\n\r\nhello");
+    const std::string headClose(head + "Connection: close\r\n\r\n");
+    CHECK(pipelined == keepAlive + headClose);
+
+    CHECK(startsWith(conditional, "HTTP/1.1 304 Not Modified\r\n"));
+    CHECK(conditional.find("ETag: \"v1\"\r\n") != std::string::npos);
+    CHECK(endsWith(conditional, "\r\nConnection: close\r\n\r\n"));
+    return testResult();
+}
@@ -0,0 +1,130 @@
+// WebSocket编解码的自测：握手的accept key、帧头解析和编码、解掩码
+#include "http/WebSocketCodec.h"
+
+#include <mymuduo/Buffer.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TestCheck.h"
+
+using namespace http;
+
+// 客户端发出的帧：带掩码
+std::string maskedFrame(int opcode, const std::string &payload, const uint8_t mask[4], bool fin = true)
+{
+    std::string frame;
+    frame.push_back(static_cast<char>((fin ? 0x80 : 0) | opcode));
+    if (payload.size() < 126)
+    {
+        frame.push_back(static_cast<char>(0x80 | payload.size()));
+    }
+    else if (payload.size() <= 0xffff)
+    {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size() & 0xff));
+    }
+    else
+    {
+        frame.push_back(static_cast<char>(0x80 | 127));
+        for (int i = 7; i >= 0; --i)
+        {
+            frame.push_back(static_cast<char>((static_cast<uint64_t>(payload.size()) >> (8 * i)) & 0xff));
+        }
+    }
+    frame.append(reinterpret_cast<const char *>(mask), 4);
+    for (size_t i = 0; i < payload.size(); ++i)
+    {
+        frame.push_back(static_cast<char>(payload[i] ^ mask[i % 4]));
+    }
+    return frame;
+}
+
+int main()
+{
+    // RFC 6455 1.3的例子
+    CHECK(WebSocketCodec::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+
+    const uint8_t mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+    {
+        // RFC 6455 5.7：带掩码的"Hello"
+        const unsigned char hello[] = {0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58};
+        WebSocketCodec::FrameHeader header;
+        CHECK(WebSocketCodec::parseHeader(reinterpret_cast<const char *>(hello), sizeof hello, &header) == 1);
+        CHECK(header.fin && header.masked && header.opcode == WebSocketCodec::kText);
+        CHECK(header.payloadLength == 5 && header.headerLength == 6);
+        char payload[5];
+        memcpy(payload, hello + 6, 5);
+        WebSocketCodec::unmask(payload, 5, header.mask);
+        CHECK(memcmp(payload, "Hello", 5) == 0);
+        // 帧头不完整
+        CHECK(WebSocketCodec::parseHeader(reinterpret_cast<const char *>(hello), 5, &header) == 0);
+    }
+    {
+        // 三种长度编码
+        const size_t lengths[] = {0, 125, 126, 65535, 65536, 200000};
+        for (size_t len : lengths)
+        {
+            std::string payload(len, 'x');
+            std::string frame(maskedFrame(WebSocketCodec::kBinary, payload, mask));
+            WebSocketCodec::FrameHeader header;
+            CHECK(WebSocketCodec::parseHeader(frame.data(), frame.size(), &header) == 1);
+            CHECK(header.payloadLength == len && header.headerLength + len == frame.size());
+
+            mymuduo::Buffer out;
+            WebSocketCodec::appendFrame(&out, WebSocketCodec::kBinary, payload.data(), payload.size());
+            CHECK(WebSocketCodec::parseHeader(out.peek(), out.readableBytes(), &header) == 1);
+            CHECK(!header.masked && header.payloadLength == len && header.headerLength + len == out.readableBytes());
+            std::string str;
+            WebSocketCodec::appendFrame(&str, WebSocketCodec::kBinary, payload.data(), payload.size());
+            CHECK(str == out.retrieveAllAsString());
+        }
+    }
+    {
+        WebSocketCodec::FrameHeader header;
+        // RSV位
+        const unsigned char rsv[] = {0xc1, 0x80, 0, 0, 0, 0};
+        CHECK(WebSocketCodec::parseHeader(reinterpret_cast<const char *>(rsv), sizeof rsv, &header) == -1);
+        // 未知opcode
+        const unsigned char opcode[] = {0x83, 0x80, 0, 0, 0, 0};
+        CHECK(WebSocketCodec::parseHeader(reinterpret_cast<const char *>(opcode), sizeof opcode, &header) == -1);
+        // 分片的控制帧
+        std::string ping(maskedFrame(WebSocketCodec::kPing, "", mask, false));
+        CHECK(WebSocketCodec::parseHeader(ping.data(), ping.size(), &header) == -1);
+        // 过长的控制帧
+        std::string close(maskedFrame(WebSocketCodec::kClose, std::string(126, 'c'), mask));
+        CHECK(WebSocketCodec::parseHeader(close.data(), close.size(), &header) == -1);
+    }
+    {
+        // 各种长度和偏移下和逐字节异或的结果一致，覆盖向量化部分和尾部
+        std::string data;
+        for (int i = 0; i < 300; ++i)
+        {
+            data.push_back(static_cast<char>(i * 7 + 3));
+        }
+        for (size_t offset = 0; offset < 4; ++offset)
+        {
+            for (size_t start = 0; start < 16; ++start)
+            {
+                for (size_t len = 0; start + len <= data.size(); len += 13)
+                {
+                    std::string expected(data, start, len);
+                    for (size_t i = 0; i < len; ++i)
+                    {
+                        expected[i] = static_cast<char>(expected[i] ^ mask[(offset + i) % 4]);
+                    }
+                    std::string actual(data, start, len);
+                    // 从不对齐的地址开始
+                    std::string copy(data);
+                    WebSocketCodec::unmask(&copy[start], len, mask, offset);
+                    CHECK(copy.compare(start, len, expected) == 0);
+                    WebSocketCodec::unmask(&actual[0], len, mask, offset);
+                    CHECK(actual == expected);
+                }
+            }
+        }
+    }
+
+    return testResult();
+}
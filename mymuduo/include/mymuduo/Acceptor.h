@@ -18,6 +18,8 @@ namespace mymuduo
         // Socket noncopyable
         using NewConnectionCallback = std::function<void(int sockfd, const InetAddress &)>;
         Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+        // 接管一个已经bind并listen的socket，比如热重启时从旧进程收到的fd，见ListenerHandoff
+        Acceptor(EventLoop *loop, int listenFd);
         ~Acceptor();
 
         void setNewConnectionCallback(const NewConnectionCallback &cb)
@@ -27,6 +29,10 @@ namespace mymuduo
 
         bool listenning() { return listenning_; }
         void listen();
+        int listenFd() const { return acceptSocket_.fd(); }
+        // 不再接受新连接，在loop线程里调用。监听fd保留到析构时关闭。
+        // shutdownSocket为false时只是本进程不再accept，用于监听socket已经交给其他进程的情况
+        void stopListening(bool shutdownSocket = true);
 
     private:
         void handleRead();
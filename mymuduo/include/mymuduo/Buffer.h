@@ -22,12 +22,19 @@ namespace mymuduo
         size_t readableBytes() const { return writerIndex_ - readerIndex_; }
         size_t writableBytes() const { return buffer_.size() - writerIndex_; }
         size_t prependableBytes() const { return readerIndex_; }
+        // 底层vector实际占用的内存，只增不减
+        size_t internalCapacity() const { return buffer_.capacity(); }
 
         // 返回buffer可读数据的起始地址
         const char *peek() const
         {
             return begin() + readerIndex_;
         }
+        // 可以原地修改的可读数据，比如WebSocket解掩码
+        char *beginRead()
+        {
+            return begin() + readerIndex_;
+        }
 
         const char *findCRLF() const
         {
@@ -110,6 +117,13 @@ namespace mymuduo
             return begin() + writerIndex_;
         }
 
+        // 直接写进beginWrite()之后调用，len不能超过writableBytes()
+        void hasWritten(size_t len)
+        {
+            assert(len <= writableBytes());
+            writerIndex_ += len;
+        }
+
         // 从fd上读取数据
         ssize_t readFd(int fd, int *saveErrno);
         // 通过fd发送数据
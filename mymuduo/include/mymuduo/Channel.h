@@ -76,14 +76,13 @@ namespace mymuduo
         // for debug
         std::string reventsToString() const;
         std::string eventsToString() const;
+        static std::string eventsToString(int fd, int ev);
 
         // one loop per thread
         EventLoop *ownerLoop() { return loop_; }
         void remove();
 
     private:
-        static std::string eventsToString(int fd, int ev);
-
         void update();
         void handleEventWithGuard(Timestamp receivetime);
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+#include "mymuduo/InetAddress.h"
+#include "mymuduo/TimerId.h"
+
+#include <functional>
+#include <memory>
+#include <atomic>
+
+namespace mymuduo
+{
+    class Channel;
+    class EventLoop;
+
+    /**
+     * @brief 主动发起连接，和Acceptor相对
+     * 非阻塞connect，socket可写时用SO_ERROR判断是否连上，成功后把sockfd交给NewConnectionCallback(通常由TcpClient创建TcpConnection)。
+     * 失败时用loop的定时器退避重试，间隔从500ms开始每次翻倍，最长30s。
+     * Connector只负责建立连接，不负责断线重连，那是TcpClient的工作。
+     */
+    class Connector : noncopyable, public std::enable_shared_from_this<Connector>
+    {
+    public:
+        using NewConnectionCallback = std::function<void(int sockfd)>;
+        using ConnectFailedCallback = std::function<void()>;
+
+        Connector(EventLoop *loop, const InetAddress &serverAddr);
+        ~Connector();
+
+        void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+        // 重试次数用完之后在loop线程里调用
+        void setConnectFailedCallback(const ConnectFailedCallback &cb) { connectFailedCallback_ = cb; }
+        // 失败后最多重试几次，-1(默认)表示一直重试。在start()之前调用
+        void setMaxRetries(int maxRetries) { maxRetries_ = maxRetries; }
+        // 单次connect的超时，超时算一次失败，0(默认)表示由内核决定(SYN重传，可能长达数分钟)
+        void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+
+        const InetAddress &serverAddress() const { return serverAddr_; }
+
+        void start();   // can be called in any thread
+        void restart(); // must be called in loop thread
+        void stop();    // can be called in any thread
+
+    private:
+        enum States
+        {
+            kDisconnected,
+            kConnecting,
+            kConnected
+        };
+        static const int kMaxRetryDelayMs = 30 * 1000;
+        static const int kInitRetryDelayMs = 500;
+
+        void setState(States s) { state_ = s; }
+        void startInLoop();
+        void stopInLoop();
+        void connect();
+        void connecting(int sockfd);
+        void handleWrite();
+        void handleError();
+        void handleTimeout();
+        void retry(int sockfd);
+        int removeAndResetChannel();
+        void resetChannel();
+
+        EventLoop *loop_;
+        InetAddress serverAddr_;
+        std::atomic_bool connect_; // 是否还要连接，stop()之后为false
+        States state_;             // 只在loop线程读写
+        std::unique_ptr<Channel> channel_;
+        NewConnectionCallback newConnectionCallback_;
+        ConnectFailedCallback connectFailedCallback_;
+        int retryDelayMs_;
+        int maxRetries_;
+        int retries_;
+        double connectTimeout_;
+        TimerId retryTimer_;
+        TimerId timeoutTimer_;
+    };
+
+    using ConnectorPtr = std::shared_ptr<Connector>;
+} // namespace mymuduo
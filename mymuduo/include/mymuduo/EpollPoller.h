@@ -4,6 +4,7 @@
 #include "mymuduo/Timestamp.h"
 
 #include <vector>
+#include <stdint.h>
 #include <sys/epoll.h>
 
 /**
@@ -27,18 +28,38 @@ namespace mymuduo
         void removeChannel(Channel *channel) override;
         // 判断参数channel是否在当前poller中
         bool hasChannel(Channel *channel) const override;
+        // EPIOCSPARAMS，需要Linux 6.9+
+        bool setBusyPoll(int usecs, int budget) override;
 
     private:
         static const int kInitEventListSize = 16;
         using EventList = std::vector<epoll_event>;
 
+        // 按fd下标的channel表。fd是内核分配的最小可用整数，表是稠密的；
+        // generation在fd每次注册新channel时加一，和fd一起放进epoll_event.data.u64，
+        // 取出事件时比对，过期注册(比如fd被关闭后复用)的事件直接丢弃
+        struct ChannelSlot
+        {
+            Channel *channel;
+            uint32_t generation;
+            uint32_t registeredEvents; // 已经通过epoll_ctl告诉内核的事件，0表示不在epoll的兴趣列表里
+            bool dirty;                // channel的事件有变化，还没同步给内核
+        };
+        using ChannelTable = std::vector<ChannelSlot>;
+
         static const char* operationToString(int op);
         void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
         // 相当于调用epoll_ctl()
-        void update(int operation, Channel *channel);
+        void update(int operation, int fd, uint32_t events);
+        // 在epoll_wait之前把本轮迭代积累的兴趣变化一次性同步给内核，
+        // 先开后关(比如EPOLLOUT)等相互抵消的变化不产生系统调用
+        void flushChanges();
 
         int epollfd_;
         EventList events_;
+        ChannelTable channelTable_;
+        size_t numChannels_;
+        std::vector<int> dirtyFds_;
     };
 
 } // namespace mymuduo
\ No newline at end of file
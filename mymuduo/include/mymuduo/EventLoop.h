@@ -17,6 +17,7 @@ namespace mymuduo
     class Channel;
     class Poller;
     class TimerQueue;
+    class Histogram;
     /**
      * @brief 事件循环类，对应Reactor模型中的Demultiplex。里面主要包含了两个大模块 Channel Poller(epoll的抽象)
      * 理清楚 EventLoop channel poller之间的关系 其中EventLoop对应Reactor模型中的Demultiplex
@@ -28,6 +29,17 @@ namespace mymuduo
     public:
         using Functor = std::function<void()>;
 
+        // 一次超过阈值的阻塞：phase为"channel"时fd有效，为"functor"时functor是回调的类型名(typeid)
+        struct Stall
+        {
+            const char *phase;
+            int fd;
+            const char *functor;
+            int64_t elapsedMicros;
+            Timestamp when;
+        };
+        using StallCallback = std::function<void(const Stall &)>;
+
         EventLoop();
         ~EventLoop();
 
@@ -60,10 +72,39 @@ namespace mymuduo
         /// Cancels the timer.
         /// Safe to call from other threads.
         ///
-        // void cancel(TimerId timerId);
+        void cancel(TimerId timerId);
 
         void wakeup();
 
+        ///
+        /// 单个Channel的事件处理或单个pending functor耗时超过seconds时调用cb，默认打ERROR日志。
+        /// seconds为0(默认)时只统计各阶段总耗时，不逐个计时。
+        /// 在loop()之前或loop线程里调用。
+        ///
+        void setStallThreshold(double seconds, StallCallback cb = StallCallback());
+
+        ///
+        /// 自适应忙轮询：处理过事件或回调之后的spinSeconds秒内用0超时poll，不让线程睡眠，
+        /// 省掉唤醒时的调度开销；空闲超过spinSeconds才回到阻塞的epoll_wait。0(默认)关闭。
+        /// 在loop()之前或loop线程里调用。
+        ///
+        void setBusyPollSpin(double spinSeconds);
+        /// 让内核在epoll_wait里忙轮询网卡队列usecs微秒(需要Linux 6.9+)，失败返回false
+        bool setEpollBusyPoll(int usecs, int budget = 8);
+
+        // 本loop每轮迭代各阶段耗时(微秒)：poll等待、Channel事件分发、pending functors
+        // 同时以 loop="<tid>" 标签注册在MetricsRegistry里
+        const Histogram *pollLatency() const { return pollLatency_; }
+        const Histogram *dispatchLatency() const { return dispatchLatency_; }
+        const Histogram *functorsLatency() const { return functorsLatency_; }
+
+        // 负载计数，由本loop上的TcpConnection更新，EventLoopThreadPool分配新连接时读取，都是relaxed原子操作
+        void addConnections(int64_t n) { numConnections_.fetch_add(n, std::memory_order_relaxed); }
+        int64_t numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+        void addPendingBytes(int64_t n) { pendingBytes_.fetch_add(n, std::memory_order_relaxed); }
+        // 本loop上所有连接输出缓冲区里还没写进内核的字节数
+        int64_t pendingBytes() const { return pendingBytes_.load(std::memory_order_relaxed); }
+
         void updateChannel(Channel *channel);
         void removeChannel(Channel *channel);
         bool hasChannel(Channel *channel);
@@ -82,7 +123,8 @@ namespace mymuduo
     private:
         void abortNotInLoopThread();
         void handleRead();
-        void doPendingFunctors();
+        size_t doPendingFunctors();
+        void reportStall(const char *phase, int fd, const char *functor, int64_t elapsedMicros, Timestamp when);
         using ChannelList = std::vector<Channel *>;
 
         std::atomic_bool looping_; // 原子操作，通过CAS实现的
@@ -104,6 +146,19 @@ namespace mymuduo
         std::atomic_bool callingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
         std::vector<Functor> pendingFunctors_;    // 存储loop需要执行的所有的回调操作
         std::mutex mutex_;                        // 互斥锁，用来保护上面vector容器的线程安全操作
+
+        // 阶段耗时直方图只由本loop线程写入，对象归MetricsRegistry所有
+        Histogram *pollLatency_;
+        Histogram *dispatchLatency_;
+        Histogram *functorsLatency_;
+        int64_t stallThresholdMicros_; // 0表示不逐个计时
+        StallCallback stallCallback_;
+
+        int64_t busyPollSpinMicros_; // 0表示不忙轮询
+        Timestamp lastActivity_;
+
+        std::atomic<int64_t> numConnections_;
+        std::atomic<int64_t> pendingBytes_;
     };
 
 } // namespace mymuduo
\ No newline at end of file
@@ -19,6 +19,13 @@ namespace mymuduo
         EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string &name = std::string());
         ~EventLoopThread();
 
+        // 以下两个设置在startLoop()之前调用，在新线程创建EventLoop之前生效
+        // 把loop线程绑定到cpu上，-1(默认)表示不绑定
+        void setCpu(int cpu) { cpu_ = cpu; }
+        // 线程的内存分配策略设为MPOL_LOCAL，总是从所在CPU的NUMA节点分配，
+        // 覆盖进程级的策略(比如numactl --interleave)
+        void setLocalMemory(bool on) { localMemory_ = on; }
+
         EventLoop *startLoop();
 
     private:
@@ -30,6 +37,8 @@ namespace mymuduo
         std::mutex mutex_;
         std::condition_variable cond_;
         ThreadInitCallback callback_;
+        int cpu_;
+        bool localMemory_;
     };
 
 } // namespace mymuduo
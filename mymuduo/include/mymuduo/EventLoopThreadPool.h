@@ -6,31 +6,62 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <stdint.h>
 
 namespace mymuduo
 {
     class EventLoop;
     class EventLoopThread;
+    class InetAddress;
 
     class EventLoopThreadPool : noncopyable
     {
     public:
         using ThreadInitCallback = std::function<void(EventLoop *)>;
+        // 自定义的分配策略：从loops里为来自peerAddr的新连接(sockfd)选一个loop，在baseLoop线程里调用
+        using PlacementPolicy = std::function<EventLoop *(const std::vector<EventLoop *> &loops, int sockfd,
+                                                          const InetAddress &peerAddr)>;
+
+        // 新连接分配到哪个subloop
+        enum Placement
+        {
+            kRoundRobin,        // 轮询(默认)
+            kLeastConnections,  // 当前连接数最少的loop
+            kLeastPendingBytes, // 输出缓冲区积压字节数最少的loop
+            kPowerOfTwoChoices, // 随机挑两个，取连接数少的；避免所有新连接同时涌向同一个最空闲的loop
+            kHashPeerAddress,   // 按对端IP哈希，同一客户端的连接总在同一个loop上
+            kIncomingCpu,       // 按SO_INCOMING_CPU交给绑定在处理该连接网卡队列的CPU上的loop，需配合setCpuAffinity
+        };
 
         EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
         ~EventLoopThreadPool();
 
         void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+        // 第i个subloop线程绑定到cpus[i % cpus.size()]，在start()之前调用
+        void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; }
+        // subloop线程从本地NUMA节点分配内存，见EventLoopThread::setLocalMemory
+        void setLocalMemory(bool on) { localMemory_ = on; }
         void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
+        void setPlacement(Placement placement) { placement_ = placement; }
+        // 设置后优先于setPlacement
+        void setPlacementPolicy(const PlacementPolicy &policy) { placementPolicy_ = policy; }
+
         // 如果工作在多线程中，baseLoop默认以轮询的方式分配channel给subloop
         EventLoop *getNextLoop();
+        // 按分配策略为新连接选择loop，只有一个loop(没有subloop)时返回baseLoop
+        EventLoop *getLoopForConnection(int sockfd, const InetAddress &peerAddr);
 
         std::vector<EventLoop *> getAllLoops();
         bool started() const { return started_; }
         const std::string name() const { return name_; }
 
     private:
+        EventLoop *leastLoaded(int64_t (EventLoop::*load)() const) const;
+        EventLoop *powerOfTwoChoices();
+        EventLoop *hashPeerAddress(const InetAddress &peerAddr) const;
+        EventLoop *incomingCpu(int sockfd);
+
         EventLoop *baseLoop_;
         bool started_;
         int numThreads_;
@@ -39,6 +70,13 @@ namespace mymuduo
         
         std::vector<std::unique_ptr<EventLoopThread>> threads_;
         std::vector<EventLoop *> loops_;    // oneloop per thread
+        std::vector<int> cpus_;
+        std::vector<int> loopCpus_;         // loops_[i]绑定的cpu，没有绑定时为空
+        bool localMemory_;
+
+        Placement placement_;
+        PlacementPolicy placementPolicy_;
+        uint64_t randomState_; // kPowerOfTwoChoices用的xorshift状态，只在baseLoop线程里使用
     };
 
 } // namespace mymuduo
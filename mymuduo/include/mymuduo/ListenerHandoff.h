@@ -0,0 +1,55 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mymuduo
+{
+    class EventLoop;
+    class Channel;
+    class Socket;
+
+    /**
+     * @brief 热重启时在新旧进程之间交接监听socket
+     * 旧进程serve()在Unix域socket上等待，新进程用receive()连上来之后，旧进程通过SCM_RIGHTS把监听fd发过去，
+     * 然后调用HandoffCallback，通常是TcpServer::detachListener() + drain()。
+     * 新旧进程共享同一个监听socket，backlog里排队的连接不会丢失，新进程用收到的fd构造TcpServer继续accept。
+     *
+     * 旧进程:
+     *   ListenerHandoff handoff(&loop, path);
+     *   handoff.serve({server.listenFd()}, [&]() { server.detachListener(); server.drain(30, quit); });
+     * 新进程:
+     *   std::vector<int> fds = ListenerHandoff::receive(path); // 为空时说明没有旧进程，正常bind
+     */
+    class ListenerHandoff : noncopyable
+    {
+    public:
+        using HandoffCallback = std::function<void()>;
+
+        ListenerHandoff(EventLoop *loop, const std::string &path);
+        ~ListenerHandoff();
+
+        // 在loop线程里调用，ListenerHandoff要活到回调执行完。path上已有的socket文件(上一代进程留下的)会被替换。
+        // 只交接一次，交接之后不再监听path，path留给新进程使用
+        void serve(const std::vector<int> &fds, const HandoffCallback &cb);
+
+        // 同步连接path并接收fd，收到的fd带FD_CLOEXEC。没有进程在serve或出错时返回空
+        static std::vector<int> receive(const std::string &path);
+
+    private:
+        void handleRead();
+        void finish();
+        void stop();
+
+        EventLoop *loop_;
+        const std::string path_;
+        std::unique_ptr<Socket> socket_; // Unix域监听socket
+        std::unique_ptr<Channel> channel_;
+        std::vector<int> fds_;
+        HandoffCallback callback_;
+    };
+} // namespace mymuduo
@@ -2,6 +2,7 @@
 
 #include "mymuduo/noncopyable.h"
 
+#include <stdint.h>
 #include <string.h>
 #include <string>
 
@@ -13,6 +14,17 @@ namespace mymuduo
         const int kSmallBuffer = 4000;
         const int kLargeBuffer = 4000 * 1000;
 
+        // 数值格式化函数，LogStream和http模块(Content-Length等)共用
+        // 均不写入结尾的'\0'，返回写入的字节数，调用方需保证buf至少有kMaxNumericSize个字节
+        const int kMaxNumericSize = 48;
+        // 十进制整数，查两位数字表，每次除以100
+        size_t formatSigned(char buf[], int64_t value);
+        size_t formatUnsigned(char buf[], uint64_t value);
+        // 定宽补零，例如formatZeroPadded(buf, 42, 6) => "000042"，value的位数不能超过width
+        size_t formatZeroPadded(char buf[], uint32_t value, int width);
+        // 最短的可往返(round-trip)表示，基于Grisu2算法，strtod读回后与value完全相等
+        size_t formatDouble(char buf[], double value);
+
         template <int SIZE>
         class FixedBuffer : noncopyable
         {
@@ -106,6 +118,6 @@ namespace mymuduo
 
         Buffer buffer_;
 
-        static const int kMaxNumericSize = 48;
+        static const int kMaxNumericSize = detail::kMaxNumericSize;
     };
 } // namespace mymuduo
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace mymuduo
+{
+    // 分片数。IO线程数不超过分片数时每个线程独占一个分片，写入路径上没有竞争
+    const int kMetricsShards = 16;
+
+    namespace detail
+    {
+        // 当前线程使用的分片下标，线程第一次写指标时按轮询分配
+        int metricsShard();
+    } // namespace detail
+
+    /**
+     * @brief 按线程分片的int64计数，写入时只对本线程分片做relaxed原子加，读取(抓取)时再把各分片求和
+     * 每个分片独占一个cache line，避免多个IO线程之间的伪共享
+     */
+    class ShardedValue : noncopyable
+    {
+    public:
+        void add(int64_t n)
+        {
+            shards_[detail::metricsShard()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        int64_t value() const;
+
+    private:
+        struct Shard
+        {
+            std::atomic<int64_t> value{0};
+            char padding[64 - sizeof(std::atomic<int64_t>)];
+        };
+
+        Shard shards_[kMetricsShards];
+    };
+
+    // 只增不减的计数器，比如累计接受的连接数
+    class Counter : public ShardedValue
+    {
+    public:
+        void increment() { add(1); }
+    };
+
+    // 可增可减的当前值，比如当前连接数
+    class Gauge : public ShardedValue
+    {
+    public:
+        void increment() { add(1); }
+        void decrement() { add(-1); }
+    };
+
+    /**
+     * @brief HDR风格的对数-线性直方图，记录非负整数(一般是微秒)
+     * 每个2的幂区间再均分为2^kSubBucketBits个子桶，相对误差不超过1/8；小于8的值每个值一个桶。
+     * 写入是对本线程分片的一次relaxed原子加，没有锁；snapshot()把各分片相加。
+     */
+    class Histogram : noncopyable
+    {
+    public:
+        static const int kSubBucketBits = 3;
+        static const int kSubBuckets = 1 << kSubBucketBits;
+        // 超过2^kMaxExponent的值都落在最后一个桶
+        static const int kMaxExponent = 40;
+        static const int kNumBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+        struct Snapshot
+        {
+            std::vector<int64_t> buckets;
+            int64_t count;
+            int64_t sum;
+
+            // 小于等于value的记录数
+            int64_t countAtOrBelow(uint64_t value) const;
+            // q取值[0, 1]，返回对应分位数所在桶的上界
+            uint64_t percentile(double q) const;
+        };
+
+        // 只被一个线程写入的直方图(比如每个EventLoop自己的)可以把shards设为1
+        explicit Histogram(int shards = kMetricsShards);
+        ~Histogram();
+
+        void record(int64_t value);
+        Snapshot snapshot() const;
+
+        // 第index个桶记录的值v满足 lower < v <= upper，返回upper
+        static uint64_t bucketUpperBound(int index);
+        static int bucketIndex(uint64_t value);
+
+    private:
+        struct Shard
+        {
+            std::atomic<int64_t> buckets[kNumBuckets];
+            std::atomic<int64_t> count;
+            std::atomic<int64_t> sum;
+            char padding[64];
+        };
+
+        const int numShards_;
+        std::unique_ptr<Shard[]> shards_;
+    };
+
+    /**
+     * @brief 全局指标注册表，抓取时输出Prometheus文本格式(0.0.4)
+     * 注册和抓取加锁，都不在热路径上；指标对象注册后一直存活到进程退出，可以缓存返回的指针。
+     * labels是已经拼好的标签串，例如 code="2xx"，同名不同标签的指标输出在同一个family下。
+     */
+    class MetricsRegistry : noncopyable
+    {
+    public:
+        static MetricsRegistry &instance();
+
+        // 同名同标签重复注册返回同一个对象
+        Counter *counter(const std::string &name, const std::string &help, const std::string &labels = std::string());
+        Gauge *gauge(const std::string &name, const std::string &help, const std::string &labels = std::string());
+        // 只有一个线程写入的直方图(比如按loop打标签的)传shards = 1
+        Histogram *histogram(const std::string &name, const std::string &help, const std::string &labels = std::string(),
+                             int shards = kMetricsShards);
+
+        std::string scrape() const;
+
+    private:
+        enum Type
+        {
+            kCounter,
+            kGauge,
+            kHistogram
+        };
+
+        struct Entry
+        {
+            std::string name;
+            std::string help;
+            std::string labels;
+            Type type;
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Gauge> gauge;
+            std::unique_ptr<Histogram> histogram;
+        };
+
+        MetricsRegistry() = default;
+
+        Entry *findOrCreate(const std::string &name, const std::string &help, const std::string &labels, Type type,
+                            int shards = kMetricsShards);
+        static void appendHistogram(std::string *out, const Entry &entry);
+
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<Entry>> entries_;
+    };
+} // namespace mymuduo
@@ -5,7 +5,6 @@
 #include "mymuduo/EventLoop.h"
 
 #include <vector>
-#include <unordered_map>
 
 namespace mymuduo
 {
@@ -24,8 +23,10 @@ namespace mymuduo
         virtual void updateChannel(Channel *channel) = 0;
         // Poller并不拥有Channel，Channel在Poller析构之前必须先unregister，避免空悬指针。
         virtual void removeChannel(Channel *channel) = 0;
-        // 判断参数channel是否在当前poller中
-        virtual bool hasChannel(Channel *channel) const;
+        // 判断参数channel是否在当前poller中，fd到channel的映射由具体的poller维护
+        virtual bool hasChannel(Channel *channel) const = 0;
+        // 让内核在poll里对就绪队列所在的网卡队列忙轮询usecs微秒，不支持时返回false
+        virtual bool setBusyPoll(int /*usecs*/, int /*budget*/) { return false; }
 
         // EvemtLoop可以通过该接口获取默认的IO复用的具体实现
         static Poller *newDefaultPoller(EventLoop *loop);
@@ -35,11 +36,6 @@ namespace mymuduo
             ownerLoop_->assertInLoopThread();
         }
 
-    protected:
-        // map的key：sockfd, value: sockfd所属的channel
-        using ChannelMap = std::unordered_map<int, Channel *>;
-        ChannelMap channels_;
-
     private:
         EventLoop *ownerLoop_; // 定义poller所属的事件循环
     };
@@ -22,6 +22,16 @@ namespace mymuduo
         void setReuseAddr(bool on);
         void setReusePort(bool on);
         void setKeepAlive(bool on);
+        // SO_BUSY_POLL，阻塞读或poll时在网卡队列上忙轮询usecs微秒；超过net.core.busy_read需要CAP_NET_ADMIN
+        void setBusyPoll(int usecs);
+
+        // 以下是对任意sockfd的工具函数
+        static InetAddress localAddress(int sockfd);
+        static InetAddress peerAddress(int sockfd);
+        // 取出并清除SO_ERROR，非阻塞connect完成后用来判断是否成功
+        static int socketError(int sockfd);
+        // 连接本机端口时，内核可能把源端口选成目的端口，自己连上自己
+        static bool isSelfConnect(int sockfd);
 
     private:
         const int sockfd_;
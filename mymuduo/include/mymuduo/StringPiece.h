@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+
+namespace mymuduo
+{
+    /**
+     * @brief 指向一段不属于自己的字符串(指针+长度)，拷贝和比较都不分配内存
+     * 只在被指向的字符串存活期间有效，常用于把请求路径里的片段交给回调而不拷贝
+     */
+    class StringPiece
+    {
+    public:
+        StringPiece()
+            : ptr_(nullptr), length_(0) {}
+        StringPiece(const char *str)
+            : ptr_(str), length_(static_cast<int>(::strlen(str))) {}
+        StringPiece(const std::string &str)
+            : ptr_(str.data()), length_(static_cast<int>(str.size())) {}
+        StringPiece(const char *offset, int len)
+            : ptr_(offset), length_(len) {}
+
+        const char *data() const { return ptr_; }
+        int size() const { return length_; }
+        bool empty() const { return length_ == 0; }
+        const char *begin() const { return ptr_; }
+        const char *end() const { return ptr_ + length_; }
+
+        char operator[](int i) const { return ptr_[i]; }
+
+        bool operator==(const StringPiece &x) const
+        {
+            return length_ == x.length_ && ::memcmp(ptr_, x.ptr_, length_) == 0;
+        }
+        bool operator!=(const StringPiece &x) const
+        {
+            return !(*this == x);
+        }
+
+        bool starts_with(const StringPiece &x) const
+        {
+            return length_ >= x.length_ && ::memcmp(ptr_, x.ptr_, x.length_) == 0;
+        }
+
+        std::string as_string() const { return std::string(data(), size()); }
+
+    private:
+        const char *ptr_;
+        int length_;
+    };
+} // namespace mymuduo
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+#include "mymuduo/Callbacks.h"
+#include "mymuduo/Connector.h"
+#include "mymuduo/InetAddress.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace mymuduo
+{
+    class EventLoop;
+
+    // 客户端，一个TcpClient管理一条到serverAddr的连接，断开后可以自动重连(enableRetry)
+    class TcpClient : noncopyable
+    {
+    public:
+        TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+        ~TcpClient(); // force out-line dtor, for std::unique_ptr members.
+
+        void connect();
+        void disconnect();
+        void stop();
+
+        TcpConnectionPtr connection() const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return connection_;
+        }
+
+        EventLoop *getLoop() const { return loop_; }
+        bool retry() const { return retry_; }
+        // 连接断开后用Connector的退避策略重新连接
+        void enableRetry() { retry_ = true; }
+        // 见Connector::setConnectTimeout，在connect()之前调用
+        void setConnectTimeout(double seconds) { connector_->setConnectTimeout(seconds); }
+
+        const std::string &name() const { return name_; }
+
+        /// Not thread safe.
+        void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+        /// Not thread safe.
+        void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+        /// Not thread safe.
+        void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+    private:
+        /// Not thread safe, but in loop
+        void newConnection(int sockfd);
+        /// Not thread safe, but in loop
+        void removeConnection(const TcpConnectionPtr &conn);
+
+        EventLoop *loop_;
+        ConnectorPtr connector_; // avoid revealing Connector
+        const std::string name_;
+        const std::shared_ptr<const std::string> connNamePrefix_;
+        ConnectionCallback connectionCallback_;
+        MessageCallback messageCallback_;
+        WriteCompleteCallback writeCompleteCallback_;
+        std::atomic_bool retry_;
+        std::atomic_bool connect_;
+        // always in loop thread
+        uint64_t nextConnId_;
+        mutable std::mutex mutex_;
+        TcpConnectionPtr connection_; // guarded by mutex_
+    };
+} // namespace mymuduo
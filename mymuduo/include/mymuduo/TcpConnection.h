@@ -15,30 +15,61 @@ namespace mymuduo
     class Channel;
     class EventLoop;
     class Socket;
+    class TlsContext;
+    class TlsEngine;
     // TcpConnection表示的是“一次TCP连接”，它是不可再生的，一旦连接断开，这个TcpConnection对象就没啥用了。
     // 而且TcpConnection没有发起连接的功能，其构造函数参数是已经建立好的sockfd，因此其初始状态是kConnecting。
     class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
     {
     public:
-        TcpConnection(EventLoop *loop, const std::string &name, int sockfd, const InetAddress &localAddr,
-                      const InetAddress &peerAddr);
+        // namePrefix由创建方(TcpServer)所有连接共享，name()用到时才拼接，建立连接时不构造字符串
+        TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix, int sockfd,
+                      const InetAddress &localAddr, const InetAddress &peerAddr);
         ~TcpConnection();
 
         EventLoop *getLoop() const { return loop_; }
-        const std::string &name() const { return name_; }
+        // 创建方分配的连接id，同一个TcpServer内唯一，不会回绕
+        uint64_t id() const { return id_; }
+        // "服务器名-ip:port#id"，每次调用都会拼接，只在日志等需要时使用
+        std::string name() const;
         const InetAddress &localAddress() const { return localAddr_; }
         const InetAddress &peerAddress() const { return peerAddr_; }
 
         bool connected() const { return state_ == kConnected; }
+        // 还没写进内核的字节数，只能在IO线程调用
+        size_t outputBufferSize() const { return outputBuffer_.readableBytes(); }
+        // 已经读进来、消息回调还没有取走的数据，只能在IO线程使用
+        Buffer *inputBuffer() { return &inputBuffer_; }
 
-        // void send(const void* message, size_t len);
+        // Thread safe，在其他线程调用时会拷贝一份数据
+        void send(const void *data, size_t len);
         // Thread safe
         void send(const std::string &buf);
         void send(Buffer *buf);
 
         // Thread safe
         void shutdown();
+        // Thread safe，不等输出缓冲区发送完，直接关闭连接
+        void forceClose();
+        // Thread safe. 暂停/恢复读(关闭/打开EPOLLIN)，用于对端读得太慢时不再接收新的请求
+        void startRead();
+        void stopRead();
+        // 只能在IO线程调用
+        bool isReading() const { return reading_; }
+
+        // 在connectEstablished之前调用(见TcpServer::setTlsContext)：之后收发的都是TLS记录，
+        // 消息回调拿到的和send()传入的仍是明文。握手完成之前send()的数据先暂存
+        void startTls(TlsContext *context);
+        bool isTls() const { return tls_ != nullptr; }
+        // 协商出的ALPN协议，不是TLS连接或者没有协商时为空，只能在IO线程调用
+        std::string alpnProtocol() const;
         void setTcpNoDelay(bool on);
+        // SO_BUSY_POLL，见Socket::setBusyPoll
+        void setBusyPoll(int usecs);
+
+        // 连接上挂载的用户数据(原版muduo用的是boost::any)，比如HttpServer每个连接的解析状态
+        void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+        const std::shared_ptr<void> &getContext() const { return context_; }
 
         void setConnectionCallback(const ConnectionCallback &cb)
         {
@@ -90,10 +121,20 @@ namespace mymuduo
 
         void sendInLoop(const void *data, size_t len);
         void sendInLoop(const std::string &message);
+        // 把数据原样写进socket或输出缓冲区，TLS连接上写的是密文
+        void writeInLoop(const void *data, size_t len);
+        // 发送TlsEngine产生的密文
+        void flushTls();
         void shutdownInLoop();
+        void forceCloseInLoop();
+        void startReadInLoop();
+        void stopReadInLoop();
+        // 两个缓冲区扩容后把增量计入缓冲区内存的指标
+        void updateBufferMemory();
 
         EventLoop *loop_; // 这里绝对不是baseloop,因为TcpConnection都是在subloop里面管理的
-        const std::string name_;
+        const uint64_t id_;
+        const std::shared_ptr<const std::string> namePrefix_;
         std::atomic_int state_;
         bool reading_;
 
@@ -113,6 +154,9 @@ namespace mymuduo
         size_t highWaterMark_;
         Buffer inputBuffer_;  // 接收数据的缓冲区
         Buffer outputBuffer_; // 发送数据的缓冲区
+        size_t bufferMemory_; // 已经计入指标的两个缓冲区容量
+        std::shared_ptr<void> context_;
+        std::unique_ptr<TlsEngine> tls_;
     };
 
 } // namespace mymuduo
@@ -19,11 +19,14 @@
 
 namespace mymuduo
 {
+    class TlsContext;
+
     // 对外的服务器编程使用的类
     class TcpServer : noncopyable
     {
     public:
         using ThreadInitCallback = std::function<void(EventLoop *)>;
+        using DrainCallback = std::function<void()>;
 
         enum Option
         {
@@ -32,28 +35,88 @@ namespace mymuduo
         };
 
         TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option = kNoReusePort);
+        // 使用已经在监听的socket，热重启时新进程用从旧进程收到的fd构造，见ListenerHandoff
+        TcpServer(EventLoop *loop, int listenFd, const std::string &nameArg);
         ~TcpServer();
 
         const std::string &ipPort() const { return ipPort_; }
         const std::string &name() const { return name_; }
         EventLoop *getLoop() const { return loop_; }
+        // 监听socket的fd，热重启时交给新进程
+        int listenFd() const { return acceptor_->listenFd(); }
         // 设置底层subloop的个数
         void setThreadNum(int numThreads);
+        // start()之后的所有IO loop，没有subloop时只有baseloop。IO线程在TcpServer析构时才退出
+        std::vector<EventLoop *> getAllLoops() const { return threadPool_->getAllLoops(); }
+        // subloop线程绑核和NUMA本地内存，见EventLoopThreadPool。在start()之前调用
+        void setCpuAffinity(const std::vector<int> &cpus) { threadPool_->setCpuAffinity(cpus); }
+        void setLocalMemory(bool on) { threadPool_->setLocalMemory(on); }
+        // 低延迟模式，在start()之前调用：
+        // spinSeconds 每个IO loop有活动之后忙轮询的时长，见EventLoop::setBusyPollSpin
+        // busyPollUsecs 大于0时给每个IO loop的epoll和每个新连接的socket开启内核忙轮询(SO_BUSY_POLL)
+        void setBusyPoll(double spinSeconds, int busyPollUsecs = 0)
+        {
+            busyPollSpinSeconds_ = spinSeconds;
+            busyPollUsecs_ = busyPollUsecs;
+        }
+        // 新连接分配到subloop的策略，默认轮询。在start()之前调用
+        void setPlacement(EventLoopThreadPool::Placement placement) { threadPool_->setPlacement(placement); }
+        void setPlacementPolicy(const EventLoopThreadPool::PlacementPolicy &policy) { threadPool_->setPlacementPolicy(policy); }
+
+        // 所有新连接都走TLS，见TcpConnection::startTls。context由调用方持有，生命周期要长于TcpServer，
+        // 在start()之前调用，证书要已经加载成功
+        void setTlsContext(TlsContext *context) { tlsContext_ = context; }
 
         void setThreadInitCallback(const ThreadInitCallback &cb) { threadInitCallback_ = cb; }
         void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
         void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
         void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
 
+        // drain时对每个已有连接执行的回调，在连接所在的IO线程里调用，默认TcpConnection::shutdown()
+        // (输出缓冲区发送完之后半关闭)。在drain()之前调用
+        void setDrainConnectionCallback(const ConnectionCallback &cb) { drainConnectionCallback_ = cb; }
+
         // 开启服务器监听
         void start();
 
+        // Thread safe. 关闭监听，不再接受新连接，已有的连接不受影响
+        void stopAccepting();
+        // Thread safe. 监听socket已经交给新进程，本进程不再accept，但不关闭共享的监听socket。
+        // 之后通常调用drain()处理完已有连接
+        void detachListener();
+        // Thread safe. 优雅退出：停止接受新连接，对每个连接执行drain回调，等待所有连接关闭；
+        // 超过timeoutSeconds还没关闭的连接被强制关闭。所有连接都关闭后在baseloop里调用cb，
+        // 通常在cb里quit baseloop，随后析构TcpServer时回收IO线程
+        void drain(double timeoutSeconds, const DrainCallback &cb);
+
     private:
-        void newConnection(int sockfd, const InetAddress &peerAddr);
-        void removeConenction(const TcpConnectionPtr &conn);
-        void removeConnectionInLoop(const TcpConnectionPtr &conn);
+        TcpServer(EventLoop *loop, const std::string &ipPort, const std::string &nameArg, std::unique_ptr<Acceptor> acceptor);
 
-        using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+        using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
+
+        // 每个IO loop一张连接表，只在该loop线程里读写，连接的加入和删除都不用回到baseloop
+        struct ConnectionShard
+        {
+            explicit ConnectionShard(EventLoop *l) : loop(l), numConnections(0), draining(false) {}
+
+            EventLoop *loop;
+            ConnectionMap connections;
+            std::atomic<size_t> numConnections; // baseloop分配连接时加一，连接关闭时在IO线程减一，drain时在baseloop读取
+            bool draining;                      // 以下两个只在IO线程访问
+            ConnectionCallback drainCallback;
+        };
+        using ConnectionShardPtr = std::shared_ptr<ConnectionShard>;
+
+        void initLoopThread(EventLoop *loop);
+        void newConnection(int sockfd, const InetAddress &peerAddr);
+        static void addConnectionInLoop(const ConnectionShardPtr &shard, const TcpConnectionPtr &conn);
+        // 连接的closeCallback只持有shard，TcpServer析构之后关闭的连接也不会访问到已销毁的TcpServer
+        static void removeConnection(const ConnectionShardPtr &shard, const TcpConnectionPtr &conn);
+        static void destroyConnectionsInLoop(const ConnectionShardPtr &shard);
+        void drainInLoop(double timeoutSeconds, const DrainCallback &cb);
+        void checkDrained(Timestamp deadline, bool forced, const DrainCallback &cb);
+        static void drainShardInLoop(const ConnectionShardPtr &shard, const ConnectionCallback &cb);
+        static void forceCloseShardInLoop(const ConnectionShardPtr &shard);
 
         EventLoop *loop_; // the acceptor loop，也就是baseloop 用户定义的loop
 
@@ -66,10 +129,17 @@ namespace mymuduo
         MessageCallback messageCallback_;                 // 有读写消息时的回调
         WriteCompleteCallback writeCompleteCallback_;     // 消息发送完成以后的回调
         ThreadInitCallback threadInitCallback_;           // loop线程初始化的回调
+        ConnectionCallback drainConnectionCallback_;      // drain时对每个连接执行的回调
         std::atomic_int started_;
 
-        int nextConnId_;
-        ConnectionMap connections_; // 所有的连接
+        double busyPollSpinSeconds_;
+        int busyPollUsecs_;
+        TlsContext *tlsContext_;
+
+        const std::shared_ptr<const std::string> connNamePrefix_; // "name-ip:port"，所有连接共享
+        uint64_t nextConnId_;                                     // 只在baseloop里分配
+        // start()之后只读，baseloop按ioLoop找到对应的shard
+        std::unordered_map<EventLoop *, ConnectionShardPtr> shards_;
     };
 
 } // namespace mymuduo
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+#include "mymuduo/Thread.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mymuduo
+{
+    /**
+     * @brief 计算线程池，用来执行会阻塞IO线程的任务(磁盘IO、CPU密集的计算)，结果再通过EventLoop::runInLoop送回IO线程
+     * 每个工作线程有自己的任务队列：
+     * - 在工作线程里提交的任务放进自己队列的尾部，自己从尾部取(LIFO，cache更热)
+     * - 其他线程(比如IO线程)提交的任务轮询放进各个队列
+     * - 自己的队列空了就从其他队列的头部偷任务
+     * 每个队列一把锁，IO线程提交任务时不会和所有工作线程争同一把锁。
+     */
+    class ThreadPool : noncopyable
+    {
+    public:
+        using Task = std::function<void()>;
+
+        explicit ThreadPool(const std::string &nameArg = std::string("ThreadPool"));
+        ~ThreadPool();
+
+        void start(int numThreads);
+        // 等队列里已有的任务执行完后回收线程，stop之后不能再调用run
+        void stop();
+
+        // 线程安全。线程池没有启动(numThreads为0)时在调用线程直接执行
+        void run(Task task);
+
+        // 近似值，任务入队和计数之间有短暂的窗口
+        int64_t queueSize() const { return pending_.load(std::memory_order_relaxed); }
+        const std::string &name() const { return name_; }
+
+    private:
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void runInThread(int index);
+        bool take(int index, Task *task);
+
+        std::string name_;
+        std::vector<std::unique_ptr<Thread>> threads_;
+        std::vector<std::unique_ptr<WorkQueue>> queues_;
+
+        // 只用来让空闲线程睡眠/唤醒，任务本身在各自的WorkQueue里
+        std::mutex mutex_;
+        std::condition_variable notEmpty_;
+        std::atomic<int64_t> pending_; // 可能短暂为负：任务已被取走但提交方还没来得及计数
+        std::atomic_uint next_;
+        bool running_;
+    };
+} // namespace mymuduo
@@ -9,6 +9,7 @@ namespace mymuduo
     class TimerId
     {
     public:
+        TimerId() : timer_(), sequence_(0) {}
         TimerId(std::shared_ptr<Timer> timer, int64_t seq) : timer_(timer), sequence_(seq){};
         friend class TimerQueue;
 
@@ -55,9 +55,6 @@ namespace mymuduo
         // Timer set sorted by expiration
         TimerSet timers_;
 
-        //for getExpired
-        std::shared_ptr<Timer> timerEntryPtr_;
-        
         // for cancel()
         ActiveTimerSet activeTimers_;
         std::atomic<bool> callingExpiredTimers_; /* atomic */
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+
+#include <string>
+#include <vector>
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+namespace mymuduo
+{
+    /**
+     * @brief 服务端的TLS配置：证书、ALPN、会话复用，见TcpServer::setTlsContext
+     * 多个IO线程的所有连接共享同一个TlsContext，配置要在TcpServer::start()之前完成，之后只读。
+     * 编译时没有找到OpenSSL时available()返回false，loadCertificate总是失败
+     */
+    class TlsContext : noncopyable
+    {
+    public:
+        TlsContext();
+        ~TlsContext();
+
+        static bool available();
+
+        // PEM格式的证书链和私钥，失败时记录日志并返回false
+        bool loadCertificate(const std::string &certFile, const std::string &keyFile);
+        // 证书和私钥都已经加载成功
+        bool ready() const { return ready_; }
+
+        // ALPN，按服务器的偏好排列，比如{"h2", "http/1.1"}。客户端支持的都不在列表里时不选协议，握手照常完成
+        void setAlpnProtocols(const std::vector<std::string> &protocols);
+        // 服务端会话缓存(TLS 1.2的session id和TLS 1.3关闭票据时的会话)，默认20480条。size为0时关闭缓存
+        void setSessionCacheSize(size_t size);
+        // 会话缓存和票据的有效期，默认300秒
+        void setSessionTimeout(int seconds);
+        // 会话票据，默认开启。票据密钥由OpenSSL在进程内随机生成，热重启换进程后旧票据失效，退化为完整握手
+        void setSessionTickets(bool on);
+
+        SSL_CTX *nativeHandle() const { return ctx_; }
+
+    private:
+        SSL_CTX *ctx_;
+        bool ready_;
+        std::string alpn_; // ALPN的线上格式：长度前缀的协议名依次拼接
+    };
+
+} // namespace mymuduo
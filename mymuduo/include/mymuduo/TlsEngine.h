@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+#include "mymuduo/Buffer.h"
+
+#include <string>
+
+typedef struct ssl_st SSL;
+typedef struct bio_st BIO;
+
+namespace mymuduo
+{
+    class TlsContext;
+
+    /**
+     * @brief 一个TLS连接的记录层，TcpConnection内部使用，见TcpConnection::startTls
+     * OpenSSL不直接读写socket，而是读写一个以两个Buffer为后端的内存BIO：TcpConnection把读到的密文放进input()，
+     * decrypt()推进握手并解出明文；encrypt()和握手产生的密文追加到output()，由TcpConnection取走后走原来的输出缓冲区发送。
+     * 这样TLS连接的读写、高水位、暂停读都和明文连接走同一条路径。只能在连接所在的IO线程使用
+     */
+    class TlsEngine : noncopyable
+    {
+    public:
+        explicit TlsEngine(TlsContext *context);
+        ~TlsEngine();
+
+        // 从socket读到、还没处理的密文
+        Buffer *input() { return &input_; }
+        // 处理input()里的全部密文，解出的明文追加到plain。握手失败或者收到非法记录时返回false，连接应当关闭
+        bool decrypt(Buffer *plain);
+        // 握手完成之前明文先暂存，完成后再加密
+        bool encrypt(const void *data, size_t len);
+        // 发送close_notify，只发一次
+        void shutdown();
+
+        // 待发送的密文，取走后retrieveAll()
+        Buffer *output() { return &output_; }
+
+        bool handshakeDone() const { return handshakeDone_; }
+        // 对方发来了close_notify
+        bool peerClosed() const { return peerClosed_; }
+        bool shutdownSent() const { return shutdownSent_; }
+        // 协商出的ALPN协议，没有时为空
+        std::string alpnProtocol() const;
+        bool sessionReused() const;
+
+    private:
+        bool handshake();
+        // 加密暂存的明文
+        bool flushPending();
+
+        // BIO的回调
+        static int bioRead(BIO *bio, char *data, int len);
+        static int bioWrite(BIO *bio, const char *data, int len);
+
+        SSL *ssl_;
+        Buffer input_;
+        Buffer output_;
+        Buffer pending_; // 握手完成之前要发送的明文
+        bool handshakeDone_;
+        bool peerClosed_;
+        bool shutdownSent_;
+    };
+
+} // namespace mymuduo
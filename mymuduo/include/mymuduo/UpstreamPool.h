@@ -0,0 +1,87 @@
+#pragma once
+
+#include "mymuduo/noncopyable.h"
+#include "mymuduo/Callbacks.h"
+#include "mymuduo/Connector.h"
+#include "mymuduo/InetAddress.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace mymuduo
+{
+    class EventLoop;
+
+    /**
+     * @brief 一个IO loop到一个上游地址的连接池，所有方法都只能在loop线程里调用
+     * 处理请求的回调直接在同一个loop上访问后端，不需要切换线程，也没有锁：
+     *   pool->acquire([](const TcpConnectionPtr &conn) {
+     *       if (!conn) { ...连接失败... return; }
+     *       conn->setContext(请求状态); conn->send(请求);
+     *   });
+     *   // 在pool的MessageCallback里读完响应后
+     *   pool->release(conn); // 连接还能复用(keep-alive)时放回空闲列表，否则直接关闭
+     * 和TcpServer一样，消息回调是整个池共用的，每次请求的状态挂在TcpConnection的context上。
+     * 空闲连接上收到数据或者被对端关闭时直接丢弃，不会再交给acquire。
+     */
+    class UpstreamPool : noncopyable
+    {
+    public:
+        // conn为空表示连接失败(重试次数用完或超时)
+        using AcquireCallback = std::function<void(const TcpConnectionPtr &)>;
+
+        UpstreamPool(EventLoop *loop, const InetAddress &serverAddr, const std::string &name);
+        ~UpstreamPool();
+
+        EventLoop *getLoop() const { return loop_; }
+        const InetAddress &serverAddress() const { return serverAddr_; }
+
+        // 最多保留多少条空闲连接，默认16
+        void setMaxIdle(size_t maxIdle) { maxIdle_ = maxIdle; }
+        // 新建连接的超时和失败后的重试次数，默认3秒、重试1次
+        void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+        void setConnectRetries(int retries) { connectRetries_ = retries; }
+
+        // 连接建立和断开(包括使用中被对端关闭)时调用
+        void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+        // 只对acquire出去、还没有release的连接调用
+        void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+        void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+        // 优先复用最近放回的空闲连接，没有时新建连接，建立后再回调
+        void acquire(const AcquireCallback &cb);
+        // 连接可以继续复用时放回池里；已经断开或空闲连接太多时关闭
+        void release(const TcpConnectionPtr &conn);
+
+        size_t numIdle() const { return idle_.size(); }
+        size_t numConnections() const { return connections_.size(); }
+        size_t numConnecting() const { return connecting_.size(); }
+
+    private:
+        void onConnected(Connector *connector, const AcquireCallback &cb, int sockfd);
+        void onConnectFailed(Connector *connector, const AcquireCallback &cb);
+        ConnectorPtr takeConnector(Connector *connector);
+        void onConnection(const TcpConnectionPtr &conn);
+        void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+        void removeConnection(const TcpConnectionPtr &conn);
+        bool removeIdle(const TcpConnectionPtr &conn);
+
+        EventLoop *loop_;
+        const InetAddress serverAddr_;
+        const std::shared_ptr<const std::string> connNamePrefix_;
+        size_t maxIdle_;
+        double connectTimeout_;
+        int connectRetries_;
+        ConnectionCallback connectionCallback_;
+        MessageCallback messageCallback_;
+        WriteCompleteCallback writeCompleteCallback_;
+
+        uint64_t nextConnId_;
+        std::map<Connector *, ConnectorPtr> connecting_;
+        std::unordered_map<uint64_t, TcpConnectionPtr> connections_; // 池里所有已建立的连接，包括使用中的
+        std::vector<TcpConnectionPtr> idle_;                         // 按放回的先后排列，从尾部取
+    };
+} // namespace mymuduo
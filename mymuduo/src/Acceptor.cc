@@ -32,10 +32,27 @@ namespace mymuduo
         acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
     }
 
+    Acceptor::Acceptor(EventLoop *loop, int listenFd)
+        : loop_(loop), acceptSocket_(listenFd), acceptChannel_(loop, listenFd), listenning_(false)
+    {
+        int accepting = 0;
+        socklen_t len = sizeof accepting;
+        if (::getsockopt(listenFd, SOL_SOCKET, SO_ACCEPTCONN, &accepting, &len) < 0 || !accepting)
+        {
+            LOG_FMT_FATAL("%s:%s:%d fd %d is not a listening socket \n", __FILE__, __FUNCTION__, __LINE__, listenFd);
+        }
+        // 文件状态标志跟着打开的文件走，旧进程里设置的O_NONBLOCK在这里依然有效
+        acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
+    }
+
     Acceptor::~Acceptor()
     {
-        acceptChannel_.disableAll();
-        acceptChannel_.remove();
+        // 没有listen或者已经stopListening时channel不在poller里
+        if (listenning_)
+        {
+            acceptChannel_.disableAll();
+            acceptChannel_.remove();
+        }
     }
 
     void Acceptor::listen()
@@ -46,6 +63,23 @@ namespace mymuduo
         acceptChannel_.enableReading();
     }
 
+    void Acceptor::stopListening(bool shutdownSocket)
+    {
+        loop_->assertInLoopThread();
+        if (listenning_)
+        {
+            listenning_ = false;
+            acceptChannel_.disableAll();
+            acceptChannel_.remove();
+            if (shutdownSocket)
+            {
+                // Linux上对监听socket做SHUT_RD会停止监听，内核不再完成新的握手，
+                // 客户端马上收到RST而不是一直卡在backlog里等待
+                ::shutdown(acceptSocket_.fd(), SHUT_RD);
+            }
+        }
+    }
+
     // listenfd有事件发生了，就是有新用户连接了
     void Acceptor::handleRead()
     {
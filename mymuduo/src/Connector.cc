@@ -0,0 +1,255 @@
+#include "mymuduo/Connector.h"
+#include "mymuduo/Channel.h"
+#include "mymuduo/EventLoop.h"
+#include "mymuduo/Logger.h"
+#include "mymuduo/Socket.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <assert.h>
+
+namespace mymuduo
+{
+    const int Connector::kMaxRetryDelayMs;
+    const int Connector::kInitRetryDelayMs;
+
+    Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+        : loop_(loop), serverAddr_(serverAddr), connect_(false), state_(kDisconnected), retryDelayMs_(kInitRetryDelayMs), maxRetries_(-1), retries_(0), connectTimeout_(0)
+    {
+        LOG_FMT_DEBUG("Connector::ctor[%p] \n", this);
+    }
+
+    Connector::~Connector()
+    {
+        LOG_FMT_DEBUG("Connector::dtor[%p] \n", this);
+        assert(!channel_);
+    }
+
+    void Connector::start()
+    {
+        connect_ = true;
+        loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+    }
+
+    void Connector::startInLoop()
+    {
+        loop_->assertInLoopThread();
+        if (state_ != kDisconnected)
+        {
+            return; // 重试定时器和restart()可能同时触发
+        }
+        if (connect_)
+        {
+            connect();
+        }
+        else
+        {
+            LOG_FMT_DEBUG("Connector::startInLoop do not connect \n");
+        }
+    }
+
+    void Connector::stop()
+    {
+        connect_ = false;
+        loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+    }
+
+    void Connector::stopInLoop()
+    {
+        loop_->assertInLoopThread();
+        loop_->cancel(retryTimer_);
+        retryTimer_ = TimerId();
+        if (state_ == kConnecting)
+        {
+            setState(kDisconnected);
+            int sockfd = removeAndResetChannel();
+            retry(sockfd); // connect_为false，只会关闭sockfd
+        }
+    }
+
+    void Connector::connect()
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+        {
+            LOG_FMT_ERROR("Connector::connect socket err: %d \n", errno);
+            return;
+        }
+        int ret = ::connect(sockfd, (sockaddr *)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+        int savedErrno = (ret == 0) ? 0 : errno;
+        switch (savedErrno)
+        {
+        case 0:
+        case EINPROGRESS:
+        case EINTR:
+        case EISCONN:
+            connecting(sockfd);
+            break;
+
+        case EAGAIN:
+        case EADDRINUSE:
+        case EADDRNOTAVAIL:
+        case ECONNREFUSED:
+        case ENETUNREACH:
+            retry(sockfd);
+            break;
+
+        case EACCES:
+        case EPERM:
+        case EAFNOSUPPORT:
+        case EALREADY:
+        case EBADF:
+        case EFAULT:
+        case ENOTSOCK:
+            LOG_FMT_ERROR("Connector::connect %s err: %d \n", serverAddr_.toIPport().c_str(), savedErrno);
+            ::close(sockfd);
+            break;
+
+        default:
+            LOG_FMT_ERROR("Connector::connect unexpected err: %d \n", savedErrno);
+            ::close(sockfd);
+            break;
+        }
+    }
+
+    void Connector::restart()
+    {
+        loop_->assertInLoopThread();
+        setState(kDisconnected);
+        retryDelayMs_ = kInitRetryDelayMs;
+        retries_ = 0;
+        connect_ = true;
+        startInLoop();
+    }
+
+    void Connector::connecting(int sockfd)
+    {
+        setState(kConnecting);
+        assert(!channel_);
+        channel_.reset(new Channel(loop_, sockfd));
+        // 连接成功或失败时socket都会变得可写
+        channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+        channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+        channel_->enableWriting();
+        if (connectTimeout_ > 0)
+        {
+            // TimerId持有Timer，Timer的回调再持有Connector就成了环，取消或者触发之后都不会释放，所以只绑weak_ptr
+            std::weak_ptr<Connector> weakSelf(shared_from_this());
+            timeoutTimer_ = loop_->runAfter(connectTimeout_, [weakSelf]() {
+                ConnectorPtr self(weakSelf.lock());
+                if (self)
+                {
+                    self->handleTimeout();
+                }
+            });
+        }
+    }
+
+    int Connector::removeAndResetChannel()
+    {
+        loop_->cancel(timeoutTimer_);
+        timeoutTimer_ = TimerId();
+        channel_->disableAll();
+        channel_->remove();
+        int sockfd = channel_->fd();
+        // 可能正在Channel::handleEvent里，不能在这里reset channel_
+        loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+        return sockfd;
+    }
+
+    void Connector::resetChannel()
+    {
+        channel_.reset();
+    }
+
+    void Connector::handleWrite()
+    {
+        LOG_FMT_DEBUG("Connector::handleWrite state=%d \n", state_);
+        if (state_ == kConnecting)
+        {
+            int sockfd = removeAndResetChannel();
+            int err = Socket::socketError(sockfd);
+            if (err)
+            {
+                LOG_FMT_ERROR("Connector::handleWrite %s SO_ERROR = %d %s \n", serverAddr_.toIPport().c_str(), err, strerror(err));
+                retry(sockfd);
+            }
+            else if (Socket::isSelfConnect(sockfd))
+            {
+                LOG_FMT_ERROR("Connector::handleWrite - Self connect \n");
+                retry(sockfd);
+            }
+            else
+            {
+                setState(kConnected);
+                if (connect_ && newConnectionCallback_)
+                {
+                    newConnectionCallback_(sockfd);
+                }
+                else
+                {
+                    ::close(sockfd);
+                }
+            }
+        }
+    }
+
+    void Connector::handleError()
+    {
+        LOG_FMT_ERROR("Connector::handleError state=%d \n", state_);
+        if (state_ == kConnecting)
+        {
+            int sockfd = removeAndResetChannel();
+            int err = Socket::socketError(sockfd);
+            (void)err; // 没有开FMT_DEBUG时LOG_FMT_DEBUG展开为空
+            LOG_FMT_DEBUG("SO_ERROR = %d %s \n", err, strerror(err));
+            retry(sockfd);
+        }
+    }
+
+    void Connector::handleTimeout()
+    {
+        if (state_ == kConnecting)
+        {
+            LOG_FMT_ERROR("Connector::handleTimeout %s after %.3fs \n", serverAddr_.toIPport().c_str(), connectTimeout_);
+            int sockfd = removeAndResetChannel();
+            retry(sockfd);
+        }
+    }
+
+    void Connector::retry(int sockfd)
+    {
+        ::close(sockfd);
+        setState(kDisconnected);
+        if (!connect_)
+        {
+            LOG_FMT_DEBUG("Connector::retry do not connect \n");
+            return;
+        }
+        if (maxRetries_ >= 0 && retries_ >= maxRetries_)
+        {
+            LOG_FMT_ERROR("Connector::retry - give up connecting to %s after %d retries \n", serverAddr_.toIPport().c_str(), retries_);
+            connect_ = false;
+            if (connectFailedCallback_)
+            {
+                connectFailedCallback_();
+            }
+            return;
+        }
+        LOG_FMT_INFO("Connector::retry - Retry connecting to %s in %d milliseconds. \n", serverAddr_.toIPport().c_str(), retryDelayMs_);
+        ++retries_;
+        // 和超时定时器一样只绑weak_ptr，等待重试期间由TcpClient/UpstreamPool持有Connector
+        std::weak_ptr<Connector> weakSelf(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weakSelf]() {
+            ConnectorPtr self(weakSelf.lock());
+            if (self)
+            {
+                self->startInLoop();
+            }
+        });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+    }
+} // namespace mymuduo
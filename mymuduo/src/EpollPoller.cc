@@ -1,20 +1,47 @@
 #include "mymuduo/EpollPoller.h"
 #include "mymuduo/Logger.h"
 #include "mymuduo/Channel.h"
+#include "mymuduo/Metrics.h"
 
 #include <errno.h>
 #include <unistd.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <sys/ioctl.h>
+
+// 较旧的glibc头文件里没有epoll的busy poll参数，按Linux 6.9的ABI定义
+#ifndef EPIOCSPARAMS
+struct epoll_params
+{
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t __pad;
+};
+#define EPOLL_IOC_TYPE 0x8A
+#define EPIOCSPARAMS _IOW(EPOLL_IOC_TYPE, 0x01, struct epoll_params)
+#endif
 
 namespace mymuduo
 {
     const int kNew = -1;    // Channel的成员index_ = -1,表示channel object未添加到Poller中
-    const int kAdded = 1;   // 已添加
-    const int kDeleted = 2; // 已删除
+    const int kAdded = 1;   // 已添加到channel表，是否在内核的兴趣列表里看ChannelSlot::registeredEvents
+
+    namespace
+    {
+        Counter *const g_epollWaits = MetricsRegistry::instance().counter(
+            "mymuduo_epoll_wait_total", "Number of epoll_wait calls.");
+        Counter *const g_epollEvents = MetricsRegistry::instance().counter(
+            "mymuduo_epoll_events_total", "Number of events returned by epoll_wait.");
+        Counter *const g_epollCtls = MetricsRegistry::instance().counter(
+            "mymuduo_epoll_ctl_total", "Number of epoll_ctl calls.");
+        Counter *const g_epollCtlsCoalesced = MetricsRegistry::instance().counter(
+            "mymuduo_epoll_ctl_coalesced_total", "Interest changes that cancelled out before the next poll.");
+    } // namespace
 
     EpollPoller::EpollPoller(EventLoop *loop)
-        : Poller(loop), epollfd_(::epoll_create1(EPOLL_CLOEXEC)), events_(kInitEventListSize)
+        : Poller(loop), epollfd_(::epoll_create1(EPOLL_CLOEXEC)), events_(kInitEventListSize), numChannels_(0)
     {
         if (epollfd_ < 0)
         {
@@ -31,14 +58,17 @@ namespace mymuduo
     Timestamp EpollPoller::poll(int timeoutMs, ChannelList *activeChannels)
     {
         // 实际上应该用LOG_FMT_DEBUG输出日志更为合理
-        LOG_FMT_DEBUG("func= %s => fd total count:%lu \n", channels_.size());
+        LOG_FMT_DEBUG("func= %s => fd total count:%lu \n", __FUNCTION__, numChannels_);
 
+        flushChanges();
         int numEvents = ::epoll_wait(epollfd_, &(*events_.begin()), static_cast<int>(events_.size()), timeoutMs);
         int saveError = errno;
         Timestamp now(Timestamp::now());
+        g_epollWaits->increment();
 
         if (numEvents > 0)
         {
+            g_epollEvents->add(numEvents);
             LOG_FMT_INFO("%d events happened", numEvents);
             LOG_INFO << events_.size();
             fillActiveChannels(numEvents, activeChannels);
@@ -64,79 +94,130 @@ namespace mymuduo
         return now;
     }
 
+    bool EpollPoller::setBusyPoll(int usecs, int budget)
+    {
+        epoll_params params;
+        ::bzero(&params, sizeof params);
+        params.busy_poll_usecs = usecs;
+        params.busy_poll_budget = static_cast<uint16_t>(budget);
+        params.prefer_busy_poll = usecs > 0 ? 1 : 0;
+        if (::ioctl(epollfd_, EPIOCSPARAMS, &params) < 0)
+        {
+            LOG_FMT_ERROR("EpollPoller::setBusyPoll usecs=%d err=%d \n", usecs, errno);
+            return false;
+        }
+        return true;
+    }
+
     // channel update remove => EventLoop updateChannel removeChannel => Poller
     /**
      *              EventLoop
      *      ChannelList     Poller
      *                        |
-     *                     ChannelMap<fd, Channel*>
+     *                     ChannelTable[fd] = {Channel*, generation}
      * channel
+     * updateChannel只记录变化，epoll_ctl推迟到下一次poll之前由flushChanges统一执行
      */
     void EpollPoller::updateChannel(Channel *channel)
     {
         Poller::assertInLoopThread();
         const int index = channel->index();
-        LOG_FMT_INFO("func = %s => fd = %d events = %d index = %d \n", __FUNCTION__, channel->fd(), channel->events(), index);
+        const int fd = channel->fd();
+        LOG_FMT_INFO("func = %s => fd = %d events = %d index = %d \n", __FUNCTION__, fd, channel->events(), index);
 
-        if (index == kNew || index == kDeleted)
+        if (index == kNew)
         {
-            int fd = channel->fd();
-            if (index == kNew)
+            if (static_cast<size_t>(fd) >= channelTable_.size())
             {
-                assert(channels_.find(fd) == channels_.end());
-                channels_[fd] = channel;
-            }
-            else // index = kDeleted
-            {
-                assert(channels_.find(fd) != channels_.end());
-                assert(channels_[fd] == channel);
+                // 按2倍扩容，新槽位channel为空、generation为0
+                channelTable_.resize(std::max<size_t>(fd + 1, channelTable_.size() * 2), ChannelSlot{nullptr, 0, 0, false});
             }
+            ChannelSlot &slot = channelTable_[fd];
+            assert(slot.channel == nullptr);
+            slot.channel = channel;
+            ++slot.generation;
+            slot.registeredEvents = 0;
+            ++numChannels_;
             channel->set_index(kAdded);
-            update(EPOLL_CTL_ADD, channel);
         }
         else
         {
-            // update existing one with EPOLL_CTL_MOD/DEL
-            int fd = channel->fd();
-            (void)fd;
-            assert(channels_.find(fd) != channels_.end());
-            assert(channels_[fd] == channel);
+            assert(hasChannel(channel));
             assert(index == kAdded);
-            if (channel->isNoneEvent())
+        }
+
+        ChannelSlot &slot = channelTable_[fd];
+        if (!slot.dirty)
+        {
+            slot.dirty = true;
+            dirtyFds_.push_back(fd);
+        }
+    }
+
+    void EpollPoller::flushChanges()
+    {
+        for (int fd : dirtyFds_)
+        {
+            ChannelSlot &slot = channelTable_[fd];
+            if (!slot.dirty)
+            {
+                continue; // 同一个fd在本轮被移除后又重新注册，已经处理过
+            }
+            slot.dirty = false;
+            if (slot.channel == nullptr)
+            {
+                continue; // 已经removeChannel
+            }
+
+            const uint32_t events = static_cast<uint32_t>(slot.channel->events());
+            if (events == slot.registeredEvents)
+            {
+                g_epollCtlsCoalesced->increment();
+            }
+            else if (slot.registeredEvents == 0)
             {
-                update(EPOLL_CTL_DEL, channel);
-                channel->set_index(kDeleted);
+                update(EPOLL_CTL_ADD, fd, events);
+            }
+            else if (events == 0)
+            {
+                update(EPOLL_CTL_DEL, fd, events);
             }
             else
             {
-                update(EPOLL_CTL_MOD, channel);
+                update(EPOLL_CTL_MOD, fd, events);
             }
+            slot.registeredEvents = events;
         }
+        dirtyFds_.clear();
     }
+
     /**
      * @brief 从poller中删除channel
-     *
+     * 调用方接下来通常会close(fd)，所以这里立即从epoll中删除，不推迟
      * @param channel
      */
     void EpollPoller::removeChannel(Channel *channel)
     {
         int fd = channel->fd();
-        channels_.erase(fd);
+        assert(hasChannel(channel));
+        ChannelSlot &slot = channelTable_[fd];
 
         LOG_FMT_INFO("func = %s => fd = %d\n", __FUNCTION__, fd);
 
-        int index = channel->index();
-        if (index == kAdded)
+        if (slot.registeredEvents != 0)
         {
-            update(EPOLL_CTL_DEL, channel);
+            update(EPOLL_CTL_DEL, fd, 0);
         }
+        slot.channel = nullptr;
+        slot.registeredEvents = 0;
+        --numChannels_;
         channel->set_index(kNew);
     }
 
     bool EpollPoller::hasChannel(Channel *channel) const
     {
-        ChannelMap::const_iterator it = channels_.find(channel->fd());
-        return it != channels_.end() && it->second == channel;
+        const size_t fd = static_cast<size_t>(channel->fd());
+        return fd < channelTable_.size() && channelTable_[fd].channel == channel;
     }
 
     void EpollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const
@@ -144,23 +225,22 @@ namespace mymuduo
         assert(static_cast<size_t>(numEvents) <= events_.size());
         for (int i = 0; i < numEvents; ++i)
         {
-            /*LOG_INFO << events_[i].data.ptr;
-            Channel *channel = static_cast<Channel *>(events_[i].data.ptr);
-            // if(hasChannel(channel))
-            //     LOG_INFO << "EpollPoller has channel*";
-            LOG_INFO << "Channel ptr found";
-            LOG_INFO << "events_[i].data.fd = " << events_[i].data.fd;
-            channel->set_revents(events_[i].events);
-            activeChannels->push_back(channel);
-            */
-            auto iter = channels_.find(events_[i].data.fd);
-            if (iter != channels_.end())
+            // data.u64：低32位fd，高32位注册时的generation，一次数组访问找到channel
+            const uint64_t data = events_[i].data.u64;
+            const uint32_t fd = static_cast<uint32_t>(data);
+            const uint32_t generation = static_cast<uint32_t>(data >> 32);
+            assert(fd < channelTable_.size());
+            const ChannelSlot &slot = channelTable_[fd];
+            if (slot.channel && slot.generation == generation)
             {
-                LOG_INFO << "Truely found channel*";
-                Channel *channel = iter->second;
+                Channel *channel = slot.channel;
                 channel->set_revents(events_[i].events);
                 activeChannels->push_back(channel);
             }
+            else
+            {
+                LOG_FMT_DEBUG("stale epoll event fd=%u generation=%u \n", fd, generation);
+            }
         }
     }
 
@@ -170,17 +250,17 @@ namespace mymuduo
      * @param operation
      * @param channel
      */
-    void EpollPoller::update(int operation, Channel *channel)
+    void EpollPoller::update(int operation, int fd, uint32_t events)
     {
         epoll_event event;
         // ::memset(&event, 0, sizeof event);
         ::bzero(&event, sizeof event);
-        int fd = channel->fd();
-        event.events = channel->events();
-        event.data.ptr = channel;
-        event.data.fd = fd;
+        event.events = events;
+        // data是union，不能同时存ptr和fd
+        event.data.u64 = static_cast<uint64_t>(channelTable_[fd].generation) << 32 | static_cast<uint32_t>(fd);
         LOG_INFO << "epoll_ctl op = " << operationToString(operation)
-                 << " fd = " << fd << " event = { " << channel->eventsToString() << " }";
+                 << " fd = " << fd << " event = { " << Channel::eventsToString(fd, events) << " }";
+        g_epollCtls->increment();
         if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
         {
             if (operation == EPOLL_CTL_DEL)
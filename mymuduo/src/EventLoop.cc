@@ -3,13 +3,17 @@
 #include "mymuduo/Poller.h"
 #include "mymuduo/Channel.h"
 #include "mymuduo/TimerQueue.h"
+#include "mymuduo/Metrics.h"
 
 #include <sys/eventfd.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <memory>
+#include <string>
+#include <typeinfo>
 #include <assert.h>
+#include <signal.h>
 
 namespace mymuduo
 {
@@ -30,6 +34,49 @@ namespace mymuduo
     // 定义默认的Poller IO复用接口的超时时间
     const int kPollTimeMs = 10000;
 
+    namespace
+    {
+        // 对端已经关闭时write会触发SIGPIPE，默认动作是结束进程；忽略后write返回EPIPE，由TcpConnection处理
+        struct IgnoreSigPipe
+        {
+            IgnoreSigPipe() { ::signal(SIGPIPE, SIG_IGN); }
+        } g_ignoreSigPipe;
+
+        // 所有EventLoop共享的指标，写入时落在各自线程的分片上
+        Counter *const g_loopIterations = MetricsRegistry::instance().counter(
+            "mymuduo_eventloop_iterations_total", "Number of event loop iterations.");
+        Counter *const g_loopWakeups = MetricsRegistry::instance().counter(
+            "mymuduo_eventloop_wakeups_total", "Number of eventfd wakeups written to event loops.");
+        Counter *const g_functorsExecuted = MetricsRegistry::instance().counter(
+            "mymuduo_eventloop_functors_executed_total", "Number of queued functors executed by event loops.");
+        Gauge *const g_pendingFunctors = MetricsRegistry::instance().gauge(
+            "mymuduo_eventloop_pending_functors", "Functors queued but not yet executed, summed over all loops.");
+        Counter *const g_loopStalls = MetricsRegistry::instance().counter(
+            "mymuduo_eventloop_stalls_total", "Channel handlers or functors that exceeded the stall threshold.");
+
+        inline int64_t microsBetween(Timestamp start, Timestamp end)
+        {
+            return end.microSecondsSinceEpoch() - start.microSecondsSinceEpoch();
+        }
+
+        Histogram *loopHistogram(const char *name, const char *help, pid_t tid)
+        {
+            return MetricsRegistry::instance().histogram(name, help, "loop=\"" + std::to_string(tid) + "\"", 1);
+        }
+
+        void defaultStallCallback(const EventLoop::Stall &stall)
+        {
+            if (stall.functor)
+            {
+                LOG_ERROR << "EventLoop stalled " << stall.elapsedMicros << "us in pending functor " << stall.functor;
+            }
+            else
+            {
+                LOG_ERROR << "EventLoop stalled " << stall.elapsedMicros << "us handling channel fd=" << stall.fd;
+            }
+        }
+    } // namespace
+
     // 定义一个全局函数，而不是EventLoop的方法
     // 创建wakeupfd，用来通知并唤醒subReactor
     int createEventfd()
@@ -47,7 +94,14 @@ namespace mymuduo
         : looping_(false), quit_(false), callingPendingFunctors_(false), threadId_(CurrentThread::tid())
           , poller_(Poller::newDefaultPoller(this))
           //,poller_(new EpollPoller(this))
+          , timerQueue_(new TimerQueue(this))
           , wakeupFd_(createEventfd()), wakeupChannel_(new Channel(this, wakeupFd_)), currentActiveChannel_(nullptr)
+          , pollLatency_(loopHistogram("mymuduo_eventloop_poll_seconds", "Time blocked in the poller per iteration.", threadId_))
+          , dispatchLatency_(loopHistogram("mymuduo_eventloop_dispatch_seconds", "Time spent in channel handlers per iteration.", threadId_))
+          , functorsLatency_(loopHistogram("mymuduo_eventloop_functors_seconds", "Time spent in pending functors per iteration.", threadId_))
+          , stallThresholdMicros_(0), stallCallback_(defaultStallCallback)
+          , busyPollSpinMicros_(0)
+          , numConnections_(0), pendingBytes_(0)
     {
         LOG_FMT_DEBUG("EventLoop created %p in thread %d \n", this, threadId_);
         if (t_loopInThisThread)
@@ -80,24 +134,53 @@ namespace mymuduo
         quit_ = false;
         LOG_FMT_INFO("EventLoop %p start looping \n", this);
 
+        Timestamp iterationStart = Timestamp::now();
         while (!quit_)
         {
             activeChannels_.clear();
             LOG_INFO << activeChannels_.size();
             // 监听两类fd   一种是client的fd 一种是wakeup的fd
-            pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+            // 忙轮询预算内不睡眠
+            const bool spinning = busyPollSpinMicros_ > 0 &&
+                                  microsBetween(lastActivity_, iterationStart) < busyPollSpinMicros_;
+            pollReturnTime_ = poller_->poll(spinning ? 0 : kPollTimeMs, &activeChannels_);
+            pollLatency_->record(microsBetween(iterationStart, pollReturnTime_));
+
+            // 开启阈值时逐个Channel计时，相邻两次计时首尾相接，分发阶段的总耗时不需要额外取时间
+            Timestamp last = pollReturnTime_;
             for (Channel *channel : activeChannels_)
             {
+                currentActiveChannel_ = channel;
+                const int fd = channel->fd(); // handleEvent之后channel可能已经析构
                 // Poller监听哪些channel发生事件了，然后上报给EventLoop
                 channel->handleEvent(pollReturnTime_);
+                if (stallThresholdMicros_ > 0)
+                {
+                    Timestamp now = Timestamp::now();
+                    if (microsBetween(last, now) > stallThresholdMicros_)
+                    {
+                        reportStall("channel", fd, nullptr, microsBetween(last, now), now);
+                    }
+                    last = now;
+                }
             }
+            currentActiveChannel_ = nullptr;
+            Timestamp dispatchEnd = stallThresholdMicros_ > 0 ? last : Timestamp::now();
+            dispatchLatency_->record(microsBetween(pollReturnTime_, dispatchEnd));
             // 执行当前EventLoop事件循环需要处理的回调操作
             /**
              * @brief IO mainloop accept fd<-channel打包 subloop
              * mainloop 事先注册一个回调cd(需要subloop)来执行
              * wakeup subloop后,执行doPendingFunctors()方法，执行之前mainloop注册的cb
              */
-            doPendingFunctors();
+            const size_t numFunctors = doPendingFunctors();
+            iterationStart = Timestamp::now();
+            if (!activeChannels_.empty() || numFunctors > 0)
+            {
+                lastActivity_ = iterationStart;
+            }
+            functorsLatency_->record(microsBetween(dispatchEnd, iterationStart));
+            g_loopIterations->increment();
         }
 
         LOG_FMT_INFO("EventLoop %p stop looping. \n", this);
@@ -137,6 +220,7 @@ namespace mymuduo
             std::unique_lock<std::mutex> lock(mutex_);
             pendingFunctors_.emplace_back(cb);
         }
+        g_pendingFunctors->increment();
 
         // 唤醒相应的需要执行cb执行的loop
         if (!isInLoopThread() || callingPendingFunctors_)
@@ -148,6 +232,7 @@ namespace mymuduo
     // 唤醒loop所在线程，向wakeupFd_写一个数据，wakeupchannel就发生读事件，loop就会被唤醒
     void EventLoop::wakeup()
     {
+        g_loopWakeups->increment();
         uint64_t one = 1;
         ssize_t n = write(wakeupFd_, &one, sizeof one);
         if (n != sizeof one)
@@ -173,6 +258,11 @@ namespace mymuduo
         return timerQueue_->addTimer(cb, time, interval);
     }
 
+    void EventLoop::cancel(TimerId timerId)
+    {
+        timerQueue_->cancel(timerId);
+    }
+
     void EventLoop::updateChannel(Channel *channel)
     {
         assert(channel->ownerLoop() == this);
@@ -205,8 +295,31 @@ namespace mymuduo
         }
     }
 
+    void EventLoop::setBusyPollSpin(double spinSeconds)
+    {
+        busyPollSpinMicros_ = static_cast<int64_t>(spinSeconds * Timestamp::kMicroSecondsPerSecond);
+    }
+
+    bool EventLoop::setEpollBusyPoll(int usecs, int budget)
+    {
+        return poller_->setBusyPoll(usecs, budget);
+    }
+
+    void EventLoop::setStallThreshold(double seconds, StallCallback cb)
+    {
+        stallThresholdMicros_ = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+        stallCallback_ = cb ? std::move(cb) : StallCallback(defaultStallCallback);
+    }
+
+    void EventLoop::reportStall(const char *phase, int fd, const char *functor, int64_t elapsedMicros, Timestamp when)
+    {
+        g_loopStalls->increment();
+        Stall stall = {phase, fd, functor, elapsedMicros, when};
+        stallCallback_(stall);
+    }
+
     // 执行回调
-    void EventLoop::doPendingFunctors()
+    size_t EventLoop::doPendingFunctors()
     {
         std::vector<Functor> functors;
         callingPendingFunctors_ = true;
@@ -216,11 +329,31 @@ namespace mymuduo
             functors.swap(pendingFunctors_);
         }
 
-        for (const Functor &functor : functors)
+        if (stallThresholdMicros_ > 0)
+        {
+            Timestamp last = Timestamp::now();
+            for (const Functor &functor : functors)
+            {
+                functor();
+                Timestamp now = Timestamp::now();
+                if (microsBetween(last, now) > stallThresholdMicros_)
+                {
+                    reportStall("functor", -1, functor.target_type().name(), microsBetween(last, now), now);
+                }
+                last = now;
+            }
+        }
+        else
         {
-            functor(); // 执行当前loop需要执行的回调操作
+            for (const Functor &functor : functors)
+            {
+                functor(); // 执行当前loop需要执行的回调操作
+            }
         }
+        g_pendingFunctors->add(-static_cast<int64_t>(functors.size()));
+        g_functorsExecuted->add(functors.size());
 
         callingPendingFunctors_ = false;
+        return functors.size();
     }
 } // namespace mymuduo
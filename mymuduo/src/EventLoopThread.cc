@@ -1,18 +1,26 @@
 #include "mymuduo/EventLoopThread.h"
 #include "mymuduo/EventLoop.h"
+#include "mymuduo/Logger.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 namespace mymuduo
 {
     EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
                                      const std::string &name)
-        : loop_(nullptr), exiting_(false), thread_(std::bind(&EventLoopThread::threadFunc, this), name), mutex_(), cond_(), callback_(cb)
+        : loop_(nullptr), exiting_(false), thread_(std::bind(&EventLoopThread::threadFunc, this), name), mutex_(), cond_(), callback_(cb), cpu_(-1), localMemory_(false)
     {
     }
 
     EventLoopThread::~EventLoopThread()
     {
         exiting_ = true;
-        if (!loop_)
+        if (loop_ != nullptr) // loop线程还在运行时才需要退出并回收
         {
             loop_->quit();
             thread_.join();
@@ -39,6 +47,27 @@ namespace mymuduo
     // 在单独的新线程里面运行
     void EventLoopThread::threadFunc()
     {
+        // 先绑核、设置内存策略，再创建EventLoop，之后本线程首次写入的内存都落在本地节点上
+        if (cpu_ >= 0)
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu_, &cpuset);
+            int err = ::pthread_setaffinity_np(::pthread_self(), sizeof cpuset, &cpuset);
+            if (err != 0)
+            {
+                LOG_FMT_ERROR("EventLoopThread: pthread_setaffinity_np cpu=%d err=%d \n", cpu_, err);
+            }
+        }
+        if (localMemory_)
+        {
+            // 直接用系统调用，不依赖libnuma
+            if (::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) < 0)
+            {
+                LOG_FMT_ERROR("EventLoopThread: set_mempolicy(MPOL_LOCAL) err=%d \n", errno);
+            }
+        }
+
         // oneloop per thread
         EventLoop loop; // 创建一个独立的eventloop， 和调用该方法的EventLoop的数据成员thread_是一一对应的
 
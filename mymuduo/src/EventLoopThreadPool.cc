@@ -1,12 +1,16 @@
 #include "mymuduo/EventLoopThreadPool.h"
 #include "mymuduo/EventLoopThread.h"
+#include "mymuduo/EventLoop.h"
+#include "mymuduo/InetAddress.h"
 
 #include <memory>
+#include <sys/socket.h>
 
 namespace mymuduo
 {
     EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg)
-        : baseLoop_(baseLoop), name_(nameArg), started_(false), numThreads_(0), next_(0)
+        : baseLoop_(baseLoop), name_(nameArg), started_(false), numThreads_(0), next_(0),
+          localMemory_(false), placement_(kRoundRobin), randomState_(reinterpret_cast<uintptr_t>(this) | 1)
     {
     }
 
@@ -26,12 +30,18 @@ namespace mymuduo
             // [FIXME]消灭掉所有的new
             EventLoopThread *t = new EventLoopThread(cb, buf);
             threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+            if (!cpus_.empty())
+            {
+                t->setCpu(cpus_[i % cpus_.size()]);
+                loopCpus_.push_back(cpus_[i % cpus_.size()]);
+            }
+            t->setLocalMemory(localMemory_);
             // auto t = std::make_unique<EventLoopThread>(cb, buf);
             loops_.push_back(t->startLoop()); // 底层创建线程，绑定一个新的EventLoop，并返回该loop的地址
         }
 
         // 整个服务端只有一个线程，运行着baseLoop
-        if (numThreads_ == 0)
+        if (numThreads_ == 0 && cb)
         {
             cb(baseLoop_);
         }
@@ -54,6 +64,100 @@ namespace mymuduo
         return loop;
     }
 
+    EventLoop *EventLoopThreadPool::getLoopForConnection(int sockfd, const InetAddress &peerAddr)
+    {
+        if (loops_.empty())
+        {
+            return baseLoop_;
+        }
+        if (placementPolicy_)
+        {
+            return placementPolicy_(loops_, sockfd, peerAddr);
+        }
+
+        switch (placement_)
+        {
+        case kLeastConnections:
+            return leastLoaded(&EventLoop::numConnections);
+        case kLeastPendingBytes:
+            return leastLoaded(&EventLoop::pendingBytes);
+        case kPowerOfTwoChoices:
+            return powerOfTwoChoices();
+        case kHashPeerAddress:
+            return hashPeerAddress(peerAddr);
+        case kIncomingCpu:
+            return incomingCpu(sockfd);
+        case kRoundRobin:
+        default:
+            return getNextLoop();
+        }
+    }
+
+    // 负载相同时取下标小的；计数是relaxed读，略有滞后不影响选择
+    EventLoop *EventLoopThreadPool::leastLoaded(int64_t (EventLoop::*load)() const) const
+    {
+        EventLoop *best = loops_[0];
+        int64_t bestLoad = (best->*load)();
+        for (size_t i = 1; i < loops_.size(); ++i)
+        {
+            int64_t l = (loops_[i]->*load)();
+            if (l < bestLoad)
+            {
+                best = loops_[i];
+                bestLoad = l;
+            }
+        }
+        return best;
+    }
+
+    EventLoop *EventLoopThreadPool::powerOfTwoChoices()
+    {
+        const size_t n = loops_.size();
+        if (n == 1)
+        {
+            return loops_[0];
+        }
+        // xorshift64，不需要std::random那么重的状态
+        randomState_ ^= randomState_ << 13;
+        randomState_ ^= randomState_ >> 7;
+        randomState_ ^= randomState_ << 17;
+        size_t first = randomState_ % n;
+        size_t second = (first + 1 + (randomState_ >> 32) % (n - 1)) % n; // 保证和first不同
+        EventLoop *a = loops_[first];
+        EventLoop *b = loops_[second];
+        if (a->numConnections() != b->numConnections())
+        {
+            return a->numConnections() < b->numConnections() ? a : b;
+        }
+        return a->pendingBytes() <= b->pendingBytes() ? a : b;
+    }
+
+    EventLoop *EventLoopThreadPool::hashPeerAddress(const InetAddress &peerAddr) const
+    {
+        // 只按IP哈希，不含端口，同一客户端的多条连接落在同一个loop
+        uint64_t ip = peerAddr.getSockAddr()->sin_addr.s_addr;
+        uint64_t h = ip * 0x9E3779B97F4A7C15ULL;
+        return loops_[(h >> 32) % loops_.size()];
+    }
+
+    // 收包软中断所在的CPU上如果有loop，连接交给它，协议栈和用户态处理共享同一份cache；找不到则退回轮询
+    EventLoop *EventLoopThreadPool::incomingCpu(int sockfd)
+    {
+        int cpu = -1;
+        socklen_t len = sizeof cpu;
+        if (!loopCpus_.empty() && ::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0 && cpu >= 0)
+        {
+            for (size_t i = 0; i < loopCpus_.size(); ++i)
+            {
+                if (loopCpus_[i] == cpu)
+                {
+                    return loops_[i];
+                }
+            }
+        }
+        return getNextLoop();
+    }
+
     std::vector<EventLoop *> EventLoopThreadPool::getAllLoops()
     {
         if (loops_.empty())
@@ -0,0 +1,208 @@
+#include "mymuduo/ListenerHandoff.h"
+#include "mymuduo/EventLoop.h"
+#include "mymuduo/Channel.h"
+#include "mymuduo/Socket.h"
+#include "mymuduo/Logger.h"
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace mymuduo
+{
+    namespace
+    {
+        const size_t kMaxFds = 16; // 一次交接的监听fd个数上限，SO_REUSEPORT时每个TcpServer一个
+
+        bool makeUnixAddr(const std::string &path, sockaddr_un *addr)
+        {
+            ::bzero(addr, sizeof *addr);
+            addr->sun_family = AF_UNIX;
+            if (path.size() >= sizeof addr->sun_path)
+            {
+                LOG_FMT_ERROR("ListenerHandoff: path too long: %s \n", path.c_str());
+                return false;
+            }
+            ::memcpy(addr->sun_path, path.c_str(), path.size());
+            return true;
+        }
+    } // namespace
+
+    ListenerHandoff::ListenerHandoff(EventLoop *loop, const std::string &path)
+        : loop_(loop), path_(path)
+    {
+    }
+
+    ListenerHandoff::~ListenerHandoff()
+    {
+        stop();
+    }
+
+    void ListenerHandoff::serve(const std::vector<int> &fds, const HandoffCallback &cb)
+    {
+        loop_->assertInLoopThread();
+        if (fds.empty() || fds.size() > kMaxFds)
+        {
+            LOG_FMT_ERROR("ListenerHandoff::serve invalid fd count: %lu \n", fds.size());
+            return;
+        }
+        sockaddr_un addr;
+        if (socket_ || !makeUnixAddr(path_, &addr))
+        {
+            return;
+        }
+
+        int sockfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sockfd < 0)
+        {
+            LOG_FMT_ERROR("ListenerHandoff::serve socket err: %d \n", errno);
+            return;
+        }
+        socket_.reset(new Socket(sockfd));
+        // 上一代进程留下的socket文件，它已经交接完成不会再用
+        ::unlink(path_.c_str());
+        if (::bind(sockfd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0 || ::listen(sockfd, 4) < 0)
+        {
+            LOG_FMT_ERROR("ListenerHandoff::serve bind/listen %s err: %d \n", path_.c_str(), errno);
+            socket_.reset();
+            return;
+        }
+
+        fds_ = fds;
+        callback_ = cb;
+        channel_.reset(new Channel(loop_, sockfd));
+        channel_->setReadCallback(std::bind(&ListenerHandoff::handleRead, this));
+        channel_->enableReading();
+        LOG_FMT_INFO("ListenerHandoff::serve %lu fds on %s \n", fds_.size(), path_.c_str());
+    }
+
+    void ListenerHandoff::handleRead()
+    {
+        int connfd = ::accept4(socket_->fd(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (connfd < 0)
+        {
+            LOG_FMT_ERROR("ListenerHandoff::handleRead accept err: %d \n", errno);
+            return;
+        }
+
+        // 至少要带1字节普通数据，控制消息才会被送达；顺带告诉对方fd个数
+        uint32_t count = static_cast<uint32_t>(fds_.size());
+        iovec iov;
+        iov.iov_base = &count;
+        iov.iov_len = sizeof count;
+
+        char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+        ::bzero(control, sizeof control);
+        msghdr msg;
+        ::bzero(&msg, sizeof msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds_.size());
+
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds_.size());
+        ::memcpy(CMSG_DATA(cmsg), fds_.data(), sizeof(int) * fds_.size());
+
+        // 阻塞的accept fd，消息很小，一次sendmsg就能发完
+        ssize_t n = ::sendmsg(connfd, &msg, MSG_NOSIGNAL);
+        ::close(connfd);
+        if (n != static_cast<ssize_t>(sizeof count))
+        {
+            LOG_FMT_ERROR("ListenerHandoff::handleRead sendmsg err: %d \n", errno);
+            return; // 继续等待下一次交接
+        }
+
+        LOG_FMT_INFO("ListenerHandoff: handed off %u fds on %s \n", count, path_.c_str());
+        // 正在channel_的回调里，不能在这里销毁它
+        channel_->disableAll();
+        loop_->queueInLoop(std::bind(&ListenerHandoff::finish, this));
+    }
+
+    void ListenerHandoff::finish()
+    {
+        // path现在属于新进程(或者即将被它替换)，不要unlink
+        stop();
+        HandoffCallback cb;
+        cb.swap(callback_);
+        if (cb)
+        {
+            cb();
+        }
+    }
+
+    void ListenerHandoff::stop()
+    {
+        if (channel_)
+        {
+            channel_->disableAll();
+            channel_->remove();
+            channel_.reset();
+        }
+        socket_.reset();
+    }
+
+    std::vector<int> ListenerHandoff::receive(const std::string &path)
+    {
+        std::vector<int> fds;
+        sockaddr_un addr;
+        if (!makeUnixAddr(path, &addr))
+        {
+            return fds;
+        }
+        Socket sock(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        if (sock.fd() < 0 || ::connect(sock.fd(), reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+        {
+            LOG_FMT_INFO("ListenerHandoff::receive no server on %s: %d \n", path.c_str(), errno);
+            return fds;
+        }
+
+        uint32_t count = 0;
+        iovec iov;
+        iov.iov_base = &count;
+        iov.iov_len = sizeof count;
+        char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+        msghdr msg;
+        ::bzero(&msg, sizeof msg);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof control;
+
+        ssize_t n;
+        do
+        {
+            n = ::recvmsg(sock.fd(), &msg, MSG_CMSG_CLOEXEC);
+        } while (n < 0 && errno == EINTR);
+        if (n != static_cast<ssize_t>(sizeof count))
+        {
+            LOG_FMT_ERROR("ListenerHandoff::receive recvmsg n=%ld err: %d \n", static_cast<long>(n), errno);
+            return fds;
+        }
+
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            {
+                size_t num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const int *data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+                fds.insert(fds.end(), data, data + num);
+            }
+        }
+        if (fds.size() != count || (msg.msg_flags & MSG_CTRUNC))
+        {
+            LOG_FMT_ERROR("ListenerHandoff::receive expected %u fds, got %lu \n", count, fds.size());
+            for (int fd : fds)
+            {
+                ::close(fd);
+            }
+            fds.clear();
+        }
+        return fds;
+    }
+} // namespace mymuduo
@@ -1,38 +1,96 @@
 #include "mymuduo/LogStream.h"
 
 #include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <assert.h>
 
 namespace mymuduo
 {
     namespace detail
     {
-        const char digits[] = "9876543210123456789";
-        const char *zero = digits + 9;
-
         const char digitsHex[] = "0123456789ABCDEF";
 
-        // From muduo
-        template <typename T>
-        size_t convert(char buf[], T value)
+        // 00 ~ 99的两位数字表，一次查表输出两位，除法次数减半
+        const char kDigitPairs[201] =
+            "0001020304050607080910111213141516171819"
+            "2021222324252627282930313233343536373839"
+            "4041424344454647484950515253545556575859"
+            "6061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        const uint64_t kPow10[20] = {
+            1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+            100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+            10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+            1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+            10000000000000000000ULL};
+
+        // 十进制位数：先用二进制位数估算 log10(v) ≈ log2(v) * 1233 / 4096，再比较一次修正，没有循环
+        // 10的正整数次幂都是偶数，value | 1不会跨过边界，同时让0也按1位数处理
+        inline int countDigits(uint64_t value)
         {
-            T i = value;
-            char *p = buf;
+            value |= 1;
+            const int t = ((64 - __builtin_clzll(value)) * 1233) >> 12;
+            return t + (value >= kPow10[t]);
+        }
 
-            do
+        // 先算出位数，再从低位向高位原地写入，省掉muduo原版的std::reverse
+        inline void writeDigits(char *end, uint64_t value)
+        {
+            while (value >= 100)
             {
-                int lsd = static_cast<int>(i % 10);
-                i /= 10;
-                *p++ = zero[lsd];
-            } while (i != 0);
+                const unsigned idx = static_cast<unsigned>(value % 100) * 2;
+                value /= 100;
+                end -= 2;
+                end[0] = kDigitPairs[idx];
+                end[1] = kDigitPairs[idx + 1];
+            }
+            if (value < 10)
+            {
+                *--end = static_cast<char>('0' + value);
+            }
+            else
+            {
+                const unsigned idx = static_cast<unsigned>(value) * 2;
+                end -= 2;
+                end[0] = kDigitPairs[idx];
+                end[1] = kDigitPairs[idx + 1];
+            }
+        }
+
+        size_t formatUnsigned(char buf[], uint64_t value)
+        {
+            const int len = countDigits(value);
+            writeDigits(buf + len, value);
+            return len;
+        }
 
+        size_t formatSigned(char buf[], int64_t value)
+        {
             if (value < 0)
             {
-                *p++ = '-';
+                buf[0] = '-';
+                // 用无符号数取反，INT64_MIN也不会溢出
+                return formatUnsigned(buf + 1, 0 - static_cast<uint64_t>(value)) + 1;
             }
-            *p = '\0';
-            std::reverse(buf, p);
+            return formatUnsigned(buf, static_cast<uint64_t>(value));
+        }
 
-            return p - buf;
+        size_t formatZeroPadded(char buf[], uint32_t value, int width)
+        {
+            assert(countDigits(value) <= width);
+            const int len = countDigits(value);
+            ::memset(buf, '0', width - len);
+            writeDigits(buf + width, value);
+            return width;
+        }
+
+        template <typename T>
+        size_t convert(char buf[], T value)
+        {
+            return std::is_signed<T>::value ? formatSigned(buf, static_cast<int64_t>(value))
+                                            : formatUnsigned(buf, static_cast<uint64_t>(value));
         }
 
         template class FixedBuffer<kSmallBuffer>;
@@ -55,6 +113,311 @@ namespace mymuduo
 
             return p - buf;
         }
+
+        /**
+         * @brief Grisu2 double => 最短十进制串，参考Florian Loitsch, "Printing Floating-Point Numbers
+         * Quickly and Accurately with Integers"和milo yip的dtoa实现。
+         * 用64位整数模拟浮点(DiyFp)，配合预先算好的10^k缓存，不需要大数运算，结果保证可往返。
+         */
+        struct DiyFp
+        {
+            DiyFp(uint64_t fp, int exp) : f(fp), e(exp) {}
+
+            explicit DiyFp(double d)
+            {
+                uint64_t u;
+                ::memcpy(&u, &d, sizeof u);
+                const int biasedE = static_cast<int>((u & kExponentMask) >> kSignificandSize);
+                const uint64_t significand = u & kSignificandMask;
+                if (biasedE != 0)
+                {
+                    f = significand + kHiddenBit;
+                    e = biasedE - kExponentBias;
+                }
+                else // subnormal
+                {
+                    f = significand;
+                    e = kMinExponent + 1;
+                }
+            }
+
+            DiyFp operator-(const DiyFp &rhs) const
+            {
+                return DiyFp(f - rhs.f, e);
+            }
+
+            // 只保留128位乘积的高64位，并对低64位四舍五入
+            DiyFp operator*(const DiyFp &rhs) const
+            {
+                const unsigned __int128 p = static_cast<unsigned __int128>(f) * rhs.f;
+                uint64_t h = static_cast<uint64_t>(p >> 64);
+                const uint64_t l = static_cast<uint64_t>(p);
+                if (l & (static_cast<uint64_t>(1) << 63))
+                {
+                    ++h;
+                }
+                return DiyFp(h, e + rhs.e + 64);
+            }
+
+            DiyFp normalize() const
+            {
+                const int s = __builtin_clzll(f);
+                return DiyFp(f << s, e - s);
+            }
+
+            DiyFp normalizeBoundary() const
+            {
+                DiyFp res = *this;
+                while (!(res.f & (kHiddenBit << 1)))
+                {
+                    res.f <<= 1;
+                    --res.e;
+                }
+                res.f <<= (kDiySignificandSize - kSignificandSize - 2);
+                res.e -= (kDiySignificandSize - kSignificandSize - 2);
+                return res;
+            }
+
+            // 计算v的上下边界m+ m-，落在(m-, m+)之间的十进制数读回来都是v
+            void normalizedBoundaries(DiyFp *minus, DiyFp *plus) const
+            {
+                DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalizeBoundary();
+                DiyFp mi = (f == kHiddenBit) ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+                mi.f <<= mi.e - pl.e;
+                mi.e = pl.e;
+                *plus = pl;
+                *minus = mi;
+            }
+
+            static const int kDiySignificandSize = 64;
+            static const int kSignificandSize = 52;
+            static const int kExponentBias = 0x3FF + kSignificandSize;
+            static const int kMinExponent = -kExponentBias;
+            static const uint64_t kExponentMask = 0x7FF0000000000000ULL;
+            static const uint64_t kSignificandMask = 0x000FFFFFFFFFFFFFULL;
+            static const uint64_t kHiddenBit = 0x0010000000000000ULL;
+
+            uint64_t f;
+            int e;
+        };
+
+        // 10^-348, 10^-340, ..., 10^340 的规格化表示
+        DiyFp getCachedPower(int e, int *K)
+        {
+            static const uint64_t kCachedPowersF[] = {
+            0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+            0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+            0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+            0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+            0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+            0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+            0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+            0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+            0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+            0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+            0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+            0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+            0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+            0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+            0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+            0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+            0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+            0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+            0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+            0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+            0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+            0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+            };
+            static const int16_t kCachedPowersE[] = {
+            -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+            -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+            -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+            -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+            -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+            109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+            375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+            641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+            907, 933, 960, 986, 1013, 1039, 1066,
+            };
+
+            // dk一定是正数，可以直接在正数上做向上取整
+            const double dk = (-61 - e) * 0.30102999566398114 + 347;
+            int k = static_cast<int>(dk);
+            if (dk - k > 0.0)
+            {
+                ++k;
+            }
+            const unsigned index = static_cast<unsigned>((k >> 3) + 1);
+            *K = -(-348 + static_cast<int>(index << 3));
+            return DiyFp(kCachedPowersF[index], kCachedPowersE[index]);
+        }
+
+        inline void grisuRound(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t wpW)
+        {
+            while (rest < wpW && delta - rest >= tenKappa &&
+                   (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW))
+            {
+                buffer[len - 1]--;
+                rest += tenKappa;
+            }
+        }
+
+        void digitGen(const DiyFp &W, const DiyFp &Mp, uint64_t delta, char *buffer, int *len, int *K)
+        {
+            const DiyFp one(static_cast<uint64_t>(1) << -Mp.e, Mp.e);
+            const DiyFp wpW = Mp - W;
+            uint32_t p1 = static_cast<uint32_t>(Mp.f >> -one.e);
+            uint64_t p2 = Mp.f & (one.f - 1);
+            int kappa = countDigits(p1);
+            *len = 0;
+
+            // 整数部分
+            while (kappa > 0)
+            {
+                const uint32_t div = static_cast<uint32_t>(kPow10[kappa - 1]);
+                const uint32_t d = p1 / div;
+                p1 %= div;
+                if (d || *len)
+                {
+                    buffer[(*len)++] = static_cast<char>('0' + d);
+                }
+                --kappa;
+                const uint64_t tmp = (static_cast<uint64_t>(p1) << -one.e) + p2;
+                if (tmp <= delta)
+                {
+                    *K += kappa;
+                    grisuRound(buffer, *len, delta, tmp, kPow10[kappa] << -one.e, wpW.f);
+                    return;
+                }
+            }
+
+            // 小数部分
+            for (;;)
+            {
+                p2 *= 10;
+                delta *= 10;
+                const char d = static_cast<char>(p2 >> -one.e);
+                if (d || *len)
+                {
+                    buffer[(*len)++] = static_cast<char>('0' + d);
+                }
+                p2 &= one.f - 1;
+                --kappa;
+                if (p2 < delta)
+                {
+                    *K += kappa;
+                    const int index = -kappa;
+                    grisuRound(buffer, *len, delta, p2, one.f, wpW.f * (index < 20 ? kPow10[index] : 0));
+                    return;
+                }
+            }
+        }
+
+        // 输出v的有效数字到buffer，v = buffer * 10^K
+        void grisu2(double value, char *buffer, int *length, int *K)
+        {
+            const DiyFp v(value);
+            DiyFp wm(0, 0), wp(0, 0);
+            v.normalizedBoundaries(&wm, &wp);
+
+            const DiyFp cmk = getCachedPower(wp.e, K);
+            const DiyFp W = v.normalize() * cmk;
+            DiyFp Wp = wp * cmk;
+            DiyFp Wm = wm * cmk;
+            ++Wm.f;
+            --Wp.f;
+            digitGen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+        }
+
+        inline size_t writeExponent(char *buf, int K)
+        {
+            char *p = buf;
+            if (K < 0)
+            {
+                *p++ = '-';
+                K = -K;
+            }
+            else
+            {
+                *p++ = '+';
+            }
+            p += formatUnsigned(p, static_cast<uint64_t>(K));
+            return p - buf;
+        }
+
+        // 按照数量级选择定点或者科学计数法，风格接近%g，但不补多余的0
+        size_t prettify(char *buffer, int length, int k)
+        {
+            const int kk = length + k; // 10^(kk-1) <= v < 10^kk
+            if (length <= kk && kk <= 21)
+            {
+                // 1234e7 -> 12340000000
+                ::memset(buffer + length, '0', kk - length);
+                return kk;
+            }
+            else if (0 < kk && kk <= 21)
+            {
+                // 1234e-2 -> 12.34
+                ::memmove(buffer + kk + 1, buffer + kk, length - kk);
+                buffer[kk] = '.';
+                return length + 1;
+            }
+            else if (-6 < kk && kk <= 0)
+            {
+                // 1234e-6 -> 0.001234
+                const int offset = 2 - kk;
+                ::memmove(buffer + offset, buffer, length);
+                buffer[0] = '0';
+                buffer[1] = '.';
+                ::memset(buffer + 2, '0', offset - 2);
+                return length + offset;
+            }
+            else if (length == 1)
+            {
+                // 1e30
+                buffer[1] = 'e';
+                return 2 + writeExponent(buffer + 2, kk - 1);
+            }
+            else
+            {
+                // 1234e30 -> 1.234e+33
+                ::memmove(buffer + 2, buffer + 1, length - 1);
+                buffer[1] = '.';
+                buffer[length + 1] = 'e';
+                return length + 2 + writeExponent(buffer + length + 2, kk - 1);
+            }
+        }
+
+        size_t formatDouble(char buf[], double value)
+        {
+            char *p = buf;
+            if (std::signbit(value))
+            {
+                *p++ = '-';
+                value = -value;
+            }
+
+            if (std::isnan(value))
+            {
+                ::memcpy(buf, "nan", 3);
+                return 3;
+            }
+            if (std::isinf(value))
+            {
+                ::memcpy(p, "inf", 3);
+                return p - buf + 3;
+            }
+            if (value == 0.0)
+            {
+                *p = '0';
+                return p - buf + 1;
+            }
+
+            int length = 0;
+            int K = 0;
+            grisu2(value, p, &length, &K);
+            return p - buf + prettify(p, length, K);
+        }
     } // namespace detail
 
     template <typename T>
@@ -134,7 +497,7 @@ namespace mymuduo
     {
         if (buffer_.avail() >= kMaxNumericSize)
         {
-            int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
+            size_t len = detail::formatDouble(buffer_.current(), v);
             buffer_.add(len);
         }
         return *this;
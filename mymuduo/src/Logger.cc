@@ -48,7 +48,7 @@ namespace mymuduo
 
     __thread char t_errnobuf[512];
     __thread char t_time[64];
-    __thread time_t t_lastSecond;
+    __thread time_t t_lastSecond = -1;
 
     const char *getErrnoMsg(int savedErrno)
     {
@@ -126,8 +126,7 @@ namespace mymuduo
           basename_(file)
     {
         formatTime();
-        CurrentThread::tid();
-        stream_ << T(std::to_string(CurrentThread::tid()));
+        stream_ << CurrentThread::tid();
         stream_ << T(LogLevelName[level], 6);
         if (savedErrno != 0)
         {
@@ -141,21 +140,27 @@ namespace mymuduo
         time_t seconds = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
         int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
 
-        struct tm *tm_time = ::localtime(&seconds);
-        // 写入此线程存储的时间buf中
-        snprintf(t_time, sizeof(t_time), "%4d/%02d/%02d %02d:%02d:%02d",
-                 tm_time->tm_year + 1900,
-                 tm_time->tm_mon + 1,
-                 tm_time->tm_mday,
-                 tm_time->tm_hour,
-                 tm_time->tm_min,
-                 tm_time->tm_sec);
-        // 更新最后一次时间调用
-        t_lastSecond = seconds;
-
-        // muduo使用Fmt格式化整数，这里我们直接写入buf
-        char buf[32] = {0};
-        snprintf(buf, sizeof(buf), "%06d ", microseconds);
+        // 同一秒内的日志复用此线程缓存的日期部分，只有秒数变化时才重新格式化
+        if (seconds != t_lastSecond)
+        {
+            struct tm tm_time;
+            ::localtime_r(&seconds, &tm_time);
+            // 写入此线程存储的时间buf中
+            snprintf(t_time, sizeof(t_time), "%4d/%02d/%02d %02d:%02d:%02d",
+                     tm_time.tm_year + 1900,
+                     tm_time.tm_mon + 1,
+                     tm_time.tm_mday,
+                     tm_time.tm_hour,
+                     tm_time.tm_min,
+                     tm_time.tm_sec);
+            // 更新最后一次时间调用
+            t_lastSecond = seconds;
+        }
+
+        // 微秒部分定宽6位补零，查表格式化，不走snprintf
+        char buf[8];
+        detail::formatZeroPadded(buf, static_cast<uint32_t>(microseconds), 6);
+        buf[6] = ' ';
 
         // 输出时间，附有微秒(之前是(buf, 6),少了一个空格)
         stream_ << T(t_time, 17) << T(buf, 7);
@@ -0,0 +1,275 @@
+#include "mymuduo/Metrics.h"
+#include "mymuduo/LogStream.h"
+
+#include <algorithm>
+
+namespace mymuduo
+{
+    namespace detail
+    {
+        __thread int t_metricsShard = -1;
+        std::atomic_int g_nextMetricsShard(0);
+
+        int metricsShard()
+        {
+            if (__builtin_expect(t_metricsShard < 0, 0))
+            {
+                t_metricsShard = g_nextMetricsShard.fetch_add(1, std::memory_order_relaxed) % kMetricsShards;
+            }
+            return t_metricsShard;
+        }
+    } // namespace detail
+
+    namespace
+    {
+        void appendNumber(std::string *out, int64_t v)
+        {
+            char buf[detail::kMaxNumericSize];
+            out->append(buf, detail::formatSigned(buf, v));
+        }
+
+        void appendNumber(std::string *out, double v)
+        {
+            char buf[detail::kMaxNumericSize];
+            out->append(buf, detail::formatDouble(buf, v));
+        }
+    } // namespace
+
+    int64_t ShardedValue::value() const
+    {
+        int64_t sum = 0;
+        for (const Shard &shard : shards_)
+        {
+            sum += shard.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    Histogram::Histogram(int shards)
+        : numShards_(std::max(1, std::min(shards, kMetricsShards))), shards_(new Shard[numShards_]())
+    {
+    }
+
+    Histogram::~Histogram() = default;
+
+    // 用value - 1计算桶下标，这样每个桶是左开右闭区间(lower, upper]，
+    // 和Prometheus的le(小于等于)语义一致，在2的幂边界上的累计计数是精确的
+    int Histogram::bucketIndex(uint64_t value)
+    {
+        const uint64_t v = value > 0 ? value - 1 : 0;
+        if (v < kSubBuckets)
+        {
+            return static_cast<int>(v);
+        }
+        const int exponent = 63 - __builtin_clzll(v);
+        if (exponent > kMaxExponent)
+        {
+            return kNumBuckets - 1;
+        }
+        const int mantissa = static_cast<int>((v >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+        return (exponent - kSubBucketBits + 1) * kSubBuckets + mantissa;
+    }
+
+    uint64_t Histogram::bucketUpperBound(int index)
+    {
+        if (index < kSubBuckets)
+        {
+            return index + 1;
+        }
+        const int exponent = index / kSubBuckets + kSubBucketBits - 1;
+        const uint64_t mantissa = index % kSubBuckets;
+        return (kSubBuckets + mantissa + 1) << (exponent - kSubBucketBits);
+    }
+
+    void Histogram::record(int64_t value)
+    {
+        Shard &shard = shards_[numShards_ == 1 ? 0 : detail::metricsShard() % numShards_];
+        const uint64_t v = value > 0 ? static_cast<uint64_t>(value) : 0;
+        shard.buckets[bucketIndex(v)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(static_cast<int64_t>(v), std::memory_order_relaxed);
+    }
+
+    Histogram::Snapshot Histogram::snapshot() const
+    {
+        Snapshot snap;
+        snap.buckets.assign(kNumBuckets, 0);
+        snap.count = 0;
+        snap.sum = 0;
+        for (int s = 0; s < numShards_; ++s)
+        {
+            const Shard &shard = shards_[s];
+            for (int i = 0; i < kNumBuckets; ++i)
+            {
+                snap.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+            }
+            snap.count += shard.count.load(std::memory_order_relaxed);
+            snap.sum += shard.sum.load(std::memory_order_relaxed);
+        }
+        return snap;
+    }
+
+    int64_t Histogram::Snapshot::countAtOrBelow(uint64_t value) const
+    {
+        int64_t n = 0;
+        for (int i = 0; i < kNumBuckets && bucketUpperBound(i) <= value; ++i)
+        {
+            n += buckets[i];
+        }
+        return n;
+    }
+
+    uint64_t Histogram::Snapshot::percentile(double q) const
+    {
+        int64_t total = 0;
+        for (int64_t b : buckets)
+        {
+            total += b;
+        }
+        if (total == 0)
+        {
+            return 0;
+        }
+        const int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(q * total + 0.5));
+        int64_t seen = 0;
+        for (int i = 0; i < kNumBuckets; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return bucketUpperBound(i);
+            }
+        }
+        return bucketUpperBound(kNumBuckets - 1);
+    }
+
+    MetricsRegistry &MetricsRegistry::instance()
+    {
+        // 函数内静态变量，保证各个模块的全局指标对象初始化时注册表已经构造好
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    MetricsRegistry::Entry *MetricsRegistry::findOrCreate(const std::string &name, const std::string &help,
+                                                         const std::string &labels, Type type, int shards)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &entry : entries_)
+        {
+            if (entry->name == name && entry->labels == labels && entry->type == type)
+            {
+                return entry.get();
+            }
+        }
+
+        std::unique_ptr<Entry> entry(new Entry);
+        entry->name = name;
+        entry->help = help;
+        entry->labels = labels;
+        entry->type = type;
+        switch (type)
+        {
+        case kCounter:
+            entry->counter.reset(new Counter);
+            break;
+        case kGauge:
+            entry->gauge.reset(new Gauge);
+            break;
+        case kHistogram:
+            entry->histogram.reset(new Histogram(shards));
+            break;
+        }
+        entries_.push_back(std::move(entry));
+        return entries_.back().get();
+    }
+
+    Counter *MetricsRegistry::counter(const std::string &name, const std::string &help, const std::string &labels)
+    {
+        return findOrCreate(name, help, labels, kCounter)->counter.get();
+    }
+
+    Gauge *MetricsRegistry::gauge(const std::string &name, const std::string &help, const std::string &labels)
+    {
+        return findOrCreate(name, help, labels, kGauge)->gauge.get();
+    }
+
+    Histogram *MetricsRegistry::histogram(const std::string &name, const std::string &help, const std::string &labels,
+                                          int shards)
+    {
+        return findOrCreate(name, help, labels, kHistogram, shards)->histogram.get();
+    }
+
+    // 直方图按微秒记录，输出时换算成秒；只输出2^4us ~ 2^26us(约67秒)之间2的幂的le，保证各次抓取的桶一致
+    void MetricsRegistry::appendHistogram(std::string *out, const Entry &entry)
+    {
+        static const int kMinLeExponent = 4;
+        static const int kMaxLeExponent = 26;
+
+        const Histogram::Snapshot snap = entry.histogram->snapshot();
+        const std::string prefix = entry.labels.empty() ? std::string("{") : "{" + entry.labels + ",";
+        for (int k = kMinLeExponent; k <= kMaxLeExponent; ++k)
+        {
+            const uint64_t le = static_cast<uint64_t>(1) << k;
+            out->append(entry.name).append("_bucket").append(prefix).append("le=\"");
+            appendNumber(out, static_cast<double>(le) / 1000000.0);
+            out->append("\"} ");
+            appendNumber(out, snap.countAtOrBelow(le));
+            out->append("\n");
+        }
+        out->append(entry.name).append("_bucket").append(prefix).append("le=\"+Inf\"} ");
+        appendNumber(out, snap.count);
+        out->append("\n");
+
+        const std::string labels = entry.labels.empty() ? std::string() : "{" + entry.labels + "}";
+        out->append(entry.name).append("_sum").append(labels).append(" ");
+        appendNumber(out, static_cast<double>(snap.sum) / 1000000.0);
+        out->append("\n");
+        out->append(entry.name).append("_count").append(labels).append(" ");
+        appendNumber(out, snap.count);
+        out->append("\n");
+    }
+
+    std::string MetricsRegistry::scrape() const
+    {
+        static const char *const kTypeNames[] = {"counter", "gauge", "histogram"};
+
+        std::string out;
+        out.reserve(4096);
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<bool> done(entries_.size(), false);
+        // 同名指标(不同标签)必须连续输出，HELP/TYPE只输出一次
+        for (size_t i = 0; i < entries_.size(); ++i)
+        {
+            if (done[i])
+            {
+                continue;
+            }
+            const Entry &family = *entries_[i];
+            out.append("# HELP ").append(family.name).append(" ").append(family.help).append("\n");
+            out.append("# TYPE ").append(family.name).append(" ").append(kTypeNames[family.type]).append("\n");
+            for (size_t j = i; j < entries_.size(); ++j)
+            {
+                const Entry &entry = *entries_[j];
+                if (done[j] || entry.name != family.name)
+                {
+                    continue;
+                }
+                done[j] = true;
+                if (entry.type == kHistogram)
+                {
+                    appendHistogram(&out, entry);
+                    continue;
+                }
+                out.append(entry.name);
+                if (!entry.labels.empty())
+                {
+                    out.append("{").append(entry.labels).append("}");
+                }
+                out.append(" ");
+                appendNumber(&out, entry.type == kCounter ? entry.counter->value() : entry.gauge->value());
+                out.append("\n");
+            }
+        }
+        return out;
+    }
+} // namespace mymuduo
@@ -4,6 +4,7 @@
 // #include "EventLoop.h"
 
 #include <unistd.h>
+#include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <strings.h>
@@ -85,4 +86,55 @@ namespace mymuduo
         ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
     }
 
+    void Socket::setBusyPoll(int usecs)
+    {
+        if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof usecs) < 0)
+        {
+            LOG_FMT_ERROR("Socket::setBusyPoll fd=%d usecs=%d err=%d \n", sockfd_, usecs, errno);
+        }
+    }
+
+    InetAddress Socket::localAddress(int sockfd)
+    {
+        sockaddr_in local;
+        ::bzero(&local, sizeof local);
+        socklen_t addrlen = sizeof local;
+        if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
+        {
+            LOG_FMT_ERROR("Socket::localAddress fd=%d err=%d \n", sockfd, errno);
+        }
+        return InetAddress(local);
+    }
+
+    InetAddress Socket::peerAddress(int sockfd)
+    {
+        sockaddr_in peer;
+        ::bzero(&peer, sizeof peer);
+        socklen_t addrlen = sizeof peer;
+        if (::getpeername(sockfd, (sockaddr *)&peer, &addrlen) < 0)
+        {
+            LOG_FMT_ERROR("Socket::peerAddress fd=%d err=%d \n", sockfd, errno);
+        }
+        return InetAddress(peer);
+    }
+
+    int Socket::socketError(int sockfd)
+    {
+        int optval;
+        socklen_t optlen = sizeof optval;
+        if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+        {
+            return errno;
+        }
+        return optval;
+    }
+
+    bool Socket::isSelfConnect(int sockfd)
+    {
+        InetAddress local(localAddress(sockfd));
+        InetAddress peer(peerAddress(sockfd));
+        return local.getSockAddr()->sin_port == peer.getSockAddr()->sin_port &&
+               local.getSockAddr()->sin_addr.s_addr == peer.getSockAddr()->sin_addr.s_addr;
+    }
+
 } // namespace mymuduo
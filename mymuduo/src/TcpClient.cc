@@ -0,0 +1,139 @@
+#include "mymuduo/TcpClient.h"
+#include "mymuduo/EventLoop.h"
+#include "mymuduo/Logger.h"
+#include "mymuduo/Socket.h"
+#include "mymuduo/TcpConnection.h"
+#include "mymuduo/Buffer.h"
+
+#include <assert.h>
+
+namespace mymuduo
+{
+    namespace
+    {
+        void destroyConnection(EventLoop *loop, const TcpConnectionPtr &conn)
+        {
+            loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        }
+
+        void removeConnector(const ConnectorPtr &)
+        {
+            // 只是让定时器持有connector到这一刻
+        }
+
+        void defaultConnectionCallback(const TcpConnectionPtr &conn)
+        {
+            (void)conn; // 没有开FMT_DEBUG时LOG_FMT_DEBUG展开为空
+            LOG_FMT_DEBUG("%s -> %s is %s \n", conn->localAddress().toIPport().c_str(),
+                          conn->peerAddress().toIPport().c_str(), conn->connected() ? "UP" : "DOWN");
+        }
+
+        void defaultMessageCallback(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+        {
+            buf->retrieveAll();
+        }
+    } // namespace
+
+    TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+        : loop_(loop),
+          connector_(std::make_shared<Connector>(loop, serverAddr)),
+          name_(nameArg),
+          connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + serverAddr.toIPport())),
+          connectionCallback_(defaultConnectionCallback),
+          messageCallback_(defaultMessageCallback),
+          retry_(false),
+          connect_(true),
+          nextConnId_(1)
+    {
+        connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+        LOG_FMT_INFO("TcpClient::TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+    }
+
+    TcpClient::~TcpClient()
+    {
+        LOG_FMT_INFO("TcpClient::~TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+        TcpConnectionPtr conn;
+        bool unique = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            unique = connection_.use_count() == 1;
+            conn = connection_;
+        }
+        if (conn)
+        {
+            assert(loop_ == conn->getLoop());
+            // TcpClient已经不在了，连接关闭时不能再回调到this
+            CloseCallback cb = std::bind(&destroyConnection, loop_, std::placeholders::_1);
+            loop_->runInLoop(std::bind(&TcpConnection::setCloseCallback, conn, cb));
+            if (unique)
+            {
+                conn->forceClose();
+            }
+        }
+        else
+        {
+            connector_->stop();
+            loop_->runAfter(1, std::bind(&removeConnector, connector_));
+        }
+    }
+
+    void TcpClient::connect()
+    {
+        LOG_FMT_INFO("TcpClient::connect[%s] - connecting to %s \n", name_.c_str(), connector_->serverAddress().toIPport().c_str());
+        connect_ = true;
+        connector_->start();
+    }
+
+    void TcpClient::disconnect()
+    {
+        connect_ = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (connection_)
+            {
+                connection_->shutdown();
+            }
+        }
+    }
+
+    void TcpClient::stop()
+    {
+        connect_ = false;
+        connector_->stop();
+    }
+
+    void TcpClient::newConnection(int sockfd)
+    {
+        loop_->assertInLoopThread();
+        InetAddress peerAddr(Socket::peerAddress(sockfd));
+        InetAddress localAddr(Socket::localAddress(sockfd));
+        TcpConnectionPtr conn(std::make_shared<TcpConnection>(loop_, nextConnId_++, connNamePrefix_, sockfd, localAddr, peerAddr));
+        conn->setConnectionCallback(connectionCallback_);
+        conn->setMessageCallback(messageCallback_);
+        conn->setWriteCompleteCallback(writeCompleteCallback_);
+        conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            connection_ = conn;
+        }
+        conn->connectEstablished();
+    }
+
+    void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+    {
+        loop_->assertInLoopThread();
+        assert(loop_ == conn->getLoop());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            assert(connection_ == conn);
+            connection_.reset();
+        }
+
+        loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        if (retry_ && connect_)
+        {
+            LOG_FMT_INFO("TcpClient::connect[%s] - Reconnecting to %s \n", name_.c_str(), connector_->serverAddress().toIPport().c_str());
+            connector_->restart();
+        }
+    }
+} // namespace mymuduo
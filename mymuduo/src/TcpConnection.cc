@@ -3,18 +3,35 @@
 #include "mymuduo/Socket.h"
 #include "mymuduo/Channel.h"
 #include "mymuduo/EventLoop.h"
+#include "mymuduo/Metrics.h"
+#include "mymuduo/TlsEngine.h"
 
 #include <functional>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <stdio.h>
 #include <strings.h>
 #include <netinet/tcp.h>
 #include <string>
 
 namespace mymuduo
 {
+    namespace
+    {
+        Gauge *const g_liveConnections = MetricsRegistry::instance().gauge(
+            "mymuduo_tcp_connections", "Number of live TcpConnection objects.");
+        Counter *const g_bytesRead = MetricsRegistry::instance().counter(
+            "mymuduo_tcp_bytes_read_total", "Bytes read from sockets.");
+        Counter *const g_bytesWritten = MetricsRegistry::instance().counter(
+            "mymuduo_tcp_bytes_written_total", "Bytes written to sockets.");
+        Gauge *const g_outputBufferBytes = MetricsRegistry::instance().gauge(
+            "mymuduo_tcp_output_buffer_bytes", "Bytes waiting in connection output buffers.");
+        Gauge *const g_bufferMemoryBytes = MetricsRegistry::instance().gauge(
+            "mymuduo_tcp_buffer_memory_bytes", "Bytes allocated for connection input and output buffers.");
+    } // namespace
+
     static EventLoop *CheckLoopNotNull(EventLoop *loop)
     {
         if (loop == nullptr)
@@ -23,11 +40,11 @@ namespace mymuduo
         }
         return loop;
     }
-    TcpConnection::TcpConnection(EventLoop *loop, const std::string &name, int sockfd, const InetAddress &localAddr,
-                                 const InetAddress &peerAddr)
+    TcpConnection::TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix, int sockfd,
+                                 const InetAddress &localAddr, const InetAddress &peerAddr)
         : loop_(CheckLoopNotNull(loop)) // 这里绝对不是baseloop,因为TcpConnection都是在subloop里面管理的
           ,
-          name_(name), state_(kConnecting), reading_(true), socket_(std::make_unique<Socket>(sockfd)), channel_(std::make_unique<Channel>(loop, sockfd)), localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024)
+          id_(id), namePrefix_(namePrefix), state_(kConnecting), reading_(true), socket_(std::make_unique<Socket>(sockfd)), channel_(std::make_unique<Channel>(loop, sockfd)), localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024), bufferMemory_(0)
     {
         // 给channel设置相应的回调函数，poller给Channel通知感兴趣的事情发生了，channel会回调相应的操作函数
         channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
@@ -35,13 +52,44 @@ namespace mymuduo
         channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
         channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
 
-        LOG_FMT_INFO("TcpConnection::ctor[%s] at fd=%d \n", name_.c_str(), sockfd);
+        LOG_FMT_INFO("TcpConnection::ctor[#%llu] at fd=%d \n", static_cast<unsigned long long>(id_), sockfd);
         socket_->setKeepAlive(true);
+        g_liveConnections->increment();
+        updateBufferMemory();
+        loop_->addConnections(1);
     }
 
     TcpConnection::~TcpConnection()
     {
-        LOG_FMT_INFO("TcpConnection::dtor[%s] at fd=%d state=%d \n", name_.c_str(), channel_->fd(), (int)state_);
+        LOG_FMT_INFO("TcpConnection::dtor[#%llu] at fd=%d state=%d \n", static_cast<unsigned long long>(id_), channel_->fd(), (int)state_);
+        g_liveConnections->decrement();
+        g_outputBufferBytes->add(-static_cast<int64_t>(outputBuffer_.readableBytes()));
+        g_bufferMemoryBytes->add(-static_cast<int64_t>(bufferMemory_));
+        loop_->addConnections(-1);
+        loop_->addPendingBytes(-static_cast<int64_t>(outputBuffer_.readableBytes()));
+    }
+
+    std::string TcpConnection::name() const
+    {
+        char buf[32];
+        snprintf(buf, sizeof buf, "#%llu", static_cast<unsigned long long>(id_));
+        return namePrefix_ ? *namePrefix_ + buf : std::string(buf);
+    }
+
+    void TcpConnection::send(const void *data, size_t len)
+    {
+        if (state_ == kConnected)
+        {
+            if (loop_->isInLoopThread())
+            {
+                sendInLoop(data, len);
+            }
+            else
+            {
+                void (TcpConnection::*fp)(const std::string &message) = &TcpConnection::sendInLoop;
+                loop_->runInLoop(std::bind(fp, shared_from_this(), std::string(static_cast<const char *>(data), len)));
+            }
+        }
     }
 
     void TcpConnection::send(const std::string &buf)
@@ -89,13 +137,95 @@ namespace mymuduo
         }
     }
 
+    void TcpConnection::forceClose()
+    {
+        if (state_ == kConnected || state_ == kDisconnecting)
+        {
+            setState(kDisconnecting);
+            // 持有shared_ptr，回调执行前连接不会被销毁
+            loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        }
+    }
+
+    void TcpConnection::forceCloseInLoop()
+    {
+        loop_->assertInLoopThread();
+        if (state_ == kConnected || state_ == kDisconnecting)
+        {
+            handleClose();
+        }
+    }
+
+    void TcpConnection::startRead()
+    {
+        loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+    }
+
+    void TcpConnection::stopRead()
+    {
+        loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+    }
+
+    void TcpConnection::startReadInLoop()
+    {
+        loop_->assertInLoopThread();
+        // 已经断开的连接channel已经disableAll，不能再打开
+        if (!reading_ && (state_ == kConnected || state_ == kDisconnecting))
+        {
+            channel_->enableReading();
+            reading_ = true;
+        }
+    }
+
+    void TcpConnection::stopReadInLoop()
+    {
+        loop_->assertInLoopThread();
+        if (reading_ && (state_ == kConnected || state_ == kDisconnecting))
+        {
+            channel_->disableReading();
+            reading_ = false;
+        }
+    }
+
+    void TcpConnection::updateBufferMemory()
+    {
+        // Buffer只扩容不缩小，容量没变时不写指标
+        size_t memory = inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity();
+        if (memory != bufferMemory_)
+        {
+            g_bufferMemoryBytes->add(static_cast<int64_t>(memory) - static_cast<int64_t>(bufferMemory_));
+            bufferMemory_ = memory;
+        }
+    }
+
+    void TcpConnection::startTls(TlsContext *context)
+    {
+        tls_.reset(new TlsEngine(context));
+    }
+
+    std::string TcpConnection::alpnProtocol() const
+    {
+        return tls_ ? tls_->alpnProtocol() : std::string();
+    }
+
     void TcpConnection::setTcpNoDelay(bool on)
     {
         socket_->setTcpNoDelay(on);
     }
 
+    void TcpConnection::setBusyPoll(int usecs)
+    {
+        socket_->setBusyPoll(usecs);
+    }
+
     void TcpConnection::shutdownInLoop()
     {
+        if (tls_ && !tls_->shutdownSent())
+        {
+            // close_notify排在已有的数据后面
+            tls_->shutdown();
+            flushTls();
+        }
         if (!channel_->isWriting()) // 说明当前output buffer中的数据已经全部发送完成
         {
             socket_->shutdownWrite();
@@ -116,7 +246,8 @@ namespace mymuduo
     // 连接销毁
     void TcpConnection::connectDestroyed()
     {
-        if (state_ == kConnected)
+        // TcpServer析构时连接可能已经shutdown了写端(kDisconnecting)，还在等对端关闭，同样要注销事件
+        if (state_ == kConnected || state_ == kDisconnecting)
         {
             setState(kDisconnected);
             channel_->disableAll();
@@ -130,11 +261,40 @@ namespace mymuduo
     void TcpConnection::handleRead(Timestamp receiveTime)
     {
         int savedErrno = 0;
-        ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-        if (n > 0)
+        // TLS连接先读密文，解密后的明文再放进inputBuffer_
+        ssize_t n = tls_ ? tls_->input()->readFd(channel_->fd(), &savedErrno)
+                         : inputBuffer_.readFd(channel_->fd(), &savedErrno);
+        if (n > 0 && tls_)
         {
+            g_bytesRead->add(n);
+            size_t before = inputBuffer_.readableBytes();
+            bool ok = tls_->decrypt(&inputBuffer_);
+            // 握手消息、会话票据、告警
+            flushTls();
+            if (!ok)
+            {
+                handleClose();
+                return;
+            }
+            if (inputBuffer_.readableBytes() > before)
+            {
+                messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            }
+            updateBufferMemory();
+            // close_notify和TCP的FIN一样处理，关闭前回一个close_notify
+            if (tls_->peerClosed() && state_ != kDisconnected)
+            {
+                tls_->shutdown();
+                flushTls();
+                handleClose();
+            }
+        }
+        else if (n > 0)
+        {
+            g_bytesRead->add(n);
             // 已建立连接的用户，有可读事件发生了，调用用户传入的回调操作onMessage
             messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            updateBufferMemory();
         }
         else if (n == 0)
         {
@@ -158,6 +318,9 @@ namespace mymuduo
             if (n > 0)
             {
                 outputBuffer_.retrieve(n);
+                g_bytesWritten->add(n);
+                g_outputBufferBytes->add(-n);
+                loop_->addPendingBytes(-n);
                 // 一旦发送完outputBuffer_的数据，就停止观察writable事件避免busyloop.
                 if (outputBuffer_.readableBytes() == 0)
                 {
@@ -209,22 +372,46 @@ namespace mymuduo
         {
             err = optval;
         }
-        LOG_FMT_ERROR("TcpConnection::handleError name: %s - SO_ERROR:%d \n", name_.c_str(), err);
+        LOG_FMT_ERROR("TcpConnection::handleError name: %s - SO_ERROR:%d \n", name().c_str(), err);
     }
 
-    // 发送数据 应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
     void TcpConnection::sendInLoop(const void *data, size_t len)
     {
-        size_t nwrote = 0;
-        size_t remaining = len;
-        bool faultError = false;
-
         // 之前调用过connection的shutdown，不能再进行发送了
         if (state_ == kDisconnected)
         {
             LOG_FMT_ERROR("disconnected, give up writing!");
             return;
         }
+        if (tls_)
+        {
+            if (!tls_->encrypt(data, len))
+            {
+                LOG_FMT_ERROR("TcpConnection::sendInLoop [#%llu] - TLS encrypt failed \n", static_cast<unsigned long long>(id_));
+                return;
+            }
+            flushTls();
+            return;
+        }
+        writeInLoop(data, len);
+    }
+
+    void TcpConnection::flushTls()
+    {
+        Buffer *output = tls_->output();
+        if (output->readableBytes() > 0)
+        {
+            writeInLoop(output->peek(), output->readableBytes());
+            output->retrieveAll();
+        }
+    }
+
+    // 发送数据 应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，而且设置了水位回调
+    void TcpConnection::writeInLoop(const void *data, size_t len)
+    {
+        ssize_t nwrote = 0;
+        size_t remaining = len;
+        bool faultError = false;
 
         // 表示channel_第一次开始写数据，而且缓冲区没有待发送数据
         if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
@@ -232,6 +419,7 @@ namespace mymuduo
             nwrote = ::write(channel_->fd(), data, len);
             if (nwrote >= 0)
             {
+                g_bytesWritten->add(nwrote);
                 remaining = len - nwrote;
                 if (remaining == 0 && writeCompleteCallback_)
                 {
@@ -259,11 +447,14 @@ namespace mymuduo
         if (!faultError && remaining > 0)
         {
             size_t oldLen = outputBuffer_.readableBytes();
-            if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMark_)
+            if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
             {
                 loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
             }
             outputBuffer_.append((char *)data + nwrote, remaining);
+            g_outputBufferBytes->add(remaining);
+            loop_->addPendingBytes(remaining);
+            updateBufferMemory();
             if (!channel_->isWriting())
             {
                 channel_->enableWriting(); // 注册channel的写事件
@@ -1,11 +1,28 @@
 #include "mymuduo/TcpServer.h"
 #include "mymuduo/Logger.h"
 #include "mymuduo/TcpConnection.h"
+#include "mymuduo/Metrics.h"
+#include "mymuduo/Socket.h"
+#include "mymuduo/TlsContext.h"
 
 #include <strings.h>
+#include <assert.h>
 
 namespace mymuduo
 {
+    namespace
+    {
+        Counter *const g_connectionsAccepted = MetricsRegistry::instance().counter(
+            "mymuduo_tcp_connections_accepted_total", "Number of connections accepted by all TcpServers.");
+
+        const double kDrainCheckInterval = 0.05; // drain时检查剩余连接数的间隔(秒)
+
+        void defaultDrainConnectionCallback(const TcpConnectionPtr &conn)
+        {
+            conn->shutdown();
+        }
+    } // namespace
+
     static EventLoop *CheckLoopNotNull(EventLoop *loop)
     {
         if (loop == nullptr)
@@ -16,7 +33,17 @@ namespace mymuduo
     }
     TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr,
                          const std::string &nameArg, Option option)
-        : loop_(CheckLoopNotNull(loop)), ipPort_(listenAddr.toIPport()), name_(nameArg), acceptor_(std::make_unique<Acceptor>(loop, listenAddr, option == kReusePort)), threadPool_(std::make_shared<EventLoopThreadPool>(loop, name_)), connectionCallback_(), messageCallback_(), writeCompleteCallback_(), threadInitCallback_(), started_(), nextConnId_(1), connections_()
+        : TcpServer(loop, listenAddr.toIPport(), nameArg, std::make_unique<Acceptor>(loop, listenAddr, option == kReusePort))
+    {
+    }
+
+    TcpServer::TcpServer(EventLoop *loop, int listenFd, const std::string &nameArg)
+        : TcpServer(loop, Socket::localAddress(listenFd).toIPport(), nameArg, std::make_unique<Acceptor>(loop, listenFd))
+    {
+    }
+
+    TcpServer::TcpServer(EventLoop *loop, const std::string &ipPort, const std::string &nameArg, std::unique_ptr<Acceptor> acceptor)
+        : loop_(CheckLoopNotNull(loop)), ipPort_(ipPort), name_(nameArg), acceptor_(std::move(acceptor)), threadPool_(std::make_shared<EventLoopThreadPool>(loop, name_)), connectionCallback_(), messageCallback_(), writeCompleteCallback_(), threadInitCallback_(), drainConnectionCallback_(defaultDrainConnectionCallback), started_(), busyPollSpinSeconds_(0), busyPollUsecs_(0), tlsContext_(nullptr), connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_)), nextConnId_(1), shards_()
     {
         // 当有新用户连接时，会执行TCPserver::newConnection回调
         acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1,
@@ -25,12 +52,10 @@ namespace mymuduo
 
     TcpServer::~TcpServer()
     {
-        for (auto &item : connections_)
+        // 各个shard只能在自己的loop线程里访问，交给对应的loop去销毁连接
+        for (auto &item : shards_)
         {
-            TcpConnectionPtr conn(item.second); // 这个局部shared_ptr智能指针对象，出右括号，可以自动释放new出来的对象资源
-            item.second.reset();
-            // 销毁连接
-            conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+            item.first->runInLoop(std::bind(&TcpServer::destroyConnectionsInLoop, item.second));
         }
     }
 
@@ -44,61 +69,186 @@ namespace mymuduo
     {
         if (started_++ == 0) // 防止一个tcpserver对象被start多次
         {
-            threadPool_->start(threadInitCallback_); // 启动底层loop的线程池
+            if (tlsContext_ && !tlsContext_->ready())
+            {
+                LOG_FMT_FATAL("TcpServer::start [%s] - TLS certificate is not loaded \n", name_.c_str());
+            }
+            threadPool_->start(std::bind(&TcpServer::initLoopThread, this, std::placeholders::_1)); // 启动底层loop的线程池
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                shards_[ioLoop] = std::make_shared<ConnectionShard>(ioLoop);
+            }
             loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
         }
     }
 
+    // 在每个IO loop线程里、loop()开始之前执行
+    void TcpServer::initLoopThread(EventLoop *loop)
+    {
+        if (busyPollSpinSeconds_ > 0)
+        {
+            loop->setBusyPollSpin(busyPollSpinSeconds_);
+        }
+        if (busyPollUsecs_ > 0)
+        {
+            loop->setEpollBusyPoll(busyPollUsecs_);
+        }
+        if (threadInitCallback_)
+        {
+            threadInitCallback_(loop);
+        }
+    }
+
     // 有一个新的客户端的连接，acceptor会执行这个回调操作
     void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     {
         loop_->assertInLoopThread();
-        // 轮询算法，选择一个subloop来管理channel
-        EventLoop *ioLoop = threadPool_->getNextLoop();
-        char buf[64] = {0};
-        snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-        ++nextConnId_;
-        std::string connName = name_ + buf;
-
-        LOG_FMT_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s \n", name_.c_str(), connName.c_str(), peerAddr.toIPport().c_str());
+        g_connectionsAccepted->increment();
+        // 按分配策略(默认轮询)选择一个subloop来管理channel
+        EventLoop *ioLoop = threadPool_->getLoopForConnection(sockfd, peerAddr);
+        const uint64_t connId = nextConnId_++;
+        auto shardIt = shards_.find(ioLoop);
+        assert(shardIt != shards_.end());
+        const ConnectionShardPtr &shard = shardIt->second;
+        shard->numConnections.fetch_add(1, std::memory_order_relaxed);
+
+        LOG_FMT_INFO("TcpServer::newConnection [%s] - new connection [#%llu] from %s \n", name_.c_str(), static_cast<unsigned long long>(connId), peerAddr.toIPport().c_str());
         // 通过sockfd获取其绑定的本机的ip地址和端口信息
-        sockaddr_in local;
-        ::bzero(&local, sizeof local);
-        socklen_t addrlen = sizeof local;
-        if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
-        {
-            //LOG_FMT_ERROR("sockets::getLocalAddr");
-            LOG_FATAL << "sockets::getLocalAddr, errno: " << errno;
-        }
-        InetAddress localAddr(local);
+        InetAddress localAddr(Socket::localAddress(sockfd));
 
         // 根据成功连接的sockfd，创建TcpConnection连接对象
         // TcpConnectionPtr是shared_ptr，使用make_shared分配和使用动态内存给一个对象，这样可以保证因为在runtime的时候
         // 异常发生能够正常回收动态分配的内存。
-        TcpConnectionPtr conn(std::make_shared<TcpConnection>(ioLoop, connName, sockfd, localAddr, peerAddr));
-        connections_[connName] = conn;
+        TcpConnectionPtr conn(std::make_shared<TcpConnection>(ioLoop, connId, connNamePrefix_, sockfd, localAddr, peerAddr));
         // 下面的回调都是用户设置给TcpServer=>TcpConnection=>Channel=>Poller=>notify channel调用回调
         conn->setConnectionCallback(connectionCallback_);
         conn->setMessageCallback(messageCallback_);
         conn->setWriteCompleteCallback(writeCompleteCallback_);
-        conn->setWriteCompleteCallback(writeCompleteCallback_);
-        // 设置了如何关闭连接的回调
-        conn->setCloseCallback(std::bind(&TcpServer::removeConenction, this, std::placeholders::_1));
-        ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+        // 设置了如何关闭连接的回调，直接在ioLoop里从它的shard删除
+        conn->setCloseCallback(std::bind(&TcpServer::removeConnection, shard, std::placeholders::_1));
+        if (busyPollUsecs_ > 0)
+        {
+            conn->setBusyPoll(busyPollUsecs_);
+        }
+        if (tlsContext_)
+        {
+            conn->startTls(tlsContext_);
+        }
+        ioLoop->runInLoop(std::bind(&TcpServer::addConnectionInLoop, shard, conn));
+    }
+
+    void TcpServer::addConnectionInLoop(const ConnectionShardPtr &shard, const TcpConnectionPtr &conn)
+    {
+        shard->loop->assertInLoopThread();
+        shard->connections[conn->id()] = conn;
+        conn->connectEstablished();
+        if (shard->draining)
+        {
+            // drain开始之前accept、之后才到达IO线程的连接
+            shard->drainCallback(conn);
+        }
+    }
+
+    void TcpServer::removeConnection(const ConnectionShardPtr &shard, const TcpConnectionPtr &conn)
+    {
+        shard->loop->assertInLoopThread();
+        LOG_FMT_INFO("TcpServer::removeConnection - connection #%llu\n", static_cast<unsigned long long>(conn->id()));
+        if (shard->connections.erase(conn->id()) > 0)
+        {
+            shard->numConnections.fetch_sub(1, std::memory_order_relaxed);
+        }
+        // 正在conn的channel回调里，销毁要推迟到这一轮事件处理完之后
+        shard->loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    }
+
+    void TcpServer::destroyConnectionsInLoop(const ConnectionShardPtr &shard)
+    {
+        ConnectionMap connections;
+        connections.swap(shard->connections);
+        for (auto &item : connections)
+        {
+            item.second->connectDestroyed();
+        }
+    }
+
+    void TcpServer::stopAccepting()
+    {
+        loop_->runInLoop(std::bind(&Acceptor::stopListening, acceptor_.get(), true));
     }
 
-    void TcpServer::removeConenction(const TcpConnectionPtr &conn)
+    void TcpServer::detachListener()
     {
-        loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+        loop_->runInLoop(std::bind(&Acceptor::stopListening, acceptor_.get(), false));
+    }
+
+    void TcpServer::drain(double timeoutSeconds, const DrainCallback &cb)
+    {
+        loop_->runInLoop(std::bind(&TcpServer::drainInLoop, this, timeoutSeconds, cb));
+    }
+
+    void TcpServer::drainInLoop(double timeoutSeconds, const DrainCallback &cb)
+    {
+        loop_->assertInLoopThread();
+        acceptor_->stopListening();
+        LOG_FMT_INFO("TcpServer::drain [%s] - timeout %.3fs \n", name_.c_str(), timeoutSeconds);
+        for (auto &item : shards_)
+        {
+            item.first->runInLoop(std::bind(&TcpServer::drainShardInLoop, item.second, drainConnectionCallback_));
+        }
+        checkDrained(addTime(Timestamp::now(), timeoutSeconds), false, cb);
     }
 
-    void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+    void TcpServer::checkDrained(Timestamp deadline, bool forced, const DrainCallback &cb)
     {
-        LOG_FMT_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n",
-                 name_.c_str(), conn->name().c_str());
-        size_t n = connections_.erase(conn->name());
-        EventLoop *ioLoop = conn->getLoop();
-        ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        size_t remaining = 0;
+        for (auto &item : shards_)
+        {
+            remaining += item.second->numConnections.load(std::memory_order_relaxed);
+        }
+        if (remaining == 0)
+        {
+            LOG_FMT_INFO("TcpServer::drain [%s] - all connections closed \n", name_.c_str());
+            if (cb)
+            {
+                cb();
+            }
+            return;
+        }
+        if (!forced && !(Timestamp::now() < deadline))
+        {
+            LOG_FMT_ERROR("TcpServer::drain [%s] - timeout, force closing %lu connections \n", name_.c_str(), remaining);
+            for (auto &item : shards_)
+            {
+                item.first->runInLoop(std::bind(&TcpServer::forceCloseShardInLoop, item.second));
+            }
+            forced = true;
+        }
+        loop_->runAfter(kDrainCheckInterval, std::bind(&TcpServer::checkDrained, this, deadline, forced, cb));
+    }
+
+    void TcpServer::drainShardInLoop(const ConnectionShardPtr &shard, const ConnectionCallback &cb)
+    {
+        shard->draining = true;
+        shard->drainCallback = cb;
+        // 回调里可能关闭连接、修改连接表，先拷贝一份
+        std::vector<TcpConnectionPtr> connections;
+        connections.reserve(shard->connections.size());
+        for (auto &item : shard->connections)
+        {
+            connections.push_back(item.second);
+        }
+        for (const TcpConnectionPtr &conn : connections)
+        {
+            cb(conn);
+        }
+    }
+
+    void TcpServer::forceCloseShardInLoop(const ConnectionShardPtr &shard)
+    {
+        for (auto &item : shard->connections)
+        {
+            item.second->forceClose();
+        }
     }
 
 } // namespace mymuduo
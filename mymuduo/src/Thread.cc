@@ -2,6 +2,7 @@
 #include "mymuduo/CurrentThread.h"
 
 #include <semaphore.h>
+#include <pthread.h>
 
 namespace mymuduo
 {
@@ -37,6 +38,8 @@ namespace mymuduo
                                                 {
                 // 获取线程的tid
                 tid_ = CurrentThread::tid();
+                // 内核里的线程名(top -H、perf、/proc/<pid>/task/<tid>/comm可见)，最多15个字符
+                ::pthread_setname_np(::pthread_self(), name_.substr(0, 15).c_str());
                 ::sem_post(&sem);
                 func_(); });
         // 这里必须等待获取上面创建的新线程tid值
@@ -0,0 +1,133 @@
+#include "mymuduo/ThreadPool.h"
+
+#include <string>
+
+namespace mymuduo
+{
+    namespace
+    {
+        // 当前线程在哪个线程池里、是第几个工作线程，用来让工作线程提交的任务进自己的队列
+        __thread ThreadPool *t_pool = nullptr;
+        __thread int t_workerIndex = -1;
+    } // namespace
+
+    ThreadPool::ThreadPool(const std::string &nameArg)
+        : name_(nameArg), pending_(0), next_(0), running_(false)
+    {
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        if (running_)
+        {
+            stop();
+        }
+    }
+
+    void ThreadPool::start(int numThreads)
+    {
+        running_ = true;
+        queues_.reserve(numThreads);
+        for (int i = 0; i < numThreads; ++i)
+        {
+            queues_.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+        }
+        threads_.reserve(numThreads);
+        for (int i = 0; i < numThreads; ++i)
+        {
+            threads_.push_back(std::unique_ptr<Thread>(
+                new Thread(std::bind(&ThreadPool::runInThread, this, i), name_ + std::to_string(i))));
+            threads_.back()->start();
+        }
+    }
+
+    void ThreadPool::stop()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        notEmpty_.notify_all();
+        for (auto &thread : threads_)
+        {
+            thread->join();
+        }
+        threads_.clear();
+    }
+
+    void ThreadPool::run(Task task)
+    {
+        if (queues_.empty())
+        {
+            task();
+            return;
+        }
+
+        const bool fromWorker = t_pool == this;
+        const size_t index = fromWorker ? t_workerIndex : next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        {
+            std::unique_lock<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->tasks.push_back(std::move(task));
+        }
+        {
+            // pending_在mutex_保护下增加，空闲线程检查条件和睡眠之间不会漏掉通知
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++pending_;
+        }
+        notEmpty_.notify_one();
+    }
+
+    bool ThreadPool::take(int index, Task *task)
+    {
+        {
+            WorkQueue &own = *queues_[index];
+            std::unique_lock<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty())
+            {
+                *task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        const int n = static_cast<int>(queues_.size());
+        for (int i = 1; i < n; ++i)
+        {
+            WorkQueue &victim = *queues_[(index + i) % n];
+            std::unique_lock<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                *task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::runInThread(int index)
+    {
+        t_pool = this;
+        t_workerIndex = index;
+        while (true)
+        {
+            Task task;
+            if (take(index, &task))
+            {
+                --pending_;
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            // 任务先进队列再计入pending_，别的线程刚偷走任务、还没减pending_时这里会空转一两次
+            notEmpty_.wait(lock, [this] { return pending_ > 0 || !running_; });
+            if (!running_ && pending_ <= 0)
+            {
+                break;
+            }
+        }
+        t_pool = nullptr;
+        t_workerIndex = -1;
+    }
+} // namespace mymuduo
@@ -4,6 +4,7 @@
 #include "mymuduo/EventLoop.h"
 #include "mymuduo/Logger.h"
 #include "mymuduo/Timestamp.h"
+#include "mymuduo/Metrics.h"
 
 #include <sys/timerfd.h>
 #include <string.h>
@@ -66,7 +67,15 @@ namespace mymuduo
 
     } // namespace detail
 
-    std::shared_ptr<Timer> timerEntryPtr_(reinterpret_cast<Timer *>(UINTPTR_MAX));
+    namespace
+    {
+        Gauge *const g_timers = MetricsRegistry::instance().gauge(
+            "mymuduo_timers", "Timers scheduled but not yet expired or cancelled, summed over all loops.");
+    } // namespace
+
+    // getExpired中lower_bound用的哨兵，地址取最大值使得到期时间等于now的定时器也算到期
+    // 用aliasing构造函数生成不持有所有权的shared_ptr，程序退出时不会去delete这个非法地址
+    static const std::shared_ptr<Timer> kSentryTimerPtr(std::shared_ptr<Timer>(), reinterpret_cast<Timer *>(UINTPTR_MAX));
 
     TimerQueue::TimerQueue(EventLoop *loop)
         : loop_(loop), timerfd_(detail::createTimerfd()), timerfdChannel_(loop_, timerfd_), timers_(), callingExpiredTimers_(false)
@@ -82,6 +91,7 @@ namespace mymuduo
         timerfdChannel_.disableAll();
         timerfdChannel_.remove();
         ::close(timerfd_);
+        g_timers->add(-static_cast<int64_t>(timers_.size()));
     }
 
     TimerId TimerQueue::addTimer(const TimerCallback &cb, Timestamp when, double interval)
@@ -120,8 +130,9 @@ namespace mymuduo
         ActiveTimerSet::iterator it = activeTimers_.find(timer);
         if(it != activeTimers_.end())
         {
-            size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
+            timers_.erase(Entry(it->first->expiration(), it->first));
             activeTimers_.erase(it);
+            g_timers->decrement();
         }
         else if(callingExpiredTimers_)
         {
@@ -154,7 +165,7 @@ namespace mymuduo
     std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
     {
         std::vector<Entry> expired;
-        Entry sentry(now, std::shared_ptr<Timer>(timerEntryPtr_));
+        Entry sentry(now, kSentryTimerPtr);
         TimerSet::iterator end = timers_.lower_bound(sentry);
         std::copy(timers_.begin(), end, back_inserter(expired));
         timers_.erase(timers_.begin(), end);
@@ -162,8 +173,9 @@ namespace mymuduo
         for (const Entry &it : expired)
         {
             ActiveTimer timer(it.second, it.second->sequence());
-            size_t n = activeTimers_.erase(timer);
+            activeTimers_.erase(timer);
         }
+        g_timers->add(-static_cast<int64_t>(expired.size()));
 
         return expired;
     }
@@ -206,6 +218,11 @@ namespace mymuduo
         {
             std::pair<TimerSet::iterator, bool> result = timers_.insert(Entry(when, timer));
         }
+        {
+            // cancel()按(Timer, sequence)在activeTimers_里查找
+            activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
+        }
+        g_timers->increment();
 
         return earliestChanged;
     }
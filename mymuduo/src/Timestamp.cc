@@ -1,6 +1,7 @@
 #include "mymuduo/Timestamp.h"
 
 #include <time.h>
+#include <sys/time.h>
 
 namespace mymuduo
 {
@@ -11,15 +12,20 @@ namespace mymuduo
     {
     }
 
+    // 微秒精度，Logger、定时器和HTTP访问日志的耗时统计都依赖这个精度
     Timestamp Timestamp::now()
     {
-        return Timestamp(time(NULL));
+        struct timeval tv;
+        ::gettimeofday(&tv, NULL);
+        int64_t seconds = tv.tv_sec;
+        return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);
     }
 
     std::string Timestamp::tostring() const
     {
         char buf[128] = {0};
-        tm *tm_time = localtime(&microSecondsSinceEpoch_);
+        time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+        tm *tm_time = localtime(&seconds);
         snprintf(buf, 128, "%4d/%02d/%02d   %02d:%02d:%02d",
                  tm_time->tm_year + 1900,
                  tm_time->tm_mon + 1,
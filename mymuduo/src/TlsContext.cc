@@ -0,0 +1,167 @@
+#include "mymuduo/TlsContext.h"
+#include "mymuduo/Logger.h"
+
+#ifdef MYMUDUO_HAVE_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+namespace mymuduo
+{
+#ifdef MYMUDUO_HAVE_OPENSSL
+    namespace
+    {
+        const unsigned char kSessionIdContext[] = "mymuduo";
+
+        // 按服务器的偏好从客户端的列表里选一个，arg是线上格式的服务器列表
+        int selectAlpn(SSL *, const unsigned char **out, unsigned char *outlen,
+                       const unsigned char *in, unsigned int inlen, void *arg)
+        {
+            const std::string *protocols = static_cast<const std::string *>(arg);
+            unsigned char *selected = nullptr;
+            if (::SSL_select_next_proto(&selected, outlen,
+                                        reinterpret_cast<const unsigned char *>(protocols->data()),
+                                        static_cast<unsigned int>(protocols->size()),
+                                        in, inlen) != OPENSSL_NPN_NEGOTIATED)
+            {
+                return SSL_TLSEXT_ERR_NOACK;
+            }
+            *out = selected;
+            return SSL_TLSEXT_ERR_OK;
+        }
+
+        void logSslError(const char *what, const std::string &file)
+        {
+            char err[256];
+            ::ERR_error_string_n(::ERR_get_error(), err, sizeof err);
+            ::ERR_clear_error();
+            LOG_FMT_ERROR("TlsContext::%s %s - %s \n", what, file.c_str(), err);
+        }
+    } // namespace
+
+    TlsContext::TlsContext()
+        : ctx_(::SSL_CTX_new(::TLS_server_method())),
+          ready_(false)
+    {
+        if (ctx_ == nullptr)
+        {
+            LOG_FMT_FATAL("TlsContext - SSL_CTX_new failed \n");
+        }
+        ::SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        ::SSL_CTX_set_options(ctx_, SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE);
+        // 空闲连接不占着读写缓冲区，长连接多的时候省内存
+        ::SSL_CTX_set_mode(ctx_, SSL_MODE_RELEASE_BUFFERS);
+        ::SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+        ::SSL_CTX_set_session_id_context(ctx_, kSessionIdContext, sizeof kSessionIdContext - 1);
+    }
+
+    TlsContext::~TlsContext()
+    {
+        ::SSL_CTX_free(ctx_);
+    }
+
+    bool TlsContext::available()
+    {
+        return true;
+    }
+
+    bool TlsContext::loadCertificate(const std::string &certFile, const std::string &keyFile)
+    {
+        if (::SSL_CTX_use_certificate_chain_file(ctx_, certFile.c_str()) != 1)
+        {
+            logSslError("loadCertificate", certFile);
+            return false;
+        }
+        if (::SSL_CTX_use_PrivateKey_file(ctx_, keyFile.c_str(), SSL_FILETYPE_PEM) != 1)
+        {
+            logSslError("loadCertificate", keyFile);
+            return false;
+        }
+        if (::SSL_CTX_check_private_key(ctx_) != 1)
+        {
+            logSslError("loadCertificate", keyFile);
+            return false;
+        }
+        ready_ = true;
+        return true;
+    }
+
+    void TlsContext::setAlpnProtocols(const std::vector<std::string> &protocols)
+    {
+        alpn_.clear();
+        for (const std::string &protocol : protocols)
+        {
+            if (protocol.empty() || protocol.size() > 255)
+            {
+                LOG_FMT_ERROR("TlsContext::setAlpnProtocols - invalid protocol '%s' \n", protocol.c_str());
+                continue;
+            }
+            alpn_.push_back(static_cast<char>(protocol.size()));
+            alpn_ += protocol;
+        }
+        if (alpn_.empty())
+        {
+            ::SSL_CTX_set_alpn_select_cb(ctx_, nullptr, nullptr);
+        }
+        else
+        {
+            ::SSL_CTX_set_alpn_select_cb(ctx_, selectAlpn, &alpn_);
+        }
+    }
+
+    void TlsContext::setSessionCacheSize(size_t size)
+    {
+        if (size == 0)
+        {
+            ::SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+        }
+        else
+        {
+            ::SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+            ::SSL_CTX_sess_set_cache_size(ctx_, static_cast<long>(size));
+        }
+    }
+
+    void TlsContext::setSessionTimeout(int seconds)
+    {
+        ::SSL_CTX_set_timeout(ctx_, seconds);
+    }
+
+    void TlsContext::setSessionTickets(bool on)
+    {
+        if (on)
+        {
+            ::SSL_CTX_clear_options(ctx_, SSL_OP_NO_TICKET);
+        }
+        else
+        {
+            ::SSL_CTX_set_options(ctx_, SSL_OP_NO_TICKET);
+        }
+    }
+#else
+    TlsContext::TlsContext()
+        : ctx_(nullptr),
+          ready_(false)
+    {
+    }
+
+    TlsContext::~TlsContext() = default;
+
+    bool TlsContext::available()
+    {
+        return false;
+    }
+
+    bool TlsContext::loadCertificate(const std::string &certFile, const std::string &)
+    {
+        LOG_FMT_ERROR("TlsContext::loadCertificate %s - built without OpenSSL \n", certFile.c_str());
+        return false;
+    }
+
+    void TlsContext::setAlpnProtocols(const std::vector<std::string> &) {}
+    void TlsContext::setSessionCacheSize(size_t) {}
+    void TlsContext::setSessionTimeout(int) {}
+    void TlsContext::setSessionTickets(bool) {}
+#endif
+
+} // namespace mymuduo
@@ -0,0 +1,246 @@
+#include "mymuduo/TlsEngine.h"
+#include "mymuduo/TlsContext.h"
+#include "mymuduo/Logger.h"
+#include "mymuduo/Metrics.h"
+
+#ifdef MYMUDUO_HAVE_OPENSSL
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+#include <string.h>
+
+namespace mymuduo
+{
+#ifdef MYMUDUO_HAVE_OPENSSL
+    namespace
+    {
+        Counter *const g_handshakes = MetricsRegistry::instance().counter(
+            "mymuduo_tls_handshakes_total", "Completed TLS handshakes.");
+        Counter *const g_resumed = MetricsRegistry::instance().counter(
+            "mymuduo_tls_sessions_resumed_total", "TLS handshakes that resumed a session (ticket or cache).");
+        Counter *const g_handshakeFailures = MetricsRegistry::instance().counter(
+            "mymuduo_tls_handshake_failures_total", "TLS handshakes that failed.");
+
+        // 一条TLS记录的明文最多16KB，每次SSL_read至少留出这么多空间
+        const size_t kMaxRecordSize = 16 * 1024;
+
+        void logSslError(const char *what, int err)
+        {
+            char reason[256] = "";
+            unsigned long code = ::ERR_get_error();
+            if (code != 0)
+            {
+                ::ERR_error_string_n(code, reason, sizeof reason);
+            }
+            ::ERR_clear_error();
+            LOG_FMT_ERROR("TlsEngine::%s - error %d %s \n", what, err, reason);
+        }
+
+        long bioCtrl(BIO *, int cmd, long, void *)
+        {
+            // OpenSSL写完一条记录会flush，其余的控制命令(kTLS、dgram等)都不支持
+            return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+        }
+
+        int bioCreate(BIO *bio)
+        {
+            ::BIO_set_init(bio, 1);
+            return 1;
+        }
+    } // namespace
+
+    int TlsEngine::bioRead(BIO *bio, char *data, int len)
+    {
+        TlsEngine *engine = static_cast<TlsEngine *>(::BIO_get_data(bio));
+        ::BIO_clear_retry_flags(bio);
+        size_t n = std::min(engine->input_.readableBytes(), static_cast<size_t>(len));
+        if (n == 0)
+        {
+            ::BIO_set_retry_read(bio);
+            return -1;
+        }
+        ::memcpy(data, engine->input_.peek(), n);
+        engine->input_.retrieve(n);
+        return static_cast<int>(n);
+    }
+
+    int TlsEngine::bioWrite(BIO *bio, const char *data, int len)
+    {
+        TlsEngine *engine = static_cast<TlsEngine *>(::BIO_get_data(bio));
+        ::BIO_clear_retry_flags(bio);
+        engine->output_.append(data, len);
+        return len;
+    }
+
+    TlsEngine::TlsEngine(TlsContext *context)
+        : ssl_(::SSL_new(context->nativeHandle())),
+          handshakeDone_(false),
+          peerClosed_(false),
+          shutdownSent_(false)
+    {
+        // 所有连接共用一个BIO_METHOD，读写直接落在input_/output_上，不经过OpenSSL自己的内存BIO
+        static BIO_METHOD *method = []() {
+            BIO_METHOD *m = ::BIO_meth_new(::BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "mymuduo buffer");
+            ::BIO_meth_set_read(m, &TlsEngine::bioRead);
+            ::BIO_meth_set_write(m, &TlsEngine::bioWrite);
+            ::BIO_meth_set_ctrl(m, bioCtrl);
+            ::BIO_meth_set_create(m, bioCreate);
+            return m;
+        }();
+        if (ssl_ == nullptr)
+        {
+            LOG_FMT_FATAL("TlsEngine - SSL_new failed \n");
+        }
+        BIO *bio = ::BIO_new(method);
+        ::BIO_set_data(bio, this);
+        // 读写用同一个BIO，只持有一次引用
+        ::SSL_set_bio(ssl_, bio, bio);
+        ::SSL_set_accept_state(ssl_);
+    }
+
+    TlsEngine::~TlsEngine()
+    {
+        // 没有互发close_notify就释放的会话会被OpenSSL从缓存里删掉，而HTTP客户端大多直接关连接，
+        // 这里当作已经正常关闭，让会话缓存照常复用。截断由HTTP自己的报文边界发现
+        if (handshakeDone_)
+        {
+            ::SSL_set_shutdown(ssl_, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        }
+        ::SSL_free(ssl_);
+    }
+
+    bool TlsEngine::decrypt(Buffer *plain)
+    {
+        if (!handshakeDone_ && !handshake())
+        {
+            return false;
+        }
+        while (handshakeDone_ && !peerClosed_)
+        {
+            plain->ensureWritableBytes(kMaxRecordSize);
+            int n = ::SSL_read(ssl_, plain->beginWrite(), static_cast<int>(plain->writableBytes()));
+            if (n > 0)
+            {
+                plain->hasWritten(n);
+                continue;
+            }
+            int err = ::SSL_get_error(ssl_, n);
+            if (err == SSL_ERROR_WANT_READ)
+            {
+                break;
+            }
+            if (err == SSL_ERROR_ZERO_RETURN)
+            {
+                peerClosed_ = true;
+                break;
+            }
+            logSslError("decrypt", err);
+            return false;
+        }
+        return true;
+    }
+
+    bool TlsEngine::handshake()
+    {
+        int ret = ::SSL_do_handshake(ssl_);
+        if (ret == 1)
+        {
+            handshakeDone_ = true;
+            g_handshakes->increment();
+            if (::SSL_session_reused(ssl_))
+            {
+                g_resumed->increment();
+            }
+            return flushPending();
+        }
+        int err = ::SSL_get_error(ssl_, ret);
+        if (err == SSL_ERROR_WANT_READ)
+        {
+            return true;
+        }
+        g_handshakeFailures->increment();
+        logSslError("handshake", err);
+        return false;
+    }
+
+    bool TlsEngine::encrypt(const void *data, size_t len)
+    {
+        if (!handshakeDone_)
+        {
+            pending_.append(static_cast<const char *>(data), len);
+            return true;
+        }
+        const char *p = static_cast<const char *>(data);
+        while (len > 0)
+        {
+            // 写进内存，不会只写一部分
+            int chunk = static_cast<int>(std::min(len, static_cast<size_t>(1 << 30)));
+            int n = ::SSL_write(ssl_, p, chunk);
+            if (n <= 0)
+            {
+                logSslError("encrypt", ::SSL_get_error(ssl_, n));
+                return false;
+            }
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    bool TlsEngine::flushPending()
+    {
+        if (pending_.readableBytes() == 0)
+        {
+            return true;
+        }
+        bool ok = encrypt(pending_.peek(), pending_.readableBytes());
+        pending_.retrieveAll();
+        return ok;
+    }
+
+    void TlsEngine::shutdown()
+    {
+        if (!shutdownSent_)
+        {
+            shutdownSent_ = true;
+            // 握手还没完成时没有可以关闭的会话，直接关TCP
+            if (handshakeDone_)
+            {
+                ::SSL_shutdown(ssl_);
+                ::ERR_clear_error();
+            }
+        }
+    }
+
+    std::string TlsEngine::alpnProtocol() const
+    {
+        const unsigned char *data = nullptr;
+        unsigned int len = 0;
+        ::SSL_get0_alpn_selected(ssl_, &data, &len);
+        return data ? std::string(reinterpret_cast<const char *>(data), len) : std::string();
+    }
+
+    bool TlsEngine::sessionReused() const
+    {
+        return ::SSL_session_reused(ssl_) == 1;
+    }
+#else
+    // 没有OpenSSL时TlsContext::ready()总是false，TcpConnection不会创建TlsEngine
+    TlsEngine::TlsEngine(TlsContext *)
+        : ssl_(nullptr),
+          handshakeDone_(false),
+          peerClosed_(false),
+          shutdownSent_(false)
+    {
+    }
+
+    TlsEngine::~TlsEngine() = default;
+    bool TlsEngine::decrypt(Buffer *) { return false; }
+    bool TlsEngine::encrypt(const void *, size_t) { return false; }
+    void TlsEngine::shutdown() {}
+    std::string TlsEngine::alpnProtocol() const { return std::string(); }
+    bool TlsEngine::sessionReused() const { return false; }
+#endif
+
+} // namespace mymuduo
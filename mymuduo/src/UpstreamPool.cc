@@ -0,0 +1,189 @@
+#include "mymuduo/UpstreamPool.h"
+#include "mymuduo/EventLoop.h"
+#include "mymuduo/Logger.h"
+#include "mymuduo/Socket.h"
+#include "mymuduo/TcpConnection.h"
+#include "mymuduo/Buffer.h"
+#include "mymuduo/Metrics.h"
+
+#include <algorithm>
+
+namespace mymuduo
+{
+    namespace
+    {
+        Counter *const g_upstreamConnects = MetricsRegistry::instance().counter(
+            "mymuduo_upstream_connects_total", "Connections opened by UpstreamPools.");
+        Counter *const g_upstreamConnectFailures = MetricsRegistry::instance().counter(
+            "mymuduo_upstream_connect_failures_total", "UpstreamPool connection attempts that gave up.");
+        Counter *const g_upstreamReuses = MetricsRegistry::instance().counter(
+            "mymuduo_upstream_reuses_total", "Idle upstream connections handed out again.");
+
+        void destroyConnection(EventLoop *loop, const TcpConnectionPtr &conn)
+        {
+            loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        }
+
+        void ignoreConnection(const TcpConnectionPtr &)
+        {
+        }
+
+        void discardMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+        {
+            buf->retrieveAll();
+        }
+    } // namespace
+
+    UpstreamPool::UpstreamPool(EventLoop *loop, const InetAddress &serverAddr, const std::string &name)
+        : loop_(loop),
+          serverAddr_(serverAddr),
+          connNamePrefix_(std::make_shared<const std::string>(name + "-" + serverAddr.toIPport())),
+          maxIdle_(16),
+          connectTimeout_(3.0),
+          connectRetries_(1),
+          nextConnId_(1)
+    {
+    }
+
+    UpstreamPool::~UpstreamPool()
+    {
+        loop_->assertInLoopThread();
+        for (auto &item : connecting_)
+        {
+            item.second->stop();
+        }
+        for (auto &item : connections_)
+        {
+            // 池已经不在了，之后的回调不能再访问this
+            const TcpConnectionPtr &conn = item.second;
+            conn->setConnectionCallback(ignoreConnection);
+            conn->setMessageCallback(discardMessage);
+            conn->setCloseCallback(std::bind(&destroyConnection, loop_, std::placeholders::_1));
+            conn->forceClose();
+        }
+    }
+
+    void UpstreamPool::acquire(const AcquireCallback &cb)
+    {
+        loop_->assertInLoopThread();
+        while (!idle_.empty())
+        {
+            TcpConnectionPtr conn(std::move(idle_.back()));
+            idle_.pop_back();
+            if (conn->connected())
+            {
+                g_upstreamReuses->increment();
+                cb(conn);
+                return;
+            }
+        }
+
+        ConnectorPtr connector(std::make_shared<Connector>(loop_, serverAddr_));
+        connector->setMaxRetries(connectRetries_);
+        connector->setConnectTimeout(connectTimeout_);
+        // connector的回调不能持有它自己的shared_ptr，用裸指针在connecting_里找回来
+        connector->setNewConnectionCallback(
+            std::bind(&UpstreamPool::onConnected, this, connector.get(), cb, std::placeholders::_1));
+        connector->setConnectFailedCallback(
+            std::bind(&UpstreamPool::onConnectFailed, this, connector.get(), cb));
+        connecting_[connector.get()] = connector;
+        connector->start();
+    }
+
+    void UpstreamPool::release(const TcpConnectionPtr &conn)
+    {
+        loop_->assertInLoopThread();
+        if (!conn->connected() || idle_.size() >= maxIdle_)
+        {
+            conn->shutdown();
+            return;
+        }
+        idle_.push_back(conn);
+    }
+
+    ConnectorPtr UpstreamPool::takeConnector(Connector *connector)
+    {
+        ConnectorPtr ptr;
+        auto it = connecting_.find(connector);
+        if (it != connecting_.end())
+        {
+            ptr = it->second;
+            connecting_.erase(it);
+            // 正在connector自己的回调里，推迟到这一轮事件处理完之后再释放
+            loop_->queueInLoop(std::bind(&Connector::stop, ptr));
+        }
+        return ptr;
+    }
+
+    void UpstreamPool::onConnected(Connector *connector, const AcquireCallback &cb, int sockfd)
+    {
+        takeConnector(connector);
+        g_upstreamConnects->increment();
+        InetAddress localAddr(Socket::localAddress(sockfd));
+        TcpConnectionPtr conn(std::make_shared<TcpConnection>(loop_, nextConnId_++, connNamePrefix_, sockfd, localAddr, serverAddr_));
+        conn->setConnectionCallback(std::bind(&UpstreamPool::onConnection, this, std::placeholders::_1));
+        conn->setMessageCallback(std::bind(&UpstreamPool::onMessage, this, std::placeholders::_1,
+                                           std::placeholders::_2, std::placeholders::_3));
+        conn->setWriteCompleteCallback(writeCompleteCallback_);
+        conn->setCloseCallback(std::bind(&UpstreamPool::removeConnection, this, std::placeholders::_1));
+        connections_[conn->id()] = conn;
+        conn->connectEstablished();
+        cb(conn);
+    }
+
+    void UpstreamPool::onConnectFailed(Connector *connector, const AcquireCallback &cb)
+    {
+        takeConnector(connector);
+        g_upstreamConnectFailures->increment();
+        cb(TcpConnectionPtr());
+    }
+
+    void UpstreamPool::onConnection(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected() && removeIdle(conn))
+        {
+            LOG_FMT_DEBUG("UpstreamPool - idle connection #%llu closed by peer \n", static_cast<unsigned long long>(conn->id()));
+            return; // 空闲连接断开，没有使用者需要通知
+        }
+        if (connectionCallback_)
+        {
+            connectionCallback_(conn);
+        }
+    }
+
+    void UpstreamPool::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+    {
+        if (messageCallback_ && std::find(idle_.begin(), idle_.end(), conn) == idle_.end())
+        {
+            messageCallback_(conn, buf, receiveTime);
+            return;
+        }
+        // 没有请求在途却收到了数据，连接的状态已经不可信
+        // LOG_FMT_*宏内部有名为buf的局部变量，先把长度取出来
+        size_t unexpected = buf->readableBytes();
+        LOG_FMT_ERROR("UpstreamPool - unexpected %lu bytes on idle connection #%llu \n",
+                      unexpected, static_cast<unsigned long long>(conn->id()));
+        buf->retrieveAll();
+        removeIdle(conn);
+        conn->forceClose();
+    }
+
+    void UpstreamPool::removeConnection(const TcpConnectionPtr &conn)
+    {
+        loop_->assertInLoopThread();
+        connections_.erase(conn->id());
+        removeIdle(conn);
+        loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    }
+
+    bool UpstreamPool::removeIdle(const TcpConnectionPtr &conn)
+    {
+        auto it = std::find(idle_.begin(), idle_.end(), conn);
+        if (it == idle_.end())
+        {
+            return false;
+        }
+        idle_.erase(it);
+        return true;
+    }
+} // namespace mymuduo
@@ -0,0 +1,116 @@
+// ListenerHandoff的自测：旧的TcpServer在loop里serve()，另一个线程receive()收到监听fd，
+// 检查它还是同一个端口上的监听socket；旧server detachListener()+drain()之后不能SHUT_RD共享的socket，
+// 用收到的fd构造的新TcpServer还能accept新连接
+#include <mymuduo/ListenerHandoff.h>
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Logger.h>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "TestCheck.h"
+
+using namespace mymuduo;
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+
+    int oldConnections = 0;
+    TcpServer oldServer(&loop, InetAddress(0), "old");
+    oldServer.setConnectionCallback([&oldConnections](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            ++oldConnections;
+        }
+    });
+    oldServer.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+    oldServer.start();
+    const uint16_t port = Socket::localAddress(oldServer.listenFd()).toPort();
+
+    // 交接之后旧server停止accept并drain，没有连接所以马上drain完
+    std::promise<void> handedOff;
+    bool drained = false;
+    const std::string path = "/tmp/mymuduo_handoff_test_" + std::to_string(::getpid()) + ".sock";
+    ListenerHandoff handoff(&loop, path);
+    handoff.serve({oldServer.listenFd()}, [&]() {
+        oldServer.detachListener();
+        oldServer.drain(5.0, [&drained]() { drained = true; });
+        handedOff.set_value();
+    });
+
+    std::unique_ptr<TcpServer> newServer;
+    int newConnections = 0;
+    std::vector<int> fds;
+    int acceptConn = 0;
+    uint16_t receivedPort = 0;
+    bool connected = false;
+    std::thread client([&]() {
+        fds = ListenerHandoff::receive(path);
+        if (fds.size() == 1)
+        {
+            socklen_t len = sizeof acceptConn;
+            ::getsockopt(fds[0], SOL_SOCKET, SO_ACCEPTCONN, &acceptConn, &len);
+            receivedPort = Socket::localAddress(fds[0]).toPort();
+        }
+        handedOff.get_future().wait();
+
+        std::promise<void> started;
+        loop.runInLoop([&]() {
+            if (fds.size() == 1)
+            {
+                newServer.reset(new TcpServer(&loop, fds[0], "new"));
+                newServer->setConnectionCallback([&](const TcpConnectionPtr &conn) {
+                    if (conn->connected())
+                    {
+                        ++newConnections;
+                        loop.quit();
+                    }
+                });
+                newServer->setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+                newServer->start();
+            }
+            started.set_value();
+        });
+        started.get_future().wait();
+
+        // 旧server drain过了，共享的socket要是被SHUT_RD，这里会收到RST
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) == 0;
+        if (!connected)
+        {
+            loop.runInLoop([&loop]() { loop.quit(); });
+        }
+        ::close(fd);
+    });
+    loop.runAfter(5.0, [&loop]() { loop.quit(); });
+    loop.loop();
+    client.join();
+
+    CHECK(fds.size() == 1);
+    CHECK(acceptConn == 1);
+    CHECK(receivedPort == port);
+    CHECK(drained);
+    CHECK(connected);
+    CHECK(newConnections == 1);
+    CHECK(oldConnections == 0);
+    ::unlink(path.c_str());
+    return testResult();
+}
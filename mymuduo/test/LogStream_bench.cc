@@ -0,0 +1,182 @@
+#include "mymuduo/LogStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace mymuduo;
+
+// [Bench] LogStream数值格式化：查表整数格式化 / Grisu2 double格式化 对比原实现
+// 同时校验结果：整数与snprintf一致，double经strtod读回后与原值完全相等，校验失败返回非0
+namespace legacy
+{
+    const char digits[] = "9876543210123456789";
+    const char *zero = digits + 9;
+
+    // 原LogStream的实现：每位除以10，最后reverse
+    template <typename T>
+    size_t convert(char buf[], T value)
+    {
+        T i = value;
+        char *p = buf;
+
+        do
+        {
+            int lsd = static_cast<int>(i % 10);
+            i /= 10;
+            *p++ = zero[lsd];
+        } while (i != 0);
+
+        if (value < 0)
+        {
+            *p++ = '-';
+        }
+        *p = '\0';
+        std::reverse(buf, p);
+
+        return p - buf;
+    }
+
+    size_t formatDouble(char buf[], double v)
+    {
+        return snprintf(buf, detail::kMaxNumericSize, "%.12g", v);
+    }
+} // namespace legacy
+
+template <typename Func>
+double benchmark(const char *name, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t total = func();
+    auto end = std::chrono::steady_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    std::cout << name << ": " << ms << " ms (" << total << " bytes)" << std::endl;
+    return ms;
+}
+
+bool checkIntegers(const std::vector<int64_t> &values)
+{
+    char buf[detail::kMaxNumericSize];
+    char expect[detail::kMaxNumericSize];
+    for (int64_t v : values)
+    {
+        size_t len = detail::formatSigned(buf, v);
+        int n = snprintf(expect, sizeof expect, "%lld", static_cast<long long>(v));
+        if (len != static_cast<size_t>(n) || ::memcmp(buf, expect, len) != 0)
+        {
+            std::cerr << "integer mismatch: " << expect << std::endl;
+            return false;
+        }
+    }
+    const uint64_t edges[] = {0, 9, 10, 99, 100, UINT64_MAX, UINT64_MAX / 10, 10000000000000000000ULL};
+    for (uint64_t v : edges)
+    {
+        size_t len = detail::formatUnsigned(buf, v);
+        int n = snprintf(expect, sizeof expect, "%llu", static_cast<unsigned long long>(v));
+        if (len != static_cast<size_t>(n) || ::memcmp(buf, expect, len) != 0)
+        {
+            std::cerr << "unsigned mismatch: " << expect << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkDoubles(const std::vector<double> &values)
+{
+    char buf[detail::kMaxNumericSize + 1];
+    for (double v : values)
+    {
+        size_t len = detail::formatDouble(buf, v);
+        buf[len] = '\0';
+        double back = ::strtod(buf, nullptr);
+        if (::memcmp(&back, &v, sizeof v) != 0 && !(std::isnan(back) && std::isnan(v)))
+        {
+            std::cerr << "double round-trip mismatch: " << buf << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t kCount = argc > 1 ? ::atoi(argv[1]) : 1000000;
+    std::mt19937_64 rng(20230219);
+
+    std::vector<int64_t> ints(kCount);
+    for (auto &v : ints)
+    {
+        // 位数均匀分布，避免全是19位的大数
+        int64_t x = static_cast<int64_t>(rng() >> (rng() % 64));
+        v = (rng() & 1) ? x : -x;
+    }
+    ints.push_back(INT64_MIN);
+    ints.push_back(INT64_MAX);
+    ints.push_back(0);
+
+    std::vector<double> doubles(kCount);
+    std::uniform_real_distribution<double> uniform(0.0, 1000.0);
+    for (size_t i = 0; i < kCount; ++i)
+    {
+        uint64_t bits = rng();
+        double d;
+        ::memcpy(&d, &bits, sizeof d);
+        // 一半是任意位模式(覆盖极大极小值)，一半是日志里常见的小数
+        doubles[i] = (i & 1) ? d : uniform(rng);
+    }
+    const double specials[] = {0.0, -0.0, 0.1, 0.3, 1e21, 1e-7, 123456789012345678.0, 5e-324, 1.7976931348623157e308,
+                               NAN, INFINITY, -INFINITY};
+    doubles.insert(doubles.end(), std::begin(specials), std::end(specials));
+
+    if (!checkIntegers(ints) || !checkDoubles(doubles))
+    {
+        return 1;
+    }
+
+    char buf[detail::kMaxNumericSize];
+    benchmark("integer legacy   ", [&]() {
+        size_t total = 0;
+        for (int64_t v : ints)
+            total += legacy::convert(buf, v);
+        return total;
+    });
+    benchmark("integer pairs    ", [&]() {
+        size_t total = 0;
+        for (int64_t v : ints)
+            total += detail::formatSigned(buf, v);
+        return total;
+    });
+    benchmark("double snprintf  ", [&]() {
+        size_t total = 0;
+        for (double v : doubles)
+            total += legacy::formatDouble(buf, v);
+        return total;
+    });
+    benchmark("double grisu2    ", [&]() {
+        size_t total = 0;
+        for (double v : doubles)
+            total += detail::formatDouble(buf, v);
+        return total;
+    });
+
+    LogStream os;
+    benchmark("LogStream << int ", [&]() {
+        size_t total = 0;
+        for (int64_t v : ints)
+        {
+            os.resetBuffer();
+            os << static_cast<long long>(v);
+            total += os.buffer().length();
+        }
+        return total;
+    });
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+// TcpClient和UpstreamPool的自测：本进程起一个回显服务器，客户端连上去收发，检查连接池复用和连接失败
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/UpstreamPool.h>
+#include <mymuduo/Connector.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Logger.h>
+#include <mymuduo/Metrics.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "TestCheck.h"
+
+using namespace mymuduo;
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+
+    // 端口0由内核分配，实际地址从监听fd取
+    TcpServer server(&loop, InetAddress(0), "EchoServer");
+    server.setConnectionCallback([](const TcpConnectionPtr &) {});
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf->retrieveAllAsString());
+    });
+    server.start();
+    InetAddress serverAddr(Socket::localAddress(server.listenFd()));
+
+    // 1. TcpClient发一条消息，收到回显后断开
+    bool clientEchoed = false;
+    TcpClient client(&loop, serverAddr, "EchoClient");
+    client.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->send("hello");
+        }
+    });
+    client.setMessageCallback([&](const TcpConnectionPtr &, Buffer *buf, Timestamp) {
+        if (buf->readableBytes() >= 5)
+        {
+            clientEchoed = buf->retrieveAllAsString() == "hello";
+            client.disconnect();
+        }
+    });
+    client.connect();
+
+    // 2. 连接池：第二次acquire复用第一次放回的连接
+    UpstreamPool pool(&loop, serverAddr, "EchoPool");
+    int poolEchoes = 0;
+    pool.setMessageCallback([&](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        buf->retrieveAll();
+        ++poolEchoes;
+        pool.release(conn);
+        if (poolEchoes == 1)
+        {
+            pool.acquire([&](const TcpConnectionPtr &again) {
+                CHECK(again == conn);
+                again->send("second");
+            });
+        }
+    });
+    pool.acquire([](const TcpConnectionPtr &conn) {
+        CHECK(conn);
+        if (conn)
+        {
+            conn->send("first");
+        }
+    });
+
+    // 3. 连不上的地址：重试用完之后回调空连接
+    UpstreamPool deadPool(&loop, InetAddress(1), "DeadPool");
+    deadPool.setConnectRetries(0);
+    bool connectFailed = false;
+    deadPool.acquire([&](const TcpConnectionPtr &conn) {
+        connectFailed = !conn;
+    });
+
+    // 4. 设置了连接超时的Connector连上之后，定时器不再持有它
+    ConnectorPtr connector(std::make_shared<Connector>(&loop, serverAddr));
+    std::weak_ptr<Connector> weakConnector(connector);
+    connector->setConnectTimeout(3);
+    bool connectorConnected = false;
+    connector->setNewConnectionCallback([&](int sockfd) {
+        connectorConnected = true;
+        ::close(sockfd);
+    });
+    connector->start();
+
+    loop.runAfter(1.0, [&]() { loop.quit(); });
+    loop.loop();
+
+    CHECK(clientEchoed);
+    CHECK(poolEchoes == 2);
+    CHECK(pool.numConnections() == 1);
+    CHECK(pool.numIdle() == 1);
+    CHECK(connectFailed);
+    CHECK(connectorConnected);
+    connector.reset();
+    CHECK(weakConnector.expired());
+
+    // 5. 定时器个数和缓冲区内存的指标：池里留着一个空闲连接，两个缓冲区都计入了
+    Gauge *timers = MetricsRegistry::instance().gauge("mymuduo_timers", "");
+    Gauge *bufferMemory = MetricsRegistry::instance().gauge("mymuduo_tcp_buffer_memory_bytes", "");
+    CHECK(bufferMemory->value() >= static_cast<int64_t>(2 * (Buffer::kCheapPretend + Buffer::kInitialSize)));
+    int64_t timersBefore = timers->value();
+    TimerId timer = loop.runAfter(60.0, []() {});
+    CHECK(timers->value() == timersBefore + 1);
+    loop.cancel(timer);
+    CHECK(timers->value() == timersBefore);
+    return testResult();
+}
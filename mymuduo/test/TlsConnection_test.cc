@@ -0,0 +1,228 @@
+// TLS的自测：本进程起一个TLS回显服务器(自签名证书)，用OpenSSL的阻塞客户端连上去，
+// 检查握手前发送的数据、大块收发、ALPN、会话复用和明文客户端被拒绝
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/TlsContext.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/Logger.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "TestCheck.h"
+
+using namespace mymuduo;
+
+const char kGreeting[] = "hello\n";
+
+// 生成自签名证书和私钥，写到临时文件
+bool writeSelfSignedCertificate(const std::string &certFile, const std::string &keyFile)
+{
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    bool ok = X509_sign(cert, key, EVP_sha256()) > 0;
+
+    FILE *fp = fopen(certFile.c_str(), "w");
+    ok = ok && fp && PEM_write_X509(fp, cert) == 1;
+    if (fp)
+    {
+        fclose(fp);
+    }
+    fp = fopen(keyFile.c_str(), "w");
+    ok = ok && fp && PEM_write_PrivateKey(fp, key, nullptr, nullptr, 0, nullptr, nullptr) == 1;
+    if (fp)
+    {
+        fclose(fp);
+    }
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ok;
+}
+
+int connectTo(const InetAddress &addr)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(addr.getSockAddr()), sizeof(sockaddr_in)) < 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool readFully(SSL *ssl, std::string *out, size_t len)
+{
+    char buf[16384];
+    while (out->size() < len)
+    {
+        int n = SSL_read(ssl, buf, static_cast<int>(std::min(sizeof buf, len - out->size())));
+        if (n <= 0)
+        {
+            return false;
+        }
+        out->append(buf, n);
+    }
+    return true;
+}
+
+struct ClientResult
+{
+    bool connected = false;
+    bool echoed = false;
+    bool reused = false;
+    std::string alpn;
+};
+
+// 阻塞的TLS客户端：读问候语，发送message并读回显
+ClientResult runClient(SSL_CTX *ctx, const InetAddress &addr, const std::string &message, SSL_SESSION **session)
+{
+    ClientResult result;
+    int fd = connectTo(addr);
+    if (fd < 0)
+    {
+        return result;
+    }
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (*session)
+    {
+        SSL_set_session(ssl, *session);
+    }
+    if (SSL_connect(ssl) == 1)
+    {
+        result.connected = true;
+        result.reused = SSL_session_reused(ssl) == 1;
+        const unsigned char *alpn = nullptr;
+        unsigned int alpnLen = 0;
+        SSL_get0_alpn_selected(ssl, &alpn, &alpnLen);
+        if (alpn)
+        {
+            result.alpn.assign(reinterpret_cast<const char *>(alpn), alpnLen);
+        }
+
+        std::string greeting;
+        std::string echo;
+        result.echoed = readFully(ssl, &greeting, sizeof kGreeting - 1) && greeting == kGreeting &&
+                        SSL_write(ssl, message.data(), static_cast<int>(message.size())) == static_cast<int>(message.size()) &&
+                        readFully(ssl, &echo, message.size()) && echo == message;
+        // TLS 1.3的会话票据在握手之后才到，读过数据之后再取
+        SSL_SESSION_free(*session);
+        *session = SSL_get1_session(ssl);
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    ::close(fd);
+    return result;
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    CHECK(TlsContext::available());
+
+    char dir[] = "/tmp/tls_testXXXXXX";
+    CHECK(::mkdtemp(dir) != nullptr);
+    const std::string certFile = std::string(dir) + "/cert.pem";
+    const std::string keyFile = std::string(dir) + "/key.pem";
+    CHECK(writeSelfSignedCertificate(certFile, keyFile));
+
+    TlsContext tls;
+    CHECK(!tls.loadCertificate(certFile, "/nonexistent.pem"));
+    CHECK(tls.loadCertificate(certFile, keyFile));
+    tls.setAlpnProtocols({"h2", "http/1.1"});
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(0), "TlsEchoServer");
+    server.setTlsContext(&tls);
+    bool alpnSeen = false;
+    // 连接建立时握手还没开始，问候语先暂存，握手完成后再加密发出
+    server.setConnectionCallback([](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->send(kGreeting, sizeof kGreeting - 1);
+        }
+    });
+    server.setMessageCallback([&alpnSeen](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        alpnSeen = alpnSeen || conn->alpnProtocol() == "http/1.1";
+        conn->send(buf);
+    });
+    server.start();
+    InetAddress serverAddr(Socket::localAddress(server.listenFd()));
+
+    std::thread client([&]() {
+        std::string message(300 * 1024, '\0');
+        for (size_t i = 0; i < message.size(); ++i)
+        {
+            message[i] = static_cast<char>(i * 7);
+        }
+
+        // 1. TLS 1.3：ALPN、大块回显，第二次用票据复用会话
+        SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+        static const unsigned char kAlpn[] = "\x08http/1.1\x03" "foo";
+        SSL_CTX_set_alpn_protos(ctx, kAlpn, sizeof kAlpn - 1);
+        SSL_SESSION *session = nullptr;
+        ClientResult first = runClient(ctx, serverAddr, message, &session);
+        CHECK(first.connected && first.echoed && !first.reused);
+        CHECK(first.alpn == "http/1.1");
+        ClientResult second = runClient(ctx, serverAddr, "again", &session);
+        CHECK(second.connected && second.echoed && second.reused);
+        SSL_SESSION_free(session);
+        SSL_CTX_free(ctx);
+
+        // 2. TLS 1.2不用票据：服务端会话缓存复用，客户端不带ALPN
+        ctx = SSL_CTX_new(TLS_client_method());
+        SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+        session = nullptr;
+        first = runClient(ctx, serverAddr, "tls1.2", &session);
+        CHECK(first.connected && first.echoed && !first.reused && first.alpn.empty());
+        second = runClient(ctx, serverAddr, "tls1.2 again", &session);
+        CHECK(second.connected && second.echoed && second.reused);
+        SSL_SESSION_free(session);
+        SSL_CTX_free(ctx);
+
+        // 3. 明文客户端：握手失败，服务器关闭连接
+        int fd = connectTo(serverAddr);
+        CHECK(fd >= 0);
+        const char request[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        CHECK(::write(fd, request, sizeof request - 1) == sizeof request - 1);
+        char buf[1024];
+        ssize_t n;
+        std::string reply;
+        while ((n = ::read(fd, buf, sizeof buf)) > 0)
+        {
+            reply.append(buf, n);
+        }
+        CHECK(reply.find("HTTP") == std::string::npos);
+        ::close(fd);
+
+        loop.runInLoop([&loop]() { loop.quit(); });
+    });
+    loop.loop();
+    client.join();
+    CHECK(alpnSeen);
+
+    ::unlink(certFile.c_str());
+    ::unlink(keyFile.c_str());
+    ::rmdir(dir);
+    return testResult();
+}
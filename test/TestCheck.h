@@ -0,0 +1,23 @@
+#pragma once
+
+// 自测程序共用的断言：CHECK失败时打印位置并计数，不中断后面的检查。
+// main最后return testResult()，打印PASS/FAIL，有失败时退出码为1，ctest据此判断
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                  \
+    do                                                               \
+    {                                                                \
+        if (!(cond))                                                 \
+        {                                                            \
+            fprintf(stderr, "%s:%d CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                              \
+        }                                                            \
+    } while (0)
+
+static inline int testResult()
+{
+    printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+    return failures == 0 ? 0 : 1;
+}